@@ -31,14 +31,64 @@
 #include <private/application/sensors/sensor_service.h>
 #include <private/application/sensors/sensor_type.h>
 #include <private/application/sensors/events.h>
+#include <private/application/sensors/sensor_recording.h>
 
+#include <atomic>
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
+
+#include <pthread.h>
 
 namespace
 {
 
 enum sensor_value_t { MIN_DELAY, MIN_VALUE, MAX_VALUE, RESOLUTION };
+
+/* Readings are recorded to the file named by $UBUNTU_PLATFORM_API_SENSOR_RECORD,
+ * if set, for later replay through the test backend. */
+ubuntu::application::sensors::recording::Writer recorder;
+pthread_once_t recorder_once = PTHREAD_ONCE_INIT;
+// set once, read by the listener threads
+std::atomic<bool> recording(false);
+
+void open_recorder()
+{
+    const char* path = getenv("UBUNTU_PLATFORM_API_SENSOR_RECORD");
+    if (path == NULL)
+        return;
+
+    recording = recorder.open(path);
+    if (!recording)
+        ALOGE("Failed to open sensor recording %s", path);
+}
+
+void record_sensor(const ubuntu::application::sensors::Sensor::Ptr& sensor)
+{
+    pthread_once(&recorder_once, open_recorder);
+
+    if (!recording || sensor.get() == NULL)
+        return;
+
+    recorder.add_sensor(
+        sensor->type(),
+        sensor->min_value(),
+        sensor->max_value(),
+        sensor->resolution(),
+        sensor->min_delay());
+}
+
+void record_reading(
+    ubuntu::application::sensors::SensorType type,
+    const ubuntu::application::sensors::SensorReading::Ptr& reading)
+{
+    if (!recording)
+        return;
+
+    // Scalar readings share their storage with the first vector element.
+    recorder.record(type, reading->timestamp, reading->vector.v);
+}
+
 template<ubuntu::application::sensors::SensorType sensor_type>
 struct SensorListener : public ubuntu::application::sensors::SensorListener
 {
@@ -56,6 +106,8 @@ struct SensorListener : public ubuntu::application::sensors::SensorListener
 
     void on_new_reading(const ubuntu::application::sensors::SensorReading::Ptr& reading)
     {
+        record_reading(sensor_type, reading);
+
         switch(sensor_type)
         {
             case ubuntu::application::sensors::sensor_type_orientation:
@@ -244,6 +296,8 @@ ua_sensors_proximity_new()
         ubuntu::application::sensors::SensorService::sensor_for_type(
             ubuntu::application::sensors::sensor_type_proximity);
 
+    record_sensor(proximity);
+
     return proximity.get();
 }
 
@@ -408,6 +462,8 @@ ua_sensors_light_new()
         ubuntu::application::sensors::SensorService::sensor_for_type(
             ubuntu::application::sensors::sensor_type_light);
 
+    record_sensor(light);
+
     return light.get();
 }
 
@@ -569,6 +625,8 @@ ua_sensors_accelerometer_new()
         ubuntu::application::sensors::SensorService::sensor_for_type(
             ubuntu::application::sensors::sensor_type_accelerometer);
 
+    record_sensor(accelerometer);
+
     return accelerometer.get();
 }
 
@@ -758,6 +816,8 @@ ua_sensors_orientation_new()
         ubuntu::application::sensors::SensorService::sensor_for_type(
             ubuntu::application::sensors::sensor_type_orientation);
 
+    record_sensor(orientation);
+
     return orientation.get();
 }
 
@@ -947,6 +1007,8 @@ ua_sensors_gyroscope_new()
         ubuntu::application::sensors::SensorService::sensor_for_type(
             ubuntu::application::sensors::sensor_type_gyroscope);
 
+    record_sensor(gyroscope);
+
     return gyroscope.get();
 }
 
@@ -1137,6 +1199,8 @@ ua_sensors_magnetic_new()
         ubuntu::application::sensors::SensorService::sensor_for_type(
             ubuntu::application::sensors::sensor_type_magnetic_field);
 
+    record_sensor(magnetic);
+
     return magnetic.get();
 }
 
@@ -1326,6 +1390,8 @@ ua_sensors_temperature_new()
         ubuntu::application::sensors::SensorService::sensor_for_type(
             ubuntu::application::sensors::sensor_type_temperature);
 
+    record_sensor(temperature);
+
     return temperature.get();
 }
 
@@ -1487,6 +1553,8 @@ ua_sensors_pressure_new()
         ubuntu::application::sensors::SensorService::sensor_for_type(
             ubuntu::application::sensors::sensor_type_pressure);
 
+    record_sensor(pressure);
+
     return pressure.get();
 }
 
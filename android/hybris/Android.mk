@@ -27,6 +27,8 @@ LOCAL_C_INCLUDES := \
 
 LOCAL_SRC_FILES := \
 	ubuntu_application_gps_for_hybris.cpp \
+	ubuntu_hardware_gps_nmea_for_hybris.cpp \
+	ubuntu_hardware_gps_assist_for_hybris.cpp \
 	ubuntu_application_sensors_for_hybris.cpp \
 	ubuntu_hardware_booster_for_hybris.cpp \
 	../default/default_ubuntu_application_sensor.cpp
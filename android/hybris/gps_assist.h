@@ -0,0 +1,107 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef GPS_ASSIST_H_
+#define GPS_ASSIST_H_
+
+#include <ubuntu/hardware/gps.h>
+
+#include <limits.h>
+#include <pthread.h>
+
+namespace ubuntu
+{
+namespace hardware
+{
+/**
+ * Shortens the chipset's time to first fix with what the previous sessions
+ * learned: the last good fix and the offset of the system clock from GPS
+ * time are kept on disk, and injected into the chipset when it starts or
+ * asks for the time.
+ *
+ * The state lives in $UBUNTU_PLATFORM_API_GPS_ASSIST_FILE, by default
+ * ubuntu-platform-api-gps-assist in $XDG_CACHE_HOME or ~/.cache. Setting
+ * the variable to an empty string disables the assistance, the time to first
+ * fix is recorded either way.
+ *
+ * on_location() and get_time_to_first_fix() may be called from any thread,
+ * the others from one at a time.
+ */
+class GpsAssist
+{
+  public:
+    struct Time
+    {
+        int64_t utc; ///< [ms] since the epoch
+        int64_t reference; ///< [ms] of CLOCK_BOOTTIME the time was taken at
+        int uncertainty; ///< [ms]
+    };
+
+    struct Position
+    {
+        double latitude; ///< [°]
+        double longitude; ///< [°]
+        float accuracy; ///< [m]
+    };
+
+    GpsAssist();
+    ~GpsAssist();
+
+    /** Reads the state of previous sessions, once. */
+    void load();
+    /** Writes the state for later sessions, if it changed. */
+    void save();
+
+    /** The current GPS time, false if the clock offset is unknown. */
+    bool time(Time& time) const;
+    /** The last good fix with its accuracy degraded by its age, false if there is none. */
+    bool position(Position& position) const;
+
+    /** Starts timing the first fix. */
+    void on_started(bool assisted);
+    void on_location(const UHardwareGpsLocation& location);
+
+    void get_time_to_first_fix(UHardwareGpsTimeToFirstFix& ttff);
+
+  private:
+    GpsAssist(const GpsAssist&);
+    GpsAssist& operator=(const GpsAssist&);
+
+    bool enabled;
+    bool loaded;
+    bool dirty;
+    char path[PATH_MAX];
+
+    mutable pthread_mutex_t guard;
+
+    bool has_fix;
+    Position fix;
+    int64_t fix_time; ///< [ms] UTC
+
+    bool has_clock_offset;
+    int64_t clock_offset; ///< [ms] GPS time minus system time
+    int64_t clock_offset_time; ///< [ms] UTC it was measured at
+
+    int64_t start_time; ///< [ms] of CLOCK_BOOTTIME, 0 once the first fix came in
+    bool start_assisted;
+    uint32_t last_ttff;
+    bool last_assisted;
+    uint32_t count[2]; ///< starts timed, by whether they were assisted
+    uint64_t total[2]; ///< [ms] their time to first fix added up
+};
+}
+}
+
+#endif // GPS_ASSIST_H_
@@ -0,0 +1,150 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LOCK_FREE_RING_H_
+#define LOCK_FREE_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ubuntu
+{
+namespace hardware
+{
+/**
+ * Bounded multi-producer, multi-consumer queue after Dmitry Vyukov, with
+ * all slots allocated up front.
+ *
+ * Every slot carries a sequence number telling whether it is free for the
+ * producer or filled for the consumer of a given round, so claiming a slot
+ * takes a single compare and swap and neither side ever waits on the other.
+ * Elements are written and read in place, through functors, to avoid
+ * copying them around.
+ */
+template<typename T>
+class LockFreeRing
+{
+  public:
+    /** Rounds capacity up to a power of two. */
+    explicit LockFreeRing(size_t capacity)
+        : mask(round_up(capacity) - 1),
+          cells(new Cell[mask + 1]),
+          enqueue_position(0),
+          dequeue_position(0)
+    {
+        for (size_t i = 0; i <= mask; i++)
+            cells[i].sequence = i;
+    }
+
+    ~LockFreeRing()
+    {
+        delete[] cells;
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    /** Calls write(T&) on a free slot, false if the ring is full. */
+    template<typename Writer>
+    bool push(const Writer& write)
+    {
+        size_t position = __atomic_load_n(&enqueue_position, __ATOMIC_RELAXED);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &cells[position & mask];
+            size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (__atomic_compare_exchange_n(&enqueue_position, &position, position + 1,
+                                                true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    break;
+            }
+            else if (difference < 0)
+                return false;
+            else
+                position = __atomic_load_n(&enqueue_position, __ATOMIC_RELAXED);
+        }
+
+        write(cell->data);
+        __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /** Calls read(T&) on the oldest element and frees its slot, false if the ring is empty. */
+    template<typename Reader>
+    bool pop(const Reader& read)
+    {
+        size_t position = __atomic_load_n(&dequeue_position, __ATOMIC_RELAXED);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &cells[position & mask];
+            size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0)
+            {
+                if (__atomic_compare_exchange_n(&dequeue_position, &position, position + 1,
+                                                true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    break;
+            }
+            else if (difference < 0)
+                return false;
+            else
+                position = __atomic_load_n(&dequeue_position, __ATOMIC_RELAXED);
+        }
+
+        read(cell->data);
+        __atomic_store_n(&cell->sequence, position + mask + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+  private:
+    LockFreeRing(const LockFreeRing&);
+    LockFreeRing& operator=(const LockFreeRing&);
+
+    static size_t round_up(size_t capacity)
+    {
+        size_t result = 2;
+        while (result < capacity)
+            result <<= 1;
+        return result;
+    }
+
+    struct Cell
+    {
+        size_t sequence;
+        T data;
+    };
+
+    // Producers and consumers each hammer their own position,
+    // keep them on cache lines of their own.
+    enum { cache_line_size = 64 };
+
+    const size_t mask;
+    Cell* const cells;
+    char padding0[cache_line_size];
+    size_t enqueue_position;
+    char padding1[cache_line_size - sizeof(size_t)];
+    size_t dequeue_position;
+    char padding2[cache_line_size - sizeof(size_t)];
+};
+}
+}
+
+#endif // LOCK_FREE_RING_H_
@@ -17,23 +17,71 @@
  */
 #include <ubuntu/hardware/gps.h>
 
+#include "gps_assist.h"
+#include "lock_free_ring.h"
+
 #include <pthread.h>
 
 // android stuff
 #include <hardware/gps.h>
 #include <hardware_legacy/power.h>
 
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 
 #define WAKE_LOCK_NAME  "U_HARDWARE_GPS"
 
+namespace
+{
+// Queued reports at most, each slot takes a bit more than a kilobyte.
+const uint32_t max_queue_size = 4096;
+
+// A report of the chipset driver, queued for dispatch.
+struct Report
+{
+    enum Kind
+    {
+        location_report,
+        status_report,
+        sv_status_report,
+        nmea_report
+    };
+
+    // Longer NMEA output is dropped, drivers report a sentence or a few at a time.
+    enum { max_nmea_length = 512 };
+
+    Kind kind;
+    int64_t timestamp;
+    int length;
+    union
+    {
+        UHardwareGpsLocation location;
+        uint16_t status;
+        UHardwareGpsSvStatus sv_status;
+        char nmea[max_nmea_length];
+    } u;
+};
+
+// The parameters of a set_position_mode() request.
+struct PositionMode
+{
+    uint32_t mode;
+    uint32_t recurrence;
+    uint32_t min_interval;
+    uint32_t preferred_accuracy;
+    uint32_t preferred_time;
+};
+}
+
 struct UHardwareGps_
 {
     UHardwareGps_(UHardwareGpsParams* params);
     ~UHardwareGps_();
 
-    bool init();
-
     bool start();
     bool stop();
     void inject_time(int64_t time, int64_t timeReference, int uncertainty);
@@ -51,12 +99,21 @@ struct UHardwareGps_
                            uint32_t preferred_accuracy, uint32_t preferred_time);
     void inject_xtra_data(char* data, int length);
 
-    const GpsInterface* gps_interface;
-    const GpsXtraInterface* gps_xtra_interface;
-    const AGpsInterface* agps_interface;
-    const GpsNiInterface* gps_ni_interface;
-    const GpsDebugInterface* gps_debug_interface;
-    const AGpsRilInterface* agps_ril_interface;
+    bool set_dispatch_mode(UHardwareGpsDispatchMode mode, uint32_t queue_size,
+                           UHardwareGpsOverflowPolicy policy);
+    void reset_dispatch();
+    ubuntu::hardware::LockFreeRing<Report>* dispatch_queue() const;
+    template<typename Writer>
+    bool enqueue(Report::Kind kind, const Writer& write, bool fits = true);
+    void count_drop(Report::Kind kind);
+    int dispatch();
+    void deliver(const Report& report);
+    void deliver_nmea(int64_t timestamp, const char* nmea, int length);
+
+    void report_location(GpsLocation* location);
+    void report_status(GpsStatus* status);
+    void report_sv_status(GpsSvStatus* sv_status);
+    void report_nmea(GpsUtcTime timestamp, const char* nmea, int length);
 
     UHardwareGpsLocationCallback location_cb;
     UHardwareGpsStatusCallback status_cb;
@@ -75,34 +132,185 @@ struct UHardwareGps_
     UHardwareGpsAGpsRilRequestRefLoc request_refloc_cb;
 
     void* context;
+
+    UHardwareGpsParsedNmeaCallback parsed_nmea_cb;
+    void* parsed_nmea_context;
+
+    // Set in the queued dispatch modes only.
+    ubuntu::hardware::LockFreeRing<Report>* queue;
+    UHardwareGpsDispatchMode dispatch_mode;
+    UHardwareGpsOverflowPolicy overflow_policy;
+    int dispatch_fd;
+    // Whether dispatch_fd was signalled since the queue was last drained.
+    uint32_t dispatch_pending;
+    // Driver callbacks that may be using the queue and dispatch_fd.
+    uint32_t enqueuing;
+    bool dispatch_thread_running;
+    bool dispatch_stopping;
+    pthread_t dispatch_thread;
+    UHardwareGpsDroppedReports dropped;
+
+    // Driver callbacks calling into the instance, see Hal::for_each_client().
+    uint32_t calls;
+    // Set once taken off the list of instances, no further callbacks are made.
+    bool removed;
+
+    // Guarded by the driver's configuration lock, started is also read by
+    // the callbacks. Once the instance is deleted, next links the retired ones.
+    UHardwareGps_* next;
+    bool started;
+    bool has_position_mode;
+    PositionMode position_mode;
 };
 
 namespace
 {
-UHardwareGps hybris_gps_instance = NULL;
+// The chipset driver, shared by all instances of the process. Its reports
+// fan out to every instance, the position modes requested by the instances
+// are merged into one and it runs while any instance is started.
+struct Hal
+{
+    Hal();
+
+    bool init();
+    void cleanup();
+
+    void add(UHardwareGps client);
+    void remove(UHardwareGps client);
+    // Waits for the callbacks to a removed client and retires it.
+    void forget(UHardwareGps client);
+
+    bool apply_position_mode();
+    bool inject_assistance();
+
+    // Calls f(UHardwareGps) for each instance, or each started one, from the
+    // driver's threads. The instances are read from the published table, and
+    // called with a hold on them rather than a lock: the driver's threads
+    // neither block nor allocate here, and the callbacks may create and
+    // delete instances, including their own.
+    template<typename F>
+    void for_each_client(bool started_only, const F& f)
+    {
+        // Counted in before picking the table up, see collect().
+        __atomic_add_fetch(&readers, 1, __ATOMIC_SEQ_CST);
+        const ClientTable* current = __atomic_load_n(&table, __ATOMIC_SEQ_CST);
+
+        // Callbacks may report from within callbacks, one walk per level.
+        Walk walk;
+        walk.calling = NULL;
+        walk.outer = static_cast<Walk*>(pthread_getspecific(walks));
+        pthread_setspecific(walks, &walk);
+
+        for (unsigned int i = 0; current && i < current->count; i++)
+        {
+            UHardwareGps client = current->clients[i];
+            if (started_only && not __atomic_load_n(&client->started, __ATOMIC_ACQUIRE))
+                continue;
+
+            // Held before looking at removed, so that forget() either waits
+            // for the call or the client is skipped.
+            __atomic_add_fetch(&client->calls, 1, __ATOMIC_SEQ_CST);
+            if (not __atomic_load_n(&client->removed, __ATOMIC_SEQ_CST))
+            {
+                walk.calling = client;
+                f(client);
+                walk.calling = NULL;
+            }
+            __atomic_sub_fetch(&client->calls, 1, __ATOMIC_SEQ_CST);
+        }
+
+        pthread_setspecific(walks, walk.outer);
+        __atomic_sub_fetch(&readers, 1, __ATOMIC_SEQ_CST);
+    }
+
+    // The instances as the callbacks see them, replaced as a whole when
+    // instances come and go. Retired tables are linked through next.
+    struct ClientTable
+    {
+        unsigned int count;
+        UHardwareGps* clients;
+        ClientTable* next;
+    };
+
+    // A for_each_client() in progress on the calling thread.
+    struct Walk
+    {
+        UHardwareGps calling;
+        Walk* outer;
+    };
+
+    // Called with config_guard held, after changing the list of instances.
+    void publish();
+    // Frees the retired tables and instances once no callback can see them.
+    void collect();
+    // Number of callbacks of the calling thread calling into client.
+    unsigned int held_here(UHardwareGps client);
+
+    const GpsInterface* gps_interface;
+    const GpsXtraInterface* gps_xtra_interface;
+    const AGpsInterface* agps_interface;
+    const GpsNiInterface* gps_ni_interface;
+    const GpsDebugInterface* gps_debug_interface;
+    const AGpsRilInterface* agps_ril_interface;
+
+    // Reported once by the driver when initialized, replayed to later instances.
+    bool has_capabilities;
+    uint32_t capabilities;
+
+    bool has_applied_position_mode;
+    PositionMode applied_position_mode;
+    unsigned int started_clients;
+
+    ubuntu::hardware::GpsAssist assist;
+
+    // Held while (re)configuring the driver, i.e. by everything but the
+    // callbacks. The driver may report from within its calls, so the
+    // callbacks take no lock at all.
+    pthread_mutex_t config_guard;
+    UHardwareGps clients;
+
+    // Published for the callbacks, see for_each_client().
+    ClientTable* table;
+    // Callbacks that may be using a table, retired ones included.
+    unsigned int readers;
+    pthread_mutex_t retired_guard;
+    ClientTable* retired_tables;
+    UHardwareGps retired_clients;
+    // The innermost Walk of the calling thread.
+    pthread_key_t walks;
+};
+
+Hal hal;
+
+struct ConfigLock
+{
+    ConfigLock()
+    {
+        pthread_mutex_lock(&hal.config_guard);
+    }
+
+    ~ConfigLock()
+    {
+        pthread_mutex_unlock(&hal.config_guard);
+    }
+};
 
 namespace cb
 {
 static void location(GpsLocation* location)
 {
-    if (hybris_gps_instance && hybris_gps_instance->location_cb)
-        hybris_gps_instance->location_cb(
-            reinterpret_cast<UHardwareGpsLocation*>(location),
-            hybris_gps_instance->context);
+    hal.assist.on_location(*reinterpret_cast<UHardwareGpsLocation*>(location));
+    hal.for_each_client(true, [location](UHardwareGps client) { client->report_location(location); });
 }
 
 static void status(GpsStatus* status)
 {
-    if (hybris_gps_instance && hybris_gps_instance->status_cb)
-        hybris_gps_instance->status_cb(status->status, hybris_gps_instance->context);
+    hal.for_each_client(true, [status](UHardwareGps client) { client->report_status(status); });
 }
 
 static void sv_status(GpsSvStatus* sv_status)
 {
-    if (hybris_gps_instance && hybris_gps_instance->sv_status_cb)
-        hybris_gps_instance->sv_status_cb(
-            reinterpret_cast<UHardwareGpsSvStatus*>(sv_status),
-            hybris_gps_instance->context);
+    hal.for_each_client(true, [sv_status](UHardwareGps client) { client->report_sv_status(sv_status); });
 }
 
 #ifdef BOARD_HAS_GNSS_STATUS_CALLBACK
@@ -115,14 +323,22 @@ static void gnss_sv_status(GnssSvStatus*)
 
 static void nmea(GpsUtcTime timestamp, const char* nmea, int length)
 {
-    if (hybris_gps_instance && hybris_gps_instance->nmea_cb)
-        hybris_gps_instance->nmea_cb(timestamp, nmea, length, hybris_gps_instance->context);
+    hal.for_each_client(true, [timestamp, nmea, length](UHardwareGps client)
+    {
+        client->report_nmea(timestamp, nmea, length);
+    });
 }
 
 static void set_capabilities(uint32_t capabilities)
 {
-    if (hybris_gps_instance && hybris_gps_instance->set_capabilities_cb)
-        hybris_gps_instance->set_capabilities_cb(capabilities, hybris_gps_instance->context);
+    hal.capabilities = capabilities;
+    __atomic_store_n(&hal.has_capabilities, true, __ATOMIC_RELEASE);
+
+    hal.for_each_client(false, [capabilities](UHardwareGps client)
+    {
+        if (client->set_capabilities_cb)
+            client->set_capabilities_cb(capabilities, client->context);
+    });
 }
 
 static void acquire_wakelock()
@@ -135,10 +351,31 @@ static void release_wakelock()
     release_wake_lock(WAKE_LOCK_NAME);
 }
 
+static void* answer_utc_time_request(void*)
+{
+    ConfigLock lock;
+    ubuntu::hardware::GpsAssist::Time time;
+    if (hal.gps_interface && hal.assist.time(time))
+        hal.gps_interface->inject_time(time.utc, time.reference, time.uncertainty);
+    return NULL;
+}
+
 static void request_utc_time()
 {
-    if (hybris_gps_instance && hybris_gps_instance->request_utc_time_cb)
-        hybris_gps_instance->request_utc_time_cb(hybris_gps_instance->context);
+    // Answered off the driver's thread, the driver is not to be called back
+    // from within its callbacks.
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    pthread_create(&thread, &attributes, answer_utc_time_request, NULL);
+    pthread_attr_destroy(&attributes);
+
+    hal.for_each_client(false, [](UHardwareGps client)
+    {
+        if (client->request_utc_time_cb)
+            client->request_utc_time_cb(client->context);
+    });
 }
 
 typedef struct 
@@ -186,8 +423,11 @@ GpsCallbacks gps =
 
 static void xtra_download_request()
 {
-    if (hybris_gps_instance && hybris_gps_instance->xtra_download_request_cb)
-        hybris_gps_instance->xtra_download_request_cb(hybris_gps_instance->context);
+    hal.for_each_client(false, [](UHardwareGps client)
+    {
+        if (client->xtra_download_request_cb)
+            client->xtra_download_request_cb(client->context);
+    });
 }
 
 GpsXtraCallbacks gps_xtra =
@@ -198,9 +438,12 @@ GpsXtraCallbacks gps_xtra =
 
 static void agps_status(AGpsStatus* agps_status)
 {
-    if (hybris_gps_instance && hybris_gps_instance->agps_status_cb)
-        hybris_gps_instance->agps_status_cb(
-            reinterpret_cast<UHardwareGpsAGpsStatus*>(agps_status), hybris_gps_instance->context);
+    hal.for_each_client(false, [agps_status](UHardwareGps client)
+    {
+        if (client->agps_status_cb)
+            client->agps_status_cb(
+                reinterpret_cast<UHardwareGpsAGpsStatus*>(agps_status), client->context);
+    });
 }
 
 AGpsCallbacks agps =
@@ -211,10 +454,12 @@ AGpsCallbacks agps =
 
 static void gps_ni_notify(GpsNiNotification *notification)
 {
-    if (hybris_gps_instance && hybris_gps_instance->gps_ni_notify_cb)
-        hybris_gps_instance->gps_ni_notify_cb(
-            reinterpret_cast<UHardwareGpsNiNotification*>(notification),
-            hybris_gps_instance->context);
+    hal.for_each_client(false, [notification](UHardwareGps client)
+    {
+        if (client->gps_ni_notify_cb)
+            client->gps_ni_notify_cb(
+                reinterpret_cast<UHardwareGpsNiNotification*>(notification), client->context);
+    });
 }
 
 GpsNiCallbacks gps_ni =
@@ -225,14 +470,20 @@ GpsNiCallbacks gps_ni =
 
 static void agps_request_set_id(uint32_t flags)
 {
-    if (hybris_gps_instance && hybris_gps_instance->request_setid_cb)
-        hybris_gps_instance->request_setid_cb(flags, hybris_gps_instance->context);
+    hal.for_each_client(false, [flags](UHardwareGps client)
+    {
+        if (client->request_setid_cb)
+            client->request_setid_cb(flags, client->context);
+    });
 }
 
 static void agps_request_ref_location(uint32_t flags)
 {
-    if (hybris_gps_instance && hybris_gps_instance->request_refloc_cb)
-        hybris_gps_instance->request_refloc_cb(flags, hybris_gps_instance->context);
+    hal.for_each_client(false, [flags](UHardwareGps client)
+    {
+        if (client->request_refloc_cb)
+            client->request_refloc_cb(flags, client->context);
+    });
 }
 
 AGpsRilCallbacks agps_ril =
@@ -242,16 +493,62 @@ AGpsRilCallbacks agps_ril =
     cb::create_thread,
 };
 }
+
+// Combines the requests of the instances into the one serving them all:
+// the fastest interval and the best accuracy and time to first fix asked
+// for, periodic fixes if anyone wants them and assistance if anyone
+// wants it, preferring MS based over MS assisted.
+PositionMode merge(const PositionMode& a, const PositionMode& b)
+{
+    PositionMode merged = a;
+
+    if (b.mode == U_HARDWARE_GPS_POSITION_MODE_MS_BASED
+        || merged.mode == U_HARDWARE_GPS_POSITION_MODE_STANDALONE)
+        merged.mode = b.mode;
+    if (b.recurrence == U_HARDWARE_GPS_POSITION_RECURRENCE_PERIODIC)
+        merged.recurrence = b.recurrence;
+    if (b.min_interval < merged.min_interval)
+        merged.min_interval = b.min_interval;
+    // 0 means no preference.
+    if (b.preferred_accuracy && (not merged.preferred_accuracy || b.preferred_accuracy < merged.preferred_accuracy))
+        merged.preferred_accuracy = b.preferred_accuracy;
+    if (b.preferred_time && (not merged.preferred_time || b.preferred_time < merged.preferred_time))
+        merged.preferred_time = b.preferred_time;
+
+    return merged;
 }
 
-UHardwareGps_::UHardwareGps_(UHardwareGpsParams* params)
+bool operator==(const PositionMode& a, const PositionMode& b)
+{
+    return a.mode == b.mode && a.recurrence == b.recurrence && a.min_interval == b.min_interval
+        && a.preferred_accuracy == b.preferred_accuracy && a.preferred_time == b.preferred_time;
+}
+
+Hal::Hal()
     : gps_interface(NULL),
       gps_xtra_interface(NULL),
       agps_interface(NULL),
       gps_ni_interface(NULL),
       gps_debug_interface(NULL),
       agps_ril_interface(NULL),
-      location_cb(params->location_cb),
+      has_capabilities(false),
+      capabilities(0),
+      has_applied_position_mode(false),
+      started_clients(0),
+      clients(NULL),
+      table(NULL),
+      readers(0),
+      retired_tables(NULL),
+      retired_clients(NULL)
+{
+    pthread_mutex_init(&config_guard, NULL);
+    pthread_mutex_init(&retired_guard, NULL);
+    pthread_key_create(&walks, NULL);
+}
+}
+
+UHardwareGps_::UHardwareGps_(UHardwareGpsParams* params)
+    : location_cb(params->location_cb),
       status_cb(params->status_cb),
       sv_status_cb(params->sv_status_cb),
       nmea_cb(params->nmea_cb),
@@ -262,18 +559,34 @@ UHardwareGps_::UHardwareGps_(UHardwareGpsParams* params)
       gps_ni_notify_cb(params->gps_ni_notify_cb),
       request_setid_cb(params->request_setid_cb),
       request_refloc_cb(params->request_refloc_cb),
-      context(params->context)
+      context(params->context),
+      parsed_nmea_cb(NULL),
+      parsed_nmea_context(NULL),
+      queue(NULL),
+      dispatch_mode(U_HARDWARE_GPS_DISPATCH_DIRECT),
+      overflow_policy(U_HARDWARE_GPS_OVERFLOW_DROP_NEWEST),
+      dispatch_fd(-1),
+      dispatch_pending(0),
+      enqueuing(0),
+      dispatch_thread_running(false),
+      dispatch_stopping(false),
+      calls(0),
+      removed(false),
+      next(NULL),
+      started(false),
+      has_position_mode(false)
 {
-   
+    memset(&dropped, 0, sizeof(dropped));
+    memset(&position_mode, 0, sizeof(position_mode));
 }
 
 UHardwareGps_::~UHardwareGps_()
 {
-    if (gps_interface)
-        gps_interface->cleanup();
+    // No longer reported to, the queue can go.
+    reset_dispatch();
 }
 
-bool UHardwareGps_::init()
+bool Hal::init()
 {
     int err;
     hw_module_t* module;
@@ -288,10 +601,12 @@ bool UHardwareGps_::init()
     if (err != 0) return false;
 
     gps_device_t* gps_device = (gps_device_t *)device;
-    gps_interface = gps_device->get_gps_interface(gps_device);
+    const GpsInterface* interface = gps_device->get_gps_interface(gps_device);
+
+    if (not interface) return false;
+    if (interface->init(&cb::gps) != 0) return false;
 
-    if (not gps_interface) return false;
-    if (gps_interface->init(&cb::gps) != 0) return false;
+    gps_interface = interface;
     
     gps_xtra_interface =
             (const GpsXtraInterface*)gps_interface->get_extension(GPS_XTRA_INTERFACE);
@@ -318,44 +633,246 @@ bool UHardwareGps_::init()
     return true;
 }
 
-bool UHardwareGps_::start()
+void Hal::cleanup()
 {
+    assist.save();
+
     if (gps_interface)
-        return (gps_interface->start() == 0);
-    else
+        gps_interface->cleanup();
+
+    gps_interface = NULL;
+    gps_xtra_interface = NULL;
+    agps_interface = NULL;
+    gps_ni_interface = NULL;
+    gps_debug_interface = NULL;
+    agps_ril_interface = NULL;
+    has_capabilities = false;
+    has_applied_position_mode = false;
+}
+
+void Hal::add(UHardwareGps client)
+{
+    client->next = clients;
+    clients = client;
+    publish();
+}
+
+void Hal::remove(UHardwareGps client)
+{
+    for (UHardwareGps* link = &clients; *link; link = &(*link)->next)
+    {
+        if (*link == client)
+        {
+            *link = client->next;
+            break;
+        }
+    }
+
+    // Callbacks in flight may still hold on to the client, see forget().
+    __atomic_store_n(&client->removed, true, __ATOMIC_SEQ_CST);
+    publish();
+}
+
+void Hal::forget(UHardwareGps client)
+{
+    // Waits for the callbacks in flight to the client on other threads to
+    // return, those of this thread no longer call it once they return.
+    unsigned int own = held_here(client);
+    while (__atomic_load_n(&client->calls, __ATOMIC_SEQ_CST) > own)
+        sched_yield();
+
+    // Reports queued for the client are dropped, its memory goes once no
+    // callback can come across it anymore.
+    client->reset_dispatch();
+
+    pthread_mutex_lock(&retired_guard);
+    client->next = retired_clients;
+    retired_clients = client;
+    pthread_mutex_unlock(&retired_guard);
+
+    collect();
+}
+
+void Hal::publish()
+{
+    ClientTable* next = new ClientTable;
+    next->count = 0;
+    for (UHardwareGps client = clients; client; client = client->next)
+        next->count++;
+
+    next->clients = new UHardwareGps[next->count];
+    next->count = 0;
+    for (UHardwareGps client = clients; client; client = client->next)
+        next->clients[next->count++] = client;
+    next->next = NULL;
+
+    ClientTable* previous = __atomic_exchange_n(&table, next, __ATOMIC_SEQ_CST);
+    if (previous)
+    {
+        pthread_mutex_lock(&retired_guard);
+        previous->next = retired_tables;
+        retired_tables = previous;
+        pthread_mutex_unlock(&retired_guard);
+    }
+
+    collect();
+}
+
+void Hal::collect()
+{
+    pthread_mutex_lock(&retired_guard);
+
+    // Callbacks count themselves in before picking the table up, so without
+    // any, none can still see a retired table or the instances only it lists.
+    // Otherwise left to the next instance created or deleted.
+    if (__atomic_load_n(&readers, __ATOMIC_SEQ_CST) == 0)
+    {
+        while (retired_tables)
+        {
+            ClientTable* retired = retired_tables;
+            retired_tables = retired->next;
+            delete[] retired->clients;
+            delete retired;
+        }
+
+        while (retired_clients)
+        {
+            UHardwareGps retired = retired_clients;
+            retired_clients = retired->next;
+            delete retired;
+        }
+    }
+
+    pthread_mutex_unlock(&retired_guard);
+}
+
+unsigned int Hal::held_here(UHardwareGps client)
+{
+    unsigned int held = 0;
+    for (Walk* walk = static_cast<Walk*>(pthread_getspecific(walks)); walk; walk = walk->outer)
+        if (walk->calling == client)
+            held++;
+    return held;
+}
+
+bool Hal::apply_position_mode()
+{
+    // The started instances decide, before any is started the ones that asked.
+    bool any_started = started_clients > 0;
+    bool has_merged = false;
+    PositionMode merged;
+    for (UHardwareGps client = clients; client; client = client->next)
+    {
+        if (not client->has_position_mode || (any_started && not client->started))
+            continue;
+        merged = has_merged ? merge(merged, client->position_mode) : client->position_mode;
+        has_merged = true;
+    }
+
+    if (not has_merged)
+        return true;
+    if (has_applied_position_mode && merged == applied_position_mode)
+        return true;
+
+    if (gps_interface->set_position_mode(merged.mode, merged.recurrence, merged.min_interval,
+                                         merged.preferred_accuracy, merged.preferred_time) != 0)
+        return false;
+
+    applied_position_mode = merged;
+    has_applied_position_mode = true;
+    return true;
+}
+
+bool Hal::inject_assistance()
+{
+    bool assisted = false;
+
+    ubuntu::hardware::GpsAssist::Time time;
+    if (assist.time(time))
+    {
+        gps_interface->inject_time(time.utc, time.reference, time.uncertainty);
+        assisted = true;
+    }
+
+    ubuntu::hardware::GpsAssist::Position position;
+    if (gps_interface->inject_location && assist.position(position))
+    {
+        gps_interface->inject_location(position.latitude, position.longitude, position.accuracy);
+        assisted = true;
+    }
+
+    return assisted;
+}
+
+bool UHardwareGps_::start()
+{
+    ConfigLock lock;
+    if (not hal.gps_interface)
+        return false;
+    if (started)
+        return true;
+
+    __atomic_store_n(&started, true, __ATOMIC_RELEASE);
+    hal.started_clients++;
+    hal.apply_position_mode();
+
+    if (hal.started_clients > 1)
+        return true;
+
+    hal.assist.on_started(hal.inject_assistance());
+    if (hal.gps_interface->start() != 0)
+    {
+        __atomic_store_n(&started, false, __ATOMIC_RELEASE);
+        hal.started_clients--;
         return false;
+    }
+    return true;
 }
 
 bool UHardwareGps_::stop()
 {
-    if (gps_interface)
-        return (gps_interface->stop() == 0);
-    else
+    ConfigLock lock;
+    if (not hal.gps_interface)
         return false;
+    if (not started)
+        return true;
+
+    __atomic_store_n(&started, false, __ATOMIC_RELEASE);
+    hal.started_clients--;
+
+    if (hal.started_clients == 0)
+    {
+        hal.assist.save();
+        return (hal.gps_interface->stop() == 0);
+    }
+
+    // The others may do with less now.
+    hal.apply_position_mode();
+    return true;
 }
 
 void UHardwareGps_::inject_time(int64_t time, int64_t time_reference, int uncertainty)
 {
-    if (gps_interface)
-        gps_interface->inject_time(time, time_reference, uncertainty);
+    if (hal.gps_interface)
+        hal.gps_interface->inject_time(time, time_reference, uncertainty);
 }
 
 void UHardwareGps_::inject_location(double latitude, double longitude, float accuracy)
 {
-    if (gps_interface && gps_interface->inject_location)
-        gps_interface->inject_location(latitude, longitude, accuracy);
+    if (hal.gps_interface && hal.gps_interface->inject_location)
+        hal.gps_interface->inject_location(latitude, longitude, accuracy);
 }
 
 void UHardwareGps_::delete_aiding_data(uint16_t flags)
 {
-    if (gps_interface)
-        gps_interface->delete_aiding_data(flags);
+    if (hal.gps_interface)
+        hal.gps_interface->delete_aiding_data(flags);
 }
 
 void UHardwareGps_::set_server_for_type(UHardwareGpsAGpsType type, const char* hostname, uint16_t port)
 {
-    if (agps_interface && agps_interface->set_server)
-        agps_interface->set_server(type, hostname, port);
+    if (hal.agps_interface && hal.agps_interface->set_server)
+        hal.agps_interface->set_server(type, hostname, port);
 }
 
 void UHardwareGps_::set_reference_location(UHardwareGpsAGpsRefLocation* location, size_t size_of_struct)
@@ -368,42 +885,319 @@ void UHardwareGps_::set_reference_location(UHardwareGpsAGpsRefLocation* location
     ref_loc.u.cellID.lac = location->u.cellID.lac;
     ref_loc.u.cellID.cid = location->u.cellID.cid;
 
-    if (agps_ril_interface && agps_ril_interface->set_ref_location)
-        agps_ril_interface->set_ref_location(&ref_loc, sizeof(ref_loc));
+    if (hal.agps_ril_interface && hal.agps_ril_interface->set_ref_location)
+        hal.agps_ril_interface->set_ref_location(&ref_loc, sizeof(ref_loc));
 }
 
 void UHardwareGps_::notify_connection_is_open(const char* apn)
 {
-    if (agps_interface && agps_interface->data_conn_open)
-        agps_interface->data_conn_open(apn);
+    if (hal.agps_interface && hal.agps_interface->data_conn_open)
+        hal.agps_interface->data_conn_open(apn);
 }
 
 void UHardwareGps_::notify_connection_is_closed()
 {
-    if (agps_interface && agps_interface->data_conn_closed)
-        agps_interface->data_conn_closed();
+    if (hal.agps_interface && hal.agps_interface->data_conn_closed)
+        hal.agps_interface->data_conn_closed();
 }
 
 void UHardwareGps_::notify_connection_not_available()
 {
-    if (agps_interface && agps_interface->data_conn_failed)
-        agps_interface->data_conn_failed();
+    if (hal.agps_interface && hal.agps_interface->data_conn_failed)
+        hal.agps_interface->data_conn_failed();
 }
 
 bool UHardwareGps_::set_position_mode(uint32_t mode, uint32_t recurrence, uint32_t min_interval,
                                     uint32_t preferred_accuracy, uint32_t preferred_time)
 {
-    if (gps_interface)
-        return (gps_interface->set_position_mode(mode, recurrence, min_interval,
-                                                 preferred_accuracy, preferred_time) == 0);
-    else
+    ConfigLock lock;
+    if (not hal.gps_interface)
         return false;
+
+    PositionMode requested = { mode, recurrence, min_interval, preferred_accuracy, preferred_time };
+    position_mode = requested;
+    has_position_mode = true;
+
+    return hal.apply_position_mode();
 }
 
 void UHardwareGps_::inject_xtra_data(char* data, int length)
 {
-    if (gps_xtra_interface)
-        gps_xtra_interface->inject_xtra_data(data, length);
+    if (hal.gps_xtra_interface)
+        hal.gps_xtra_interface->inject_xtra_data(data, length);
+}
+
+namespace
+{
+void* run_dispatch_thread(void* context)
+{
+    UHardwareGps self = static_cast<UHardwareGps>(context);
+    while (not __atomic_load_n(&self->dispatch_stopping, __ATOMIC_ACQUIRE))
+    {
+        struct pollfd fd = { self->dispatch_fd, POLLIN, 0 };
+        if (::poll(&fd, 1, -1) > 0)
+            self->dispatch();
+    }
+    return NULL;
+}
+}
+
+bool UHardwareGps_::set_dispatch_mode(UHardwareGpsDispatchMode mode, uint32_t queue_size,
+                                      UHardwareGpsOverflowPolicy policy)
+{
+    reset_dispatch();
+
+    if (mode == U_HARDWARE_GPS_DISPATCH_DIRECT)
+        return true;
+    if (mode != U_HARDWARE_GPS_DISPATCH_THREAD && mode != U_HARDWARE_GPS_DISPATCH_POLL)
+        return false;
+    if (queue_size == 0 || queue_size > max_queue_size)
+        return false;
+
+    dispatch_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (dispatch_fd < 0)
+        return false;
+
+    dispatch_pending = 0;
+    dispatch_stopping = false;
+    overflow_policy = policy;
+    memset(&dropped, 0, sizeof(dropped));
+
+    if (mode == U_HARDWARE_GPS_DISPATCH_THREAD)
+    {
+        if (pthread_create(&dispatch_thread, NULL, run_dispatch_thread, this) != 0)
+        {
+            reset_dispatch();
+            return false;
+        }
+        dispatch_thread_running = true;
+    }
+
+    // Published last, the driver's callbacks start queueing from here.
+    dispatch_mode = mode;
+    __atomic_store_n(&queue, new ubuntu::hardware::LockFreeRing<Report>(queue_size), __ATOMIC_RELEASE);
+    return true;
+}
+
+void UHardwareGps_::reset_dispatch()
+{
+    ubuntu::hardware::LockFreeRing<Report>* previous = queue;
+    __atomic_store_n(&queue, static_cast<ubuntu::hardware::LockFreeRing<Report>*>(NULL), __ATOMIC_SEQ_CST);
+
+    // Driver callbacks that picked up the queue before may still write to it
+    // and signal dispatch_fd; they are short and never block.
+    while (__atomic_load_n(&enqueuing, __ATOMIC_SEQ_CST) != 0)
+        sched_yield();
+
+    if (dispatch_thread_running)
+    {
+        __atomic_store_n(&dispatch_stopping, true, __ATOMIC_RELEASE);
+        uint64_t one = 1;
+        while (::write(dispatch_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+        pthread_join(dispatch_thread, NULL);
+        dispatch_thread_running = false;
+    }
+
+    if (dispatch_fd >= 0)
+    {
+        ::close(dispatch_fd);
+        dispatch_fd = -1;
+    }
+
+    dispatch_mode = U_HARDWARE_GPS_DISPATCH_DIRECT;
+    delete previous;
+}
+
+ubuntu::hardware::LockFreeRing<Report>* UHardwareGps_::dispatch_queue() const
+{
+    return __atomic_load_n(&queue, __ATOMIC_ACQUIRE);
+}
+
+// Returns false in the direct dispatch mode, the report is to be delivered
+// right away then. Reports that do not fit are dropped.
+template<typename Writer>
+bool UHardwareGps_::enqueue(Report::Kind kind, const Writer& write, bool fits)
+{
+    // Announced before picking the queue up, so that reset_dispatch() waits.
+    __atomic_add_fetch(&enqueuing, 1, __ATOMIC_SEQ_CST);
+
+    ubuntu::hardware::LockFreeRing<Report>* ring = __atomic_load_n(&queue, __ATOMIC_SEQ_CST);
+    if (not ring)
+    {
+        __atomic_sub_fetch(&enqueuing, 1, __ATOMIC_SEQ_CST);
+        return false;
+    }
+    if (not fits)
+    {
+        count_drop(kind);
+        __atomic_sub_fetch(&enqueuing, 1, __ATOMIC_SEQ_CST);
+        return true;
+    }
+
+    auto fill = [kind, &write](Report& report)
+    {
+        report.kind = kind;
+        write(report);
+    };
+
+    bool queued = ring->push(fill);
+    if (not queued && overflow_policy == U_HARDWARE_GPS_OVERFLOW_DROP_OLDEST)
+    {
+        // Consumers may pop concurrently, so the room made might be taken by the
+        // time the report is pushed again; it is dropped then.
+        ring->pop([this](const Report& oldest) { count_drop(oldest.kind); });
+        queued = ring->push(fill);
+    }
+
+    if (not queued)
+        count_drop(kind);
+    // Signal once per drain, not once per report.
+    else if (__atomic_exchange_n(&dispatch_pending, 1, __ATOMIC_SEQ_CST) == 0)
+    {
+        uint64_t one = 1;
+        while (::write(dispatch_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+    }
+
+    __atomic_sub_fetch(&enqueuing, 1, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+void UHardwareGps_::count_drop(Report::Kind kind)
+{
+    uint32_t* counter = &dropped.nmea;
+    switch (kind)
+    {
+    case Report::location_report: counter = &dropped.location; break;
+    case Report::status_report: counter = &dropped.status; break;
+    case Report::sv_status_report: counter = &dropped.sv_status; break;
+    case Report::nmea_report: counter = &dropped.nmea; break;
+    }
+    __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+}
+
+int UHardwareGps_::dispatch()
+{
+    ubuntu::hardware::LockFreeRing<Report>* ring = dispatch_queue();
+    if (not ring)
+        return 0;
+
+    // Clear the signal before draining, reports queued from here on raise it again.
+    uint64_t signalled;
+    while (::read(dispatch_fd, &signalled, sizeof(signalled)) < 0 && errno == EINTR);
+    __atomic_store_n(&dispatch_pending, 0, __ATOMIC_SEQ_CST);
+
+    Report report;
+    int dispatched = 0;
+    while (ring->pop([&report](const Report& queued)
+    {
+        // Copy what is used only, the slot is free for the driver right after.
+        report.kind = queued.kind;
+        report.timestamp = queued.timestamp;
+        report.length = queued.length;
+        switch (queued.kind)
+        {
+        case Report::location_report: report.u.location = queued.u.location; break;
+        case Report::status_report: report.u.status = queued.u.status; break;
+        case Report::sv_status_report: report.u.sv_status = queued.u.sv_status; break;
+        case Report::nmea_report: memcpy(report.u.nmea, queued.u.nmea, queued.length); break;
+        }
+    }))
+    {
+        deliver(report);
+        dispatched++;
+    }
+
+    return dispatched;
+}
+
+void UHardwareGps_::deliver(const Report& report)
+{
+    switch (report.kind)
+    {
+    case Report::location_report:
+        if (location_cb)
+            location_cb(const_cast<UHardwareGpsLocation*>(&report.u.location), context);
+        break;
+    case Report::status_report:
+        if (status_cb)
+            status_cb(report.u.status, context);
+        break;
+    case Report::sv_status_report:
+        if (sv_status_cb)
+            sv_status_cb(const_cast<UHardwareGpsSvStatus*>(&report.u.sv_status), context);
+        break;
+    case Report::nmea_report:
+        deliver_nmea(report.timestamp, report.u.nmea, report.length);
+        break;
+    }
+}
+
+void UHardwareGps_::deliver_nmea(int64_t timestamp, const char* nmea, int length)
+{
+    if (nmea_cb)
+        nmea_cb(timestamp, nmea, length, context);
+
+    if (parsed_nmea_cb)
+    {
+        UHardwareGpsNmeaSentence sentence;
+        for (int offset = 0, consumed;
+             (consumed = u_hardware_gps_nmea_parse(nmea + offset, length - offset, &sentence)) > 0;
+             offset += consumed)
+        {
+            if (sentence.type != U_HARDWARE_GPS_NMEA_UNKNOWN)
+                parsed_nmea_cb(timestamp, &sentence, parsed_nmea_context);
+        }
+    }
+}
+
+void UHardwareGps_::report_location(GpsLocation* location)
+{
+    if (enqueue(Report::location_report, [location](Report& report)
+        {
+            memcpy(&report.u.location, location, sizeof(report.u.location));
+        }))
+        return;
+
+    if (location_cb)
+        location_cb(reinterpret_cast<UHardwareGpsLocation*>(location), context);
+}
+
+void UHardwareGps_::report_status(GpsStatus* status)
+{
+    if (enqueue(Report::status_report, [status](Report& report)
+        {
+            report.u.status = status->status;
+        }))
+        return;
+
+    if (status_cb)
+        status_cb(status->status, context);
+}
+
+void UHardwareGps_::report_sv_status(GpsSvStatus* sv_status)
+{
+    if (enqueue(Report::sv_status_report, [sv_status](Report& report)
+        {
+            memcpy(&report.u.sv_status, sv_status, sizeof(report.u.sv_status));
+        }))
+        return;
+
+    if (sv_status_cb)
+        sv_status_cb(reinterpret_cast<UHardwareGpsSvStatus*>(sv_status), context);
+}
+
+void UHardwareGps_::report_nmea(GpsUtcTime timestamp, const char* nmea, int length)
+{
+    bool fits = length >= 0 && length <= Report::max_nmea_length;
+    if (enqueue(Report::nmea_report, [timestamp, nmea, length](Report& report)
+        {
+            report.timestamp = timestamp;
+            report.length = length;
+            memcpy(report.u.nmea, nmea, length);
+        }, fits))
+        return;
+
+    deliver_nmea(timestamp, nmea, length);
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -411,32 +1205,66 @@ void UHardwareGps_::inject_xtra_data(char* data, int length)
 
 UHardwareGps u_hardware_gps_new(UHardwareGpsParams* params)
 {
-    if (hybris_gps_instance != NULL)
-        return NULL;
-
     UHardwareGps u_hardware_gps = new UHardwareGps_(params);
-    hybris_gps_instance = u_hardware_gps;
 
-    // Try ten times to initialize the GPS HAL interface,
-    // sleeping for 200ms per iteration in case of issues.
-    for (unsigned int i = 0; i < 50; i++)
-        if (u_hardware_gps->init())
-            return hybris_gps_instance = u_hardware_gps;
-        else
-            // Sleep for some time and leave some time for the system
-            // to finish initialization.
-            ::usleep(200 * 1000);
-
-    // This is the error case, as we did not succeed in initializing the GPS interface.
-    delete u_hardware_gps;
-    return hybris_gps_instance;
+    {
+        ConfigLock lock;
+        // Added first, to be told the capabilities while the driver initializes.
+        hal.add(u_hardware_gps);
+
+        if (hal.gps_interface)
+        {
+            // The driver is up for other instances already.
+            if (__atomic_load_n(&hal.has_capabilities, __ATOMIC_ACQUIRE) && u_hardware_gps->set_capabilities_cb)
+                u_hardware_gps->set_capabilities_cb(hal.capabilities, u_hardware_gps->context);
+            return u_hardware_gps;
+        }
+
+        // Try ten times to initialize the GPS HAL interface,
+        // sleeping for 200ms per iteration in case of issues.
+        for (unsigned int i = 0; i < 50; i++)
+            if (hal.init())
+            {
+                hal.assist.load();
+                return u_hardware_gps;
+            }
+            else
+                // Sleep for some time and leave some time for the system
+                // to finish initialization.
+                ::usleep(200 * 1000);
+
+        // This is the error case, as we did not succeed in initializing the GPS interface.
+        hal.remove(u_hardware_gps);
+    }
+
+    hal.forget(u_hardware_gps);
+    return NULL;
 }
 
 void u_hardware_gps_delete(UHardwareGps handle)
 {
-    delete handle;
-    if (handle == hybris_gps_instance)
-        hybris_gps_instance = NULL;
+    {
+        ConfigLock lock;
+        if (handle->started)
+        {
+            __atomic_store_n(&handle->started, false, __ATOMIC_RELEASE);
+            if (--hal.started_clients == 0)
+            {
+                hal.assist.save();
+                hal.gps_interface->stop();
+            }
+        }
+
+        hal.remove(handle);
+
+        if (not hal.clients)
+            hal.cleanup();
+        else
+            hal.apply_position_mode();
+    }
+
+    // Not holding the configuration lock, callbacks in flight may need it.
+    hal.forget(handle);
 }
 
 bool u_hardware_gps_start(UHardwareGps self)
@@ -514,3 +1342,39 @@ void u_hardware_gps_inject_xtra_data(UHardwareGps self, char* data, int length)
 {
     self->inject_xtra_data(data, length);
 }
+
+void u_hardware_gps_set_parsed_nmea_callback(UHardwareGps self, UHardwareGpsParsedNmeaCallback cb,
+                                             void* context)
+{
+    self->parsed_nmea_cb = cb;
+    self->parsed_nmea_context = context;
+}
+
+bool u_hardware_gps_set_dispatch_mode(UHardwareGps self, UHardwareGpsDispatchMode mode,
+                                      uint32_t queue_size, UHardwareGpsOverflowPolicy policy)
+{
+    return self->set_dispatch_mode(mode, queue_size, policy);
+}
+
+int u_hardware_gps_get_dispatch_fd(UHardwareGps self)
+{
+    return self->dispatch_mode == U_HARDWARE_GPS_DISPATCH_POLL ? self->dispatch_fd : -1;
+}
+
+int u_hardware_gps_dispatch(UHardwareGps self)
+{
+    return self->dispatch_mode == U_HARDWARE_GPS_DISPATCH_POLL ? self->dispatch() : 0;
+}
+
+void u_hardware_gps_get_dropped_reports(UHardwareGps self, UHardwareGpsDroppedReports* dropped)
+{
+    dropped->location = __atomic_load_n(&self->dropped.location, __ATOMIC_RELAXED);
+    dropped->status = __atomic_load_n(&self->dropped.status, __ATOMIC_RELAXED);
+    dropped->sv_status = __atomic_load_n(&self->dropped.sv_status, __ATOMIC_RELAXED);
+    dropped->nmea = __atomic_load_n(&self->dropped.nmea, __ATOMIC_RELAXED);
+}
+
+void u_hardware_gps_get_time_to_first_fix(UHardwareGps self, UHardwareGpsTimeToFirstFix* ttff)
+{
+    hal.assist.get_time_to_first_fix(*ttff);
+}
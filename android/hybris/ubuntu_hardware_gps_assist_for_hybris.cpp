@@ -0,0 +1,282 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "gps_assist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+namespace uh = ubuntu::hardware;
+
+namespace
+{
+// Fixes worse than that are not worth keeping.
+const float max_fix_accuracy = 200.f;
+// [m/s] the device is assumed to move at most since the last fix.
+const float assumed_speed = 1.f;
+const float max_position_accuracy = 100000.f;
+const int64_t max_position_age = 7 * 24 * 3600 * 1000LL;
+
+// [ms] between a fix being taken and reported.
+const int clock_offset_uncertainty = 100;
+// Of the system clock when not synchronized, 50ppm.
+const double clock_drift = 50e-6;
+const int max_time_uncertainty = 60 * 1000;
+
+const char* const header = "ubuntu-platform-api-gps-assist 1";
+
+int64_t now(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+bool default_path(char* path, size_t size)
+{
+    if (const char* file = getenv("UBUNTU_PLATFORM_API_GPS_ASSIST_FILE"))
+        return snprintf(path, size, "%s", file) < static_cast<int>(size) && *file;
+
+    if (const char* cache = getenv("XDG_CACHE_HOME"))
+        return snprintf(path, size, "%s/ubuntu-platform-api-gps-assist", cache) < static_cast<int>(size);
+    if (const char* home = getenv("HOME"))
+        return snprintf(path, size, "%s/.cache/ubuntu-platform-api-gps-assist", home) < static_cast<int>(size);
+
+    return false;
+}
+
+struct Lock
+{
+    Lock(pthread_mutex_t& guard) : guard(guard)
+    {
+        pthread_mutex_lock(&guard);
+    }
+
+    ~Lock()
+    {
+        pthread_mutex_unlock(&guard);
+    }
+
+    pthread_mutex_t& guard;
+};
+}
+
+uh::GpsAssist::GpsAssist()
+    : enabled(false),
+      loaded(false),
+      dirty(false),
+      has_fix(false),
+      fix_time(0),
+      has_clock_offset(false),
+      clock_offset(0),
+      clock_offset_time(0),
+      start_time(0),
+      start_assisted(false),
+      last_ttff(0),
+      last_assisted(false)
+{
+    path[0] = 0;
+    memset(&fix, 0, sizeof(fix));
+    memset(count, 0, sizeof(count));
+    memset(total, 0, sizeof(total));
+    pthread_mutex_init(&guard, NULL);
+}
+
+uh::GpsAssist::~GpsAssist()
+{
+    pthread_mutex_destroy(&guard);
+}
+
+void uh::GpsAssist::load()
+{
+    if (loaded)
+        return;
+    loaded = true;
+
+    enabled = default_path(path, sizeof(path));
+    if (not enabled)
+        return;
+
+    FILE* file = fopen(path, "r");
+    if (not file)
+        return;
+
+    Lock lock(guard);
+
+    // Line by line, unknown or malformed lines are skipped.
+    char line[256];
+    bool valid = fgets(line, sizeof(line), file) && strncmp(line, header, strlen(header)) == 0;
+    while (valid && fgets(line, sizeof(line), file))
+    {
+        long long a, b, c, d;
+        if (sscanf(line, "fix %lf %lf %f %lld", &fix.latitude, &fix.longitude, &fix.accuracy, &a) == 4)
+        {
+            fix_time = a;
+            has_fix = true;
+        }
+        else if (sscanf(line, "clock %lld %lld", &a, &b) == 2)
+        {
+            clock_offset = a;
+            clock_offset_time = b;
+            has_clock_offset = true;
+        }
+        else if (sscanf(line, "ttff %lld %lld %lld %lld", &a, &b, &c, &d) == 4)
+        {
+            count[true] = a;
+            total[true] = b;
+            count[false] = c;
+            total[false] = d;
+        }
+    }
+
+    fclose(file);
+}
+
+void uh::GpsAssist::save()
+{
+    if (not enabled)
+        return;
+
+    char temporary[PATH_MAX + 4];
+    if (snprintf(temporary, sizeof(temporary), "%s.new", path) >= static_cast<int>(sizeof(temporary)))
+        return;
+
+    Lock lock(guard);
+    if (not dirty)
+        return;
+
+    // Replaced in one go, so that a crash leaves either state intact.
+    FILE* file = fopen(temporary, "w");
+    if (not file)
+        return;
+
+    fprintf(file, "%s\n", header);
+    if (has_fix)
+        fprintf(file, "fix %.7f %.7f %.1f %lld\n", fix.latitude, fix.longitude, fix.accuracy,
+                static_cast<long long>(fix_time));
+    if (has_clock_offset)
+        fprintf(file, "clock %lld %lld\n", static_cast<long long>(clock_offset),
+                static_cast<long long>(clock_offset_time));
+    fprintf(file, "ttff %u %llu %u %llu\n", count[true], static_cast<unsigned long long>(total[true]),
+            count[false], static_cast<unsigned long long>(total[false]));
+
+    bool written = fflush(file) == 0;
+    written = fclose(file) == 0 && written;
+    if (written && rename(temporary, path) == 0)
+        dirty = false;
+    else
+        remove(temporary);
+}
+
+bool uh::GpsAssist::time(Time& time) const
+{
+    Lock lock(guard);
+    if (not enabled || not has_clock_offset)
+        return false;
+
+    int64_t system = now(CLOCK_REALTIME);
+    int64_t age = system - clock_offset_time;
+    if (age < 0)
+        age = 0;
+
+    double uncertainty = clock_offset_uncertainty + age * clock_drift;
+    if (uncertainty > max_time_uncertainty)
+        return false;
+
+    time.utc = system + clock_offset;
+    time.reference = now(CLOCK_BOOTTIME);
+    time.uncertainty = static_cast<int>(uncertainty);
+    return true;
+}
+
+bool uh::GpsAssist::position(Position& position) const
+{
+    Lock lock(guard);
+    if (not enabled || not has_fix)
+        return false;
+
+    int64_t age = now(CLOCK_REALTIME) + (has_clock_offset ? clock_offset : 0) - fix_time;
+    if (age < 0)
+        age = 0;
+    if (age > max_position_age)
+        return false;
+
+    position = fix;
+    position.accuracy += assumed_speed * age / 1000.f;
+    if (position.accuracy > max_position_accuracy)
+        position.accuracy = max_position_accuracy;
+    return true;
+}
+
+void uh::GpsAssist::on_started(bool assisted)
+{
+    Lock lock(guard);
+    start_time = now(CLOCK_BOOTTIME);
+    start_assisted = assisted;
+    last_ttff = 0;
+    last_assisted = assisted;
+}
+
+void uh::GpsAssist::on_location(const UHardwareGpsLocation& location)
+{
+    if (not (location.flags & U_HARDWARE_GPS_LOCATION_HAS_LAT_LONG))
+        return;
+
+    int64_t system = now(CLOCK_REALTIME);
+
+    Lock lock(guard);
+
+    if (start_time)
+    {
+        int64_t ttff = now(CLOCK_BOOTTIME) - start_time;
+        last_ttff = ttff > 0 ? ttff : 1;
+        count[start_assisted]++;
+        total[start_assisted] += last_ttff;
+        start_time = 0;
+        dirty = true;
+    }
+
+    if (location.timestamp > 0)
+    {
+        clock_offset = location.timestamp - system;
+        clock_offset_time = system;
+        has_clock_offset = true;
+        dirty = true;
+    }
+
+    if ((location.flags & U_HARDWARE_GPS_LOCATION_HAS_ACCURACY)
+        && location.accuracy > 0 && location.accuracy <= max_fix_accuracy)
+    {
+        fix.latitude = location.latitude;
+        fix.longitude = location.longitude;
+        fix.accuracy = location.accuracy;
+        fix_time = location.timestamp > 0 ? location.timestamp : system;
+        has_fix = true;
+        dirty = true;
+    }
+}
+
+void uh::GpsAssist::get_time_to_first_fix(UHardwareGpsTimeToFirstFix& ttff)
+{
+    Lock lock(guard);
+    ttff.last = last_ttff;
+    ttff.last_assisted = last_assisted;
+    ttff.assisted_count = count[true];
+    ttff.assisted_mean = count[true] ? total[true] / count[true] : 0;
+    ttff.unassisted_count = count[false];
+    ttff.unassisted_mean = count[false] ? total[false] / count[false] : 0;
+}
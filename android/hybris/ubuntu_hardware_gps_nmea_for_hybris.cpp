@@ -0,0 +1,466 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <ubuntu/hardware/gps.h>
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NMEA_USE_NEON
+#endif
+
+// The chipset hands over one or a few sentences at a time, many times a
+// second, so sentences are decoded where they lie: a single pass over the
+// text computes the checksum and finds the field separators, 16 bytes at a
+// time where SIMD is available, and the fields are then decoded straight
+// from the buffer.
+
+namespace
+{
+// GSV, the longest sentence decoded, has 21 fields with NMEA 4.1.
+const int max_fields = 24;
+
+const double knots_to_meters_per_second = 1852. / 3600.;
+const double kmh_to_meters_per_second = 1. / 3.6;
+
+struct Field
+{
+    const char* begin;
+    int length;
+};
+
+struct Fields
+{
+    Field field[max_fields];
+    int count;
+
+    // Fields past the end of the sentence read as empty.
+    Field operator[](int i) const
+    {
+        if (i < count)
+            return field[i];
+        Field empty = { NULL, 0 };
+        return empty;
+    }
+};
+
+// Records the field starting after the separator at offset,
+// relative to the start of body.
+inline void add_separator(const char* body, int offset, Fields& fields)
+{
+    if (fields.count == max_fields)
+        return;
+
+    Field& previous = fields.field[fields.count - 1];
+    previous.length = body + offset - previous.begin;
+
+    Field& next = fields.field[fields.count++];
+    next.begin = body + offset + 1;
+}
+
+// Splits body, the text between '$' and '*', into fields and
+// returns the XOR of its bytes.
+unsigned char scan(const char* body, int length, Fields& fields)
+{
+    fields.field[0].begin = body;
+    fields.count = 1;
+
+    unsigned char checksum = 0;
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i commas = _mm_set1_epi8(',');
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(body + i));
+        acc = _mm_xor_si128(acc, chunk);
+
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, commas));
+        while (mask)
+        {
+            add_separator(body, i + __builtin_ctz(mask), fields);
+            mask &= mask - 1;
+        }
+    }
+    // Fold the 16 lanes into one.
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 4));
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 2));
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 1));
+    checksum = static_cast<unsigned char>(_mm_cvtsi128_si32(acc));
+#elif defined(NMEA_USE_NEON)
+    const uint8x16_t commas = vdupq_n_u8(',');
+    uint8x16_t acc = vdupq_n_u8(0);
+    for (; i + 16 <= length; i += 16)
+    {
+        uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(body + i));
+        acc = veorq_u8(acc, chunk);
+
+        // NEON has no movemask, narrowing the comparison leaves a nibble per byte.
+        uint8x16_t matches = vceqq_u8(chunk, commas);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+        while (mask)
+        {
+            int bit = __builtin_ctzll(mask);
+            add_separator(body, i + (bit >> 2), fields);
+            mask &= ~(0xfULL << (bit & ~3));
+        }
+    }
+    uint8x8_t folded = veor_u8(vget_low_u8(acc), vget_high_u8(acc));
+    folded = veor_u8(folded, vreinterpret_u8_u64(vshr_n_u64(vreinterpret_u64_u8(folded), 32)));
+    folded = veor_u8(folded, vreinterpret_u8_u64(vshr_n_u64(vreinterpret_u64_u8(folded), 16)));
+    folded = veor_u8(folded, vreinterpret_u8_u64(vshr_n_u64(vreinterpret_u64_u8(folded), 8)));
+    checksum = vget_lane_u8(folded, 0);
+#endif
+
+    for (; i < length; i++)
+    {
+        checksum ^= static_cast<unsigned char>(body[i]);
+        if (body[i] == ',')
+            add_separator(body, i, fields);
+    }
+
+    Field& last = fields.field[fields.count - 1];
+    last.length = body + length - last.begin;
+
+    return checksum;
+}
+
+inline int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+const double negative_powers_of_ten[] =
+{
+    1., 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9,
+    1e-10, 1e-11, 1e-12, 1e-13, 1e-14, 1e-15, 1e-16, 1e-17, 1e-18
+};
+
+// Plain decimal numbers as found in NMEA, NaN if empty or malformed.
+double to_double(const Field& f)
+{
+    const char* p = f.begin;
+    const char* end = f.begin + f.length;
+    if (p == end)
+        return NAN;
+
+    bool negative = false;
+    if (*p == '-' || *p == '+')
+        negative = *p++ == '-';
+
+    // Accumulate all digits as an integer and scale once, as long as they fit.
+    unsigned long long mantissa = 0;
+    int digits = 0, decimals = 0;
+    bool point = false;
+    for (; p != end; p++)
+    {
+        if (*p == '.' && not point)
+        {
+            point = true;
+            continue;
+        }
+        if (not is_digit(*p))
+            return NAN;
+        if (digits == 18)
+        {
+            // Further integer digits would overflow, further decimals do not matter.
+            if (not point)
+                return NAN;
+            continue;
+        }
+        mantissa = mantissa * 10 + (*p - '0');
+        digits++;
+        if (point)
+            decimals++;
+    }
+    if (digits == 0)
+        return NAN;
+
+    double value = mantissa * negative_powers_of_ten[decimals];
+    return negative ? -value : value;
+}
+
+inline float to_float(const Field& f)
+{
+    return static_cast<float>(to_double(f));
+}
+
+// Unsigned integers, fallback if empty or malformed.
+int to_int(const Field& f, int fallback)
+{
+    if (f.length == 0 || f.length > 9)
+        return fallback;
+
+    int value = 0;
+    for (int i = 0; i < f.length; i++)
+    {
+        if (not is_digit(f.begin[i]))
+            return fallback;
+        value = value * 10 + (f.begin[i] - '0');
+    }
+    return value;
+}
+
+inline char to_char(const Field& f)
+{
+    return f.length > 0 ? f.begin[0] : 0;
+}
+
+inline int two_digits(const char* p)
+{
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+// hhmmss[.sss] to milliseconds since midnight, 0 if malformed.
+uint32_t to_time_of_day(const Field& f)
+{
+    if (f.length < 6)
+        return 0;
+    for (int i = 0; i < 6; i++)
+        if (not is_digit(f.begin[i]))
+            return 0;
+
+    uint32_t ms = (two_digits(f.begin) * 3600 + two_digits(f.begin + 2) * 60 + two_digits(f.begin + 4)) * 1000;
+    if (f.length > 7 && f.begin[6] == '.')
+    {
+        uint32_t scale = 100;
+        for (int i = 7; i < f.length && scale > 0 && is_digit(f.begin[i]); i++, scale /= 10)
+            ms += (f.begin[i] - '0') * scale;
+    }
+    return ms;
+}
+
+// (d)ddmm.mmmm and hemisphere to degrees.
+double to_degrees(const Field& value, const Field& hemisphere, char negative)
+{
+    double v = to_double(value);
+    if (isnan(v))
+        return v;
+
+    double degrees = floor(v / 100.);
+    degrees += (v - degrees * 100.) / 60.;
+    return to_char(hemisphere) == negative ? -degrees : degrees;
+}
+
+void decode_gga(const Fields& f, UHardwareGpsNmeaGga& gga)
+{
+    gga.time_of_day = to_time_of_day(f[1]);
+    gga.latitude = to_degrees(f[2], f[3], 'S');
+    gga.longitude = to_degrees(f[4], f[5], 'W');
+    gga.quality = to_int(f[6], 0);
+    gga.satellites_in_use = to_int(f[7], 0);
+    gga.hdop = to_float(f[8]);
+    gga.altitude = to_float(f[9]);
+    gga.geoid_separation = to_float(f[11]);
+}
+
+void decode_rmc(const Fields& f, UHardwareGpsNmeaRmc& rmc)
+{
+    rmc.time_of_day = to_time_of_day(f[1]);
+    rmc.status = to_char(f[2]);
+    rmc.latitude = to_degrees(f[3], f[4], 'S');
+    rmc.longitude = to_degrees(f[5], f[6], 'W');
+    rmc.speed = static_cast<float>(to_double(f[7]) * knots_to_meters_per_second);
+    rmc.course = to_float(f[8]);
+
+    Field date = f[9];
+    if (date.length == 6 && to_int(date, -1) >= 0)
+    {
+        rmc.day = two_digits(date.begin);
+        rmc.month = two_digits(date.begin + 2);
+        int year = two_digits(date.begin + 4);
+        // Two digit years, receivers older than 1980 are rare.
+        rmc.year = year < 80 ? 2000 + year : 1900 + year;
+    }
+
+    rmc.magnetic_variation = to_float(f[10]);
+    if (to_char(f[11]) == 'W')
+        rmc.magnetic_variation = -rmc.magnetic_variation;
+    rmc.mode = to_char(f[12]);
+}
+
+void decode_gsa(const Fields& f, UHardwareGpsNmeaGsa& gsa)
+{
+    gsa.selection = to_char(f[1]);
+    gsa.fix_type = to_int(f[2], 0);
+    for (int i = 0; i < U_HARDWARE_GPS_NMEA_GSA_MAX_SATELLITES; i++)
+    {
+        int prn = to_int(f[3 + i], 0);
+        if (prn > 0)
+            gsa.prn[gsa.count++] = prn;
+    }
+    gsa.pdop = to_float(f[15]);
+    gsa.hdop = to_float(f[16]);
+    gsa.vdop = to_float(f[17]);
+    gsa.system = to_int(f[18], 0);
+}
+
+void decode_gsv(const Fields& f, UHardwareGpsNmeaGsv& gsv)
+{
+    gsv.total_messages = to_int(f[1], 0);
+    gsv.message_number = to_int(f[2], 0);
+    gsv.satellites_in_view = to_int(f[3], 0);
+    // NMEA 4.1 appends a signal id after the last satellite.
+    for (int i = 4; i + 3 < f.count && gsv.count < U_HARDWARE_GPS_NMEA_GSV_MAX_SATELLITES; i += 4)
+    {
+        int prn = to_int(f[i], 0);
+        if (prn == 0)
+            continue;
+
+        UHardwareGpsNmeaSatellite& satellite = gsv.satellites[gsv.count++];
+        satellite.prn = prn;
+        satellite.elevation = to_int(f[i + 1], -1);
+        satellite.azimuth = to_int(f[i + 2], -1);
+        satellite.snr = to_int(f[i + 3], -1);
+    }
+}
+
+void decode_vtg(const Fields& f, UHardwareGpsNmeaVtg& vtg)
+{
+    vtg.course = to_float(f[1]);
+    if (to_char(f[2]) != 'T' && f[2].length > 0)
+    {
+        // Before NMEA 2.3: course, magnetic course, knots, km/h.
+        vtg.magnetic_course = to_float(f[2]);
+        vtg.speed = static_cast<float>(to_double(f[3]) * knots_to_meters_per_second);
+        return;
+    }
+
+    vtg.magnetic_course = to_float(f[3]);
+    double knots = to_double(f[5]);
+    vtg.speed = static_cast<float>(isnan(knots) ? to_double(f[7]) * kmh_to_meters_per_second
+                                                : knots * knots_to_meters_per_second);
+    vtg.mode = to_char(f[9]);
+}
+
+UHardwareGpsNmeaSentenceType type_of(const char* formatter)
+{
+    switch (formatter[0])
+    {
+    case 'G':
+        if (formatter[1] == 'G' && formatter[2] == 'A')
+            return U_HARDWARE_GPS_NMEA_GGA;
+        if (formatter[1] == 'S' && formatter[2] == 'A')
+            return U_HARDWARE_GPS_NMEA_GSA;
+        if (formatter[1] == 'S' && formatter[2] == 'V')
+            return U_HARDWARE_GPS_NMEA_GSV;
+        break;
+    case 'R':
+        if (formatter[1] == 'M' && formatter[2] == 'C')
+            return U_HARDWARE_GPS_NMEA_RMC;
+        break;
+    case 'V':
+        if (formatter[1] == 'T' && formatter[2] == 'G')
+            return U_HARDWARE_GPS_NMEA_VTG;
+        break;
+    }
+    return U_HARDWARE_GPS_NMEA_UNKNOWN;
+}
+
+void decode(const char* sentence, int length, UHardwareGpsNmeaSentence* out)
+{
+    // $<talker><formatter>,...*hh
+    const char* star = static_cast<const char*>(memchr(sentence, '*', length));
+    if (not star || sentence + length - star < 3)
+        return;
+
+    int expected = hex_digit(star[1]) << 4 | hex_digit(star[2]);
+    if (expected < 0)
+        return;
+
+    Fields fields;
+    if (scan(sentence + 1, star - sentence - 1, fields) != expected)
+        return;
+
+    const Field& address = fields.field[0];
+    // Proprietary sentences start with 'P' and have no talker.
+    if (address.length != 5 || address.begin[0] == 'P')
+        return;
+
+    out->talker[0] = address.begin[0];
+    out->talker[1] = address.begin[1];
+
+    switch (out->type = type_of(address.begin + 2))
+    {
+    case U_HARDWARE_GPS_NMEA_GGA:
+        decode_gga(fields, out->u.gga);
+        break;
+    case U_HARDWARE_GPS_NMEA_RMC:
+        decode_rmc(fields, out->u.rmc);
+        break;
+    case U_HARDWARE_GPS_NMEA_GSA:
+        decode_gsa(fields, out->u.gsa);
+        break;
+    case U_HARDWARE_GPS_NMEA_GSV:
+        decode_gsv(fields, out->u.gsv);
+        break;
+    case U_HARDWARE_GPS_NMEA_VTG:
+        decode_vtg(fields, out->u.vtg);
+        break;
+    default:
+        break;
+    }
+}
+}
+
+int u_hardware_gps_nmea_parse(const char* nmea, int length, UHardwareGpsNmeaSentence* sentence)
+{
+    if (not nmea || length <= 0)
+        return 0;
+
+    // Talker sentences start with '$', encapsulation ones (AIS) with '!'.
+    const char* begin = nmea;
+    const char* end = nmea + length;
+    while (begin != end && *begin != '$' && *begin != '!')
+        begin++;
+    if (begin == end)
+        return 0;
+
+    const char* line_end = static_cast<const char*>(memchr(begin, '\n', end - begin));
+    const char* next = line_end ? line_end + 1 : end;
+    // Some chipsets zero terminate the text and count the terminator.
+    const char* terminator = static_cast<const char*>(memchr(begin, '\0', next - begin));
+    if (terminator)
+        line_end = next = terminator;
+    else if (not line_end)
+        line_end = end;
+    if (line_end != begin && line_end[-1] == '\r')
+        line_end--;
+
+    memset(sentence, 0, sizeof(*sentence));
+    sentence->type = U_HARDWARE_GPS_NMEA_UNKNOWN;
+    if (*begin == '$')
+        decode(begin, line_end - begin, sentence);
+
+    // Nothing follows a terminator.
+    return terminator ? length : next - nmea;
+}
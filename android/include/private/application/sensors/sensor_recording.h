@@ -0,0 +1,452 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UBUNTU_APPLICATION_SENSORS_SENSOR_RECORDING_H_
+#define UBUNTU_APPLICATION_SENSORS_SENSOR_RECORDING_H_
+
+#include "private/application/sensors/sensor_type.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ubuntu
+{
+namespace application
+{
+namespace sensors
+{
+/**
+ * Compact binary format for recording sensor readings and replaying them
+ * later, e.g. through the test backend.
+ *
+ * A recording consists of a fixed-size Header, a table of max_sensors
+ * SensorEntry records indexed by SensorType, and a stream of samples. Every
+ * sample starts with a SampleHeader carrying the delta to the timestamp of
+ * the previous sample in [ns], followed by an optional absolute timestamp
+ * (sample_flag_absolute_timestamp) and value_count raw float readings. All
+ * fields are stored in host byte order.
+ */
+namespace recording
+{
+static const char magic[8] = {'U', 'P', 'A', 'S', 'R', 'E', 'C', '\0'};
+
+enum
+{
+    format_version = 1,
+    max_sensors = 16,
+    max_values = 3
+};
+
+enum SampleFlags
+{
+    sample_flag_absolute_timestamp = 1 << 0 ///< An int64_t absolute timestamp follows the SampleHeader.
+};
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t sensor_table_offset;
+    uint32_t sensor_entry_size;
+    uint32_t sensor_count; ///< Number of entries in the sensor table, always max_sensors.
+    uint32_t samples_offset;
+    int64_t start_timestamp; ///< Timestamp of the first sample in [ns], -1 if there is none.
+};
+
+struct SensorEntry
+{
+    uint32_t type; ///< The SensorType, identical to the index into the table.
+    uint32_t value_count; ///< Number of values per sample, 0 if the sensor is not part of the recording.
+    float min_value;
+    float max_value;
+    float resolution;
+    int32_t min_delay;
+};
+
+struct SampleHeader
+{
+    uint32_t delta; ///< Delta to the timestamp of the previous sample in [ns].
+    uint16_t sensor; ///< The SensorType of the sample.
+    uint16_t flags; ///< A combination of SampleFlags.
+};
+
+/** A decoded sample as returned by Reader::next(). */
+struct Sample
+{
+    SensorType type;
+    int64_t timestamp;
+    uint32_t value_count;
+    float values[max_values];
+};
+
+/** Returns the number of float values a reading of the given type carries. */
+inline uint32_t value_count_for_type(SensorType type)
+{
+    switch (type)
+    {
+        case sensor_type_light:
+        case sensor_type_proximity:
+        case sensor_type_temperature:
+        case sensor_type_pressure:
+            return 1;
+        case undefined_sensor_type:
+            return 0;
+        default:
+            return 3;
+    }
+}
+
+/**
+ * Appends samples to a recording file. All functions are thread-safe. The
+ * recording stops, closing the file, on the first failed write, so that it
+ * never holds samples at offsets other than the ones the header implies.
+ */
+class Writer
+{
+public:
+    Writer() : fd(-1), end(0), fill(0), last_timestamp(-1)
+    {
+        pthread_mutex_init(&guard, NULL);
+    }
+
+    ~Writer()
+    {
+        close();
+        pthread_mutex_destroy(&guard);
+    }
+
+    /** Creates or truncates the file at path and writes an empty sensor table. */
+    bool open(const char* path)
+    {
+        Lock lock(guard);
+
+        fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+
+        Header header;
+        ::memcpy(header.magic, magic, sizeof(magic));
+        header.version = format_version;
+        header.header_size = sizeof(Header);
+        header.sensor_table_offset = sizeof(Header);
+        header.sensor_entry_size = sizeof(SensorEntry);
+        header.sensor_count = max_sensors;
+        header.samples_offset = sizeof(Header) + max_sensors * sizeof(SensorEntry);
+        header.start_timestamp = -1;
+
+        SensorEntry table[max_sensors];
+        ::memset(table, 0, sizeof(table));
+        for (unsigned int i = 0; i < max_sensors; i++)
+            table[i].type = i;
+
+        if (!write_at(&header, sizeof(header), 0) || !write_at(table, sizeof(table), sizeof(header)))
+            return false;
+
+        end = header.samples_offset;
+        return true;
+    }
+
+    /** Flushes pending samples and closes the file. */
+    void close()
+    {
+        Lock lock(guard);
+
+        // a failed flush closes the file itself
+        if (fd < 0 || !flush_locked())
+            return;
+
+        ::close(fd);
+        fd = -1;
+    }
+
+    bool is_open()
+    {
+        Lock lock(guard);
+        return fd >= 0;
+    }
+
+    /** Stores the metadata of a sensor in the table. */
+    void add_sensor(SensorType type, float min_value, float max_value, float resolution, int32_t min_delay)
+    {
+        Lock lock(guard);
+
+        if (fd < 0 || static_cast<unsigned int>(type) >= max_sensors)
+            return;
+
+        SensorEntry entry;
+        entry.type = type;
+        entry.value_count = value_count_for_type(type);
+        entry.min_value = min_value;
+        entry.max_value = max_value;
+        entry.resolution = resolution;
+        entry.min_delay = min_delay;
+
+        write_at(&entry, sizeof(entry), sizeof(Header) + type * sizeof(SensorEntry));
+    }
+
+    /** Appends a sample, timestamp in [ns]. */
+    void record(SensorType type, int64_t timestamp, const float* values)
+    {
+        Lock lock(guard);
+
+        if (fd < 0 || static_cast<unsigned int>(type) >= max_sensors)
+            return;
+
+        uint32_t count = value_count_for_type(type);
+        size_t size = sizeof(SampleHeader) + sizeof(int64_t) + count * sizeof(float);
+        if (fill + size > sizeof(buffer) && !flush_locked())
+            return;
+
+        SampleHeader sample;
+        sample.sensor = type;
+        sample.flags = 0;
+        sample.delta = 0;
+
+        if (last_timestamp < 0)
+        {
+            int64_t start = timestamp;
+            if (!write_at(&start, sizeof(start), offsetof(Header, start_timestamp)))
+                return;
+            sample.flags |= sample_flag_absolute_timestamp;
+        } else if (timestamp < last_timestamp || timestamp - last_timestamp > 0xffffffffLL)
+        {
+            sample.flags |= sample_flag_absolute_timestamp;
+        } else
+        {
+            sample.delta = static_cast<uint32_t>(timestamp - last_timestamp);
+        }
+        last_timestamp = timestamp;
+
+        append(&sample, sizeof(sample));
+        if (sample.flags & sample_flag_absolute_timestamp)
+            append(&timestamp, sizeof(timestamp));
+        append(values, count * sizeof(float));
+    }
+
+    /** Writes buffered samples to the file. */
+    void flush()
+    {
+        Lock lock(guard);
+        flush_locked();
+    }
+
+private:
+    struct Lock
+    {
+        Lock(pthread_mutex_t& m) : m(m) { pthread_mutex_lock(&m); }
+        ~Lock() { pthread_mutex_unlock(&m); }
+        pthread_mutex_t& m;
+    };
+
+    void append(const void* data, size_t size)
+    {
+        ::memcpy(buffer + fill, data, size);
+        fill += size;
+    }
+
+    bool flush_locked()
+    {
+        if (fd < 0 || fill == 0)
+            return fd >= 0;
+
+        if (!write_at(buffer, fill, end))
+            return false;
+
+        end += fill;
+        fill = 0;
+        return true;
+    }
+
+    /** Writes all of data at offset, stopping the recording if that fails. */
+    bool write_at(const void* data, size_t size, off_t offset)
+    {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            ssize_t written = ::pwrite(fd, p, size, offset);
+            if (written < 0 && errno == EINTR)
+                continue;
+
+            if (written <= 0)
+            {
+                ::close(fd);
+                fd = -1;
+                fill = 0;
+                return false;
+            }
+
+            p += written;
+            size -= written;
+            offset += written;
+        }
+
+        return true;
+    }
+
+    pthread_mutex_t guard;
+    int fd;
+    off_t end;
+    size_t fill;
+    int64_t last_timestamp;
+    char buffer[4096];
+
+protected:
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+};
+
+/** Iterates over the samples of a memory-mapped recording. */
+class Reader
+{
+public:
+    Reader() : data(NULL), size(0), position(0), last_timestamp(-1)
+    {
+    }
+
+    ~Reader()
+    {
+        close();
+    }
+
+    /** Maps the recording at path and validates its header. */
+    bool open(const char* path)
+    {
+        close();
+
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* map = ::mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+            return false;
+
+        data = static_cast<const char*>(map);
+        size = st.st_size;
+
+        ::memcpy(&header, data, sizeof(header));
+        if (::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+            header.version != format_version ||
+            header.sensor_entry_size != sizeof(SensorEntry) ||
+            header.sensor_table_offset + static_cast<size_t>(header.sensor_count) * sizeof(SensorEntry) > size ||
+            header.samples_offset > size)
+        {
+            close();
+            return false;
+        }
+
+        rewind();
+        return true;
+    }
+
+    void close()
+    {
+        if (data != NULL)
+            ::munmap(const_cast<char*>(data), size);
+
+        data = NULL;
+        size = 0;
+    }
+
+    /** Fills in the metadata of the given sensor; returns false if it is not part of the recording. */
+    bool sensor(SensorType type, SensorEntry& entry) const
+    {
+        if (data == NULL || static_cast<uint32_t>(type) >= header.sensor_count)
+            return false;
+
+        ::memcpy(&entry, data + header.sensor_table_offset + type * sizeof(SensorEntry), sizeof(entry));
+        return entry.value_count > 0;
+    }
+
+    int64_t start_timestamp() const
+    {
+        return header.start_timestamp;
+    }
+
+    /** Restarts iteration at the first sample. */
+    void rewind()
+    {
+        position = header.samples_offset;
+        last_timestamp = header.start_timestamp;
+    }
+
+    /** Decodes the next sample; returns false at the end of the recording or on truncated data. */
+    bool next(Sample& sample)
+    {
+        if (data == NULL || position + sizeof(SampleHeader) > size)
+            return false;
+
+        SampleHeader sh;
+        ::memcpy(&sh, data + position, sizeof(sh));
+        size_t p = position + sizeof(sh);
+
+        int64_t timestamp = last_timestamp + sh.delta;
+        if (sh.flags & sample_flag_absolute_timestamp)
+        {
+            if (p + sizeof(int64_t) > size)
+                return false;
+            ::memcpy(&timestamp, data + p, sizeof(timestamp));
+            p += sizeof(timestamp);
+        }
+
+        SensorType type = static_cast<SensorType>(sh.sensor);
+        uint32_t count = value_count_for_type(type);
+        if (count > max_values || p + count * sizeof(float) > size)
+            return false;
+
+        sample.type = type;
+        sample.timestamp = timestamp;
+        sample.value_count = count;
+        ::memcpy(sample.values, data + p, count * sizeof(float));
+
+        position = p + count * sizeof(float);
+        last_timestamp = timestamp;
+        return true;
+    }
+
+private:
+    const char* data;
+    size_t size;
+    size_t position;
+    int64_t last_timestamp;
+    Header header;
+
+protected:
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+};
+}
+}
+}
+}
+
+#endif // UBUNTU_APPLICATION_SENSORS_SENSOR_RECORDING_H_
@@ -22,6 +22,11 @@
 
 #include <ubuntu/application/sensors/haptic.h>
 
+static void on_vibrated(UStatus status, void* context)
+{
+    printf("%s acknowledged: %s\n", (const char*) context, status == U_STATUS_SUCCESS ? "ok" : "error");
+}
+
 int main(int argc, char *argv[])
 {
     UASensorsHaptic *sensor = ua_sensors_haptic_new();
@@ -40,5 +45,12 @@ int main(int argc, char *argv[])
     uint32_t pattern[MAX_PATTERN_SIZE] = {1500, 1500, 1500, 1500, 1500, 1500};
     ua_sensors_haptic_vibrate_with_pattern(sensor, pattern, 2);
 
+    sleep(10);
+
+    printf("Vibrating once for 500ms without blocking\n");
+    ua_sensors_haptic_vibrate_once_async(sensor, 500, on_vibrated, (void*) "Asynchronous vibration");
+
+    sleep(1);
+
     return 0;
 }
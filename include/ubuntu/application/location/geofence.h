@@ -0,0 +1,147 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UBUNTU_APPLICATION_LOCATION_GEOFENCE_H_
+#define UBUNTU_APPLICATION_LOCATION_GEOFENCE_H_
+
+#include <ubuntu/application/location/position_update.h>
+
+#include <ubuntu/status.h>
+#include <ubuntu/visibility.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * \brief Opaque type encapsulating a set of geofences.
+     * \ingroup location_service
+     */
+    typedef struct UbuntuApplicationLocationGeofenceSet UALocationGeofenceSet;
+
+    /**
+     * \brief Transitions a geofence reports.
+     * \ingroup location_service
+     */
+    typedef enum
+    {
+        UA_LOCATION_GEOFENCE_ENTER = 1 << 0, /**< A fix inside the fence followed one outside of it, or none. */
+        UA_LOCATION_GEOFENCE_EXIT = 1 << 1, /**< A fix outside the fence followed one inside of it. */
+        UA_LOCATION_GEOFENCE_DWELL = 1 << 2 /**< All fixes were inside the fence for its dwell time. */
+    } UbuntuApplicationLocationGeofenceTransition;
+
+    typedef UbuntuApplicationLocationGeofenceTransition UALocationGeofenceTransition;
+
+    /**
+     * \brief A circular geofence.
+     * \ingroup location_service
+     */
+    typedef struct
+    {
+        uint32_t id; /**< Identifies the fence within its set. */
+        double latitude; /**< Latitude of the center in [°]. */
+        double longitude; /**< Longitude of the center in [°]. */
+        double radius; /**< Radius in [m]. */
+        uint32_t transitions; /**< Bitmask of UALocationGeofenceTransition to be reported. */
+        uint32_t dwell_time_in_ms; /**< Time inside the fence after which UA_LOCATION_GEOFENCE_DWELL is reported. */
+    } UALocationGeofence;
+
+    /**
+     * \brief Callback type that is invoked for geofence transitions.
+     * \ingroup location_service
+     */
+    typedef void (*UALocationGeofenceTransitionHandler)(
+        UALocationGeofenceSet *set,
+        uint32_t id,
+        UALocationGeofenceTransition transition,
+        const UALocationPosition *position,
+        void *context);
+
+    /**
+     * \brief Creates a new, empty set of geofences.
+     * \ingroup location_service
+     * \returns A new set with a reference count of 1, or NULL in case of errors.
+     */
+    UBUNTU_DLL_PUBLIC UALocationGeofenceSet*
+    ua_location_geofence_set_new();
+
+    /**
+     * \brief Increments the reference count of the geofence set.
+     * \ingroup location_service
+     * \param[in] set The geofence set to increment the reference count for.
+     */
+    UBUNTU_DLL_PUBLIC void
+    ua_location_geofence_set_ref(
+        UALocationGeofenceSet *set);
+
+    /**
+     * \brief Decrements the reference count of the geofence set.
+     * \ingroup location_service
+     * \param[in] set The geofence set to decrement the reference count for.
+     */
+    UBUNTU_DLL_PUBLIC void
+    ua_location_geofence_set_unref(
+        UALocationGeofenceSet *set);
+
+    /**
+     * \brief Adds a geofence to the set, or replaces the one with the same id.
+     * \ingroup location_service
+     * A replaced fence starts out as not entered.
+     * \returns U_STATUS_SUCCESS if the fence was added, U_STATUS_ERROR if an argument is invalid.
+     * \param[in] set The geofence set to add to.
+     * \param[in] fence The fence, copied into the set.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_geofence_set_add(
+        UALocationGeofenceSet *set,
+        const UALocationGeofence *fence);
+
+    /**
+     * \brief Removes a geofence from the set. No transitions are reported for it afterwards.
+     * \ingroup location_service
+     * \returns U_STATUS_SUCCESS if the fence was removed, U_STATUS_ERROR if it is not in the set.
+     * \param[in] set The geofence set to remove from.
+     * \param[in] id The id of the fence.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_geofence_set_remove(
+        UALocationGeofenceSet *set,
+        uint32_t id);
+
+    /**
+     * \brief Installs the handler that is invoked for transitions of the fences in the set.
+     * \ingroup location_service
+     * The handler is invoked on the thread delivering position updates, with
+     * the set unlocked. It may add and remove fences and release the set.
+     * \returns U_STATUS_SUCCESS if the handler was installed, else U_STATUS_ERROR.
+     * \param[in] set The geofence set to install the handler for.
+     * \param[in] handler The transition handler, or NULL to remove it.
+     * \param[in] context Passed on to the handler.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_geofence_set_set_transition_handler(
+        UALocationGeofenceSet *set,
+        UALocationGeofenceTransitionHandler handler,
+        void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UBUNTU_APPLICATION_LOCATION_GEOFENCE_H_
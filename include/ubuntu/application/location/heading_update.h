@@ -19,6 +19,7 @@
 #ifndef UBUNTU_APPLICATION_LOCATION_HEADING_UPDATE_H_
 #define UBUNTU_APPLICATION_LOCATION_HEADING_UPDATE_H_
 
+#include <ubuntu/status.h>
 #include <ubuntu/visibility.h>
 
 #include <stdbool.h>
@@ -73,6 +74,28 @@ extern "C"
     ua_location_heading_update_get_heading_in_degree(
         UALocationHeadingUpdate *update);
 
+    /**
+     * \brief All values of a heading update, copied out in one step.
+     * \ingroup location_service
+     */
+    typedef struct
+    {
+        uint64_t timestamp; /**< Timestamp of the update in [µs]. */
+        double heading; /**< Heading in [°]. */
+    } UALocationHeading;
+
+    /**
+     * \brief Copies all values of the heading update at once.
+     * \ingroup location_service
+     * \returns U_STATUS_SUCCESS if the snapshot was filled in, U_STATUS_ERROR if an argument is NULL.
+     * \param[in] update The heading update instance to be queried.
+     * \param[out] heading Receives the values of the update.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_heading_update_read(
+        UALocationHeadingUpdate *update,
+        UALocationHeading *heading);
+
 #ifdef __cplusplus
 }
 #endif
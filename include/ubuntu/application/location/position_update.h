@@ -19,6 +19,7 @@
 #ifndef UBUNTU_APPLICATION_LOCATION_POSITION_UPDATE_H_
 #define UBUNTU_APPLICATION_LOCATION_POSITION_UPDATE_H_
 
+#include <ubuntu/status.h>
 #include <ubuntu/visibility.h>
 
 #include <stdbool.h>
@@ -143,6 +144,46 @@ extern "C"
     ua_location_position_update_get_vertical_accuracy_in_meter(
         UALocationPositionUpdate *update);
 
+    /**
+     * \brief Optional fields of a position snapshot.
+     * \ingroup location_service
+     */
+    typedef enum
+    {
+        UA_LOCATION_POSITION_ALTITUDE = 1 << 0, /**< altitude is valid. */
+        UA_LOCATION_POSITION_HORIZONTAL_ACCURACY = 1 << 1, /**< horizontal_accuracy is valid. */
+        UA_LOCATION_POSITION_VERTICAL_ACCURACY = 1 << 2 /**< vertical_accuracy is valid. */
+    } UbuntuApplicationLocationPositionField;
+
+    typedef UbuntuApplicationLocationPositionField UALocationPositionField;
+
+    /**
+     * \brief All values of a position update, copied out in one step.
+     * \ingroup location_service
+     */
+    typedef struct
+    {
+        uint64_t timestamp; /**< Timestamp of the update in [µs]. */
+        double latitude; /**< Latitude in [°]. */
+        double longitude; /**< Longitude in [°]. */
+        double altitude; /**< Altitude in [m], only valid if UA_LOCATION_POSITION_ALTITUDE is set in valid. */
+        double horizontal_accuracy; /**< Horizontal accuracy in [m], only valid if UA_LOCATION_POSITION_HORIZONTAL_ACCURACY is set in valid. */
+        double vertical_accuracy; /**< Vertical accuracy in [m], only valid if UA_LOCATION_POSITION_VERTICAL_ACCURACY is set in valid. */
+        uint32_t valid; /**< Bitmask of UALocationPositionField, fields not set are 0. */
+    } UALocationPosition;
+
+    /**
+     * \brief Copies all values of the position update at once.
+     * \ingroup location_service
+     * \returns U_STATUS_SUCCESS if the snapshot was filled in, U_STATUS_ERROR if an argument is NULL.
+     * \param[in] update The position update instance to be queried.
+     * \param[out] position Receives the values of the update.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_position_update_read(
+        UALocationPositionUpdate *update,
+        UALocationPosition *position);
+
 #ifdef __cplusplus
 }
 #endif
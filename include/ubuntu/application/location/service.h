@@ -134,6 +134,56 @@ extern "C"
         UALocationServiceRequirementsFlags flags,
         UALocationServiceError* status);
 
+    /**
+     * \brief Callback type for reporting the outcome of asynchronous session creation.
+     * \ingroup location_service
+     * \param[in] session The new session, owned by the application, or NULL in case of errors.
+     * \param[in] error Describes why the session could not be created.
+     * \param[in] context The context passed to ua_location_service_create_session_async.
+     */
+    typedef void (*UALocationServiceSessionCreatedHandler)(
+        UALocationServiceSession *session,
+        UALocationServiceError error,
+        void *context);
+
+    /**
+     * \brief Opaque type of a pending asynchronous session request.
+     * \ingroup location_service
+     */
+    typedef struct UbuntuApplicationLocationServiceSessionRequest UALocationServiceSessionRequest;
+
+    /**
+     * \brief Creates a new session with the location service without blocking the caller.
+     * \ingroup location_service
+     * Connecting to the system bus, resolving the location service and
+     * creating the session all happen on a background thread, which also
+     * invokes the handler once the session is available or has failed.
+     * \returns A request to be released with ua_location_service_session_request_destroy
+     * once it is not needed anymore, or NULL if creation could not be started,
+     * in which case the handler is never invoked.
+     * \param[in] flags Bitfield describing the application's requirements.
+     * \param[in] handler Invoked at most once with the result.
+     * \param[in] context Passed on to the handler.
+     */
+    UBUNTU_DLL_PUBLIC UALocationServiceSessionRequest*
+    ua_location_service_create_session_async(
+        UALocationServiceRequirementsFlags flags,
+        UALocationServiceSessionCreatedHandler handler,
+        void *context);
+
+    /**
+     * \brief Cancels a session request unless its handler was invoked already, and releases it.
+     * \ingroup location_service
+     * Waits for a handler running on the background thread to return, unless
+     * called from within the handler itself. Once this returns the handler is
+     * not invoked anymore and its context may be freed; a session created
+     * after cancellation is released by the library.
+     * \param[in] request The request to cancel and release.
+     */
+    UBUNTU_DLL_PUBLIC void
+    ua_location_service_session_request_destroy(
+        UALocationServiceSessionRequest *request);
+
     /**
      * \brief Creates a new controller for the location service.
      * \ingroup location_service
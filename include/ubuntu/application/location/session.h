@@ -22,6 +22,7 @@
 #include <ubuntu/status.h>
 #include <ubuntu/visibility.h>
 
+#include <ubuntu/application/location/geofence.h>
 #include <ubuntu/application/location/heading_update.h>
 #include <ubuntu/application/location/position_update.h>
 #include <ubuntu/application/location/velocity_update.h>
@@ -61,6 +62,39 @@ extern "C"
         UALocationVelocityUpdate *heading,
         void *context);
 
+    /**
+     * \brief Components of a combined fix.
+     * \ingroup location_service
+     */
+    typedef enum
+    {
+        UA_LOCATION_FIX_POSITION = 1 << 0, /**< position is valid. */
+        UA_LOCATION_FIX_HEADING = 1 << 1, /**< heading is valid. */
+        UA_LOCATION_FIX_VELOCITY = 1 << 2 /**< velocity is valid. */
+    } UbuntuApplicationLocationFixComponent;
+
+    typedef UbuntuApplicationLocationFixComponent UALocationFixComponent;
+
+    /**
+     * \brief Position, heading and velocity updates of one update cycle of the service.
+     * \ingroup location_service
+     */
+    typedef struct
+    {
+        uint32_t components; /**< Bitmask of UALocationFixComponent, components not set are 0. */
+        UALocationPosition position; /**< The position, with its own timestamp. */
+        UALocationHeading heading; /**< The heading, with its own timestamp. */
+        UALocationVelocity velocity; /**< The velocity, with its own timestamp. */
+    } UALocationFix;
+
+    /**
+     * \brief Callback type that is invoked for combined fixes.
+     * \ingroup location_service
+     */
+    typedef void (*UALocationServiceSessionFixHandler)(
+        const UALocationFix *fix,
+        void *context);
+
     /**
      * \brief Increments the reference count of the session instance.
      * \ingroup location_service
@@ -115,6 +149,219 @@ extern "C"
         UALocationServiceSessionVelocityUpdatesHandler handler,
         void *context);
 
+    /**
+     * \brief Installs a handler receiving position, heading and velocity together.
+     * \ingroup location_service
+     * Updates whose timestamps lie within window_in_ms of the first update of
+     * a fix are merged into that fix. A fix is delivered as soon as it holds
+     * all components whose updates are started, when an update falls outside
+     * the window or repeats a component already in the fix, or at the latest
+     * window_in_ms after its first update arrived. The handler is invoked in
+     * addition to the per-component handlers and is not subject to their filters.
+     * Stopping the updates of a component may complete the pending fix, which
+     * is then delivered on the stopping thread before the stop call returns.
+     * \returns U_STATUS_SUCCESS if the handler was installed, else U_STATUS_ERROR.
+     * \param[in] session The session instance to install the handler for.
+     * \param[in] handler The fix handler, or NULL to remove it.
+     * \param[in] window_in_ms Maximum time between the first and the last update of a fix.
+     * \param[in] context Passed on to the handler.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_set_fix_handler(
+        UALocationServiceSession *session,
+        UALocationServiceSessionFixHandler handler,
+        uint32_t window_in_ms,
+        void *context);
+
+    /**
+     * \brief Evaluates a set of geofences against the position updates of the session.
+     * \ingroup location_service
+     * Each position update is checked against the fences near it only, and the
+     * set's transition handler is invoked for transitions only. The position
+     * filter of the session does not apply.
+     * \returns U_STATUS_SUCCESS if the set was attached, else U_STATUS_ERROR.
+     * \param[in] session The session instance to attach the set to.
+     * \param[in] set The geofence set, referenced by the session, or NULL to detach the current one.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_set_geofence_set(
+        UALocationServiceSession *session,
+        UALocationGeofenceSet *set);
+
+    /**
+     * \brief Sets how many of the most recent position updates the session keeps.
+     * \ingroup location_service
+     * The session records every position update it receives, independent of
+     * the position handler and its filter, in a ring of capacity fixes
+     * allocated up front. By default, the last 32 fixes are kept. Changing the
+     * capacity drops the fixes kept so far.
+     * \returns U_STATUS_SUCCESS if the capacity was set, U_STATUS_ERROR if it exceeds 4096.
+     * \param[in] session The session instance to configure.
+     * \param[in] capacity The number of fixes to keep, 0 disables the history.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_set_history_capacity(
+        UALocationServiceSession *session,
+        uint32_t capacity);
+
+    /**
+     * \brief Copies recent position updates kept by the session.
+     * \ingroup location_service
+     * Copies the most recent fixes, up to max of them, whose timestamp is at
+     * least since_in_us, oldest first. With a NULL buffer, nothing is copied
+     * and the number of fixes available is returned instead.
+     * \returns The number of fixes copied, 0 if an argument is invalid.
+     * \param[in] session The session instance to query.
+     * \param[in] since_in_us The oldest timestamp of interest in [µs], 0 for all fixes.
+     * \param[out] buffer Receives the fixes, room for max of them, or NULL.
+     * \param[in] max The number of fixes buffer can take.
+     */
+    UBUNTU_DLL_PUBLIC uint32_t
+    ua_location_service_session_get_history(
+        UALocationServiceSession *session,
+        uint64_t since_in_us,
+        UALocationPosition *buffer,
+        uint32_t max);
+
+    /**
+     * \brief Looks up the kept position update closest to a point in time.
+     * \ingroup location_service
+     * \returns U_STATUS_SUCCESS if a fix was found, U_STATUS_ERROR if the history is empty or an argument is NULL.
+     * \param[in] session The session instance to query.
+     * \param[in] timestamp_in_us The point in time in [µs], on the clock of the position timestamps.
+     * \param[out] position Receives the fix.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_get_nearest_fix(
+        UALocationServiceSession *session,
+        uint64_t timestamp_in_us,
+        UALocationPosition *position);
+
+    /**
+     * \brief Smoothes the position updates of the session and rejects outliers.
+     * \ingroup location_service
+     * Positions are run through a constant velocity Kalman filter that weighs
+     * each fix by its horizontal accuracy and takes the heading and velocity
+     * updates of the session into account. Fixes that are implausibly far from
+     * the track are dropped; after a run of them the filter restarts. The
+     * position handler, the position filter, combined fixes and geofences all
+     * see the smoothed positions, with the filter's accuracy estimate as
+     * horizontal accuracy.
+     * \returns U_STATUS_SUCCESS if the setting was applied, U_STATUS_ERROR if an argument is invalid.
+     * \param[in] session The session instance to configure.
+     * \param[in] acceleration_noise_in_meter_per_square_second Expected acceleration of the device, e.g. 1 for walking or 3 for driving; 0 disables smoothing.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_set_position_smoothing(
+        UALocationServiceSession *session,
+        double acceleration_noise_in_meter_per_square_second);
+
+    /**
+     * \brief Starts estimating the position between fixes from the device's motion sensors.
+     * \ingroup location_service
+     * From the last position fix of the session, the speed of its velocity
+     * updates and a heading from gyroscope and magnetometer, calibrated
+     * against the course of its heading updates, positions are extrapolated
+     * and handed to the handler rate_in_hz times per second. Their horizontal
+     * accuracy grows with the time since the last fix; no estimates are
+     * delivered once it is older than 30s. The session's position, velocity
+     * and heading updates need to be started for the estimates to follow the
+     * device, typically at a much lower rate than the estimates.
+     * Dead reckoning reads the accelerometer, gyroscope and magnetometer of
+     * the process, so it refuses to start while the application set a reading
+     * callback for one of them, and only one session can run it at a time.
+     * \returns U_STATUS_SUCCESS if dead reckoning was started, else U_STATUS_ERROR.
+     * \param[in] session The session instance to estimate positions for.
+     * \param[in] rate_in_hz Estimates per second, between 1 and 100.
+     * \param[in] handler Receives the estimates, as fixes carrying position, heading and velocity.
+     * \param[in] context Passed on to the handler.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_start_dead_reckoning(
+        UALocationServiceSession *session,
+        uint32_t rate_in_hz,
+        UALocationServiceSessionFixHandler handler,
+        void *context);
+
+    /**
+     * \brief Stops estimating positions and releases the motion sensors.
+     * \ingroup location_service
+     * \param[in] session The session instance to stop dead reckoning for.
+     */
+    UBUNTU_DLL_PUBLIC void
+    ua_location_service_session_stop_dead_reckoning(
+        UALocationServiceSession *session);
+
+    /**
+     * \brief Restricts the position updates passed to the session's handler.
+     * \ingroup location_service
+     * An update is only passed on if it is at least min_distance_in_meter away
+     * from and min_interval_in_ms later than the last update passed on.
+     * Dropped updates are discarded before any application code runs. A
+     * threshold of 0 disables it; the first update after setting the filter or
+     * starting updates is always passed on.
+     * \returns U_STATUS_SUCCESS if the filter was set, U_STATUS_ERROR for a negative distance.
+     * \param[in] session The session instance to filter position updates for.
+     * \param[in] min_distance_in_meter The minimum distance between two updates.
+     * \param[in] min_interval_in_ms The minimum time between two updates, as given by their timestamps.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_set_position_filter(
+        UALocationServiceSession *session,
+        double min_distance_in_meter,
+        uint32_t min_interval_in_ms);
+
+    /**
+     * \brief Adapts the rate of position updates passed to the session's handler to the device's motion.
+     * \ingroup location_service
+     * The session tells from its velocity updates, or from its positions if
+     * velocity updates are not started, whether the device is stationary
+     * (below 0.5m/s), at walking pace or in a vehicle (above 4m/s), and only
+     * passes on an update if at least the interval of that regime passed
+     * since the last update passed on. Speeding up switches regimes at once,
+     * slowing down only after 10s. The interval of the position filter still
+     * applies, the larger one wins. All intervals 0 disable adaptation.
+     * \returns U_STATUS_SUCCESS if the intervals were set, else U_STATUS_ERROR.
+     * \param[in] session The session instance to adapt position updates for.
+     * \param[in] stationary_interval_in_ms The minimum time between two updates while the device rests, e.g. 60000.
+     * \param[in] walking_interval_in_ms The minimum time between two updates at walking pace, e.g. 5000.
+     * \param[in] driving_interval_in_ms The minimum time between two updates in a vehicle, e.g. 0.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_set_adaptive_position_interval(
+        UALocationServiceSession *session,
+        uint32_t stationary_interval_in_ms,
+        uint32_t walking_interval_in_ms,
+        uint32_t driving_interval_in_ms);
+
+    /**
+     * \brief Restricts the heading updates passed to the session's handler.
+     * \ingroup location_service
+     * An update is only passed on if the heading changed by at least
+     * min_change_in_degree since the last update passed on. 0 disables the filter.
+     * \returns U_STATUS_SUCCESS if the filter was set, U_STATUS_ERROR for a negative change.
+     * \param[in] session The session instance to filter heading updates for.
+     * \param[in] min_change_in_degree The minimum change of the heading.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_set_heading_filter(
+        UALocationServiceSession *session,
+        double min_change_in_degree);
+
+    /**
+     * \brief Restricts the velocity updates passed to the session's handler.
+     * \ingroup location_service
+     * An update is only passed on if the velocity changed by at least
+     * min_change_in_meter_per_second since the last update passed on. 0 disables the filter.
+     * \returns U_STATUS_SUCCESS if the filter was set, U_STATUS_ERROR for a negative change.
+     * \param[in] session The session instance to filter velocity updates for.
+     * \param[in] min_change_in_meter_per_second The minimum change of the velocity.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_service_session_set_velocity_filter(
+        UALocationServiceSession *session,
+        double min_change_in_meter_per_second);
+
     /**
      * \brief Starts position updates for the supplied session.
      * \ingroup location_service
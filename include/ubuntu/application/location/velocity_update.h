@@ -19,6 +19,7 @@
 #ifndef UBUNTU_APPLICATION_LOCATION_VELOCITY_UPDATE_H_
 #define UBUNTU_APPLICATION_LOCATION_VELOCITY_UPDATE_H_
 
+#include <ubuntu/status.h>
 #include <ubuntu/visibility.h>
 
 #include <stdbool.h>
@@ -73,6 +74,28 @@ extern "C"
     ua_location_velocity_update_get_velocity_in_meters_per_second(
         UALocationVelocityUpdate *update);
 
+    /**
+     * \brief All values of a velocity update, copied out in one step.
+     * \ingroup location_service
+     */
+    typedef struct
+    {
+        uint64_t timestamp; /**< Timestamp of the update in [µs]. */
+        double velocity; /**< Velocity in [m/s]. */
+    } UALocationVelocity;
+
+    /**
+     * \brief Copies all values of the velocity update at once.
+     * \ingroup location_service
+     * \returns U_STATUS_SUCCESS if the snapshot was filled in, U_STATUS_ERROR if an argument is NULL.
+     * \param[in] update The velocity update instance to be queried.
+     * \param[out] velocity Receives the values of the update.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_location_velocity_update_read(
+        UALocationVelocityUpdate *update,
+        UALocationVelocity *velocity);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,7 @@
 #include <ubuntu/visibility.h>
 
 #include <ubuntu/application/sensors/event/accelerometer.h>
+#include <ubuntu/application/sensors/rate_governor.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -125,6 +126,18 @@ extern "C" {
         on_accelerometer_event_cb cb,
         void *ctx);
 
+    /**
+     * \brief Queries the callback last set with ua_sensors_accelerometer_set_reading_cb.
+     * \ingroup sensor_access
+     * The sensor instance is shared by the whole process, this tells whether
+     * another part of it already consumes the readings.
+     * \returns The callback, or NULL if none was set.
+     * \param[in] sensor The sensor instance to be queried.
+     */
+    UBUNTU_DLL_PUBLIC on_accelerometer_event_cb
+    ua_sensors_accelerometer_get_reading_cb(
+        UASensorsAccelerometer* sensor);
+
     /**
      * \brief Set the sensor event delivery rate in nanoseconds..
      * \ingroup sensor_access
@@ -137,6 +150,30 @@ extern "C" {
         UASensorsAccelerometer* sensor,
         uint32_t rate);
 
+    /**
+     * \brief Installs a governor that lowers the event rate while the accelerometer is still.
+     * \ingroup sensor_access
+     * \returns U_STATUS_SUCCESS if successful or U_STATUS_ERROR if an error occured.
+     * \param[in] sensor The sensor instance to be governed.
+     * \param[in] config The governor tunables, or NULL to remove the governor and restore the requested rate.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_sensors_accelerometer_set_rate_governor(
+        UASensorsAccelerometer* sensor,
+        const UASensorsRateGovernorConfig* config);
+
+    /**
+     * \brief Queries how long the governed accelerometer ran at its requested and idle rates.
+     * \ingroup sensor_access
+     * \returns U_STATUS_SUCCESS if successful or U_STATUS_ERROR if no governor is installed.
+     * \param[in] sensor The sensor instance to be queried.
+     * \param[out] stats The time spent in each state.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_sensors_accelerometer_get_rate_governor_stats(
+        UASensorsAccelerometer* sensor,
+        UASensorsRateGovernorStats* stats);
+
 #ifdef __cplusplus
 }
 #endif
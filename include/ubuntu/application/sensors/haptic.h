@@ -48,6 +48,7 @@ extern "C" {
      * \ingroup sensor_access
      * \param[in] sensor The instance to be destroyed.
      * \post All resources held by the instance are released. The result of any operation invoked on the destroyed instance are undefined.
+     * \post Completion callbacks of asynchronous requests still in flight are not invoked anymore.
      */
     UBUNTU_DLL_PUBLIC void
     ua_sensors_haptic_destroy(UASensorsHaptic* sensor);
@@ -84,6 +85,7 @@ extern "C" {
         UASensorsHaptic* sensor,
         uint32_t duration);
         
+    /** Length of the patterns taken by ua_sensors_haptic_vibrate_with_pattern; see ua_sensors_haptic_pattern_new for longer ones. */
     #define MAX_PATTERN_SIZE 6
 
     /**
@@ -101,6 +103,106 @@ extern "C" {
         uint32_t pattern[MAX_PATTERN_SIZE],
         uint32_t repeat);
 
+    /**
+     * \brief Callback type used to report the outcome of an asynchronous haptic request.
+     * \ingroup sensor_access
+     * \param[in] status U_STATUS_SUCCESS if the haptics service carried out the request, U_STATUS_ERROR otherwise.
+     * \param[in] context The context supplied with the request.
+     */
+    typedef void (*UASensorsHapticCompletionCallback)(UStatus status, void* context);
+
+    /**
+     * \brief Run the vibrator for a fixed duration without waiting for the haptics service.
+     * \ingroup sensor_access
+     * \returns U_STATUS_SUCCESS if the request was queued, U_STATUS_ERROR if the device is disabled or the request cannot be sent.
+     * \param[in] sensor Haptic device to activate.
+     * \param[in] duration How long should the vibrator stay on.
+     * \param[in] cb Invoked from the haptic bus thread once the service replied, may be NULL. Not invoked if the device is destroyed first.
+     * \param[in] ctx The context supplied to the callback invocation.
+     */
+     UBUNTU_DLL_PUBLIC UStatus
+     ua_sensors_haptic_vibrate_once_async(
+        UASensorsHaptic* sensor,
+        uint32_t duration,
+        UASensorsHapticCompletionCallback cb,
+        void* ctx);
+
+    /**
+     * \brief Run the vibrator with a pattern without waiting for the haptics service.
+     * \ingroup sensor_access
+     * \returns U_STATUS_SUCCESS if the request was queued, U_STATUS_ERROR if the device is disabled or the request cannot be sent.
+     * \param[in] sensor Haptic device to activate.
+     * \param[in] pattern An array of uint32_t durations for which to keep the vibrator on or off, as for ua_sensors_haptic_vibrate_with_pattern.
+     * \param[in] repeat How many times to repeat the whole pattern for.
+     * \param[in] cb Invoked from the haptic bus thread once the service replied, may be NULL. Not invoked if the device is destroyed first.
+     * \param[in] ctx The context supplied to the callback invocation.
+     */
+     UBUNTU_DLL_PUBLIC UStatus
+     ua_sensors_haptic_vibrate_with_pattern_async(
+        UASensorsHaptic* sensor,
+        uint32_t pattern[MAX_PATTERN_SIZE],
+        uint32_t repeat,
+        UASensorsHapticCompletionCallback cb,
+        void* ctx);
+
+    /**
+     * \brief Opaque type that models a vibration pattern prepared for repeated use.
+     * \ingroup sensor_access
+     */
+    typedef void UASensorsHapticPattern;
+
+    /**
+     * \brief Prepares a vibration pattern of any length. Ownership is transfered to caller.
+     * \ingroup sensor_access
+     * \sa ua_sensors_haptic_pattern_destroy
+     * \returns A new instance or NULL if the pattern is empty or repeat is 0.
+     * \param[in] durations Alternating on and off durations in [ms], starting with on.
+     * \param[in] length Number of entries in durations.
+     * \param[in] repeat How many times to play the whole pattern.
+     */
+    UBUNTU_DLL_PUBLIC UASensorsHapticPattern*
+    ua_sensors_haptic_pattern_new(
+        const uint32_t* durations,
+        uint32_t length,
+        uint32_t repeat);
+
+    /**
+     * \brief Destroys the given pattern. Requests already made with it are not affected.
+     * \ingroup sensor_access
+     * \param[in] pattern The instance to be destroyed.
+     */
+    UBUNTU_DLL_PUBLIC void
+    ua_sensors_haptic_pattern_destroy(
+        UASensorsHapticPattern* pattern);
+
+    /**
+     * \brief Run the vibrator with a prepared pattern without waiting for the haptics service.
+     * \ingroup sensor_access
+     * \returns U_STATUS_SUCCESS if the request was queued, U_STATUS_ERROR if the device is disabled or the request cannot be sent.
+     * \param[in] sensor Haptic device to activate.
+     * \param[in] pattern The pattern to play.
+     * \param[in] cb Invoked from the haptic bus thread once the service replied, may be NULL. Not invoked if the device is destroyed first.
+     * \param[in] ctx The context supplied to the callback invocation.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_sensors_haptic_vibrate_pattern(
+        UASensorsHaptic* sensor,
+        const UASensorsHapticPattern* pattern,
+        UASensorsHapticCompletionCallback cb,
+        void* ctx);
+
+    /**
+     * \brief Merges pattern requests made within a time window into a single request to the haptics service.
+     * \ingroup sensor_access
+     * \returns U_STATUS_SUCCESS if successful or U_STATUS_ERROR if an error occured.
+     * \param[in] sensor The haptic device to configure.
+     * \param[in] window_ms How long ua_sensors_haptic_vibrate_pattern requests are collected before they are sent, played back to back; 0 (the default) sends every request right away.
+     */
+    UBUNTU_DLL_PUBLIC UStatus
+    ua_sensors_haptic_set_coalescing_window(
+        UASensorsHaptic* sensor,
+        uint32_t window_ms);
+
 #ifdef __cplusplus
 }
 #endif
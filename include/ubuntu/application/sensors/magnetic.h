@@ -123,6 +123,18 @@ extern "C" {
         on_magnetic_event_cb cb,
         void *ctx);
 
+    /**
+     * \brief Queries the callback last set with ua_sensors_magnetic_set_reading_cb.
+     * \ingroup sensor_access
+     * The sensor instance is shared by the whole process, this tells whether
+     * another part of it already consumes the readings.
+     * \returns The callback, or NULL if none was set.
+     * \param[in] sensor The sensor instance to be queried.
+     */
+    UBUNTU_DLL_PUBLIC on_magnetic_event_cb
+    ua_sensors_magnetic_get_reading_cb(
+        UASensorsMagnetic* sensor);
+
     /**
      * \brief Set the sensor event delivery rate in nanoseconds..
      * \ingroup sensor_access
@@ -0,0 +1,63 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UBUNTU_APPLICATION_SENSORS_RATE_GOVERNOR_H_
+#define UBUNTU_APPLICATION_SENSORS_RATE_GOVERNOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+     * \brief Tunables of the motion-adaptive rate governor.
+     * \ingroup sensor_access
+     *
+     * While the readings of a governed sensor hardly change, the governor lowers
+     * the event rate of the sensor to idle_rate. The first reading that deviates
+     * from the resting value by more than motion_threshold restores the rate
+     * requested with the sensor's set_event_rate function; without a requested
+     * rate faster than idle_rate there is nothing to save and the sensor never
+     * idles. Fields set to 0 take their default values.
+     */
+    typedef struct
+    {
+        uint32_t idle_rate; /**< Event rate in [ns] used while still, defaults to 200 ms. */
+        float stillness_variance; /**< Upper bound of the summed per-axis variance of still readings, in squared sensor units; defaults to 0.01 (m/s^2)^2 and 0.0005 (rad/s)^2. */
+        float motion_threshold; /**< Deviation of a single reading from the resting value that counts as motion, in sensor units; defaults to 0.5 m/s^2 and 0.1 rad/s. */
+        uint32_t stillness_window; /**< Number of readings the variance is computed over, defaults to 32. */
+        uint32_t stillness_duration; /**< Time in [ms] the readings have to stay still before idling, defaults to 2000. */
+    } UASensorsRateGovernorConfig;
+
+    /**
+     * \brief Time a governed sensor spent at each rate since the governor was installed.
+     * \ingroup sensor_access
+     */
+    typedef struct
+    {
+        uint64_t active_time; /**< Time in [ms] spent at the requested rate. */
+        uint64_t idle_time; /**< Time in [ms] spent at the idle rate. */
+        uint32_t transitions; /**< Number of switches between the two rates. */
+        bool idle; /**< Whether the sensor currently runs at the idle rate. */
+    } UASensorsRateGovernorStats;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UBUNTU_APPLICATION_SENSORS_RATE_GOVERNOR_H_ */
@@ -416,10 +416,172 @@ typedef struct {
 
 } UHardwareGpsNiNotification;
 
+/**
+ * Maximum number of satellites reported by one GSV sentence.
+ * \ingroup gps_access
+ */
+#define U_HARDWARE_GPS_NMEA_GSV_MAX_SATELLITES 4
+
+/**
+ * Maximum number of satellites reported by one GSA sentence.
+ * \ingroup gps_access
+ */
+#define U_HARDWARE_GPS_NMEA_GSA_MAX_SATELLITES 12
+
+/**
+ * NMEA 0183 sentences decoded by u_hardware_gps_nmea_parse().
+ * \ingroup gps_access
+ */
+typedef enum
+{
+    /** Not decoded: unsupported, proprietary or malformed, or a bad checksum. */
+    U_HARDWARE_GPS_NMEA_UNKNOWN = 0,
+    /** Fix data. */
+    U_HARDWARE_GPS_NMEA_GGA = 1,
+    /** Recommended minimum data. */
+    U_HARDWARE_GPS_NMEA_RMC = 2,
+    /** DOP and active satellites. */
+    U_HARDWARE_GPS_NMEA_GSA = 3,
+    /** Satellites in view. */
+    U_HARDWARE_GPS_NMEA_GSV = 4,
+    /** Course over ground and ground speed. */
+    U_HARDWARE_GPS_NMEA_VTG = 5
+} UHardwareGpsNmeaSentenceType;
+
+/*
+ * In the decoded sentences below, empty numeric fields are NaN for floating
+ * point members and 0 for integer members, times of day are in milliseconds
+ * since midnight UTC, latitudes and longitudes in degrees, negative to the
+ * south and west, speeds in meters per second and courses in degrees.
+ * Single character fields hold the character, or 0 if empty.
+ */
+
+/**
+ * Decoded GGA sentence.
+ * \ingroup gps_access
+ */
+typedef struct
+{
+    uint32_t time_of_day;
+    double latitude;
+    double longitude;
+    /** 0 for no fix, 1 for GPS, 2 for DGPS, ... */
+    uint8_t quality;
+    uint8_t satellites_in_use;
+    float hdop;
+    /** Above mean sea level, in meters. */
+    float altitude;
+    /** Height of the geoid above the WGS84 ellipsoid, in meters. */
+    float geoid_separation;
+} UHardwareGpsNmeaGga;
+
+/**
+ * Decoded RMC sentence.
+ * \ingroup gps_access
+ */
+typedef struct
+{
+    uint32_t time_of_day;
+    /** 'A' for a valid fix, 'V' for a warning. */
+    char status;
+    double latitude;
+    double longitude;
+    float speed;
+    float course;
+    /** Full year, e.g. 2020, 0 if there is no date. */
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    /** Positive to the east. */
+    float magnetic_variation;
+    /** NMEA 2.3 mode indicator, e.g. 'A' autonomous, 'D' differential, 'N' not valid. */
+    char mode;
+} UHardwareGpsNmeaRmc;
+
+/**
+ * Decoded GSA sentence.
+ * \ingroup gps_access
+ */
+typedef struct
+{
+    /** 'M' manual or 'A' automatic 2D/3D selection. */
+    char selection;
+    /** 1 for no fix, 2 for 2D, 3 for 3D. */
+    uint8_t fix_type;
+    uint8_t count;
+    uint16_t prn[U_HARDWARE_GPS_NMEA_GSA_MAX_SATELLITES];
+    float pdop;
+    float hdop;
+    float vdop;
+    /** NMEA 4.1 GNSS system id, 0 if absent. */
+    uint8_t system;
+} UHardwareGpsNmeaGsa;
+
+/**
+ * A satellite in a decoded GSV sentence.
+ * \ingroup gps_access
+ */
+typedef struct
+{
+    uint16_t prn;
+    /** In degrees, -1 if unknown. */
+    int16_t elevation;
+    /** In degrees, -1 if unknown. */
+    int16_t azimuth;
+    /** Carrier to noise density in dB-Hz, -1 if the satellite is not tracked. */
+    int16_t snr;
+} UHardwareGpsNmeaSatellite;
+
+/**
+ * Decoded GSV sentence.
+ * \ingroup gps_access
+ */
+typedef struct
+{
+    uint8_t total_messages;
+    uint8_t message_number;
+    uint8_t satellites_in_view;
+    uint8_t count;
+    UHardwareGpsNmeaSatellite satellites[U_HARDWARE_GPS_NMEA_GSV_MAX_SATELLITES];
+} UHardwareGpsNmeaGsv;
+
+/**
+ * Decoded VTG sentence.
+ * \ingroup gps_access
+ */
+typedef struct
+{
+    float course;
+    float magnetic_course;
+    float speed;
+    char mode;
+} UHardwareGpsNmeaVtg;
+
+/**
+ * A decoded NMEA sentence.
+ * \ingroup gps_access
+ */
+typedef struct
+{
+    /** One of the U_HARDWARE_GPS_NMEA_* values, selects the member of u. */
+    uint8_t type;
+    /** The talker id, e.g. "GP", "GL" or "GN", zero terminated. */
+    char talker[3];
+    union {
+        UHardwareGpsNmeaGga gga;
+        UHardwareGpsNmeaRmc rmc;
+        UHardwareGpsNmeaGsa gsa;
+        UHardwareGpsNmeaGsv gsv;
+        UHardwareGpsNmeaVtg vtg;
+    } u;
+} UHardwareGpsNmeaSentence;
+
 typedef void (*UHardwareGpsLocationCallback)(UHardwareGpsLocation *location, void *context);
 typedef void (*UHardwareGpsStatusCallback)(uint16_t status, void *context);
 typedef void (*UHardwareGpsSvStatusCallback)(UHardwareGpsSvStatus *sv_info, void *context);
 typedef void (*UHardwareGpsNmeaCallback)(int64_t timestamp, const char *nmea, int length, void *context);
+/** Callback with one decoded NMEA sentence, see u_hardware_gps_set_parsed_nmea_callback(). */
+typedef void (*UHardwareGpsParsedNmeaCallback)(int64_t timestamp, const UHardwareGpsNmeaSentence *sentence, void *context);
 typedef void (*UHardwareGpsSetCapabilities)(uint32_t capabilities, void *context);
 typedef void (*UHardwareGpsRequestUtcTime)(void *context);
 
@@ -459,8 +621,73 @@ typedef struct
     void* context;
 } UHardwareGpsParams;
 
+/**
+ * How the location, status, satellite and NMEA callbacks are invoked.
+ * \ingroup gps_access
+ */
+typedef enum
+{
+    /** From the chipset driver's own thread, as it reports (default). */
+    U_HARDWARE_GPS_DISPATCH_DIRECT = 0,
+    /** From a dispatch thread owned by the instance. */
+    U_HARDWARE_GPS_DISPATCH_THREAD = 1,
+    /** From u_hardware_gps_dispatch(), when u_hardware_gps_get_dispatch_fd() becomes readable. */
+    U_HARDWARE_GPS_DISPATCH_POLL = 2
+} UHardwareGpsDispatchMode;
+
+/**
+ * What happens to reports arriving while the dispatch queue is full.
+ * \ingroup gps_access
+ */
+typedef enum
+{
+    /** The report that arrives is dropped. */
+    U_HARDWARE_GPS_OVERFLOW_DROP_NEWEST = 0,
+    /** The oldest queued report is dropped to make room. */
+    U_HARDWARE_GPS_OVERFLOW_DROP_OLDEST = 1
+} UHardwareGpsOverflowPolicy;
+
+/**
+ * Number of reports dropped from the dispatch queue, by kind.
+ * \ingroup gps_access
+ */
+typedef struct
+{
+    uint32_t location;
+    uint32_t status;
+    uint32_t sv_status;
+    /** Includes NMEA output too long to be queued. */
+    uint32_t nmea;
+} UHardwareGpsDroppedReports;
+
+/**
+ * Time to first fix of the chipset, see u_hardware_gps_get_time_to_first_fix().
+ * \ingroup gps_access
+ */
+typedef struct
+{
+    /** Of the most recent start, in milliseconds, 0 while waiting for the fix. */
+    uint32_t last;
+    /** 1 if the most recent start was assisted with a stored time or position, else 0. */
+    uint32_t last_assisted;
+    /** Number of assisted starts timed, including those of earlier processes. */
+    uint32_t assisted_count;
+    /** Mean time to first fix of the assisted starts, in milliseconds. */
+    uint32_t assisted_mean;
+    /** Number of starts without assistance timed, including those of earlier processes. */
+    uint32_t unassisted_count;
+    /** Mean time to first fix of the starts without assistance, in milliseconds. */
+    uint32_t unassisted_mean;
+} UHardwareGpsTimeToFirstFix;
+
 /*
- You must create only one instance per process/application.
+ Instances of a process share the chipset: each has its own callbacks, the
+ started ones are told about every location, status, satellite and NMEA
+ report of the chipset, which runs while any of them is started. Instances
+ may be created and deleted from within the callbacks, their own included;
+ u_hardware_gps_delete() waits for the callbacks in flight on other threads.
+ Fanning a report out takes no lock and allocates nothing on the driver's
+ threads.
 */
 UBUNTU_DLL_PUBLIC UHardwareGps
 u_hardware_gps_new(UHardwareGpsParams *params);
@@ -563,6 +790,9 @@ u_hardware_gps_delete_aiding_data(
 
 /**
  * \brief Sets the positioning mode of the chipset.
+ * The modes requested by the started instances are combined, so that the
+ * chipset runs with the shortest interval and the best accuracy and time to
+ * first fix asked for.
  * \param mode One of the U_HARDWARE_GPS_POSITION_MODE_* values
  * \param recurrence One of the U_HARDWARE_GPS_POSITION_RECURRENCE_* values
  * \param min_interval represents the time between fixes in milliseconds.
@@ -584,6 +814,113 @@ u_hardware_gps_inject_xtra_data(
     char* data,
     int length);
 
+/**
+ * \brief Decodes the first NMEA sentence in a buffer, in place.
+ * \ingroup gps_access
+ * GGA, RMC, GSA, GSV and VTG sentences of any talker are decoded, other
+ * sentences and ones with a bad checksum come out as
+ * U_HARDWARE_GPS_NMEA_UNKNOWN. Nothing is allocated, the buffer is not
+ * modified and does not need to be zero terminated.
+ * \returns The number of bytes consumed, including the line end, to be skipped
+ *   to get to the next sentence; 0 if the buffer holds no further sentence.
+ * \param nmea The text as handed to a UHardwareGpsNmeaCallback.
+ * \param length The length of the text.
+ * \param sentence Receives the decoded sentence.
+ */
+UBUNTU_DLL_PUBLIC int
+u_hardware_gps_nmea_parse(
+    const char *nmea,
+    int length,
+    UHardwareGpsNmeaSentence *sentence);
+
+/**
+ * \brief Sets a callback receiving the NMEA output of the chipset decoded.
+ * \ingroup gps_access
+ * The callback is invoked once per GGA, RMC, GSA, GSV and VTG sentence, in
+ * addition to the nmea_cb of the instance's parameters. Set it before
+ * starting the GPS.
+ * \param self The instance to set the callback for.
+ * \param cb The callback, or NULL to stop decoding.
+ * \param context Passed on to the callback.
+ */
+UBUNTU_DLL_PUBLIC void
+u_hardware_gps_set_parsed_nmea_callback(
+    UHardwareGps self,
+    UHardwareGpsParsedNmeaCallback cb,
+    void *context);
+
+/**
+ * \brief Decouples the callbacks from the chipset driver's thread.
+ * \ingroup gps_access
+ * By default the location, status, sv_status and NMEA callbacks run on the
+ * driver's thread, so a slow client stalls the driver and loses fixes. In
+ * the queued modes the driver's thread only copies its reports into a ring
+ * allocated here, without locking, and the callbacks are invoked from a
+ * dispatch thread or from u_hardware_gps_dispatch(). Other callbacks keep
+ * running on the driver's thread. Call while the GPS is stopped.
+ * \returns true if the mode was set up.
+ * \param self The instance to configure.
+ * \param mode One of the U_HARDWARE_GPS_DISPATCH_* values.
+ * \param queue_size Number of reports queued at most, rounded up to a power of two.
+ * \param policy One of the U_HARDWARE_GPS_OVERFLOW_* values.
+ */
+UBUNTU_DLL_PUBLIC bool
+u_hardware_gps_set_dispatch_mode(
+    UHardwareGps self,
+    UHardwareGpsDispatchMode mode,
+    uint32_t queue_size,
+    UHardwareGpsOverflowPolicy policy);
+
+/**
+ * \brief A descriptor becoming readable when reports are queued.
+ * \ingroup gps_access
+ * \returns The descriptor to poll in U_HARDWARE_GPS_DISPATCH_POLL mode, else -1.
+ *   It is owned by the instance.
+ * \param self The instance to query.
+ */
+UBUNTU_DLL_PUBLIC int
+u_hardware_gps_get_dispatch_fd(
+    UHardwareGps self);
+
+/**
+ * \brief Invokes the callbacks for all queued reports, in U_HARDWARE_GPS_DISPATCH_POLL mode.
+ * \ingroup gps_access
+ * \returns The number of reports dispatched.
+ * \param self The instance to dispatch for.
+ */
+UBUNTU_DLL_PUBLIC int
+u_hardware_gps_dispatch(
+    UHardwareGps self);
+
+/**
+ * \brief Reports how many reports were dropped from the dispatch queue.
+ * \ingroup gps_access
+ * \param self The instance to query.
+ * \param dropped Receives the counts since the dispatch mode was set.
+ */
+UBUNTU_DLL_PUBLIC void
+u_hardware_gps_get_dropped_reports(
+    UHardwareGps self,
+    UHardwareGpsDroppedReports *dropped);
+
+/**
+ * \brief Reports the time the chipset took to a fix after being started.
+ * \ingroup gps_access
+ * Whenever the chipset starts, the last good fix and the offset of the
+ * system clock from GPS time, kept on disk by earlier sessions, are injected
+ * into it, and requests of the chipset for the time are answered from the
+ * system clock. The state is kept in $UBUNTU_PLATFORM_API_GPS_ASSIST_FILE,
+ * by default ubuntu-platform-api-gps-assist in the user's cache directory;
+ * set it to an empty string to disable the assistance. The time to first
+ * fix is recorded with and without it, to compare.
+ * \param self The instance to query.
+ * \param ttff Receives the times to first fix.
+ */
+UBUNTU_DLL_PUBLIC void
+u_hardware_gps_get_time_to_first_fix(
+    UHardwareGps self,
+    UHardwareGpsTimeToFirstFix *ttff);
+
 #ifdef __cplusplus
 }
 #endif
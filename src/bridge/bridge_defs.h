@@ -108,6 +108,13 @@ extern "C" {
         DLSYM(&f, #symbol, #module);                                     \
         return f(_1, _2, _3, _4); }
 
+#define IMPLEMENT_FUNCTION5(module, return_type, symbol, arg1, arg2, arg3, arg4, arg5) \
+    return_type symbol(arg1 _1, arg2 _2, arg3 _3, arg4 _4, arg5 _5)              \
+    {                                                                           \
+        static return_type (*f)(arg1, arg2, arg3, arg4, arg5) = NULL;           \
+        DLSYM(&f, #symbol, #module);                                            \
+        return f(_1, _2, _3, _4, _5); }
+
 #define IMPLEMENT_FUNCTION6(module, return_type, symbol, arg1, arg2, arg3, arg4, arg5, arg6) \
     return_type symbol(arg1 _1, arg2 _2, arg3 _3, arg4 _4, arg5 _5, arg6 _6)         \
     {                                                                                \
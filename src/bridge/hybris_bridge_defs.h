@@ -123,6 +123,13 @@ extern "C" {
         DLSYM(&f, #symbol);                                           \
         return f(_1, _2, _3); } 
 
+#define IMPLEMENT_OPTIONAL_FUNCTION3(return_type, symbol, return_value, arg1, arg2, arg3) \
+    return_type symbol(arg1 _1, arg2 _2, arg3 _3)                     \
+    {                                                                 \
+        static return_type (*f)(arg1, arg2, arg3) = NULL;             \
+        DLSYM(&f, #symbol);                                           \
+        return f ? f(_1, _2, _3) : return_value; }
+
 #define IMPLEMENT_VOID_FUNCTION3(symbol, arg1, arg2, arg3)      \
     void symbol(arg1 _1, arg2 _2, arg3 _3)                      \
     {                                                           \
@@ -130,6 +137,13 @@ extern "C" {
         DLSYM(&f, #symbol);                                     \
         f(_1, _2, _3); }
 
+#define IMPLEMENT_OPTIONAL_VOID_FUNCTION3(symbol, arg1, arg2, arg3) \
+    void symbol(arg1 _1, arg2 _2, arg3 _3)                      \
+    {                                                           \
+        static void (*f)(arg1, arg2, arg3) = NULL;              \
+        DLSYM(&f, #symbol);                                     \
+        if (f) f(_1, _2, _3); }
+
 #define IMPLEMENT_VOID_FUNCTION4(symbol, arg1, arg2, arg3, arg4) \
     void symbol(arg1 _1, arg2 _2, arg3 _3, arg4 _4)              \
     {                                                            \
@@ -144,6 +158,13 @@ extern "C" {
         DLSYM(&f, #symbol);                                              \
         return f(_1, _2, _3, _4); }
 
+#define IMPLEMENT_OPTIONAL_FUNCTION4(return_type, symbol, return_value, arg1, arg2, arg3, arg4) \
+    return_type symbol(arg1 _1, arg2 _2, arg3 _3, arg4 _4)               \
+    {                                                                    \
+        static return_type (*f)(arg1, arg2, arg3, arg4) = NULL;          \
+        DLSYM(&f, #symbol);                                              \
+        return f ? f(_1, _2, _3, _4) : return_value; }
+
 #define IMPLEMENT_FUNCTION6(return_type, symbol, arg1, arg2, arg3, arg4, arg5, arg6) \
     return_type symbol(arg1 _1, arg2 _2, arg3 _3, arg4 _4, arg5 _5, arg6 _6)         \
     {                                                                                \
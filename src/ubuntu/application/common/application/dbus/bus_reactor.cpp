@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bus_reactor.h"
+
+#include <core/dbus/asio/executor.h>
+
+#include <map>
+#include <mutex>
+
+namespace application = ubuntu::application;
+
+application::BusReactor::Ptr
+application::BusReactor::acquire(core::dbus::WellKnownBus type)
+{
+    // only weak references are kept, the users decide how long a reactor lives
+    static std::mutex registry_guard;
+    static std::map<core::dbus::WellKnownBus, std::weak_ptr<BusReactor>> reactors;
+
+    std::lock_guard<std::mutex> lock(registry_guard);
+
+    Ptr reactor = reactors[type].lock();
+    if (!reactor)
+    {
+        reactor.reset(new BusReactor(type));
+        reactors[type] = reactor;
+    }
+
+    return reactor;
+}
+
+application::BusReactor::BusReactor(core::dbus::WellKnownBus type)
+    : connection(std::make_shared<core::dbus::Bus>(type)),
+      executor(core::dbus::asio::make_executor(connection)),
+      running(std::make_shared<std::atomic<bool>>(true))
+{
+    connection->install_executor(executor);
+
+    // the thread keeps its own references, see the destructor
+    core::dbus::Bus::Ptr bus = connection;
+    std::shared_ptr<std::atomic<bool>> flag = running;
+    worker = std::thread([bus, flag]()
+    {
+        try
+        {
+            bus->run();
+        } catch(...)
+        {
+            // Reported through dispatching() like a regular exit.
+        }
+        *flag = false;
+    });
+}
+
+application::BusReactor::~BusReactor()
+{
+    try
+    {
+        connection->stop();
+
+        // the last reference may be dropped by a callback running on the
+        // reactor thread itself, which then finishes on its own
+        if (worker.get_id() == std::this_thread::get_id())
+            worker.detach();
+        else if (worker.joinable())
+            worker.join();
+    } catch(...)
+    {
+        // We silently ignore errors to fulfill our noexcept guarantee.
+    }
+}
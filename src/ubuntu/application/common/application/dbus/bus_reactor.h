@@ -0,0 +1,73 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UBUNTU_APPLICATION_BUS_REACTOR_PRIVATE_H_
+#define UBUNTU_APPLICATION_BUS_REACTOR_PRIVATE_H_
+
+#include <core/dbus/bus.h>
+#include <core/dbus/executor.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace ubuntu
+{
+namespace application
+{
+/**
+ * A connection to a well-known bus together with the thread dispatching it,
+ * shared by all D-Bus based parts of the library. The reactor of a bus type
+ * is started by the first acquire() and stopped once the last reference is
+ * dropped, so an application using haptics and location only pays for one
+ * connection and one thread per bus.
+ */
+class BusReactor
+{
+public:
+    typedef std::shared_ptr<BusReactor> Ptr;
+
+    /**
+     * Returns the running reactor for the given bus, starting it if needed.
+     * Throws std::runtime_error if the bus cannot be connected to.
+     */
+    static Ptr acquire(core::dbus::WellKnownBus type);
+
+    ~BusReactor();
+
+    const core::dbus::Bus::Ptr& bus() const { return connection; }
+
+    /**
+     * False once the connection stopped being dispatched, e.g. because it
+     * was lost; signals subscribed to through it are not delivered anymore.
+     */
+    bool dispatching() const { return *running; }
+
+private:
+    BusReactor(core::dbus::WellKnownBus type);
+
+    core::dbus::Bus::Ptr connection;
+    core::dbus::Executor::Ptr executor;
+    std::shared_ptr<std::atomic<bool>> running;
+    std::thread worker;
+
+protected:
+    BusReactor(const BusReactor&) = delete;
+    BusReactor& operator=(const BusReactor&) = delete;
+};
+}
+}
+
+#endif // UBUNTU_APPLICATION_BUS_REACTOR_PRIVATE_H_
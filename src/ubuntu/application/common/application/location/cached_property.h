@@ -0,0 +1,129 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CACHED_PROPERTY_H_
+#define CACHED_PROPERTY_H_
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+
+namespace detail
+{
+/**
+ * The last known value of a remote property. It is kept current by the
+ * property's change signal and stays valid for as long as that signal is
+ * subscribed to. Without a live subscription, e.g. once the connection
+ * delivering the signal is lost, a value is only considered fresh for a
+ * bounded time after the last update, after which readers fall back to a
+ * round trip. A staleness bound of 0 disables caching.
+ */
+template<typename T>
+class CachedProperty
+{
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    CachedProperty() : staleness{0}, valid{false}, value{}
+    {
+    }
+
+    void set_staleness(const std::chrono::milliseconds& bound)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        staleness = bound;
+    }
+
+    /**
+     * Installs a probe telling whether the change signal is still delivered;
+     * while it returns true, stored values do not go stale.
+     */
+    void set_subscription(const std::function<bool()>& probe)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        subscribed = probe;
+    }
+
+    /** Stores a value known to be current, e.g. from a change signal. */
+    void update(const T& new_value)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        value = new_value;
+        valid = true;
+        updated = Clock::now();
+    }
+
+    /**
+     * Stores a value read before any update arrived; it is dropped if one
+     * did, as it may be older than that update.
+     */
+    void prime(const T& new_value)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        if (valid)
+            return;
+
+        value = new_value;
+        valid = true;
+        updated = Clock::now();
+    }
+
+    /** Returns true and the cached value if it is fresh. */
+    bool get(T& out) const
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        if (not valid || staleness.count() == 0)
+            return false;
+
+        if (not (subscribed && subscribed()) && Clock::now() - updated > staleness)
+            return false;
+
+        out = value;
+        return true;
+    }
+
+    /** Returns the cached value if fresh, else the result of fetch(), which is cached in turn. */
+    template<typename Fetch>
+    T get_or_fetch(Fetch fetch)
+    {
+        T result;
+        if (get(result))
+            return result;
+
+        // Might throw, in which case the cache stays as it is.
+        result = fetch();
+        update(result);
+        return result;
+    }
+
+    /** Whether a value was ever stored, regardless of its age. */
+    bool known(T& out) const
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        out = value;
+        return valid;
+    }
+
+  private:
+    mutable std::mutex guard;
+    std::chrono::milliseconds staleness;
+    std::function<bool()> subscribed;
+    bool valid;
+    T value;
+    Clock::time_point updated;
+};
+}
+
+#endif // CACHED_PROPERTY_H_
@@ -66,14 +66,14 @@ ua_location_service_controller_query_status(
 
     try
     {
-        auto service = Instance::instance().get_service();
+        auto& instance = Instance::instance();
 
-        if (service->is_online().get())
+        if (instance.is_online())
             *out_flags |= UA_LOCATION_SERVICE_ENABLED;
         else
             *out_flags |= UA_LOCATION_SERVICE_DISABLED;
 
-        if (service->does_satellite_based_positioning().get())
+        if (instance.does_satellite_based_positioning())
             *out_flags |= UA_LOCATION_SERVICE_GPS_ENABLED;
         else
             *out_flags |= UA_LOCATION_SERVICE_GPS_DISABLED;
@@ -98,8 +98,7 @@ ua_location_service_controller_enable_service(
 
     try
     {
-        auto service = Instance::instance().get_service();
-        service->is_online().set(true);
+        Instance::instance().set_online(true);
 
         return U_STATUS_SUCCESS;
     } catch(const std::exception& e)
@@ -121,8 +120,7 @@ ua_location_service_controller_disable_service(
 
     try
     {
-        auto service = Instance::instance().get_service();
-        service->is_online().set(false);
+        Instance::instance().set_online(false);
 
         return U_STATUS_SUCCESS;
     } catch(const std::exception& e)
@@ -144,8 +142,7 @@ ua_location_service_controller_enable_gps(
 
     try
     {
-        auto service = Instance::instance().get_service();
-        service->does_satellite_based_positioning().set(true);
+        Instance::instance().set_satellite_based_positioning(true);
 
         return U_STATUS_SUCCESS;
     } catch(const std::exception& e)
@@ -167,8 +164,7 @@ ua_location_service_controller_disable_gps(
 
     try
     {
-        auto service = Instance::instance().get_service();
-        service->does_satellite_based_positioning().set(false);
+        Instance::instance().set_satellite_based_positioning(false);
 
         return U_STATUS_SUCCESS;
     } catch(const std::exception& e)
@@ -0,0 +1,342 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DEAD_RECKONING_H_
+#define DEAD_RECKONING_H_
+
+#include <cmath>
+#include <mutex>
+
+namespace detail
+{
+/**
+ * Estimates the position between location fixes from the last fix, the last
+ * known speed and the heading of the device.
+ *
+ * The heading integrates the gyroscope's rotation around the vertical axis
+ * and is pulled towards the tilt compensated magnetometer azimuth. While the
+ * device moves fast enough for the fixes' course to be meaningful, the offset
+ * between course and sensor heading is learned, which takes care of the
+ * magnetic declination and of how the device is mounted. Without sensors the
+ * course of the fixes is used as it is.
+ *
+ * The accelerometer tells whether a device at walking pace came to rest, in
+ * which case the estimate stays put instead of drifting with the last known
+ * speed. Faster vehicles can move smoothly enough to look resting, so their
+ * speed is trusted until the next fix.
+ *
+ * All times are in [s] on a monotonic clock. Sensors, fixes and readers may
+ * call in from different threads.
+ */
+class DeadReckoning
+{
+  public:
+    static constexpr double max_age = 30.; ///< [s], no estimates without a more recent fix
+    static constexpr double standard_gravity = 9.80665; ///< [m/s²]
+
+    struct Estimate
+    {
+        double latitude; ///< [°]
+        double longitude; ///< [°]
+        double accuracy; ///< [m], grows with the age of the fix
+        double heading; ///< [°], clockwise from north
+        double speed; ///< [m/s], 0 while at rest
+    };
+
+    DeadReckoning()
+    {
+        reset();
+    }
+
+    /** Forgets everything, e.g. when dead reckoning is restarted. */
+    void reset()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        has_fix = false;
+        fix_time = last_time = 0;
+        fix_latitude = fix_longitude = 0;
+        fix_accuracy = 0;
+        east = north = 0;
+        drift = 0;
+
+        speed = 0;
+        has_course = false;
+        course = 0;
+
+        has_gravity = false;
+        gravity[0] = gravity[1] = 0;
+        gravity[2] = standard_gravity;
+        acceleration_time = 0;
+        motion_variance = 1;
+
+        has_yaw = false;
+        yaw = 0;
+        rotation_time = 0;
+        magnetic_time = 0;
+        has_offset = false;
+        offset = 0;
+    }
+
+    /** A location fix, accuracy in [m]. */
+    void fix(double t, double latitude, double longitude, double accuracy)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        has_fix = true;
+        fix_time = last_time = t;
+        fix_latitude = latitude;
+        fix_longitude = longitude;
+        fix_accuracy = accuracy;
+        east = north = drift = 0;
+    }
+
+    /** The speed reported along with the fixes, in [m/s]. */
+    void velocity(double t, double meter_per_second)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        advance(t);
+        speed = meter_per_second;
+    }
+
+    /** The course reported along with the fixes, in [°] clockwise from north. */
+    void heading(double t, double degree)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        advance(t);
+        has_course = true;
+        course = degree;
+
+        // The course of a standing or crawling device is noise.
+        if (has_yaw && speed >= min_calibration_speed)
+        {
+            double error = wrap(course - yaw - offset);
+            offset = has_offset ? wrap(offset + calibration_gain * error) : wrap(course - yaw);
+            has_offset = true;
+        }
+    }
+
+    /** Accelerometer reading in [m/s²], device coordinates. */
+    void acceleration(double t, double x, double y, double z)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        double dt = acceleration_time > 0 ? t - acceleration_time : 0;
+        acceleration_time = t;
+        if (dt < 0 || dt > 1)
+            dt = 0;
+
+        double a = dt / (gravity_time_constant + dt);
+        double v[3] = {x, y, z};
+        for (int i = 0; i < 3; i++)
+            gravity[i] = has_gravity ? gravity[i] + a * (v[i] - gravity[i]) : v[i];
+        has_gravity = true;
+
+        // Variance of the magnitude around gravity, over about a second.
+        double deviation = std::sqrt(x * x + y * y + z * z) - standard_gravity;
+        double m = dt / (motion_time_constant + dt);
+        motion_variance += m * (deviation * deviation - motion_variance);
+    }
+
+    /** Gyroscope reading in [rad/s], device coordinates, counter-clockwise positive. */
+    void rotation(double t, double x, double y, double z)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        advance(t);
+
+        double dt = rotation_time > 0 ? t - rotation_time : 0;
+        rotation_time = t;
+        if (not has_gravity || not has_yaw || dt <= 0 || dt > 1)
+            return;
+
+        double up[3];
+        if (not unit(gravity, up))
+            return;
+
+        // Counter-clockwise around the up axis decreases the azimuth.
+        double rate = x * up[0] + y * up[1] + z * up[2];
+        yaw = wrap(yaw - rate * dt * 180. / M_PI);
+    }
+
+    /** Magnetometer reading in [µT], device coordinates. */
+    void magnetic_field(double t, double x, double y, double z)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        if (not has_gravity)
+            return;
+
+        double up[3];
+        if (not unit(gravity, up))
+            return;
+
+        // East is perpendicular to the field and up, north to up and east.
+        double field[3] = {x, y, z};
+        double e[3], n[3];
+        cross(field, up, e);
+        if (not unit(e, e))
+            return;
+        cross(up, e, n);
+
+        // Azimuth of the device's y axis.
+        double azimuth = std::atan2(e[1], n[1]) * 180. / M_PI;
+
+        double dt = magnetic_time > 0 ? t - magnetic_time : 0;
+        magnetic_time = t;
+
+        if (not has_yaw)
+        {
+            yaw = wrap(azimuth);
+            has_yaw = true;
+            return;
+        }
+
+        if (dt <= 0 || dt > 1)
+            return;
+
+        yaw = wrap(yaw + dt / (heading_time_constant + dt) * wrap(azimuth - yaw));
+    }
+
+    /** Returns false if there is no fix or the last one is too old. */
+    bool estimate(double t, Estimate& out)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        if (not has_fix || t - fix_time > max_age)
+            return false;
+
+        advance(t);
+
+        static const double meter_per_degree = 6371008.8 * M_PI / 180.;
+        double cos_latitude = std::cos(fix_latitude * M_PI / 180.);
+
+        out.latitude = fix_latitude + north / meter_per_degree;
+        out.longitude = fix_longitude + (cos_latitude > 1e-6 ? east / (meter_per_degree * cos_latitude) : 0);
+        if (out.longitude > 180)
+            out.longitude -= 360;
+        else if (out.longitude < -180)
+            out.longitude += 360;
+
+        out.accuracy = fix_accuracy + drift;
+        out.heading = current_heading();
+        out.speed = at_rest() ? 0 : speed;
+        return true;
+    }
+
+  private:
+    static constexpr double gravity_time_constant = 0.5; ///< [s]
+    static constexpr double motion_time_constant = 1.; ///< [s]
+    static constexpr double heading_time_constant = 2.; ///< [s], how fast the magnetometer corrects the gyroscope
+    static constexpr double rest_deviation = 0.2; ///< [m/s²], standard deviation below which the device is at rest
+    static constexpr double max_rest_speed = 3.; ///< [m/s], above it the device is never considered at rest
+    static constexpr double min_calibration_speed = 2.; ///< [m/s]
+    static constexpr double calibration_gain = 0.1;
+    static constexpr double base_drift_rate = 0.5; ///< [m/s], growth of the uncertainty while moving
+    static constexpr double speed_drift_rate = 0.25; ///< growth of the uncertainty per [m/s] of speed
+
+    static double wrap(double degree)
+    {
+        degree = std::fmod(degree, 360.);
+        if (degree > 180)
+            degree -= 360;
+        else if (degree <= -180)
+            degree += 360;
+        return degree;
+    }
+
+    static bool unit(const double v[3], double out[3])
+    {
+        double norm = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (norm < 1e-9)
+            return false;
+        for (int i = 0; i < 3; i++)
+            out[i] = v[i] / norm;
+        return true;
+    }
+
+    static void cross(const double a[3], const double b[3], double out[3])
+    {
+        double x = a[1] * b[2] - a[2] * b[1];
+        double y = a[2] * b[0] - a[0] * b[2];
+        double z = a[0] * b[1] - a[1] * b[0];
+        out[0] = x; out[1] = y; out[2] = z;
+    }
+
+    // Called with guard held.
+    bool at_rest() const
+    {
+        return has_gravity && speed < max_rest_speed && motion_variance < rest_deviation * rest_deviation;
+    }
+
+    // Called with guard held.
+    double current_heading() const
+    {
+        if (has_yaw && (has_offset || not has_course))
+            return wrap(yaw + offset);
+        return course;
+    }
+
+    // Moves the estimate along the current heading up to t. Called with guard held.
+    void advance(double t)
+    {
+        if (not has_fix || t <= last_time)
+            return;
+
+        double dt = t - last_time;
+        last_time = t;
+
+        if (at_rest())
+            return;
+
+        double distance = speed * dt;
+        double h = current_heading() * M_PI / 180.;
+        east += distance * std::sin(h);
+        north += distance * std::cos(h);
+        drift += (base_drift_rate + speed_drift_rate * speed) * dt;
+    }
+
+    std::mutex guard;
+
+    bool has_fix;
+    double fix_time;
+    double last_time;
+    double fix_latitude;
+    double fix_longitude;
+    double fix_accuracy;
+    double east, north; ///< [m] from the fix
+    double drift; ///< [m]
+
+    double speed;
+    bool has_course;
+    double course;
+
+    bool has_gravity;
+    double gravity[3];
+    double acceleration_time;
+    double motion_variance;
+
+    bool has_yaw;
+    double yaw; ///< [°], sensor heading
+    double rotation_time;
+    double magnetic_time;
+    bool has_offset;
+    double offset; ///< [°], from sensor heading to course
+};
+}
+
+#endif // DEAD_RECKONING_H_
@@ -0,0 +1,251 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dead_reckoning_driver.h"
+
+#include <ubuntu/application/sensors/accelerometer.h>
+#include <ubuntu/application/sensors/gyroscope.h>
+#include <ubuntu/application/sensors/magnetic.h>
+
+namespace
+{
+// Sensor events are delivered at about 50Hz, in [ns].
+const uint32_t sensor_event_rate = 20000000;
+
+/**
+ * Routes the sensor callbacks to the running estimator. It outlives every
+ * driver, so that a reading still in flight when a driver stops finds no
+ * target instead of a destroyed one.
+ */
+struct SensorFeed
+{
+    std::mutex guard;
+    detail::DeadReckoning* target = nullptr;
+
+    UASensorsAccelerometer* accelerometer = nullptr;
+    UASensorsGyroscope* gyroscope = nullptr;
+    UASensorsMagnetic* magnetic = nullptr;
+};
+
+SensorFeed& feed()
+{
+    static SensorFeed instance;
+    return instance;
+}
+
+/** Whether another part of the application set a reading callback for the sensor. */
+template<typename Sensor, typename Callback>
+bool consumed_elsewhere(Sensor* sensor, Callback (*reading_cb)(Sensor*), Callback own)
+{
+    if (not sensor)
+        return false;
+
+    Callback cb = reading_cb(sensor);
+    return cb && cb != own;
+}
+
+void on_acceleration(UASAccelerometerEvent* event, void*)
+{
+    float x, y, z;
+    if (uas_accelerometer_event_get_acceleration_x(event, &x) != U_STATUS_SUCCESS ||
+        uas_accelerometer_event_get_acceleration_y(event, &y) != U_STATUS_SUCCESS ||
+        uas_accelerometer_event_get_acceleration_z(event, &z) != U_STATUS_SUCCESS)
+        return;
+
+    std::lock_guard<std::mutex> lg(feed().guard);
+    if (feed().target)
+        feed().target->acceleration(detail::DeadReckoningDriver::now(), x, y, z);
+}
+
+void on_rotation(UASGyroscopeEvent* event, void*)
+{
+    float x, y, z;
+    if (uas_gyroscope_event_get_rate_of_rotation_around_x(event, &x) != U_STATUS_SUCCESS ||
+        uas_gyroscope_event_get_rate_of_rotation_around_y(event, &y) != U_STATUS_SUCCESS ||
+        uas_gyroscope_event_get_rate_of_rotation_around_z(event, &z) != U_STATUS_SUCCESS)
+        return;
+
+    std::lock_guard<std::mutex> lg(feed().guard);
+    if (feed().target)
+        feed().target->rotation(detail::DeadReckoningDriver::now(), x, y, z);
+}
+
+void on_magnetic_field(UASMagneticEvent* event, void*)
+{
+    float x, y, z;
+    if (uas_magnetic_event_get_magnetic_field_x(event, &x) != U_STATUS_SUCCESS ||
+        uas_magnetic_event_get_magnetic_field_y(event, &y) != U_STATUS_SUCCESS ||
+        uas_magnetic_event_get_magnetic_field_z(event, &z) != U_STATUS_SUCCESS)
+        return;
+
+    std::lock_guard<std::mutex> lg(feed().guard);
+    if (feed().target)
+        feed().target->magnetic_field(detail::DeadReckoningDriver::now(), x, y, z);
+}
+}
+
+detail::DeadReckoningDriver::DeadReckoningDriver(DeadReckoning& estimator)
+    : estimator(estimator),
+      active{false}
+{
+}
+
+detail::DeadReckoningDriver::~DeadReckoningDriver()
+{
+    stop();
+}
+
+bool detail::DeadReckoningDriver::start(std::uint32_t rate_in_hz, UALocationServiceSessionFixHandler new_handler, void* new_context)
+{
+    if (rate_in_hz == 0 || rate_in_hz > 100 || not new_handler)
+        return false;
+
+    std::lock_guard<std::mutex> lg(guard);
+    if (active.load())
+        return false;
+
+    {
+        SensorFeed& f = feed();
+        std::lock_guard<std::mutex> flg(f.guard);
+        if (f.target)
+            return false;
+
+        if (not f.accelerometer)
+            f.accelerometer = ua_sensors_accelerometer_new();
+        if (not f.gyroscope)
+            f.gyroscope = ua_sensors_gyroscope_new();
+        if (not f.magnetic)
+            f.magnetic = ua_sensors_magnetic_new();
+
+        // The application's readings must not be diverted.
+        if (consumed_elsewhere(f.accelerometer, ua_sensors_accelerometer_get_reading_cb, on_acceleration) ||
+            consumed_elsewhere(f.gyroscope, ua_sensors_gyroscope_get_reading_cb, on_rotation) ||
+            consumed_elsewhere(f.magnetic, ua_sensors_magnetic_get_reading_cb, on_magnetic_field))
+            return false;
+
+        estimator.reset();
+        f.target = &estimator;
+
+        // Sensors that are missing leave the estimator to the course of the fixes.
+        if (f.accelerometer)
+        {
+            ua_sensors_accelerometer_set_reading_cb(f.accelerometer, on_acceleration, nullptr);
+            ua_sensors_accelerometer_set_event_rate(f.accelerometer, sensor_event_rate);
+            ua_sensors_accelerometer_enable(f.accelerometer);
+        }
+        if (f.gyroscope)
+        {
+            ua_sensors_gyroscope_set_reading_cb(f.gyroscope, on_rotation, nullptr);
+            ua_sensors_gyroscope_set_event_rate(f.gyroscope, sensor_event_rate);
+            ua_sensors_gyroscope_enable(f.gyroscope);
+        }
+        if (f.magnetic)
+        {
+            ua_sensors_magnetic_set_reading_cb(f.magnetic, on_magnetic_field, nullptr);
+            ua_sensors_magnetic_set_event_rate(f.magnetic, sensor_event_rate);
+            ua_sensors_magnetic_enable(f.magnetic);
+        }
+    }
+
+    current = std::make_shared<Run>(new_handler, new_context, std::chrono::microseconds{1000000 / rate_in_hz});
+    active = true;
+
+    std::shared_ptr<Run> state = current;
+    DeadReckoning& e = estimator;
+    timer = std::thread{[state, &e]() { run(state, e); }};
+    return true;
+}
+
+void detail::DeadReckoningDriver::stop()
+{
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        if (not active.load())
+            return;
+
+        active = false;
+        {
+            std::lock_guard<std::mutex> rlg(current->guard);
+            current->stopping = true;
+        }
+        current->wakeup.notify_all();
+        current.reset();
+        t = std::move(timer);
+    }
+
+    // Stopped by the handler, the timer leaves without touching the driver.
+    if (t.get_id() != std::this_thread::get_id())
+        t.join();
+    else
+        t.detach();
+
+    SensorFeed& f = feed();
+    std::lock_guard<std::mutex> flg(f.guard);
+    if (f.target != &estimator)
+        return;
+
+    f.target = nullptr;
+
+    // The callbacks stay registered, not every backend accepts removing them;
+    // sensors the application took over in the meantime are left alone.
+    if (f.accelerometer && ua_sensors_accelerometer_get_reading_cb(f.accelerometer) == on_acceleration)
+        ua_sensors_accelerometer_disable(f.accelerometer);
+    if (f.gyroscope && ua_sensors_gyroscope_get_reading_cb(f.gyroscope) == on_rotation)
+        ua_sensors_gyroscope_disable(f.gyroscope);
+    if (f.magnetic && ua_sensors_magnetic_get_reading_cb(f.magnetic) == on_magnetic_field)
+        ua_sensors_magnetic_disable(f.magnetic);
+}
+
+void detail::DeadReckoningDriver::run(const std::shared_ptr<Run>& state, DeadReckoning& estimator)
+{
+    std::unique_lock<std::mutex> ul(state->guard);
+
+    auto next = std::chrono::steady_clock::now();
+    while (not state->stopping)
+    {
+        next += state->period;
+        if (state->wakeup.wait_until(ul, next, [&state]() { return state->stopping; }))
+            break;
+
+        DeadReckoning::Estimate estimate;
+        if (not estimator.estimate(now(), estimate))
+            continue;
+
+        UALocationFix fix = UALocationFix{};
+        fix.components = UA_LOCATION_FIX_POSITION | UA_LOCATION_FIX_HEADING | UA_LOCATION_FIX_VELOCITY;
+        fix.position.timestamp = fix.heading.timestamp = fix.velocity.timestamp =
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        fix.position.latitude = estimate.latitude;
+        fix.position.longitude = estimate.longitude;
+        fix.position.horizontal_accuracy = estimate.accuracy;
+        fix.position.valid = UA_LOCATION_POSITION_HORIZONTAL_ACCURACY;
+        fix.heading.heading = estimate.heading;
+        fix.velocity.velocity = estimate.speed;
+
+        // Not holding the lock, the handler may stop dead reckoning and
+        // destroy the estimator with its session.
+        ul.unlock();
+        state->handler(&fix, state->context);
+        ul.lock();
+
+        // Do not try to catch up after a slow handler.
+        auto now = std::chrono::steady_clock::now();
+        if (next + state->period < now)
+            next = now;
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DEAD_RECKONING_DRIVER_H_
+#define DEAD_RECKONING_DRIVER_H_
+
+#include "ubuntu/application/location/session.h"
+
+#include "dead_reckoning.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace detail
+{
+/**
+ * Feeds a DeadReckoning estimator with the accelerometer, gyroscope and
+ * magnetometer and hands its estimates to the application at a fixed rate.
+ *
+ * The sensor instances and their reading callbacks are shared by the whole
+ * process, so only one driver can run at a time, and it refuses to start
+ * while another part of the application consumes one of these sensors.
+ * Stopping only disables the sensors still delivering to the driver.
+ */
+class DeadReckoningDriver
+{
+  public:
+    explicit DeadReckoningDriver(DeadReckoning& estimator);
+    ~DeadReckoningDriver();
+
+    DeadReckoningDriver(const DeadReckoningDriver&) = delete;
+    DeadReckoningDriver& operator=(const DeadReckoningDriver&) = delete;
+
+    /**
+     * Returns false if the arguments are invalid, another driver is running
+     * or the application set a reading callback for one of the sensors.
+     */
+    bool start(std::uint32_t rate_in_hz, UALocationServiceSessionFixHandler handler, void* context);
+    void stop();
+
+    /** Whether fixes, speed and course should be passed to the estimator. */
+    bool running() const
+    {
+        return active.load();
+    }
+
+    /** The time base of the estimator, in [s]. */
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+  private:
+    /**
+     * The state of one run, shared with its timer thread. A handler stopping
+     * dead reckoning detaches the timer, which may then outlive the driver.
+     */
+    struct Run
+    {
+        Run(UALocationServiceSessionFixHandler handler, void* context, std::chrono::microseconds period)
+            : handler{handler},
+              context{context},
+              period{period},
+              stopping{false}
+        {
+        }
+
+        const UALocationServiceSessionFixHandler handler;
+        void* const context;
+        const std::chrono::microseconds period;
+
+        std::mutex guard;
+        std::condition_variable wakeup;
+        bool stopping;
+    };
+
+    /** The estimator is only used while the run is not stopping. */
+    static void run(const std::shared_ptr<Run>& state, DeadReckoning& estimator);
+
+    DeadReckoning& estimator;
+    std::atomic<bool> active;
+
+    std::mutex guard;
+    std::shared_ptr<Run> current;
+    std::thread timer;
+};
+}
+
+#endif // DEAD_RECKONING_DRIVER_H_
@@ -0,0 +1,147 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FIX_HISTORY_H_
+#define FIX_HISTORY_H_
+
+#include "ubuntu/application/location/position_update.h"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace detail
+{
+/**
+ * The most recent positions of a session, in a ring allocated up front so
+ * that recording a fix never allocates.
+ *
+ * Fixes are kept in the order they arrived, which is not necessarily the
+ * order of their timestamps, e.g. after the system clock was set back, so
+ * queries look at every fix kept. The ring is small enough for that.
+ */
+class FixHistory
+{
+  public:
+    static constexpr std::uint32_t default_capacity = 32;
+    static constexpr std::uint32_t max_capacity = 4096;
+
+    FixHistory() : ring(default_capacity), head{0}, size{0}
+    {
+    }
+
+    /** Drops the fixes kept so far. Returns false if capacity exceeds max_capacity. */
+    bool set_capacity(std::uint32_t capacity)
+    {
+        if (capacity > max_capacity)
+            return false;
+
+        // Allocate outside the lock, recording must not wait for it.
+        std::vector<UALocationPosition> next(capacity);
+
+        std::lock_guard<std::mutex> lg(guard);
+        ring.swap(next);
+        head = size = 0;
+        return true;
+    }
+
+    void add(const UALocationPosition& position)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        if (ring.empty())
+            return;
+
+        ring[head] = position;
+        head = (head + 1) % ring.size();
+        if (size < ring.size())
+            size++;
+    }
+
+    /**
+     * Copies the most recent max fixes with a timestamp of at least since
+     * into buffer, oldest first, and returns how many were copied. Without
+     * a buffer, returns how many there are.
+     */
+    std::uint32_t get(std::uint64_t since, UALocationPosition* buffer, std::uint32_t max)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        // Newest first, to find the most recent ones.
+        std::uint32_t count = 0;
+        std::size_t first = size;
+        for (std::size_t i = 0; i < size && (not buffer || count < max); i++)
+        {
+            if (at(i).timestamp < since)
+                continue;
+            count++;
+            first = i;
+        }
+
+        if (not buffer || count == 0)
+            return count;
+
+        std::uint32_t copied = 0;
+        for (std::size_t i = first + 1; i-- > 0 && copied < count;)
+        {
+            if (at(i).timestamp >= since)
+                buffer[copied++] = at(i);
+        }
+        return copied;
+    }
+
+    /** The fix whose timestamp is closest to when, false if there is none. */
+    bool nearest(std::uint64_t when, UALocationPosition& position)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        if (size == 0)
+            return false;
+
+        std::size_t best = 0;
+        std::uint64_t best_distance = distance(at(0).timestamp, when);
+        for (std::size_t i = 1; i < size; i++)
+        {
+            std::uint64_t d = distance(at(i).timestamp, when);
+            // The more recent fix wins a tie.
+            if (d < best_distance)
+            {
+                best = i;
+                best_distance = d;
+            }
+        }
+
+        position = at(best);
+        return true;
+    }
+
+  private:
+    static std::uint64_t distance(std::uint64_t a, std::uint64_t b)
+    {
+        return a > b ? a - b : b - a;
+    }
+
+    /** The i-th most recent fix. Called with guard held. */
+    const UALocationPosition& at(std::size_t i) const
+    {
+        return ring[(head + ring.size() - 1 - i) % ring.size()];
+    }
+
+    std::mutex guard;
+    std::vector<UALocationPosition> ring;
+    std::size_t head; ///< where the next fix goes
+    std::size_t size;
+};
+}
+
+#endif // FIX_HISTORY_H_
@@ -0,0 +1,288 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FIX_MERGER_H_
+#define FIX_MERGER_H_
+
+#include "ubuntu/application/location/session.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace detail
+{
+/**
+ * Merges position, heading and velocity updates whose timestamps lie within
+ * a window into one fix for the application's fix handler.
+ *
+ * A fix is delivered once it holds every component whose updates are
+ * enabled, when an update does not fit into it, or from a timer thread once
+ * the window passed after its first update arrived. The handler runs with
+ * the merger unlocked, but never concurrently with itself nor after
+ * set_handler(nullptr, ...) or shutdown() returned on another thread.
+ *
+ * Whoever delivers a fix shares the merger's state rather than the merger,
+ * as the handler may well destroy the merger together with its session.
+ */
+class FixMerger
+{
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    FixMerger() : state{std::make_shared<State>()}
+    {
+    }
+
+    FixMerger(const FixMerger&) = delete;
+    FixMerger& operator=(const FixMerger&) = delete;
+
+    ~FixMerger()
+    {
+        shutdown();
+    }
+
+    /** Installs or, if handler is null, removes the fix handler. A pending fix is dropped. */
+    void set_handler(UALocationServiceSessionFixHandler new_handler, std::uint32_t window_in_ms, void* new_context)
+    {
+        State& s = *state;
+        std::unique_lock<std::mutex> ul(s.guard);
+
+        s.handler = new_handler;
+        s.context = new_context;
+        s.window_in_us = std::int64_t(window_in_ms) * 1000;
+        s.window = std::chrono::milliseconds{window_in_ms};
+        s.pending = UALocationFix{};
+        s.installed = s.handler != nullptr;
+
+        if (s.handler && not timer.joinable() && not s.stopping)
+        {
+            std::shared_ptr<State> shared = state;
+            timer = std::thread{[shared]() { shared->run(); }};
+        }
+
+        s.settle(ul);
+    }
+
+    /**
+     * Records whether updates of component are running, which defines a
+     * complete fix. Disabling a component may complete the pending fix,
+     * which is then delivered on the calling thread.
+     */
+    void set_enabled(std::uint32_t component, bool on)
+    {
+        std::shared_ptr<State> shared = state;
+        std::unique_lock<std::mutex> ul(shared->guard);
+
+        if (on)
+            shared->enabled |= component;
+        else
+            shared->enabled &= ~component;
+
+        if (shared->pending.components && shared->complete())
+            shared->deliver(ul);
+    }
+
+    /** Whether a fix handler is installed; cheap enough to check before preparing an update. */
+    bool active() const
+    {
+        return state->installed.load();
+    }
+
+    void add(const UALocationPosition& position)
+    {
+        State::add(state, UA_LOCATION_FIX_POSITION, position.timestamp, [&position](UALocationFix& fix) { fix.position = position; });
+    }
+
+    void add(const UALocationHeading& heading)
+    {
+        State::add(state, UA_LOCATION_FIX_HEADING, heading.timestamp, [&heading](UALocationFix& fix) { fix.heading = heading; });
+    }
+
+    void add(const UALocationVelocity& velocity)
+    {
+        State::add(state, UA_LOCATION_FIX_VELOCITY, velocity.timestamp, [&velocity](UALocationFix& fix) { fix.velocity = velocity; });
+    }
+
+    /**
+     * Removes the handler and stops the timer thread, no handler runs
+     * afterwards. Called from a handler on the timer thread, the thread is
+     * left to finish on its own once the handler returned.
+     */
+    void shutdown()
+    {
+        State& s = *state;
+        {
+            std::unique_lock<std::mutex> ul(s.guard);
+            s.stopping = true;
+            s.handler = nullptr;
+            s.installed = false;
+            s.wakeup.notify_all();
+            s.settle(ul);
+        }
+
+        if (not timer.joinable())
+            return;
+
+        if (timer.get_id() == std::this_thread::get_id())
+            timer.detach();
+        else
+            timer.join();
+    }
+
+  private:
+    struct State
+    {
+        State()
+            : installed{false},
+              handler{nullptr},
+              context{nullptr},
+              window_in_us{0},
+              window{0},
+              enabled{0},
+              pending{},
+              first_timestamp{0},
+              stopping{false},
+              delivering{false}
+        {
+        }
+
+        // Takes the state by reference count, the handler may drop the merger's.
+        template<typename Fill>
+        static void add(std::shared_ptr<State> self, std::uint32_t component, std::uint64_t timestamp, Fill fill)
+        {
+            State& s = *self;
+            std::unique_lock<std::mutex> ul(s.guard);
+            if (not s.handler)
+                return;
+
+            if (s.pending.components)
+            {
+                std::int64_t distance = std::int64_t(timestamp - s.first_timestamp);
+                if ((s.pending.components & component) || distance > s.window_in_us || -distance > s.window_in_us)
+                    s.deliver(ul);
+            }
+
+            // The handler may have removed itself.
+            if (not s.handler)
+                return;
+
+            if (not s.pending.components)
+            {
+                s.first_timestamp = timestamp;
+                s.deadline = Clock::now() + s.window;
+                s.wakeup.notify_all();
+            }
+
+            fill(s.pending);
+            s.pending.components |= component;
+
+            if (s.complete())
+                s.deliver(ul);
+        }
+
+        // Called with guard held.
+        bool complete() const
+        {
+            return (pending.components & enabled) == enabled;
+        }
+
+        // Called with guard held through ul, which is released while the
+        // handler runs; a handler running on another thread is waited for.
+        void deliver(std::unique_lock<std::mutex>& ul)
+        {
+            bool nested = delivering && deliverer == std::this_thread::get_id();
+            while (delivering && not nested && not stopping)
+                wakeup.wait(ul);
+
+            if (not handler || not pending.components)
+                return;
+
+            UALocationFix fix = pending;
+            pending = UALocationFix{};
+            UALocationServiceSessionFixHandler h = handler;
+            void* c = context;
+
+            delivering = true;
+            deliverer = std::this_thread::get_id();
+            ul.unlock();
+
+            h(&fix, c);
+
+            ul.lock();
+            if (not nested)
+            {
+                delivering = false;
+                wakeup.notify_all();
+            }
+        }
+
+        // Called with guard held, waits for a handler running on another thread.
+        void settle(std::unique_lock<std::mutex>& ul)
+        {
+            while (delivering && deliverer != std::this_thread::get_id())
+                wakeup.wait(ul);
+        }
+
+        void run()
+        {
+            std::unique_lock<std::mutex> ul(guard);
+            while (not stopping)
+            {
+                if (not pending.components)
+                {
+                    wakeup.wait(ul);
+                    continue;
+                }
+
+                wakeup.wait_until(ul, deadline);
+                if (pending.components && Clock::now() >= deadline)
+                    deliver(ul);
+            }
+        }
+
+        std::atomic<bool> installed;
+
+        // Not held while the handler runs, which may call back into the session.
+        std::mutex guard;
+        std::condition_variable wakeup;
+
+        UALocationServiceSessionFixHandler handler;
+        void* context;
+        std::int64_t window_in_us;
+        std::chrono::milliseconds window;
+        std::uint32_t enabled;
+
+        UALocationFix pending;
+        std::uint64_t first_timestamp;
+        Clock::time_point deadline;
+
+        bool stopping;
+
+        // Set while a handler runs, by the thread running it.
+        bool delivering;
+        std::thread::id deliverer;
+    };
+
+    std::shared_ptr<State> state;
+    std::thread timer;
+};
+}
+
+#endif // FIX_MERGER_H_
@@ -0,0 +1,218 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ubuntu/application/location/geofence.h"
+
+#include "geofence_p.h"
+#include "update_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+bool contains(const UALocationGeofence& geofence, const UALocationPosition& position)
+{
+    return detail::haversine_distance_in_meter(
+        geofence.latitude, geofence.longitude,
+        position.latitude, position.longitude) <= geofence.radius;
+}
+}
+
+void
+UbuntuApplicationLocationGeofenceSet::add(const UALocationGeofence& geofence)
+{
+    remove(geofence.id);
+
+    index.insert(geofence.id, geofence.latitude, geofence.longitude, geofence.radius);
+    fences[geofence.id] = Fence{geofence, 0, false};
+}
+
+bool
+UbuntuApplicationLocationGeofenceSet::remove(std::uint32_t id)
+{
+    auto it = fences.find(id);
+    if (it == fences.end())
+        return false;
+
+    const UALocationGeofence& geofence = it->second.geofence;
+    index.erase(id, geofence.latitude, geofence.longitude, geofence.radius);
+    inside.erase(std::remove(inside.begin(), inside.end(), id), inside.end());
+    fences.erase(it);
+    return true;
+}
+
+void
+UbuntuApplicationLocationGeofenceSet::evaluate(const UALocationPosition& position)
+{
+    std::vector<std::pair<std::uint32_t, UALocationGeofenceTransition>> transitions;
+
+    std::unique_lock<std::mutex> ul(guard);
+
+    // Exits and dwells, among the fences entered before.
+    for (auto it = inside.begin(); it != inside.end();)
+    {
+        Fence& fence = fences[*it];
+        if (not contains(fence.geofence, position))
+        {
+            transitions.emplace_back(*it, UA_LOCATION_GEOFENCE_EXIT);
+            it = inside.erase(it);
+            continue;
+        }
+
+        if (not fence.dwelled && position.timestamp >= fence.entered_at &&
+            position.timestamp - fence.entered_at >= std::uint64_t(fence.geofence.dwell_time_in_ms) * 1000)
+        {
+            fence.dwelled = true;
+            transitions.emplace_back(*it, UA_LOCATION_GEOFENCE_DWELL);
+        }
+        ++it;
+    }
+
+    // Entries, among the fences near the position.
+    std::size_t entered_before = inside.size();
+    index.candidates(position.latitude, position.longitude, [this, &position](std::uint32_t id)
+    {
+        if (std::find(inside.begin(), inside.end(), id) != inside.end())
+            return;
+
+        if (contains(fences[id].geofence, position))
+            inside.push_back(id);
+    });
+
+    for (auto it = inside.begin() + entered_before; it != inside.end(); ++it)
+    {
+        Fence& fence = fences[*it];
+        fence.entered_at = position.timestamp;
+        fence.dwelled = fence.geofence.dwell_time_in_ms == 0;
+
+        transitions.emplace_back(*it, UA_LOCATION_GEOFENCE_ENTER);
+        if (fence.dwelled)
+            transitions.emplace_back(*it, UA_LOCATION_GEOFENCE_DWELL);
+    }
+
+    ul.unlock();
+
+    if (transitions.empty())
+        return;
+
+    // The handler may release the set, which lives on until it returned.
+    ref();
+    for (const auto& transition : transitions)
+    {
+        UALocationGeofenceTransitionHandler h;
+        void* c;
+        {
+            // The handler may have removed the fence meanwhile.
+            std::lock_guard<std::mutex> lg(guard);
+            auto it = fences.find(transition.first);
+            if (not handler || it == fences.end() || not (it->second.geofence.transitions & transition.second))
+                continue;
+
+            h = handler;
+            c = context;
+        }
+
+        h(this, transition.first, transition.second, &position, c);
+    }
+    unref();
+}
+
+UALocationGeofenceSet*
+ua_location_geofence_set_new()
+{
+    try
+    {
+        return new UbuntuApplicationLocationGeofenceSet();
+    } catch(...)
+    {
+        return nullptr;
+    }
+}
+
+void
+ua_location_geofence_set_ref(
+    UALocationGeofenceSet *set)
+{
+    if (not set)
+        return;
+
+    set->ref();
+}
+
+void
+ua_location_geofence_set_unref(
+    UALocationGeofenceSet *set)
+{
+    if (not set)
+        return;
+
+    set->unref();
+}
+
+UStatus
+ua_location_geofence_set_add(
+    UALocationGeofenceSet *set,
+    const UALocationGeofence *geofence)
+{
+    if (not set || not geofence)
+        return U_STATUS_ERROR;
+
+    if (not (geofence->radius > 0) ||
+        not (std::fabs(geofence->latitude) <= 90) ||
+        not (std::fabs(geofence->longitude) <= 180))
+        return U_STATUS_ERROR;
+
+    try
+    {
+        std::lock_guard<std::mutex> lg(set->guard);
+        set->add(*geofence);
+    } catch(...)
+    {
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_location_geofence_set_remove(
+    UALocationGeofenceSet *set,
+    uint32_t id)
+{
+    if (not set)
+        return U_STATUS_ERROR;
+
+    std::lock_guard<std::mutex> lg(set->guard);
+    return set->remove(id) ? U_STATUS_SUCCESS : U_STATUS_ERROR;
+}
+
+UStatus
+ua_location_geofence_set_set_transition_handler(
+    UALocationGeofenceSet *set,
+    UALocationGeofenceTransitionHandler handler,
+    void *context)
+{
+    if (not set)
+        return U_STATUS_ERROR;
+
+    std::lock_guard<std::mutex> lg(set->guard);
+    set->handler = handler;
+    set->context = context;
+
+    return U_STATUS_SUCCESS;
+}
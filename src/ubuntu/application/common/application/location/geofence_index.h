@@ -0,0 +1,144 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef GEOFENCE_INDEX_H_
+#define GEOFENCE_INDEX_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace detail
+{
+/**
+ * Spatial index of circles on the sphere, a hierarchy of latitude/longitude
+ * grids whose cell size doubles from level to level. Each circle is filed
+ * in the finest level where its bounding box spans at most two cells per
+ * axis, so it is found in at most four cells, and a lookup visits one cell
+ * per level. Lookups cost O(levels + candidates) regardless of the number
+ * of circles.
+ */
+class GeofenceIndex
+{
+  public:
+    /** Cells are 360° / 2^n wide, so that every level wraps around the antimeridian evenly. */
+    static constexpr int levels = 17; ///< the finest cell is about 610m of latitude, the coarsest spans all longitudes
+
+    GeofenceIndex() : cells(levels)
+    {
+    }
+
+    void insert(std::uint32_t id, double latitude, double longitude, double radius)
+    {
+        for_each_cell(latitude, longitude, radius, [this, id](int level, std::uint64_t key)
+        {
+            cells[level][key].push_back(id);
+        });
+    }
+
+    void erase(std::uint32_t id, double latitude, double longitude, double radius)
+    {
+        for_each_cell(latitude, longitude, radius, [this, id](int level, std::uint64_t key)
+        {
+            auto it = cells[level].find(key);
+            if (it == cells[level].end())
+                return;
+
+            auto& ids = it->second;
+            ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+            if (ids.empty())
+                cells[level].erase(it);
+        });
+    }
+
+    /** Calls f(id) for every circle whose bounding box might contain the coordinate. */
+    template<typename F>
+    void candidates(double latitude, double longitude, F f) const
+    {
+        for (int level = 0; level < levels; level++)
+        {
+            if (cells[level].empty())
+                continue;
+
+            double size = cell_size(level);
+            auto it = cells[level].find(key(row(latitude, size), column(longitude, size), size));
+            if (it == cells[level].end())
+                continue;
+
+            for (std::uint32_t id : it->second)
+                f(id);
+        }
+    }
+
+  private:
+    static double cell_size(int level)
+    {
+        return std::ldexp(360., level - (levels - 1));
+    }
+
+    static std::int64_t row(double latitude, double size)
+    {
+        return std::int64_t(std::floor((std::max(-90., std::min(90., latitude)) + 90.) / size));
+    }
+
+    static std::int64_t columns(double size)
+    {
+        return std::int64_t(std::ceil(360. / size));
+    }
+
+    // Wraps around the antimeridian.
+    static std::int64_t column(double longitude, double size)
+    {
+        std::int64_t n = columns(size);
+        std::int64_t c = std::int64_t(std::floor((longitude + 180.) / size)) % n;
+        return c < 0 ? c + n : c;
+    }
+
+    static std::uint64_t key(std::int64_t row, std::int64_t column, double size)
+    {
+        return std::uint64_t(row) * std::uint64_t(columns(size)) + std::uint64_t(column);
+    }
+
+    template<typename F>
+    static void for_each_cell(double latitude, double longitude, double radius, F f)
+    {
+        static const double meter_per_degree = 6371008.8 * M_PI / 180.;
+
+        double dlat = radius / meter_per_degree;
+        double cos_lat = std::cos(std::min(90., std::fabs(latitude) + dlat) * M_PI / 180.);
+        // Near the poles the box covers all longitudes.
+        double dlon = cos_lat > 1e-9 ? std::min(180., dlat / cos_lat) : 180.;
+
+        int level = 0;
+        while (level < levels - 1 && 2 * std::max(dlat, dlon) > cell_size(level))
+            level++;
+
+        double size = cell_size(level);
+        std::int64_t n = columns(size);
+        std::int64_t first_column = std::int64_t(std::floor((longitude - dlon + 180.) / size));
+        std::int64_t last_column = std::min(first_column + n - 1, std::int64_t(std::floor((longitude + dlon + 180.) / size)));
+
+        for (std::int64_t r = row(latitude - dlat, size); r <= row(latitude + dlat, size); r++)
+            for (std::int64_t c = first_column; c <= last_column; c++)
+                f(level, key(r, ((c % n) + n) % n, size));
+    }
+
+    std::vector<std::unordered_map<std::uint64_t, std::vector<std::uint32_t>>> cells;
+};
+}
+
+#endif // GEOFENCE_INDEX_H_
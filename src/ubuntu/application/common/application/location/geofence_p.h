@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef GEOFENCE_PRIVATE_H_
+#define GEOFENCE_PRIVATE_H_
+
+#include "ubuntu/application/location/geofence.h"
+
+#include "geofence_index.h"
+#include "ref_counted.h"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct UbuntuApplicationLocationGeofenceSet : public detail::RefCounted
+{
+    struct Fence
+    {
+        UALocationGeofence geofence;
+        std::uint64_t entered_at; ///< [µs], timestamp of the fix that entered the fence
+        bool dwelled;
+    };
+
+    UbuntuApplicationLocationGeofenceSet() : handler{nullptr}, context{nullptr}
+    {
+    }
+
+    void add(const UALocationGeofence& geofence);
+    bool remove(std::uint32_t id);
+
+    /**
+     * Updates the state of the fences near position and reports their
+     * transitions, holding a reference but not the guard while the handler runs.
+     */
+    void evaluate(const UALocationPosition& position);
+
+    std::mutex guard;
+
+    UALocationGeofenceTransitionHandler handler;
+    void* context;
+
+    std::unordered_map<std::uint32_t, Fence> fences;
+    detail::GeofenceIndex index;
+    /** Ids of the fences the last position was in; exits are only looked for among those. */
+    std::vector<std::uint32_t> inside;
+};
+
+#endif // GEOFENCE_PRIVATE_H_
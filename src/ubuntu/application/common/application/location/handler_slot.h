@@ -0,0 +1,198 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef HANDLER_SLOT_H_
+#define HANDLER_SLOT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace detail
+{
+/**
+ * The application handler of one kind of update, together with its filter.
+ *
+ * Handler, context and filter settings live in an immutable record that is
+ * replaced as a whole when the application changes any of them. Dispatching
+ * only loads the current record, so it never waits for the application
+ * thread. Replaced records are retired and freed once no dispatch is in
+ * flight.
+ *
+ * Updates of one kind are dispatched from a single thread, the bus thread,
+ * which also owns the filter state. A handler may shut down, and destroy,
+ * the slot it was dispatched from.
+ */
+template<typename Handler, typename Filter>
+class HandlerSlot
+{
+  public:
+    struct Record
+    {
+        Handler handler;
+        void* context;
+        Filter filter; ///< Settings only, the state is kept by the dispatching thread.
+        std::uint64_t generation;
+    };
+
+    HandlerSlot() : current{nullptr}, readers{0}, generations{0}, seen_generation{0}
+    {
+    }
+
+    HandlerSlot(const HandlerSlot&) = delete;
+    HandlerSlot& operator=(const HandlerSlot&) = delete;
+
+    ~HandlerSlot()
+    {
+        shutdown();
+        for (const Record* r : retired)
+            delete r;
+    }
+
+    /** Replaces the record by a copy changed by mutate, e.g. [](Record& r) { r.handler = nullptr; }. */
+    template<typename Mutator>
+    void update(Mutator mutate)
+    {
+        std::lock_guard<std::mutex> lg(writers);
+
+        const Record* previous = current.load();
+        std::unique_ptr<Record> next{previous ? new Record(*previous) : new Record{nullptr, nullptr, Filter{}, 0}};
+        mutate(*next);
+        // A new generation restarts filtering, the first update afterwards always passes.
+        next->generation = ++generations;
+
+        publish(next.release());
+    }
+
+    /**
+     * Detaches the handler and waits for a running dispatch to finish.
+     * Called from a handler, the dispatch on the calling thread is not waited
+     * for, it returns without touching the slot once the handler returned.
+     */
+    void shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lg(writers);
+            publish(nullptr);
+        }
+
+        for (Reader* reader = innermost(); reader; reader = reader->outer)
+        {
+            if (&reader->slot == this && not reader->released)
+            {
+                reader->released = true;
+                readers.fetch_sub(1);
+            }
+        }
+
+        while (readers.load() != 0)
+            std::this_thread::yield();
+    }
+
+    /**
+     * Hands value to the application, wrapped into a Wrapper, unless it is
+     * filtered. Any further arguments are passed on to the filter.
+     */
+    template<typename Wrapper, typename Value, typename... FilterArgs>
+    void dispatch(const Value& value, const FilterArgs&... args)
+    {
+        Reader reader{*this};
+
+        const Record* r = current.load();
+        if (not r || not r->handler)
+            return;
+
+        if (r->generation != seen_generation)
+        {
+            filter = r->filter;
+            filter.reset();
+            seen_generation = r->generation;
+        }
+
+        // Filtered updates never reach the application.
+        if (not filter.accept(value, args...))
+            return;
+
+        // The handler may destroy the slot, and with it the record.
+        Handler handler = r->handler;
+        void* context = r->context;
+
+        Wrapper wrapper{value};
+        handler(std::addressof(wrapper), context);
+    }
+
+  private:
+    // The dispatches running on a thread form a stack, so that shutdown()
+    // finds the ones it is called from.
+    struct Reader
+    {
+        Reader(HandlerSlot& slot) : slot(slot), outer{innermost()}, released{false}
+        {
+            slot.readers.fetch_add(1);
+            innermost() = this;
+        }
+
+        ~Reader()
+        {
+            innermost() = outer;
+            if (not released)
+                slot.readers.fetch_sub(1);
+        }
+
+        HandlerSlot& slot;
+        Reader* outer;
+        bool released; ///< Discounted by shutdown(), the slot may be gone.
+    };
+
+    static Reader*& innermost()
+    {
+        static thread_local Reader* reader = nullptr;
+        return reader;
+    }
+
+    // Called with writers held.
+    void publish(const Record* next)
+    {
+        const Record* previous = current.exchange(next);
+        if (previous)
+            retired.push_back(previous);
+
+        // A dispatch starting from now on only sees next, so without readers
+        // none of the retired records can be in use anymore.
+        if (readers.load() == 0)
+        {
+            for (const Record* r : retired)
+                delete r;
+            retired.clear();
+        }
+    }
+
+    std::atomic<const Record*> current;
+    std::atomic<unsigned int> readers;
+
+    std::mutex writers;
+    std::vector<const Record*> retired;
+    std::uint64_t generations;
+
+    // Owned by the dispatching thread.
+    std::uint64_t seen_generation;
+    Filter filter;
+};
+}
+
+#endif // HANDLER_SLOT_H_
@@ -53,3 +53,18 @@ ua_location_heading_update_get_heading_in_degree(
 {
     return update->update.value.value();
 }
+
+UStatus
+ua_location_heading_update_read(
+    UALocationHeadingUpdate *update,
+    UALocationHeading *heading)
+{
+    if (not update || not heading)
+        return U_STATUS_ERROR;
+
+    heading->timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        update->update.when.time_since_epoch()).count();
+    heading->heading = update->update.value.value();
+
+    return U_STATUS_SUCCESS;
+}
@@ -23,11 +23,17 @@
 
 #include "ubuntu/application/location/controller.h"
 
+#include "application/dbus/bus_reactor.h"
+
+#include "cached_property.h"
+#include "session_request_p.h"
+
 #include <com/ubuntu/location/service/stub.h>
 
 #include <core/dbus/resolver.h>
-#include <core/dbus/asio/executor.h>
 
+#include <chrono>
+#include <cstdlib>
 #include <thread>
 
 class UBUNTU_DLL_LOCAL Instance
@@ -52,81 +58,127 @@ class UBUNTU_DLL_LOCAL Instance
         changed_handler_context = context;
     }
 
+    // Served from the cache while it is fresh, else read from the service.
+    bool is_online()
+    {
+        return cached.is_online.get_or_fetch([this]() { return service->is_online().get(); });
+    }
+
+    bool does_satellite_based_positioning()
+    {
+        return cached.does_satellite_based_positioning.get_or_fetch([this]()
+        {
+            return service->does_satellite_based_positioning().get();
+        });
+    }
+
+    void set_online(bool value)
+    {
+        service->is_online().set(value);
+        cached.is_online.update(value);
+    }
+
+    void set_satellite_based_positioning(bool value)
+    {
+        service->does_satellite_based_positioning().set(value);
+        cached.does_satellite_based_positioning.update(value);
+    }
+
   private:
+    // [ms], overridden by $UBUNTU_PLATFORM_API_LOCATION_CACHE_STALENESS_MS;
+    // 0 disables the cache.
+    static constexpr unsigned long default_cache_staleness = 10000;
+
     Instance()
-        : bus(std::make_shared<core::dbus::Bus>(core::dbus::WellKnownBus::system)),
-          executor(core::dbus::asio::make_executor(bus)),
+        : reactor(ubuntu::application::BusReactor::acquire(core::dbus::WellKnownBus::system)),
           service(core::dbus::resolve_service_on_bus<
                     com::ubuntu::location::service::Interface,
                     com::ubuntu::location::service::Stub
-                  >(bus)),
+                  >(reactor->bus())),
           connections
           {
               service->does_satellite_based_positioning().changed().connect([this](bool value)
               {
-                  // Update our cached value.
-                  if (value)
-                  {
-                      cached_state_flags |= UA_LOCATION_SERVICE_GPS_ENABLED;
-                      cached_state_flags &= ~UA_LOCATION_SERVICE_GPS_DISABLED;
-                  }
-                  else
-                  {
-                      cached_state_flags |= UA_LOCATION_SERVICE_GPS_DISABLED;
-                      cached_state_flags &= ~UA_LOCATION_SERVICE_GPS_ENABLED;
-                  }
+                  cached.does_satellite_based_positioning.update(value);
 
                   // And notify change handler if one is set.
                   if (changed_handler)
-                      changed_handler(cached_state_flags, changed_handler_context);
+                      changed_handler(state_flags(), changed_handler_context);
               }),
               service->is_online().changed().connect([this](bool value)
               {
-                  // Update our cached value.
-                  if (value)
-                  {
-                      cached_state_flags |= UA_LOCATION_SERVICE_ENABLED;
-                      cached_state_flags &= ~UA_LOCATION_SERVICE_DISABLED;
-                  }
-                  else
-                  {
-                      cached_state_flags |= UA_LOCATION_SERVICE_DISABLED;
-                      cached_state_flags &= ~UA_LOCATION_SERVICE_ENABLED;
-                  }
+                  cached.is_online.update(value);
 
                   // And notify change handler if one is set.
                   if (changed_handler)
-                      changed_handler(cached_state_flags, changed_handler_context);
+                      changed_handler(state_flags(), changed_handler_context);
               })
           },
-          cached_state_flags{0},
           changed_handler{nullptr},
           changed_handler_context{nullptr}
     {
-        bus->install_executor(executor);
-        worker = std::move(std::thread([&]() { bus->run(); }));
+        unsigned long staleness = default_cache_staleness;
+        if (auto env = ::getenv("UBUNTU_PLATFORM_API_LOCATION_CACHE_STALENESS_MS"))
+            staleness = std::strtoul(env, nullptr, 10);
+
+        cached.is_online.set_staleness(std::chrono::milliseconds{staleness});
+        cached.does_satellite_based_positioning.set_staleness(std::chrono::milliseconds{staleness});
+
+        // No subscription is installed: a dispatched bus does not mean the
+        // change signals still arrive, the service may have been restarted
+        // or the match rule lost. The staleness bound always applies.
+
+        // Prime the cache off the caller's thread; change signals arriving
+        // in the meantime take precedence over the values read here.
+        primer = std::thread([this]()
+        {
+            try
+            {
+                cached.is_online.prime(service->is_online().get());
+                cached.does_satellite_based_positioning.prime(service->does_satellite_based_positioning().get());
+            } catch(...)
+            {
+                // The first query does the round trip instead.
+            }
+        });
     }
 
     ~Instance() noexcept
     {
-        try
-        {
-            bus->stop();
+        // Asynchronous session requests might still be using the service.
+        detail::PendingRequests::instance().close();
 
-            if (worker.joinable())
-                worker.join();
-        } catch(...)
-        {
-            // We silently ignore errors to fulfill our noexcept guarantee.
-        }
+        if (primer.joinable())
+            primer.join();
+    }
+
+    // Flags of the properties whose value is known.
+    UALocationServiceStatusFlags state_flags() const
+    {
+        UALocationServiceStatusFlags flags{0};
+        bool value;
+
+        if (cached.is_online.known(value))
+            flags |= value ? UA_LOCATION_SERVICE_ENABLED : UA_LOCATION_SERVICE_DISABLED;
+
+        if (cached.does_satellite_based_positioning.known(value))
+            flags |= value ? UA_LOCATION_SERVICE_GPS_ENABLED : UA_LOCATION_SERVICE_GPS_DISABLED;
+
+        return flags;
     }
 
-    core::dbus::Bus::Ptr bus;
-    core::dbus::Executor::Ptr executor;
-    std::thread worker;
+    // Shared with the other system bus clients of the library, outlives the service.
+    ubuntu::application::BusReactor::Ptr reactor;
 
     com::ubuntu::location::service::Interface::Ptr service;
 
+    // Last known values of the service properties.
+    struct
+    {
+        detail::CachedProperty<bool> is_online;
+        detail::CachedProperty<bool> does_satellite_based_positioning;
+    } cached;
+
     // All event connections go here.
     struct
     {
@@ -134,8 +186,9 @@ class UBUNTU_DLL_LOCAL Instance
         core::ScopedConnection on_is_online_changed;
     } connections;
 
+    std::thread primer;
+
     // All change-handler specifics go here.
-    UALocationServiceStatusFlags cached_state_flags;
     UALocationServiceStatusChangedHandler changed_handler;
     void* changed_handler_context;
 };
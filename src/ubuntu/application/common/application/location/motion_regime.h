@@ -0,0 +1,181 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MOTION_REGIME_H_
+#define MOTION_REGIME_H_
+
+#include "update_filter.h"
+
+#include <com/ubuntu/location/clock.h>
+
+#include <chrono>
+
+namespace detail
+{
+/**
+ * Tells whether the device is stationary, at walking pace or in a vehicle.
+ *
+ * Speeding up switches to the faster regime at once, so that a device that
+ * starts moving gets its updates promptly. Slowing down only switches once
+ * the speed stayed below the lower threshold for settle_time, which keeps a
+ * car at a traffic light or a pedestrian waiting at a crossing from
+ * flapping between regimes.
+ *
+ * The speed is taken from velocity updates. Without recent ones, it is
+ * derived from positions at least min_span apart, less their accuracy so
+ * that the jitter of a resting receiver does not look like motion.
+ *
+ * Owned by the thread delivering the updates.
+ */
+class MotionRegime
+{
+  public:
+    typedef com::ubuntu::location::Clock::Timestamp Timestamp;
+
+    static constexpr double stationary_leave_speed = 1.; ///< [m/s]
+    static constexpr double stationary_enter_speed = 0.5; ///< [m/s]
+    static constexpr double driving_enter_speed = 4.; ///< [m/s]
+    static constexpr double driving_leave_speed = 2.5; ///< [m/s]
+
+    MotionRegime()
+        : regime{Motion::walking},
+          has_velocity{false},
+          has_anchor{false},
+          anchor_latitude{0},
+          anchor_longitude{0},
+          anchor_accuracy{0},
+          slow_since_valid{false},
+          slower{Motion::walking}
+    {
+    }
+
+    Motion current() const
+    {
+        return regime;
+    }
+
+    void observe_velocity(double speed, const Timestamp& when)
+    {
+        has_velocity = true;
+        velocity_when = when;
+        classify(speed, when);
+    }
+
+    /** accuracy in [m], 0 if unknown. */
+    void observe_position(double latitude, double longitude, double accuracy, const Timestamp& when)
+    {
+        if (has_velocity && when - velocity_when < velocity_timeout())
+            return;
+
+        if (not has_anchor || when < anchor_when)
+        {
+            anchor(latitude, longitude, accuracy, when);
+            return;
+        }
+
+        double span = std::chrono::duration<double>(when - anchor_when).count();
+        if (span < std::chrono::duration<double>(min_span()).count())
+            return;
+
+        double d = haversine_distance_in_meter(anchor_latitude, anchor_longitude, latitude, longitude) - anchor_accuracy - accuracy;
+        classify(d > 0 ? d / span : 0, when);
+        anchor(latitude, longitude, accuracy, when);
+    }
+
+    static std::chrono::seconds settle_time()
+    {
+        return std::chrono::seconds{10};
+    }
+
+    static std::chrono::seconds min_span()
+    {
+        return std::chrono::seconds{5};
+    }
+
+    static std::chrono::seconds velocity_timeout()
+    {
+        return std::chrono::seconds{5};
+    }
+
+  private:
+    void anchor(double latitude, double longitude, double accuracy, const Timestamp& when)
+    {
+        has_anchor = true;
+        anchor_latitude = latitude;
+        anchor_longitude = longitude;
+        anchor_accuracy = accuracy;
+        anchor_when = when;
+    }
+
+    void classify(double speed, const Timestamp& when)
+    {
+        // Where the speed would put a device slowing down.
+        Motion target = regime;
+        if (regime == Motion::driving && speed < driving_leave_speed)
+            target = speed < stationary_enter_speed ? Motion::stationary : Motion::walking;
+        else if (regime == Motion::walking && speed < stationary_enter_speed)
+            target = Motion::stationary;
+
+        // Speeding up applies at once.
+        if (speed > driving_enter_speed)
+            regime = Motion::driving;
+        else if (regime == Motion::stationary && speed > stationary_leave_speed)
+            regime = Motion::walking;
+
+        if (target >= regime)
+        {
+            slow_since_valid = false;
+            return;
+        }
+
+        if (not slow_since_valid)
+        {
+            slow_since_valid = true;
+            slow_since = when;
+            slower = target;
+            return;
+        }
+
+        // Settling to walking on the way to stationary counts towards both.
+        if (target > slower)
+            slower = target;
+
+        if (when - slow_since >= settle_time())
+        {
+            regime = slower;
+            slower = target;
+            slow_since_valid = regime != target;
+            slow_since = when;
+        }
+    }
+
+    Motion regime;
+
+    bool has_velocity;
+    Timestamp velocity_when;
+
+    bool has_anchor;
+    double anchor_latitude;
+    double anchor_longitude;
+    double anchor_accuracy;
+    Timestamp anchor_when;
+
+    bool slow_since_valid;
+    Timestamp slow_since;
+    Motion slower; ///< the fastest regime the speed pointed to while slowing down
+};
+}
+
+#endif // MOTION_REGIME_H_
@@ -0,0 +1,324 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef POSITION_SMOOTHER_H_
+#define POSITION_SMOOTHER_H_
+
+#include <com/ubuntu/location/heading.h>
+#include <com/ubuntu/location/position.h>
+#include <com/ubuntu/location/update.h>
+#include <com/ubuntu/location/velocity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+namespace detail
+{
+/**
+ * Constant velocity Kalman filter over position fixes, in a local east/north
+ * plane in [m] around the first fix after a reset. Both axes share the same
+ * model and an isotropic measurement noise, the horizontal accuracy of the
+ * fix, so they are filtered independently.
+ *
+ * Fixes whose innovation exceeds the 99.9% gate of a chi-squared
+ * distribution with two degrees of freedom are rejected as outliers. A run
+ * of max_rejections rather means that the filter lost track, e.g. after a
+ * tunnel, and restarts it from the next fix.
+ *
+ * Recent heading and velocity updates are folded in as a measurement of the
+ * velocity vector.
+ *
+ * Settings are changed from the application thread, filtering happens on the
+ * thread delivering the updates, which owns the filter state.
+ */
+class PositionSmoother
+{
+  public:
+    static constexpr double gate = 13.82; ///< chi-squared, 2 degrees of freedom, p = 0.999
+    static constexpr unsigned int max_rejections = 5;
+    static constexpr double default_accuracy = 25.; ///< [m], for fixes lacking a horizontal accuracy
+    static constexpr double velocity_accuracy = 1.; ///< [m/s]
+    static constexpr double earth_radius = 6371008.8; ///< [m], mean radius
+
+    PositionSmoother()
+        : acceleration_noise{0},
+          generations{0},
+          seen_generation{0},
+          primed{false},
+          rejections{0},
+          reference_latitude{0},
+          reference_longitude{0},
+          meter_per_degree_longitude{0},
+          east{},
+          north{},
+          heading_valid{false},
+          heading{0},
+          velocity_valid{false},
+          velocity{0}
+    {
+    }
+
+    /** Standard deviation of the acceleration in [m/s²] assumed by the model, 0 disables smoothing. */
+    void set_acceleration_noise(double noise)
+    {
+        acceleration_noise = noise;
+        reset();
+    }
+
+    /** Restarts the filter with the next fix. */
+    void reset()
+    {
+        generations.fetch_add(1);
+    }
+
+    bool enabled() const
+    {
+        return acceleration_noise.load() > 0;
+    }
+
+    void observe(const com::ubuntu::location::Update<com::ubuntu::location::Heading>& update)
+    {
+        heading_valid = true;
+        heading = update.value.value();
+        heading_when = update.when;
+    }
+
+    void observe(const com::ubuntu::location::Update<com::ubuntu::location::Velocity>& update)
+    {
+        velocity_valid = true;
+        velocity = update.value.value();
+        velocity_when = update.when;
+    }
+
+    /**
+     * Filters update into smoothed, which starts out as a copy of update.
+     * Returns false if update is rejected as an outlier.
+     */
+    bool smooth(const com::ubuntu::location::Update<com::ubuntu::location::Position>& update,
+                com::ubuntu::location::Update<com::ubuntu::location::Position>& smoothed)
+    {
+        namespace cul = com::ubuntu::location;
+
+        std::uint64_t generation = generations.load();
+        if (generation != seen_generation)
+        {
+            seen_generation = generation;
+            primed = false;
+        }
+
+        double latitude = update.value.latitude.value.value();
+        double longitude = update.value.longitude.value.value();
+        double accuracy = default_accuracy;
+        if (update.value.accuracy.horizontal)
+            accuracy = update.value.accuracy.horizontal->value();
+        double r = accuracy * accuracy;
+
+        if (not primed || rejections >= max_rejections)
+        {
+            restart(latitude, longitude, r, update.when);
+            return true;
+        }
+
+        double x, y;
+        to_plane(latitude, longitude, x, y);
+
+        // Out of order, or the clock of the fixes went back; the latter
+        // restarts the filter once the run of rejections is long enough.
+        double dt = std::chrono::duration<double>(update.when - when).count();
+        if (dt < 0)
+        {
+            rejections++;
+            return false;
+        }
+
+        double q = acceleration_noise.load();
+        q *= q;
+
+        Axis e = east.predicted(dt, q);
+        Axis n = north.predicted(dt, q);
+
+        double distance = e.innovation_distance(x, r) + n.innovation_distance(y, r);
+        if (distance > gate)
+        {
+            rejections++;
+            return false;
+        }
+
+        rejections = 0;
+        e.correct_position(x, r);
+        n.correct_position(y, r);
+
+        // A velocity that describes the same moment as the fix.
+        if (heading_valid && velocity_valid &&
+            close(heading_when, update.when) && close(velocity_when, update.when))
+        {
+            static const double to_radian = M_PI / 180.;
+            double rv = velocity_accuracy * velocity_accuracy;
+            e.correct_velocity(velocity * std::sin(heading * to_radian), rv);
+            n.correct_velocity(velocity * std::cos(heading * to_radian), rv);
+        }
+
+        east = e;
+        north = n;
+        when = update.when;
+
+        double smoothed_latitude, smoothed_longitude;
+        from_plane(east.position, north.position, smoothed_latitude, smoothed_longitude);
+
+        smoothed.value.latitude = cul::wgs84::Latitude{smoothed_latitude * cul::units::Degrees};
+        smoothed.value.longitude = cul::wgs84::Longitude{smoothed_longitude * cul::units::Degrees};
+        smoothed.value.accuracy.horizontal = std::sqrt((east.p00 + north.p00) / 2) * cul::units::Meters;
+        return true;
+    }
+
+  private:
+    /** State and covariance of one axis, position [m] and velocity [m/s]. */
+    struct Axis
+    {
+        double position;
+        double velocity;
+        double p00, p01, p11;
+
+        Axis predicted(double dt, double q) const
+        {
+            Axis a;
+            a.position = position + dt * velocity;
+            a.velocity = velocity;
+
+            // F P F^T + Q for white noise acceleration
+            double dt2 = dt * dt;
+            a.p00 = p00 + 2 * dt * p01 + dt2 * p11 + q * dt2 * dt2 / 4;
+            a.p01 = p01 + dt * p11 + q * dt2 * dt / 2;
+            a.p11 = p11 + q * dt2;
+            return a;
+        }
+
+        /** Squared innovation in units of its variance. */
+        double innovation_distance(double z, double r) const
+        {
+            double innovation = z - position;
+            return innovation * innovation / (p00 + r);
+        }
+
+        void correct_position(double z, double r)
+        {
+            double s = p00 + r;
+            double k0 = p00 / s, k1 = p01 / s;
+            double innovation = z - position;
+
+            position += k0 * innovation;
+            velocity += k1 * innovation;
+
+            double n00 = (1 - k0) * p00;
+            double n01 = (1 - k0) * p01;
+            double n11 = p11 - k1 * p01;
+            p00 = n00; p01 = n01; p11 = n11;
+        }
+
+        void correct_velocity(double z, double r)
+        {
+            double s = p11 + r;
+            double k0 = p01 / s, k1 = p11 / s;
+            double innovation = z - velocity;
+
+            position += k0 * innovation;
+            velocity += k1 * innovation;
+
+            double n00 = p00 - k0 * p01;
+            double n01 = (1 - k1) * p01;
+            double n11 = (1 - k1) * p11;
+            p00 = n00; p01 = n01; p11 = n11;
+        }
+    };
+
+    static bool close(const com::ubuntu::location::Clock::Timestamp& a,
+                      const com::ubuntu::location::Clock::Timestamp& b)
+    {
+        static const std::chrono::seconds bound{2};
+        return a - b < bound && b - a < bound;
+    }
+
+    void restart(double latitude, double longitude, double r,
+                 const com::ubuntu::location::Clock::Timestamp& timestamp)
+    {
+        static const double to_radian = M_PI / 180.;
+        // Nothing is known about the velocity yet, allow for driving speeds.
+        static const double initial_velocity_variance = 30. * 30.;
+
+        primed = true;
+        rejections = 0;
+        reference_latitude = latitude;
+        reference_longitude = longitude;
+        meter_per_degree_longitude = earth_radius * to_radian * std::cos(latitude * to_radian);
+        when = timestamp;
+
+        east = Axis{0, 0, r, 0, initial_velocity_variance};
+        north = Axis{0, 0, r, 0, initial_velocity_variance};
+    }
+
+    void to_plane(double latitude, double longitude, double& x, double& y) const
+    {
+        static const double meter_per_degree_latitude = earth_radius * M_PI / 180.;
+
+        double dlon = longitude - reference_longitude;
+        // Across the antimeridian.
+        if (dlon > 180)
+            dlon -= 360;
+        else if (dlon < -180)
+            dlon += 360;
+
+        x = dlon * meter_per_degree_longitude;
+        y = (latitude - reference_latitude) * meter_per_degree_latitude;
+    }
+
+    void from_plane(double x, double y, double& latitude, double& longitude) const
+    {
+        static const double meter_per_degree_latitude = earth_radius * M_PI / 180.;
+
+        latitude = reference_latitude + y / meter_per_degree_latitude;
+        longitude = reference_longitude +
+                (meter_per_degree_longitude > 0 ? x / meter_per_degree_longitude : 0);
+        if (longitude > 180)
+            longitude -= 360;
+        else if (longitude < -180)
+            longitude += 360;
+    }
+
+    std::atomic<double> acceleration_noise;
+    std::atomic<std::uint64_t> generations;
+
+    // Owned by the dispatching thread.
+    std::uint64_t seen_generation;
+    bool primed;
+    unsigned int rejections;
+    double reference_latitude;
+    double reference_longitude;
+    double meter_per_degree_longitude;
+    com::ubuntu::location::Clock::Timestamp when;
+    Axis east;
+    Axis north;
+
+    bool heading_valid;
+    double heading; ///< [°]
+    com::ubuntu::location::Clock::Timestamp heading_when;
+    bool velocity_valid;
+    double velocity; ///< [m/s]
+    com::ubuntu::location::Clock::Timestamp velocity_when;
+};
+}
+
+#endif // POSITION_SMOOTHER_H_
@@ -102,3 +102,40 @@ ua_location_position_update_get_vertical_accuracy_in_meter(
 {
     return update->update.value.accuracy.vertical->value();
 }
+
+UStatus
+ua_location_position_update_read(
+    UALocationPositionUpdate *update,
+    UALocationPosition *position)
+{
+    if (not update || not position)
+        return U_STATUS_ERROR;
+
+    const auto& value = update->update.value;
+
+    *position = UALocationPosition{};
+    position->timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        update->update.when.time_since_epoch()).count();
+    position->latitude = value.latitude.value.value();
+    position->longitude = value.longitude.value.value();
+
+    if (value.altitude)
+    {
+        position->altitude = value.altitude->value.value();
+        position->valid |= UA_LOCATION_POSITION_ALTITUDE;
+    }
+
+    if (value.accuracy.horizontal)
+    {
+        position->horizontal_accuracy = value.accuracy.horizontal->value();
+        position->valid |= UA_LOCATION_POSITION_HORIZONTAL_ACCURACY;
+    }
+
+    if (value.accuracy.vertical)
+    {
+        position->vertical_accuracy = value.accuracy.vertical->value();
+        position->valid |= UA_LOCATION_POSITION_VERTICAL_ACCURACY;
+    }
+
+    return U_STATUS_SUCCESS;
+}
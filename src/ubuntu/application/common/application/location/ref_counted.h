@@ -34,6 +34,18 @@ class RefCounted
     void ref() { counter.fetch_add(1); }
     void unref() { if (1 == counter.fetch_sub(1)) { delete this; } }
 
+    /** Takes a reference unless the last one is gone already; false if it is. */
+    bool try_ref()
+    {
+        int current = counter.load();
+        while (current > 0)
+        {
+            if (counter.compare_exchange_weak(current, current + 1))
+                return true;
+        }
+        return false;
+    }
+
   protected:
     RefCounted() : counter(1)
     {
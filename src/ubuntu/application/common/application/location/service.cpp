@@ -21,16 +21,34 @@
 #include "controller_p.h"
 #include "instance.h"
 #include "session_p.h"
+#include "session_request_p.h"
+#include "trace_session.h"
 
 #include <com/ubuntu/location/service/stub.h>
 
 #include <core/dbus/resolver.h>
 #include <core/dbus/asio/executor.h>
 
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
 namespace dbus = core::dbus;
 namespace cul = com::ubuntu::location;
 namespace culs = com::ubuntu::location::service;
 
+namespace
+{
+// A replayed trace if the environment asks for one, else a session of the service.
+culss::Interface::Ptr create_session()
+{
+    if (auto session = detail::TraceSession::create_from_environment())
+        return session;
+
+    return Instance::instance().get_service()->create_session_for_criteria(cul::Criteria{});
+}
+}
+
 UALocationServiceSession*
 ua_location_service_create_session_for_low_accuracy(
     UALocationServiceRequirementsFlags /*flags*/)
@@ -45,7 +63,7 @@ ua_location_service_create_session_for_low_accuracy(
         {
             // Creating the instance might fail for a number of reasons.
 
-            Instance::instance().get_service()->create_session_for_criteria(cul::Criteria{})
+            create_session()
         };
     } catch(const std::exception& e)
     {
@@ -74,7 +92,7 @@ ua_location_service_try_create_session_for_low_accuracy(
         {
             // Creating the instance might fail for a number of reasons.
 
-            Instance::instance().get_service()->create_session_for_criteria(cul::Criteria{})
+            create_session()
         };
     } catch(...)
     {
@@ -99,7 +117,7 @@ ua_location_service_create_session_for_high_accuracy(
         {
             // Creating the instance might fail for a number of reasons.
 
-            Instance::instance().get_service()->create_session_for_criteria(cul::Criteria{})
+            create_session()
         };
     } catch(const std::exception& e)
     {
@@ -129,7 +147,7 @@ ua_location_service_try_create_session_for_high_accuracy(
         {
             // Creating the instance might fail for a number of reasons.
 
-            Instance::instance().get_service()->create_session_for_criteria(cul::Criteria{})
+            create_session()
         };
     } catch(...)
     {
@@ -140,6 +158,69 @@ ua_location_service_try_create_session_for_high_accuracy(
     return nullptr;
 }
 
+UALocationServiceSessionRequest*
+ua_location_service_create_session_async(
+    UALocationServiceRequirementsFlags flags,
+    UALocationServiceSessionCreatedHandler handler,
+    void* context)
+{
+    if (not handler)
+        return nullptr;
+
+    // Workers still running at exit are waited for, before the static Instance
+    // goes away if it exists by then, else from here.
+    static std::once_flag teardown;
+    std::call_once(teardown, []() { std::atexit([]() { detail::PendingRequests::instance().close(); }); });
+
+    auto& pending = detail::PendingRequests::instance();
+    if (not pending.enter())
+        return nullptr;
+
+    UALocationServiceSessionRequest* request = nullptr;
+    try
+    {
+        request = new UbuntuApplicationLocationServiceSessionRequest{handler, context};
+        auto state = request->state;
+
+        // Detached, the application cancels through the request instead of joining.
+        std::thread([flags, state]()
+        {
+            auto& pending = detail::PendingRequests::instance();
+
+            UALocationServiceError error = UA_LOCATION_SERVICE_ERROR_NONE;
+            auto session = ua_location_service_try_create_session_for_high_accuracy(flags, &error);
+
+            // Nobody is left to take the session during teardown.
+            if (pending.closed() or not state->invoke(session, error))
+            {
+                if (session)
+                    ua_location_service_session_unref(session);
+            }
+
+            pending.leave();
+        }).detach();
+    } catch(const std::exception& e)
+    {
+        std::cerr << "ua_location_service_create_session_async: Error starting creation: " << e.what() << std::endl;
+        delete request;
+        pending.leave();
+        return nullptr;
+    }
+
+    return request;
+}
+
+void
+ua_location_service_session_request_destroy(
+    UALocationServiceSessionRequest* request)
+{
+    if (not request)
+        return;
+
+    request->state->cancel();
+    delete request;
+}
+
 UALocationServiceController*
 ua_location_service_create_controller()
 {
@@ -61,9 +61,11 @@ ua_location_service_session_set_position_updates_handler(
 
     try
     {
-        std::lock_guard<std::mutex> lg(s->position_updates.guard);
-        s->position_updates.handler = handler;
-        s->position_updates.context = context;
+        s->position_updates.update([handler, context](decltype(s->position_updates)::Record& r)
+        {
+            r.handler = handler;
+            r.context = context;
+        });
     } catch(const std::exception& e)
     {
         fprintf(stderr, "Error setting up position updates handler: %s \n", e.what());
@@ -86,9 +88,11 @@ ua_location_service_session_set_heading_updates_handler(
 
     try
     {
-        std::lock_guard<std::mutex> lg(s->heading_updates.guard);
-        s->heading_updates.handler = handler;
-        s->heading_updates.context = context;
+        s->heading_updates.update([handler, context](decltype(s->heading_updates)::Record& r)
+        {
+            r.handler = handler;
+            r.context = context;
+        });
     } catch(const std::exception& e)
     {
         fprintf(stderr, "Error setting up heading updates handler: %s \n", e.what());
@@ -111,9 +115,11 @@ ua_location_service_session_set_velocity_updates_handler(
 
     try
     {
-        std::lock_guard<std::mutex> lg(s->velocity_updates.guard);
-        s->velocity_updates.handler = handler;
-        s->velocity_updates.context = context;
+        s->velocity_updates.update([handler, context](decltype(s->velocity_updates)::Record& r)
+        {
+            r.handler = handler;
+            r.context = context;
+        });
     } catch(const std::exception& e)
     {
         fprintf(stderr, "Error setting up velocity updates handler: %s \n", e.what());
@@ -123,6 +129,247 @@ ua_location_service_session_set_velocity_updates_handler(
     }
 }
 
+UStatus
+ua_location_service_session_set_fix_handler(
+    UALocationServiceSession *session,
+    UALocationServiceSessionFixHandler handler,
+    uint32_t window_in_ms,
+    void *context)
+{
+    if (not session)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+
+    try
+    {
+        s->fixes.set_handler(handler, window_in_ms, context);
+    } catch(...)
+    {
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_location_service_session_set_geofence_set(
+    UALocationServiceSession *session,
+    UALocationGeofenceSet *set)
+{
+    if (not session)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+    s->set_geofences(set);
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_location_service_session_set_position_filter(
+    UALocationServiceSession *session,
+    double min_distance_in_meter,
+    uint32_t min_interval_in_ms)
+{
+    if (not session || min_distance_in_meter < 0)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+
+    try
+    {
+        s->position_updates.update([min_distance_in_meter, min_interval_in_ms](decltype(s->position_updates)::Record& r)
+        {
+            r.filter.min_distance = min_distance_in_meter;
+            r.filter.min_interval = std::chrono::milliseconds{min_interval_in_ms};
+        });
+    } catch(...)
+    {
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_location_service_session_set_history_capacity(
+    UALocationServiceSession *session,
+    uint32_t capacity)
+{
+    if (not session)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+
+    try
+    {
+        if (not s->history.set_capacity(capacity))
+            return U_STATUS_ERROR;
+    } catch(...)
+    {
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+uint32_t
+ua_location_service_session_get_history(
+    UALocationServiceSession *session,
+    uint64_t since_in_us,
+    UALocationPosition *buffer,
+    uint32_t max)
+{
+    if (not session)
+        return 0;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+    return s->history.get(since_in_us, buffer, max);
+}
+
+UStatus
+ua_location_service_session_get_nearest_fix(
+    UALocationServiceSession *session,
+    uint64_t timestamp_in_us,
+    UALocationPosition *position)
+{
+    if (not session || not position)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+    if (not s->history.nearest(timestamp_in_us, *position))
+        return U_STATUS_ERROR;
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_location_service_session_set_position_smoothing(
+    UALocationServiceSession *session,
+    double acceleration_noise_in_meter_per_square_second)
+{
+    if (not session || not (acceleration_noise_in_meter_per_square_second >= 0))
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+    s->smoother.set_acceleration_noise(acceleration_noise_in_meter_per_square_second);
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_location_service_session_start_dead_reckoning(
+    UALocationServiceSession *session,
+    uint32_t rate_in_hz,
+    UALocationServiceSessionFixHandler handler,
+    void *context)
+{
+    if (not session)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+
+    try
+    {
+        if (not s->dead_reckoning_driver.start(rate_in_hz, handler, context))
+            return U_STATUS_ERROR;
+    } catch(...)
+    {
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+void
+ua_location_service_session_stop_dead_reckoning(
+    UALocationServiceSession *session)
+{
+    if (not session)
+        return;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+    s->dead_reckoning_driver.stop();
+}
+
+UStatus
+ua_location_service_session_set_adaptive_position_interval(
+    UALocationServiceSession *session,
+    uint32_t stationary_interval_in_ms,
+    uint32_t walking_interval_in_ms,
+    uint32_t driving_interval_in_ms)
+{
+    if (not session)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+
+    try
+    {
+        s->position_updates.update([=](decltype(s->position_updates)::Record& r)
+        {
+            r.filter.adaptive = stationary_interval_in_ms > 0 || walking_interval_in_ms > 0 || driving_interval_in_ms > 0;
+            r.filter.stationary_interval = std::chrono::milliseconds{stationary_interval_in_ms};
+            r.filter.walking_interval = std::chrono::milliseconds{walking_interval_in_ms};
+            r.filter.driving_interval = std::chrono::milliseconds{driving_interval_in_ms};
+        });
+    } catch(...)
+    {
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_location_service_session_set_heading_filter(
+    UALocationServiceSession *session,
+    double min_change_in_degree)
+{
+    if (not session || min_change_in_degree < 0)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+
+    try
+    {
+        s->heading_updates.update([min_change_in_degree](decltype(s->heading_updates)::Record& r)
+        {
+            r.filter.min_change = min_change_in_degree;
+        });
+    } catch(...)
+    {
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_location_service_session_set_velocity_filter(
+    UALocationServiceSession *session,
+    double min_change_in_meter_per_second)
+{
+    if (not session || min_change_in_meter_per_second < 0)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationLocationServiceSession*>(session);
+
+    try
+    {
+        s->velocity_updates.update([min_change_in_meter_per_second](decltype(s->velocity_updates)::Record& r)
+        {
+            r.filter.min_change = min_change_in_meter_per_second;
+        });
+    } catch(...)
+    {
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
 UStatus
 ua_location_service_session_start_position_updates(
     UALocationServiceSession *session)
@@ -134,8 +381,13 @@ ua_location_service_session_start_position_updates(
 
     try
     {
+        // The first update after (re-)starting always passes the filter.
+        s->position_updates.update([](decltype(s->position_updates)::Record&) {});
+        s->smoother.reset();
+
         s->session->updates().position_status.set(
                     location::service::session::Interface::Updates::Status::enabled);
+        s->fixes.set_enabled(UA_LOCATION_FIX_POSITION, true);
     } catch(...)
     {
         return U_STATUS_ERROR;
@@ -157,6 +409,7 @@ ua_location_service_session_stop_position_updates(
     {
         s->session->updates().position_status.set(
                     location::service::session::Interface::Updates::Status::disabled);
+        s->fixes.set_enabled(UA_LOCATION_FIX_POSITION, false);
     } catch(...)
     {
     }    
@@ -173,8 +426,12 @@ ua_location_service_session_start_heading_updates(
 
     try
     {
+        // The first update after (re-)starting always passes the filter.
+        s->heading_updates.update([](decltype(s->heading_updates)::Record&) {});
+
         s->session->updates().heading_status.set(
                     location::service::session::Interface::Updates::Status::enabled);
+        s->fixes.set_enabled(UA_LOCATION_FIX_HEADING, true);
     } catch(...)
     {
         return U_STATUS_ERROR;
@@ -196,6 +453,7 @@ ua_location_service_session_stop_heading_updates(
     {
         s->session->updates().heading_status.set(
                     location::service::session::Interface::Updates::Status::disabled);
+        s->fixes.set_enabled(UA_LOCATION_FIX_HEADING, false);
     } catch(...)
     {
     }
@@ -212,8 +470,12 @@ ua_location_service_session_start_velocity_updates(
 
     try
     {
+        // The first update after (re-)starting always passes the filter.
+        s->velocity_updates.update([](decltype(s->velocity_updates)::Record&) {});
+
         s->session->updates().velocity_status.set(
                     location::service::session::Interface::Updates::Status::enabled);
+        s->fixes.set_enabled(UA_LOCATION_FIX_VELOCITY, true);
     } catch(...)
     {
         return U_STATUS_ERROR;
@@ -235,6 +497,7 @@ ua_location_service_session_stop_velocity_updates(
     {
         s->session->updates().velocity_status.set(
                     location::service::session::Interface::Updates::Status::disabled);
+        s->fixes.set_enabled(UA_LOCATION_FIX_VELOCITY, false);
     } catch(...)
     {
     }
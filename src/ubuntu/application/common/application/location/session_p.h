@@ -20,7 +20,16 @@
 
 #include "ubuntu/application/location/session.h"
 
+#include "dead_reckoning.h"
+#include "dead_reckoning_driver.h"
+#include "fix_history.h"
+#include "fix_merger.h"
+#include "geofence_p.h"
+#include "handler_slot.h"
+#include "motion_regime.h"
+#include "position_smoother.h"
 #include "ref_counted.h"
+#include "update_filter.h"
 
 #include "heading_update_p.h"
 #include "position_update_p.h"
@@ -28,63 +37,63 @@
 
 #include <com/ubuntu/location/service/session/interface.h>
 
-#include <mutex>
-
 namespace cul = com::ubuntu::location;
 namespace culss = com::ubuntu::location::service::session;
 
+/*
+ * The updates hold a reference while they are handled, as a handler may
+ * drop the application's last one; the session then goes away once the
+ * update was handled.
+ */
 struct UbuntuApplicationLocationServiceSession : public detail::RefCounted
 {
     UbuntuApplicationLocationServiceSession(const culss::Interface::Ptr& session)
             : session(session),
+              geofences{nullptr},
+              dead_reckoning_driver{dead_reckoning},
               connections
               {
                   session->updates().position.changed().connect(
                       [this](const cul::Update<cul::Position>& new_position)
                       {
+                          if (not try_ref())
+                              return;
                           try
                           {
-                              std::lock_guard<std::mutex> lg(position_updates.guard);
-
-                              UbuntuApplicationLocationPositionUpdate pu{new_position};
-                              if (position_updates.handler) position_updates.handler(
-                                  std::addressof(pu),
-                                  position_updates.context);
+                              on_position(new_position);
                           } catch(...)
                           {
                               // We silently ignore the issue and keep going.
                           }
+                          unref();
                       }),
                   session->updates().heading.changed().connect(
                       [this](const cul::Update<cul::Heading>& new_heading)
                       {
+                          if (not try_ref())
+                              return;
                           try
                           {
-                              std::lock_guard<std::mutex> lg(heading_updates.guard);
-                              UbuntuApplicationLocationHeadingUpdate hu{new_heading};
-                              if (heading_updates.handler) heading_updates.handler(
-                                      std::addressof(hu),
-                                      heading_updates.context);
+                              on_heading(new_heading);
                           } catch(...)
                           {
                               // We silently ignore the issue and keep going.
                           }
+                          unref();
                       }),
                   session->updates().velocity.changed().connect(
                       [this](const cul::Update<cul::Velocity>& new_velocity)
                       {
+                          if (not try_ref())
+                              return;
                           try
                           {
-                              std::lock_guard<std::mutex> lg(velocity_updates.guard);
-
-                              UbuntuApplicationLocationVelocityUpdate vu{new_velocity};
-                              if (velocity_updates.handler) velocity_updates.handler(
-                                      std::addressof(vu),
-                                      velocity_updates.context);
+                              on_velocity(new_velocity);
                           } catch(...)
                           {
                               // We silently ignore the issue and keep going.
                           }
+                          unref();
                       }),
               }
     {
@@ -92,37 +101,133 @@ struct UbuntuApplicationLocationServiceSession : public detail::RefCounted
 
     ~UbuntuApplicationLocationServiceSession()
     {
-        std::lock_guard<std::mutex> lgp(position_updates.guard);
-        std::lock_guard<std::mutex> lgh(heading_updates.guard);
-        std::lock_guard<std::mutex> lgv(velocity_updates.guard);
+        // No handler may run past this point.
+        dead_reckoning_driver.stop();
+        fixes.shutdown();
+        position_updates.shutdown();
+        heading_updates.shutdown();
+        velocity_updates.shutdown();
+
+        set_geofences(nullptr);
+    }
 
-        position_updates.handler = nullptr;
-        heading_updates.handler = nullptr;
-        velocity_updates.handler = nullptr;
+    void on_position(const cul::Update<cul::Position>& new_position)
+    {
+        if (smoother.enabled())
+        {
+            cul::Update<cul::Position> smoothed{new_position};
+            // Outliers reach none of the consumers.
+            if (smoother.smooth(new_position, smoothed))
+                deliver_position(smoothed);
+            return;
+        }
+
+        deliver_position(new_position);
     }
 
-    culss::Interface::Ptr session;
+    void deliver_position(const cul::Update<cul::Position>& position)
+    {
+        motion.observe_position(
+                    position.value.latitude.value.value(),
+                    position.value.longitude.value.value(),
+                    position.value.accuracy.horizontal ? position.value.accuracy.horizontal->value() : 0,
+                    position.when);
+        position_updates.dispatch<UbuntuApplicationLocationPositionUpdate>(position, motion.current());
+
+        UbuntuApplicationLocationGeofenceSet* fences = acquire_geofences();
+        {
+            UbuntuApplicationLocationPositionUpdate update{position};
+            UALocationPosition snapshot;
+            if (ua_location_position_update_read(&update, &snapshot) == U_STATUS_SUCCESS)
+            {
+                history.add(snapshot);
+                if (fixes.active())
+                    fixes.add(snapshot);
+                if (fences)
+                    fences->evaluate(snapshot);
+                if (dead_reckoning_driver.running())
+                    dead_reckoning.fix(
+                        detail::DeadReckoningDriver::now(), snapshot.latitude, snapshot.longitude,
+                        (snapshot.valid & UA_LOCATION_POSITION_HORIZONTAL_ACCURACY) ? snapshot.horizontal_accuracy : 0);
+            }
+        }
+        if (fences)
+            fences->unref();
+    }
 
-    struct
+    void on_heading(const cul::Update<cul::Heading>& new_heading)
+    {
+        smoother.observe(new_heading);
+        if (dead_reckoning_driver.running())
+            dead_reckoning.heading(detail::DeadReckoningDriver::now(), new_heading.value.value());
+        heading_updates.dispatch<UbuntuApplicationLocationHeadingUpdate>(new_heading);
+
+        if (fixes.active())
+        {
+            UbuntuApplicationLocationHeadingUpdate update{new_heading};
+            UALocationHeading snapshot;
+            if (ua_location_heading_update_read(&update, &snapshot) == U_STATUS_SUCCESS)
+                fixes.add(snapshot);
+        }
+    }
+
+    void on_velocity(const cul::Update<cul::Velocity>& new_velocity)
     {
-        std::mutex guard;
-        UALocationServiceSessionPositionUpdatesHandler handler{nullptr};
-        void* context{nullptr};
-    } position_updates{};
+        smoother.observe(new_velocity);
+        motion.observe_velocity(new_velocity.value.value(), new_velocity.when);
+        if (dead_reckoning_driver.running())
+            dead_reckoning.velocity(detail::DeadReckoningDriver::now(), new_velocity.value.value());
+        velocity_updates.dispatch<UbuntuApplicationLocationVelocityUpdate>(new_velocity);
+
+        if (fixes.active())
+        {
+            UbuntuApplicationLocationVelocityUpdate update{new_velocity};
+            UALocationVelocity snapshot;
+            if (ua_location_velocity_update_read(&update, &snapshot) == U_STATUS_SUCCESS)
+                fixes.add(snapshot);
+        }
+    }
 
-    struct
+    /** The attached geofence set with a reference taken, or null. */
+    UbuntuApplicationLocationGeofenceSet* acquire_geofences()
     {
-        std::mutex guard;
-        UALocationServiceSessionHeadingUpdatesHandler handler{nullptr};
-        void* context{nullptr};
-    } heading_updates{};
+        std::lock_guard<std::mutex> lg(geofences_guard);
+        if (geofences)
+            geofences->ref();
+        return geofences;
+    }
 
-    struct
+    void set_geofences(UbuntuApplicationLocationGeofenceSet* set)
     {
-        std::mutex guard;
-        UALocationServiceSessionVelocityUpdatesHandler handler{nullptr};
-        void* context{nullptr};
-    } velocity_updates{};
+        if (set)
+            set->ref();
+
+        UbuntuApplicationLocationGeofenceSet* previous = nullptr;
+        {
+            std::lock_guard<std::mutex> lg(geofences_guard);
+            previous = geofences;
+            geofences = set;
+        }
+
+        if (previous)
+            previous->unref();
+    }
+
+    culss::Interface::Ptr session;
+
+    detail::HandlerSlot<UALocationServiceSessionPositionUpdatesHandler, detail::PositionFilter> position_updates;
+    detail::HandlerSlot<UALocationServiceSessionHeadingUpdatesHandler, detail::HeadingFilter> heading_updates;
+    detail::HandlerSlot<UALocationServiceSessionVelocityUpdatesHandler, detail::VelocityFilter> velocity_updates;
+    detail::FixMerger fixes;
+    detail::FixHistory history;
+    detail::PositionSmoother smoother;
+    detail::MotionRegime motion;
+
+    std::mutex geofences_guard;
+    UbuntuApplicationLocationGeofenceSet* geofences;
+
+    detail::DeadReckoning dead_reckoning;
+    detail::DeadReckoningDriver dead_reckoning_driver;
 
     struct
     {
@@ -0,0 +1,157 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSION_REQUEST_PRIVATE_H_
+#define SESSION_REQUEST_PRIVATE_H_
+
+#include "ubuntu/application/location/service.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace detail
+{
+/**
+ * Book-keeping of the asynchronous session requests still being worked on,
+ * so that library teardown waits for them instead of destroying the static
+ * Instance under their feet. Never destroyed itself, as the workers may
+ * outlive every other static object.
+ */
+class PendingRequests
+{
+  public:
+    static PendingRequests& instance()
+    {
+        static PendingRequests* pending = new PendingRequests;
+        return *pending;
+    }
+
+    /** Registers a worker; false once teardown began, in which case there must not be one. */
+    bool enter()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        if (closing)
+            return false;
+
+        busy++;
+        return true;
+    }
+
+    void leave()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        busy--;
+        idle.notify_all();
+    }
+
+    bool closed()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        return closing;
+    }
+
+    /** Refuses further requests and waits for the workers still running. */
+    void close()
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        closing = true;
+        idle.wait(ul, [this]() { return busy == 0; });
+    }
+
+  private:
+    PendingRequests() : busy{0}, closing{false}
+    {
+    }
+
+    std::mutex guard;
+    std::condition_variable idle;
+    unsigned int busy;
+    bool closing;
+};
+}
+
+/**
+ * The application's handle of an asynchronous session request. The worker
+ * creating the session shares the state, as the handle may be destroyed
+ * before the service answered.
+ */
+struct UbuntuApplicationLocationServiceSessionRequest
+{
+    struct State
+    {
+        State(UALocationServiceSessionCreatedHandler handler, void* context)
+            : handler{handler},
+              context{context},
+              cancelled{false},
+              invoking{false}
+        {
+        }
+
+        /** Invokes the handler unless the request was cancelled; false if it was. */
+        bool invoke(UALocationServiceSession* session, UALocationServiceError error)
+        {
+            {
+                std::lock_guard<std::mutex> lg(guard);
+                if (cancelled)
+                    return false;
+
+                invoking = true;
+                invoker = std::this_thread::get_id();
+            }
+
+            handler(session, error, context);
+
+            std::lock_guard<std::mutex> lg(guard);
+            invoking = false;
+            idle.notify_all();
+            return true;
+        }
+
+        /**
+         * Keeps the handler from being invoked and waits for a running
+         * invocation, unless called from within the handler.
+         */
+        void cancel()
+        {
+            std::unique_lock<std::mutex> ul(guard);
+            cancelled = true;
+            if (invoking && invoker == std::this_thread::get_id())
+                return;
+
+            idle.wait(ul, [this]() { return not invoking; });
+        }
+
+        const UALocationServiceSessionCreatedHandler handler;
+        void* const context;
+
+        std::mutex guard;
+        std::condition_variable idle;
+        bool cancelled;
+        bool invoking;
+        std::thread::id invoker;
+    };
+
+    UbuntuApplicationLocationServiceSessionRequest(UALocationServiceSessionCreatedHandler handler, void* context)
+        : state{std::make_shared<State>(handler, context)}
+    {
+    }
+
+    std::shared_ptr<State> state;
+};
+
+#endif // SESSION_REQUEST_PRIVATE_H_
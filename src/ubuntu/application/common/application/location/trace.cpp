@@ -0,0 +1,448 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+
+#include "update_filter.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+// Nominal user equivalent range error, turns a dilution of precision into [m].
+const double range_error = 5.;
+const double meter_per_second_per_knot = 1852. / 3600.;
+const double seconds_per_day = 86400.;
+
+detail::TraceSample empty_sample()
+{
+    detail::TraceSample s;
+    s.time = 0;
+    s.latitude = s.longitude = 0;
+    s.has_altitude = false;
+    s.altitude = 0;
+    s.has_accuracy = false;
+    s.accuracy = 0;
+    s.speed = -1;
+    s.has_course = false;
+    s.course = 0;
+    return s;
+}
+
+double bearing_in_degree(double lat1, double lon1, double lat2, double lon2)
+{
+    static const double to_radian = M_PI / 180.;
+
+    double dlon = (lon2 - lon1) * to_radian;
+    double y = std::sin(dlon) * std::cos(lat2 * to_radian);
+    double x = std::cos(lat1 * to_radian) * std::sin(lat2 * to_radian) -
+               std::sin(lat1 * to_radian) * std::cos(lat2 * to_radian) * std::cos(dlon);
+    double bearing = std::atan2(y, x) / to_radian;
+    return bearing < 0 ? bearing + 360 : bearing;
+}
+
+// Fills in speed and course from the neighbouring fixes and makes the times relative.
+std::vector<detail::TraceSample> complete(std::vector<detail::TraceSample> samples)
+{
+    if (samples.empty())
+        return samples;
+
+    double start = samples.front().time;
+    for (auto& s : samples)
+        s.time -= start;
+
+    for (std::size_t i = 0; i < samples.size(); i++)
+    {
+        detail::TraceSample& s = samples[i];
+        if (s.speed >= 0 && s.has_course)
+            continue;
+
+        // The leg towards this fix, or away from it for the first one.
+        const detail::TraceSample* from = i > 0 ? &samples[i - 1] : nullptr;
+        const detail::TraceSample* to = &s;
+        if (not from && samples.size() > 1)
+        {
+            from = &s;
+            to = &samples[1];
+        }
+
+        double distance = 0, dt = 0;
+        if (from)
+        {
+            distance = detail::haversine_distance_in_meter(from->latitude, from->longitude, to->latitude, to->longitude);
+            dt = to->time - from->time;
+        }
+
+        if (s.speed < 0)
+            s.speed = dt > 0 ? distance / dt : 0;
+
+        // A standing device keeps the course it had.
+        if (not s.has_course && distance > 0)
+        {
+            s.has_course = true;
+            s.course = bearing_in_degree(from->latitude, from->longitude, to->latitude, to->longitude);
+        }
+        else if (not s.has_course && i > 0 && samples[i - 1].has_course)
+        {
+            s.has_course = true;
+            s.course = samples[i - 1].course;
+        }
+    }
+
+    return samples;
+}
+
+/** Seconds since the epoch of an ISO 8601 time, e.g. 2020-05-01T12:00:00.5Z; false if malformed. */
+bool parse_iso8601(const std::string& text, double& seconds)
+{
+    int year, month, day, hour, minute;
+    double second;
+    int consumed = 0;
+    if (std::sscanf(text.c_str(), "%d-%d-%dT%d:%d:%lf%n", &year, &month, &day, &hour, &minute, &second, &consumed) != 6)
+        return false;
+
+    struct tm t = {};
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_min = minute;
+    seconds = double(timegm(&t)) + second;
+
+    // Local times are taken as UTC, there is nothing better to go by.
+    const char* zone = text.c_str() + consumed;
+    int zone_hours = 0, zone_minutes = 0;
+    if ((*zone == '+' || *zone == '-') && std::sscanf(zone + 1, "%d:%d", &zone_hours, &zone_minutes) >= 1)
+        seconds -= (*zone == '-' ? -1 : 1) * (zone_hours * 3600. + zone_minutes * 60.);
+
+    return true;
+}
+
+/** The value of attribute name in the start tag tag, false if missing. */
+bool attribute(const std::string& tag, const char* name, std::string& value)
+{
+    std::string key = std::string{name} + "=";
+    std::size_t pos = tag.find(key);
+    while (pos != std::string::npos && not std::isspace(static_cast<unsigned char>(tag[pos - 1])))
+        pos = tag.find(key, pos + 1);
+    if (pos == std::string::npos)
+        return false;
+
+    pos += key.size();
+    if (pos >= tag.size() || (tag[pos] != '"' && tag[pos] != '\''))
+        return false;
+
+    std::size_t end = tag.find(tag[pos], pos + 1);
+    if (end == std::string::npos)
+        return false;
+
+    value = tag.substr(pos + 1, end - pos - 1);
+    return true;
+}
+
+/** The text of the first element named name in body, ignoring namespace prefixes. */
+bool element(const std::string& body, const char* name, std::string& text)
+{
+    std::string wanted{name};
+    for (std::size_t pos = body.find('<'); pos != std::string::npos; pos = body.find('<', pos + 1))
+    {
+        std::size_t end = body.find_first_of(" >/", pos + 1);
+        if (end == std::string::npos || body[end] != '>')
+            continue;
+
+        std::string tag = body.substr(pos + 1, end - pos - 1);
+        std::size_t colon = tag.find(':');
+        if (colon != std::string::npos)
+            tag = tag.substr(colon + 1);
+        if (tag != wanted)
+            continue;
+
+        std::size_t close = body.find('<', end + 1);
+        text = body.substr(end + 1, close == std::string::npos ? std::string::npos : close - end - 1);
+        return true;
+    }
+
+    return false;
+}
+
+bool number(const std::string& text, double& value)
+{
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return end != text.c_str();
+}
+
+std::vector<detail::TraceSample> parse_gpx_points(const std::string& document, const char* point)
+{
+    std::vector<detail::TraceSample> samples;
+    std::string open = std::string{"<"} + point;
+    std::string close = std::string{"</"} + point + ">";
+
+    for (std::size_t pos = document.find(open); pos != std::string::npos; pos = document.find(open, pos + 1))
+    {
+        std::size_t tag_end = document.find('>', pos);
+        if (tag_end == std::string::npos)
+            break;
+
+        std::string tag = document.substr(pos, tag_end - pos);
+        std::string body;
+        if (document[tag_end - 1] != '/')
+        {
+            std::size_t body_end = document.find(close, tag_end);
+            if (body_end == std::string::npos)
+                break;
+            body = document.substr(tag_end + 1, body_end - tag_end - 1);
+        }
+
+        detail::TraceSample s = empty_sample();
+        std::string text;
+        if (not attribute(tag, "lat", text) || not number(text, s.latitude) ||
+            not attribute(tag, "lon", text) || not number(text, s.longitude))
+            continue;
+
+        s.time = samples.empty() ? 0 : samples.back().time + 1;
+        double value;
+        if (element(body, "time", text))
+            parse_iso8601(text, s.time);
+        if (element(body, "ele", text) && number(text, value))
+        {
+            s.has_altitude = true;
+            s.altitude = value;
+        }
+        if (element(body, "hdop", text) && number(text, value))
+        {
+            s.has_accuracy = true;
+            s.accuracy = value * range_error;
+        }
+        if (element(body, "speed", text) && number(text, value) && value >= 0)
+            s.speed = value;
+        if (element(body, "course", text) && number(text, value))
+        {
+            s.has_course = true;
+            s.course = value;
+        }
+
+        samples.push_back(s);
+    }
+
+    return samples;
+}
+
+/** NMEA ddmm.mmmm or dddmm.mmmm with hemisphere into [°]. */
+bool nmea_angle(const std::string& text, const std::string& hemisphere, double& degree)
+{
+    double value;
+    if (text.empty() || not number(text, value))
+        return false;
+
+    double degrees = std::floor(value / 100);
+    degree = degrees + (value - degrees * 100) / 60;
+    if (hemisphere == "S" || hemisphere == "W")
+        degree = -degree;
+    return true;
+}
+
+/** NMEA hhmmss.ss into seconds of the day. */
+bool nmea_time(const std::string& text, double& seconds)
+{
+    double value;
+    if (text.size() < 6 || not number(text, value))
+        return false;
+
+    int hhmmss = int(value);
+    seconds = (hhmmss / 10000) * 3600. + (hhmmss / 100 % 100) * 60. + (value - hhmmss / 100 * 100);
+    return true;
+}
+
+/** Splits a sentence into its fields if the checksum, if any, matches. */
+bool nmea_fields(const std::string& line, std::vector<std::string>& fields)
+{
+    std::size_t start = line.find('$');
+    if (start == std::string::npos)
+        return false;
+
+    std::size_t star = line.find('*', start);
+    std::string data = line.substr(start + 1, star == std::string::npos ? std::string::npos : star - start - 1);
+
+    if (star != std::string::npos)
+    {
+        unsigned int checksum = 0;
+        for (char c : data)
+            checksum ^= static_cast<unsigned char>(c);
+        if (checksum != std::strtoul(line.substr(star + 1, 2).c_str(), nullptr, 16))
+            return false;
+    }
+
+    fields.clear();
+    std::size_t pos = 0;
+    for (std::size_t comma = data.find(','); ; comma = data.find(',', pos))
+    {
+        fields.push_back(data.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos));
+        if (comma == std::string::npos)
+            break;
+        pos = comma + 1;
+    }
+
+    return fields.front().size() >= 3;
+}
+}
+
+std::vector<detail::TraceSample> detail::parse_gpx(std::istream& in)
+{
+    std::string document{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+
+    std::vector<TraceSample> samples = parse_gpx_points(document, "trkpt");
+    if (samples.empty())
+        samples = parse_gpx_points(document, "rtept");
+
+    return complete(std::move(samples));
+}
+
+std::vector<detail::TraceSample> detail::parse_nmea(std::istream& in)
+{
+    std::vector<TraceSample> samples;
+
+    // The sentences of the fix being collected.
+    std::string key;
+    TraceSample current = empty_sample();
+    bool has_position = false;
+
+    // Sentences carry the time of day only, RMC also the date. Until the
+    // first date, day counts the midnights passed since the log began.
+    double day = 0;
+    bool dated = false;
+    double last_time_of_day = -1;
+
+    auto flush = [&]()
+    {
+        if (has_position)
+            samples.push_back(current);
+        current = empty_sample();
+        has_position = false;
+    };
+
+    std::string line;
+    std::vector<std::string> f;
+    while (std::getline(in, line))
+    {
+        if (not nmea_fields(line, f))
+            continue;
+
+        std::string type = f[0].substr(f[0].size() - 3);
+        bool rmc = type == "RMC" && f.size() >= 10;
+        bool gga = type == "GGA" && f.size() >= 10;
+        if (not rmc && not gga)
+            continue;
+
+        double time_of_day;
+        if (not nmea_time(f[1], time_of_day))
+            continue;
+
+        if (f[1] != key)
+        {
+            flush();
+            key = f[1];
+
+            // Without a date, passing midnight shows as time going back by a lot.
+            if (last_time_of_day >= 0 && time_of_day < last_time_of_day - seconds_per_day / 2)
+                day += seconds_per_day;
+            last_time_of_day = time_of_day;
+        }
+
+        if (rmc && f[9].size() == 6)
+        {
+            struct tm t = {};
+            t.tm_mday = std::atoi(f[9].substr(0, 2).c_str());
+            t.tm_mon = std::atoi(f[9].substr(2, 2).c_str()) - 1;
+            t.tm_year = std::atoi(f[9].substr(4, 2).c_str()) + 100;
+            double date = double(timegm(&t));
+
+            // Re-bases the fixes read before the first date, they would be days off.
+            if (not dated)
+            {
+                for (auto& sample : samples)
+                    sample.time += date - day;
+                dated = true;
+            }
+            day = date;
+        }
+        current.time = day + time_of_day;
+
+        double latitude, longitude, value;
+        if (rmc)
+        {
+            if (f[2] != "A" || not nmea_angle(f[3], f[4], latitude) || not nmea_angle(f[5], f[6], longitude))
+                continue;
+
+            has_position = true;
+            current.latitude = latitude;
+            current.longitude = longitude;
+            if (number(f[7], value))
+                current.speed = value * meter_per_second_per_knot;
+            if (number(f[8], value))
+            {
+                current.has_course = true;
+                current.course = value;
+            }
+        }
+        else
+        {
+            if (f[6].empty() || f[6] == "0" || not nmea_angle(f[2], f[3], latitude) || not nmea_angle(f[4], f[5], longitude))
+                continue;
+
+            has_position = true;
+            current.latitude = latitude;
+            current.longitude = longitude;
+            if (number(f[8], value))
+            {
+                current.has_accuracy = true;
+                current.accuracy = value * range_error;
+            }
+            if (number(f[9], value))
+            {
+                current.has_altitude = true;
+                current.altitude = value;
+            }
+        }
+    }
+    flush();
+
+    return complete(std::move(samples));
+}
+
+std::vector<detail::TraceSample> detail::load_trace(const std::string& path)
+{
+    std::ifstream in{path};
+    if (not in)
+        throw std::runtime_error{"Cannot open location trace " + path};
+
+    in >> std::ws;
+    char first = static_cast<char>(in.peek());
+
+    std::vector<TraceSample> samples = first == '<' ? parse_gpx(in) : parse_nmea(in);
+    if (samples.empty())
+        throw std::runtime_error{"No fixes in location trace " + path};
+
+    return samples;
+}
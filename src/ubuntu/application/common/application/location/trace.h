@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace detail
+{
+/** One fix of a recorded trace. */
+struct TraceSample
+{
+    double time; ///< [s] since the first sample of the trace
+    double latitude; ///< [°]
+    double longitude; ///< [°]
+    bool has_altitude;
+    double altitude; ///< [m]
+    bool has_accuracy;
+    double accuracy; ///< [m], horizontal
+    double speed; ///< [m/s], derived from the neighbouring fixes if not recorded
+    bool has_course;
+    double course; ///< [°] clockwise from north, derived if not recorded and the device moved
+};
+
+/**
+ * Reads the track points of a GPX file, or route points if it has no track.
+ * Elevation, time, speed, course and hdop are picked up if present, also
+ * from extensions. Points without time are taken to be 1s apart.
+ */
+std::vector<TraceSample> parse_gpx(std::istream& in);
+
+/**
+ * Reads the RMC and GGA sentences of an NMEA 0183 log; sentences with a bad
+ * checksum or without a valid fix are skipped. Sentences for the same time
+ * of day make up one fix. Fixes before the first RMC date are dated back
+ * from it.
+ */
+std::vector<TraceSample> parse_nmea(std::istream& in);
+
+/**
+ * Reads a GPX or NMEA file, telling them apart by their first character.
+ * Throws std::runtime_error if the file cannot be read or holds no fixes.
+ */
+std::vector<TraceSample> load_trace(const std::string& path);
+}
+
+#endif // TRACE_H_
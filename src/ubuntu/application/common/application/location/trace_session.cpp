@@ -0,0 +1,193 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace_session.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace cul = com::ubuntu::location;
+namespace culss = com::ubuntu::location::service::session;
+
+namespace
+{
+typedef culss::Interface::Updates::Status Status;
+
+// [s] of trace time between the last fix and the first one when looping.
+const double loop_gap = 1.;
+
+// Traces are loaded once per process and shared by its sessions.
+std::shared_ptr<const std::vector<detail::TraceSample>> shared_trace(const std::string& path)
+{
+    static std::mutex guard;
+    static std::string loaded_path;
+    static std::shared_ptr<const std::vector<detail::TraceSample>> trace;
+
+    std::lock_guard<std::mutex> lg(guard);
+    if (not trace || loaded_path != path)
+    {
+        trace = std::make_shared<const std::vector<detail::TraceSample>>(detail::load_trace(path));
+        loaded_path = path;
+    }
+    return trace;
+}
+}
+
+culss::Interface::Ptr detail::TraceSession::create_from_environment()
+{
+    const char* backend = ::getenv("UBUNTU_PLATFORM_API_LOCATION_BACKEND");
+    if (not backend || std::strcmp(backend, "trace") != 0)
+        return Ptr{};
+
+    const char* path = ::getenv("UBUNTU_PLATFORM_API_LOCATION_TRACE");
+    if (not path)
+        throw std::runtime_error{"UBUNTU_PLATFORM_API_LOCATION_TRACE names no trace to replay"};
+
+    double speed = 1;
+    if (const char* env = ::getenv("UBUNTU_PLATFORM_API_LOCATION_TRACE_SPEED"))
+        speed = std::strtod(env, nullptr);
+    if (not (speed > 0))
+        throw std::runtime_error{"UBUNTU_PLATFORM_API_LOCATION_TRACE_SPEED needs to be positive"};
+
+    const char* loop = ::getenv("UBUNTU_PLATFORM_API_LOCATION_TRACE_LOOP");
+
+    return std::make_shared<TraceSession>(shared_trace(path), speed, loop && std::strcmp(loop, "1") == 0);
+}
+
+detail::TraceSession::TraceSession(const std::shared_ptr<const std::vector<TraceSample>>& trace, double speed, bool loop)
+    : trace(trace),
+      speed(speed),
+      loop(loop),
+      started{false},
+      stopping{false},
+      position_enabled{false},
+      heading_enabled{false},
+      velocity_enabled{false},
+      connections
+      {
+          the_updates.position_status.changed().connect([this](Status status)
+          {
+              std::lock_guard<std::mutex> lg(guard);
+              position_enabled = status == Status::enabled;
+              started = started || position_enabled;
+              wakeup.notify_all();
+          }),
+          the_updates.heading_status.changed().connect([this](Status status)
+          {
+              std::lock_guard<std::mutex> lg(guard);
+              heading_enabled = status == Status::enabled;
+              started = started || heading_enabled;
+              wakeup.notify_all();
+          }),
+          the_updates.velocity_status.changed().connect([this](Status status)
+          {
+              std::lock_guard<std::mutex> lg(guard);
+              velocity_enabled = status == Status::enabled;
+              started = started || velocity_enabled;
+              wakeup.notify_all();
+          })
+      }
+{
+    the_updates.position_status.set(Status::disabled);
+    the_updates.heading_status.set(Status::disabled);
+    the_updates.velocity_status.set(Status::disabled);
+
+    player = std::thread{[this]() { run(); }};
+}
+
+detail::TraceSession::~TraceSession() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        stopping = true;
+    }
+    wakeup.notify_all();
+
+    if (player.joinable())
+        player.join();
+}
+
+culss::Interface::Updates& detail::TraceSession::updates()
+{
+    return the_updates;
+}
+
+void detail::TraceSession::run()
+{
+    std::unique_lock<std::mutex> ul(guard);
+    wakeup.wait(ul, [this]() { return started || stopping; });
+
+    const std::vector<TraceSample>& samples = *trace;
+    const double duration = samples.back().time + loop_gap;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0, round = 0; not stopping; )
+    {
+        if (i == samples.size())
+        {
+            if (not loop)
+                break;
+            i = 0;
+            round++;
+        }
+
+        double at = (round * duration + samples[i].time) / speed;
+        auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>{at});
+        if (wakeup.wait_until(ul, due, [this]() { return stopping; }))
+            break;
+
+        // Not holding the lock, the handlers of the session run from here.
+        ul.unlock();
+        publish(samples[i++]);
+        ul.lock();
+    }
+}
+
+void detail::TraceSession::publish(const TraceSample& sample)
+{
+    bool position, heading, velocity;
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        position = position_enabled;
+        heading = heading_enabled;
+        velocity = velocity_enabled;
+    }
+
+    auto now = cul::Clock::now();
+
+    if (position)
+    {
+        cul::Position p
+        {
+            cul::wgs84::Latitude{sample.latitude * cul::units::Degrees},
+            cul::wgs84::Longitude{sample.longitude * cul::units::Degrees}
+        };
+        if (sample.has_altitude)
+            p.altitude = cul::wgs84::Altitude{sample.altitude * cul::units::Meters};
+        if (sample.has_accuracy)
+            p.accuracy.horizontal = sample.accuracy * cul::units::Meters;
+
+        the_updates.position.set(cul::Update<cul::Position>{p, now});
+    }
+
+    if (heading && sample.has_course)
+        the_updates.heading.set(cul::Update<cul::Heading>{sample.course * cul::units::Degrees, now});
+
+    if (velocity)
+        the_updates.velocity.set(cul::Update<cul::Velocity>{sample.speed * cul::units::MetersPerSecond, now});
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRACE_SESSION_H_
+#define TRACE_SESSION_H_
+
+#include "trace.h"
+
+#include <com/ubuntu/location/service/session/interface.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace detail
+{
+/**
+ * A location service session that replays a recorded trace instead of
+ * talking to the service, for testing location heavy applications on
+ * machines without GPS or D-Bus.
+ *
+ * Selected with $UBUNTU_PLATFORM_API_LOCATION_BACKEND=trace, which replays
+ * $UBUNTU_PLATFORM_API_LOCATION_TRACE, a GPX or NMEA file, at
+ * $UBUNTU_PLATFORM_API_LOCATION_TRACE_SPEED times its original pace (1 by
+ * default). With $UBUNTU_PLATFORM_API_LOCATION_TRACE_LOOP=1 it starts over
+ * after the last fix.
+ *
+ * Each session replays the trace on a thread of its own, from the start
+ * once the first kind of update is enabled. Position, heading and velocity
+ * updates are published for the kinds that are enabled, timestamped with
+ * the time they are published at.
+ */
+class TraceSession : public com::ubuntu::location::service::session::Interface
+{
+  public:
+    /** A replaying session if the environment selects one, else null. Throws if the trace cannot be loaded. */
+    static Ptr create_from_environment();
+
+    TraceSession(const std::shared_ptr<const std::vector<TraceSample>>& trace, double speed, bool loop);
+    ~TraceSession() noexcept;
+
+    Updates& updates() override;
+
+  private:
+    void run();
+    void publish(const TraceSample& sample);
+
+    std::shared_ptr<const std::vector<TraceSample>> trace;
+    double speed;
+    bool loop;
+
+    Updates the_updates;
+
+    std::mutex guard;
+    std::condition_variable wakeup;
+    bool started;
+    bool stopping;
+    bool position_enabled;
+    bool heading_enabled;
+    bool velocity_enabled;
+
+    struct
+    {
+        core::ScopedConnection position_status;
+        core::ScopedConnection heading_status;
+        core::ScopedConnection velocity_status;
+    } connections;
+
+    std::thread player;
+};
+}
+
+#endif // TRACE_SESSION_H_
@@ -0,0 +1,157 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UPDATE_FILTER_H_
+#define UPDATE_FILTER_H_
+
+#include <com/ubuntu/location/heading.h>
+#include <com/ubuntu/location/position.h>
+#include <com/ubuntu/location/update.h>
+#include <com/ubuntu/location/velocity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace detail
+{
+/** Great-circle distance in [m] between two WGS84 coordinates given in degrees. */
+inline double haversine_distance_in_meter(double lat1, double lon1, double lat2, double lon2)
+{
+    static const double earth_radius = 6371008.8; // mean radius [m]
+    static const double to_radian = M_PI / 180.;
+
+    double dlat = (lat2 - lat1) * to_radian;
+    double dlon = (lon2 - lon1) * to_radian;
+    double a = std::sin(dlat / 2) * std::sin(dlat / 2) +
+               std::cos(lat1 * to_radian) * std::cos(lat2 * to_radian) *
+               std::sin(dlon / 2) * std::sin(dlon / 2);
+
+    return 2 * earth_radius * std::asin(std::sqrt(std::min(1., a)));
+}
+
+/** How fast the device moves, see MotionRegime. Ordered by speed. */
+enum class Motion
+{
+    stationary,
+    walking,
+    driving
+};
+
+/**
+ * Passes a position update only if it is at least min_distance away from
+ * and min_interval later than the last one passed. A threshold of 0 is
+ * always met; the first update after a reset always passes.
+ *
+ * If adaptive, the interval also depends on how fast the device moves, the
+ * larger of min_interval and the interval of the current motion applies.
+ */
+struct PositionFilter
+{
+    double min_distance{0}; ///< [m]
+    std::chrono::milliseconds min_interval{0};
+    bool adaptive{false};
+    std::chrono::milliseconds stationary_interval{0};
+    std::chrono::milliseconds walking_interval{0};
+    std::chrono::milliseconds driving_interval{0};
+
+    bool primed{false};
+    double latitude{0};
+    double longitude{0};
+    com::ubuntu::location::Clock::Timestamp when{};
+
+    void reset() { primed = false; }
+
+    bool accept(const com::ubuntu::location::Update<com::ubuntu::location::Position>& update,
+                Motion motion = Motion::walking)
+    {
+        double lat = update.value.latitude.value.value();
+        double lon = update.value.longitude.value.value();
+
+        if (primed)
+        {
+            std::chrono::milliseconds interval = min_interval;
+            if (adaptive)
+                interval = std::max(interval, motion == Motion::stationary ? stationary_interval :
+                                              motion == Motion::walking ? walking_interval : driving_interval);
+
+            if (interval.count() > 0 && update.when - when < interval)
+                return false;
+
+            if (min_distance > 0 && haversine_distance_in_meter(latitude, longitude, lat, lon) < min_distance)
+                return false;
+        }
+
+        primed = true;
+        latitude = lat;
+        longitude = lon;
+        when = update.when;
+        return true;
+    }
+};
+
+/** Passes a heading update only if it turned by at least min_change [°] since the last one passed. */
+struct HeadingFilter
+{
+    double min_change{0};
+
+    bool primed{false};
+    double heading{0};
+
+    void reset() { primed = false; }
+
+    bool accept(const com::ubuntu::location::Update<com::ubuntu::location::Heading>& update)
+    {
+        double value = update.value.value();
+
+        if (primed && min_change > 0)
+        {
+            // the shorter way around the circle
+            double change = std::fmod(std::fabs(value - heading), 360.);
+            if (std::min(change, 360. - change) < min_change)
+                return false;
+        }
+
+        primed = true;
+        heading = value;
+        return true;
+    }
+};
+
+/** Passes a velocity update only if it changed by at least min_change [m/s] since the last one passed. */
+struct VelocityFilter
+{
+    double min_change{0};
+
+    bool primed{false};
+    double velocity{0};
+
+    void reset() { primed = false; }
+
+    bool accept(const com::ubuntu::location::Update<com::ubuntu::location::Velocity>& update)
+    {
+        double value = update.value.value();
+
+        if (primed && min_change > 0 && std::fabs(value - velocity) < min_change)
+            return false;
+
+        primed = true;
+        velocity = value;
+        return true;
+    }
+};
+}
+
+#endif // UPDATE_FILTER_H_
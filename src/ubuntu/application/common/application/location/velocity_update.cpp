@@ -53,3 +53,18 @@ ua_location_velocity_update_get_velocity_in_meters_per_second(
 {
     return update->update.value.value();
 }
+
+UStatus
+ua_location_velocity_update_read(
+    UALocationVelocityUpdate *update,
+    UALocationVelocity *velocity)
+{
+    if (not update || not velocity)
+        return U_STATUS_ERROR;
+
+    velocity->timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        update->update.when.time_since_epoch()).count();
+    velocity->velocity = update->update.value.value();
+
+    return U_STATUS_SUCCESS;
+}
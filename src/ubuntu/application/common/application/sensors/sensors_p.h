@@ -25,8 +25,15 @@
 #include <core/dbus/types/stl/tuple.h>
 #include <core/dbus/types/stl/vector.h>
 
-#include <core/dbus/asio/executor.h>
+#include "application/dbus/bus_reactor.h"
 
+#include <ubuntu/application/sensors/haptic.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <memory>
 
@@ -34,22 +41,67 @@ namespace dbus = core::dbus;
 
 struct UbuntuApplicationSensorsHaptic
 {
-    UbuntuApplicationSensorsHaptic(std::shared_ptr<dbus::Object> session)
+    typedef std::pair<UASensorsHapticCompletionCallback, void*> Completion;
+
+    /** Shared with the calls in flight, whose replies are dropped once the instance is gone. */
+    struct Liveness
+    {
+        std::recursive_mutex guard; ///< Held while completion callbacks run.
+        bool alive;
+    };
+
+    UbuntuApplicationSensorsHaptic(
+        const ubuntu::application::BusReactor::Ptr& reactor,
+        std::shared_ptr<dbus::Object> session)
         : enabled(false), 
-          session(session)
+          reactor(reactor),
+          session(session),
+          liveness(std::make_shared<Liveness>()),
+          stopping(false),
+          coalescing_window(0)
     {
+        liveness->alive = true;
     }
 
     ~UbuntuApplicationSensorsHaptic()
     {
-        bus->stop();
+        // the reactor is shared and keeps running, so late replies must not
+        // reach the application, including those to the final flush below
+        {
+            std::lock_guard<std::recursive_mutex> lock(liveness->guard);
+            liveness->alive = false;
+        }
 
-        if (bus_thread.joinable())
-            bus_thread.join();
+        // the flush thread sends what is still pending before it exits
+        {
+            std::lock_guard<std::mutex> lock(guard);
+            stopping = true;
+        }
+        flush_cv.notify_all();
+        if (flush_thread.joinable())
+            flush_thread.join();
     }
 
     bool enabled;
+    ubuntu::application::BusReactor::Ptr reactor;
     std::shared_ptr<dbus::Object> session;
-    std::thread bus_thread;
-    std::shared_ptr<dbus::Bus> bus;
+    std::shared_ptr<Liveness> liveness;
+
+    // pattern requests merged into a single VibratePattern call
+    std::mutex guard;
+    std::condition_variable flush_cv;
+    std::thread flush_thread; ///< Started with the first coalesced request.
+    bool stopping;
+    std::chrono::milliseconds coalescing_window;
+    std::vector<std::uint32_t> batch;
+    std::vector<Completion> batch_completions;
+    std::chrono::steady_clock::time_point batch_deadline;
+};
+
+struct UbuntuApplicationSensorsHapticPattern
+{
+    std::vector<std::uint32_t> durations;
+    std::uint32_t repeat;
+    /** durations played repeat times as a single pass; empty if too long to be merged. */
+    std::vector<std::uint32_t> expanded;
 };
@@ -20,25 +20,130 @@
 #include "usensord_service.h"
 #include "sensors_p.h"
 
+#include <functional>
+#include <iostream>
+
 #include <stdlib.h>
 
 namespace dbus = core::dbus;
 namespace uas = ubuntu::application::sensors;
 
+namespace
+{
+// longest pattern sent in a single call when merging requests
+const std::size_t max_merged_pattern_size = 1024;
+
+// Reports the outcome of an asynchronous call from the bus thread, unless the instance is gone by then
+std::function<void(const dbus::Result<void>&)> completion(
+    UbuntuApplicationSensorsHaptic* s,
+    const std::vector<UbuntuApplicationSensorsHaptic::Completion>& completions)
+{
+    auto liveness = s->liveness;
+    return [liveness, completions](const dbus::Result<void>& result)
+    {
+        if (result.is_error())
+            std::cout << result.error().print() << std::endl;
+
+        std::lock_guard<std::recursive_mutex> lock(liveness->guard);
+        for (const auto& c : completions)
+        {
+            // a callback may destroy the instance
+            if (!liveness->alive)
+                break;
+
+            if (c.first != nullptr)
+                c.first(result.is_error() ? U_STATUS_ERROR : U_STATUS_SUCCESS, c.second);
+        }
+    };
+}
+
+std::function<void(const dbus::Result<void>&)> completion(
+    UbuntuApplicationSensorsHaptic* s,
+    UASensorsHapticCompletionCallback cb,
+    void* ctx)
+{
+    return completion(s, std::vector<UbuntuApplicationSensorsHaptic::Completion>(1, std::make_pair(cb, ctx)));
+}
+
+// Patterns alternate between on and off, starting with on; keeps that across the seam
+void append_pattern(std::vector<uint32_t>& to, const std::vector<uint32_t>& pattern)
+{
+    if (to.size() % 2 == 1)
+        to.push_back(0);
+    to.insert(to.end(), pattern.begin(), pattern.end());
+}
+
+UStatus send_pattern(
+    UbuntuApplicationSensorsHaptic* s,
+    const std::vector<uint32_t>& pattern,
+    uint32_t repeat,
+    const std::vector<UbuntuApplicationSensorsHaptic::Completion>& completions)
+{
+    try
+    {
+        s->session->invoke_method_asynchronously_with_callback<uas::USensorD::Haptic::VibratePattern, void>(
+            completion(s, completions), pattern, repeat);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cout << e.what() << std::endl;
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+// Sends the merged requests; the lock is dropped while reporting a failure
+void flush(UbuntuApplicationSensorsHaptic* s, std::unique_lock<std::mutex>& lock)
+{
+    std::vector<uint32_t> pattern;
+    std::vector<UbuntuApplicationSensorsHaptic::Completion> completions;
+    pattern.swap(s->batch);
+    completions.swap(s->batch_completions);
+
+    // sending does not block, so it is done under the lock to keep requests in order
+    if (send_pattern(s, pattern, 1, completions) == U_STATUS_SUCCESS)
+        return;
+
+    lock.unlock();
+    for (const auto& c : completions)
+    {
+        if (c.first != nullptr)
+            c.first(U_STATUS_ERROR, c.second);
+    }
+    lock.lock();
+}
+
+void run_flush_thread(UbuntuApplicationSensorsHaptic* s)
+{
+    std::unique_lock<std::mutex> lock(s->guard);
+
+    for (;;)
+    {
+        s->flush_cv.wait(lock, [s] { return s->stopping || !s->batch.empty(); });
+
+        // batch_deadline moves on when the batch is flushed early for being full
+        s->flush_cv.wait_until(lock, s->batch_deadline, [s] { return s->stopping || s->batch.empty(); });
+
+        if (!s->batch.empty())
+            flush(s, lock);
+
+        if (s->stopping)
+            break;
+    }
+}
+}
+
 UASensorsHaptic*
 ua_sensors_haptic_new()
 {
-    auto bus = std::shared_ptr<dbus::Bus>(new dbus::Bus(core::dbus::WellKnownBus::session));
-    bus->install_executor(dbus::asio::make_executor(bus));
+    // all instances share one connection and reactor thread
+    auto reactor = ubuntu::application::BusReactor::acquire(core::dbus::WellKnownBus::session);
 
-    auto stub_service = dbus::Service::use_service(bus, dbus::traits::Service<uas::USensorD>::interface_name());
+    auto stub_service = dbus::Service::use_service(reactor->bus(), dbus::traits::Service<uas::USensorD>::interface_name());
     auto stub = stub_service->object_for_path(dbus::types::ObjectPath("/com/canonical/usensord/haptic"));
 
-    auto s = new UbuntuApplicationSensorsHaptic(stub);
-    s->bus_thread = std::thread{[bus](){ bus->run(); }};
-    s->bus = bus;
-
-    return s;
+    return new UbuntuApplicationSensorsHaptic(reactor, stub);
 }
 
 void
@@ -120,3 +225,159 @@ ua_sensors_haptic_vibrate_with_pattern(
     
     return U_STATUS_SUCCESS;
 }
+
+UStatus
+ua_sensors_haptic_vibrate_once_async(
+    UASensorsHaptic* sensor,
+    uint32_t duration,
+    UASensorsHapticCompletionCallback cb,
+    void* ctx)
+{
+    if (sensor == nullptr)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationSensorsHaptic*>(sensor);
+
+    if (s->enabled == false)
+        return U_STATUS_ERROR;
+
+    // only queues the message, the reply is dispatched by the bus thread
+    try
+    {
+        s->session->invoke_method_asynchronously_with_callback<uas::USensorD::Haptic::Vibrate, void>(
+            completion(s, cb, ctx), duration);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cout << e.what() << std::endl;
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_sensors_haptic_vibrate_with_pattern_async(
+    UASensorsHaptic* sensor,
+    uint32_t pattern[MAX_PATTERN_SIZE],
+    uint32_t repeat,
+    UASensorsHapticCompletionCallback cb,
+    void* ctx)
+{
+    if (sensor == nullptr)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationSensorsHaptic*>(sensor);
+
+    if (s->enabled == false)
+        return U_STATUS_ERROR;
+
+    std::vector<uint32_t> p_arg (pattern, pattern + MAX_PATTERN_SIZE);
+
+    try
+    {
+        s->session->invoke_method_asynchronously_with_callback<uas::USensorD::Haptic::VibratePattern, void>(
+            completion(s, cb, ctx), p_arg, repeat);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cout << e.what() << std::endl;
+        return U_STATUS_ERROR;
+    }
+
+    return U_STATUS_SUCCESS;
+}
+
+UASensorsHapticPattern*
+ua_sensors_haptic_pattern_new(
+    const uint32_t* durations,
+    uint32_t length,
+    uint32_t repeat)
+{
+    if (durations == nullptr || length == 0 || repeat == 0)
+        return nullptr;
+
+    auto p = new UbuntuApplicationSensorsHapticPattern();
+    p->durations.assign(durations, durations + length);
+    p->repeat = repeat;
+
+    // prepared once, so that merging only has to copy it
+    if ((uint64_t(length) + 1) * repeat <= max_merged_pattern_size)
+    {
+        for (uint32_t i = 0; i < repeat; i++)
+            append_pattern(p->expanded, p->durations);
+    }
+
+    return p;
+}
+
+void
+ua_sensors_haptic_pattern_destroy(UASensorsHapticPattern* pattern)
+{
+    delete static_cast<UbuntuApplicationSensorsHapticPattern*>(pattern);
+}
+
+UStatus
+ua_sensors_haptic_vibrate_pattern(
+    UASensorsHaptic* sensor,
+    const UASensorsHapticPattern* pattern,
+    UASensorsHapticCompletionCallback cb,
+    void* ctx)
+{
+    if (sensor == nullptr || pattern == nullptr)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationSensorsHaptic*>(sensor);
+    auto p = static_cast<const UbuntuApplicationSensorsHapticPattern*>(pattern);
+
+    if (s->enabled == false)
+        return U_STATUS_ERROR;
+
+    std::unique_lock<std::mutex> lock(s->guard);
+
+    if (s->coalescing_window.count() == 0 || p->expanded.empty())
+    {
+        // keep the order of requests, anything pending goes first
+        if (!s->batch.empty())
+            flush(s, lock);
+
+        return send_pattern(s, p->durations, p->repeat, {{cb, ctx}});
+    }
+
+    if (s->batch.size() + p->expanded.size() + 1 > max_merged_pattern_size)
+        flush(s, lock);
+
+    if (s->batch.empty())
+        s->batch_deadline = std::chrono::steady_clock::now() + s->coalescing_window;
+
+    append_pattern(s->batch, p->expanded);
+    s->batch_completions.push_back({cb, ctx});
+
+    if (!s->flush_thread.joinable())
+        s->flush_thread = std::thread{run_flush_thread, s};
+
+    lock.unlock();
+    s->flush_cv.notify_all();
+
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+ua_sensors_haptic_set_coalescing_window(
+    UASensorsHaptic* sensor,
+    uint32_t window_ms)
+{
+    if (sensor == nullptr)
+        return U_STATUS_ERROR;
+
+    auto s = static_cast<UbuntuApplicationSensorsHaptic*>(sensor);
+
+    std::unique_lock<std::mutex> lock(s->guard);
+    s->coalescing_window = std::chrono::milliseconds{window_ms};
+
+    // no point in holding back what is pending any longer
+    if (window_ms == 0 && !s->batch.empty())
+        flush(s, lock);
+
+    return U_STATUS_SUCCESS;
+}
@@ -0,0 +1,435 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "evdev_source.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+// older kernel headers only have the timeval member
+#ifndef input_event_sec
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
+namespace desktop = ubuntu::application::sensors::desktop;
+namespace evdev = ubuntu::application::sensors::desktop::evdev;
+
+namespace
+{
+const char* input_path = "/dev/input";
+// number of events fetched with a single read(), enough for several frames
+const size_t events_per_read = 64;
+const double standard_gravity = 9.80665;
+
+// ranges assumed when a device does not report them, e.g. a FIFO in tests
+const int32_t default_accel_minimum = -32768;
+const int32_t default_accel_maximum = 32767;
+const int32_t default_proximity_maximum = 1;
+
+const uint16_t accel_codes[] = {ABS_X, ABS_Y, ABS_Z};
+
+bool test_bit(const unsigned long* bits, unsigned int bit)
+{
+    const unsigned int bits_per_long = 8 * sizeof(unsigned long);
+    return (bits[bit / bits_per_long] >> (bit % bits_per_long)) & 1;
+}
+
+std::vector<std::string> list_event_devices()
+{
+    std::vector<std::string> entries;
+
+    DIR* dir = opendir(input_path);
+    if (dir == NULL)
+        return entries;
+
+    while (struct dirent* entry = readdir(dir))
+    {
+        if (strncmp(entry->d_name, "event", strlen("event")) == 0)
+            entries.push_back(std::string(input_path) + "/" + entry->d_name);
+    }
+    closedir(dir);
+
+    std::sort(entries.begin(), entries.end());
+    return entries;
+}
+
+// Tells accelerometers and proximity sensors from the other input devices.
+bool classify(const std::string& path, desktop::SensorType& type)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    const unsigned int bits_per_long = 8 * sizeof(unsigned long);
+    unsigned long abs_bits[(ABS_CNT + bits_per_long - 1) / bits_per_long] = {0};
+    unsigned long key_bits[(KEY_CNT + bits_per_long - 1) / bits_per_long] = {0};
+    unsigned long prop_bits[(INPUT_PROP_CNT + bits_per_long - 1) / bits_per_long] = {0};
+
+    bool has_abs = ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits) >= 0;
+    bool has_keys = ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits) > 0 &&
+        std::any_of(std::begin(key_bits), std::end(key_bits), [](unsigned long b) { return b != 0; });
+    ioctl(fd, EVIOCGPROP(sizeof(prop_bits)), prop_bits);
+    close(fd);
+
+    if (!has_abs)
+        return false;
+
+    if (test_bit(prop_bits, INPUT_PROP_ACCELEROMETER) &&
+        test_bit(abs_bits, ABS_X) && test_bit(abs_bits, ABS_Y) && test_bit(abs_bits, ABS_Z))
+    {
+        type = desktop::SensorType::accelerometer;
+        return true;
+    }
+
+    // touch screens report ABS_DISTANCE for hovering, proximity sensors have no position
+    if (test_bit(abs_bits, ABS_DISTANCE) && !test_bit(abs_bits, ABS_X) && !has_keys)
+    {
+        type = desktop::SensorType::proximity;
+        return true;
+    }
+
+    return false;
+}
+
+uint64_t now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+}
+
+std::vector<desktop::Source::Ptr>
+evdev::discover(EventLoop& loop)
+{
+    std::vector<Source::Ptr> sources;
+
+    const char* forced_accelerometer = getenv("UBUNTU_PLATFORM_API_EVDEV_ACCELEROMETER");
+    const char* forced_proximity = getenv("UBUNTU_PLATFORM_API_EVDEV_PROXIMITY");
+
+    auto add = [&](const std::string& path, SensorType type)
+    {
+        auto device = std::make_shared<evdev::Device>(loop, path, type);
+        if (device->valid())
+            sources.push_back(device);
+    };
+
+    if (forced_accelerometer != NULL)
+        add(forced_accelerometer, SensorType::accelerometer);
+    if (forced_proximity != NULL)
+        add(forced_proximity, SensorType::proximity);
+
+    for (const auto& path : list_event_devices())
+    {
+        SensorType type;
+        if (!classify(path, type))
+            continue;
+
+        if ((type == SensorType::accelerometer && forced_accelerometer != NULL) ||
+            (type == SensorType::proximity && forced_proximity != NULL))
+            continue;
+
+        add(path, type);
+    }
+
+    return sources;
+}
+
+evdev::Device::Device(EventLoop& loop, const std::string& path, SensorType type)
+    : loop(loop),
+      path(path),
+      sensor_type(type),
+      is_evdev(false),
+      axis_count(0),
+      active(NULL),
+      period(0),
+      fd(-1),
+      dropped(false),
+      last_delivery(0)
+{
+    std::memset(axes, 0, sizeof(axes));
+    std::memset(values, 0, sizeof(values));
+    buffer.resize(events_per_read);
+
+    probe();
+}
+
+evdev::Device::~Device()
+{
+    std::lock_guard<std::mutex> lock(guard);
+    stop_locked();
+}
+
+void
+evdev::Device::probe()
+{
+    int probe_fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (probe_fd < 0)
+    {
+        std::cerr << "evdev: failed to open " << path << ": " << strerror(errno) << std::endl;
+        return;
+    }
+
+    char name[256] = {0};
+    is_evdev = ioctl(probe_fd, EVIOCGNAME(sizeof(name) - 1), name) >= 0;
+    device_name = is_evdev ? name : "event stream";
+
+    if (sensor_type == SensorType::accelerometer)
+    {
+        for (uint16_t code : accel_codes)
+        {
+            Axis& axis = axes[axis_count++];
+            axis.code = code;
+            axis.minimum = default_accel_minimum;
+            axis.maximum = default_accel_maximum;
+            axis.resolution = 0;
+        }
+    } else
+    {
+        Axis& axis = axes[axis_count++];
+        axis.code = ABS_DISTANCE;
+        axis.minimum = 0;
+        axis.maximum = default_proximity_maximum;
+        axis.resolution = 0;
+    }
+
+    for (unsigned int i = 0; i < axis_count && is_evdev; i++)
+    {
+        struct input_absinfo absinfo;
+        if (ioctl(probe_fd, EVIOCGABS(axes[i].code), &absinfo) < 0)
+        {
+            std::cerr << "evdev: " << path << " lacks absolute axis " << axes[i].code << std::endl;
+            axis_count = 0;
+            break;
+        }
+
+        axes[i].minimum = absinfo.minimum;
+        axes[i].maximum = absinfo.maximum;
+        axes[i].resolution = absinfo.resolution;
+        values[i] = absinfo.value;
+    }
+    close(probe_fd);
+
+    for (unsigned int i = 0; i < axis_count; i++)
+    {
+        Axis& axis = axes[i];
+        if (sensor_type == SensorType::accelerometer)
+        {
+            // with INPUT_PROP_ACCELEROMETER the resolution is in units/g; drivers
+            // that leave it out are assumed to span +-2g, the common default
+            double units_per_g = axis.resolution > 0 ? axis.resolution : (double(axis.maximum) - axis.minimum + 1) / 4;
+            axis.scale = standard_gravity / units_per_g;
+        } else
+        {
+            // reported as is, uas_proximity_event_get_distance() compares against the maximum
+            axis.scale = 1.0;
+        }
+    }
+}
+
+std::string
+evdev::Device::description() const
+{
+    return "input device " + path + " (" + device_name + ")";
+}
+
+std::vector<desktop::SensorType>
+evdev::Device::types() const
+{
+    std::vector<SensorType> result;
+    if (valid())
+        result.push_back(sensor_type);
+    return result;
+}
+
+desktop::SensorInfo
+evdev::Device::info(SensorType) const
+{
+    SensorInfo info = {0.f, 0.f, 0.f, 0};
+    if (!valid())
+        return info;
+
+    info.min_value = axes[0].minimum * axes[0].scale;
+    info.max_value = axes[0].maximum * axes[0].scale;
+    info.resolution = axes[0].scale;
+    // min_delay stays 0: the driver decides the rate and may report on change only
+    return info;
+}
+
+bool
+evdev::Device::set_enabled(Sensor& sensor, bool enabled)
+{
+    std::lock_guard<std::mutex> lock(guard);
+
+    stop_locked();
+    active = enabled ? &sensor : NULL;
+
+    return !enabled || start_locked();
+}
+
+bool
+evdev::Device::set_period(Sensor&, uint32_t period_ns)
+{
+    period = period_ns;
+    return true;
+}
+
+bool
+evdev::Device::start_locked()
+{
+    fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::cerr << "evdev: failed to open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (is_evdev)
+    {
+        // event timestamps default to CLOCK_REALTIME, readings use CLOCK_MONOTONIC
+        int clock = CLOCK_MONOTONIC;
+        ioctl(fd, EVIOCSCLOCKID, &clock);
+        sync_state();
+    }
+
+    dropped = false;
+    last_delivery = 0;
+
+    if (!loop.add(fd, [this](uint32_t events) { on_readable(events); }))
+    {
+        stop_locked();
+        return false;
+    }
+
+    return true;
+}
+
+void
+evdev::Device::stop_locked()
+{
+    if (fd < 0)
+        return;
+
+    // waits for on_readable() to finish unless called from within it
+    loop.remove(fd);
+    close(fd);
+    fd = -1;
+}
+
+void
+evdev::Device::sync_state()
+{
+    for (unsigned int i = 0; i < axis_count; i++)
+    {
+        struct input_absinfo absinfo;
+        if (ioctl(fd, EVIOCGABS(axes[i].code), &absinfo) >= 0)
+            values[i] = absinfo.value;
+    }
+}
+
+void
+evdev::Device::on_readable(uint32_t events)
+{
+    const size_t event_size = sizeof(struct input_event);
+
+    ssize_t n = read(fd, buffer.data(), buffer.size() * event_size);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    if (n <= 0)
+    {
+        if (n == 0 || (events & (EPOLLHUP | EPOLLERR)))
+        {
+            // the device went away
+            std::cerr << "evdev: stopped reading from " << path << std::endl;
+            loop.remove(fd);
+        }
+        return;
+    }
+
+    // evdev only hands out whole events; a torn record from a stream is dropped
+    int current_fd = fd;
+    for (size_t i = 0; i < size_t(n) / event_size; i++)
+    {
+        on_event(buffer[i]);
+
+        // a callback disabled the sensor, the remaining events are stale
+        if (fd != current_fd)
+            break;
+    }
+}
+
+void
+evdev::Device::on_event(const struct input_event& ev)
+{
+    if (ev.type == EV_SYN && ev.code == SYN_DROPPED)
+    {
+        dropped = true;
+        return;
+    }
+
+    if (ev.type == EV_ABS)
+    {
+        for (unsigned int i = 0; i < axis_count; i++)
+        {
+            if (axes[i].code == ev.code)
+                values[i] = ev.value;
+        }
+        return;
+    }
+
+    if (ev.type != EV_SYN || ev.code != SYN_REPORT)
+        return;
+
+    if (dropped)
+    {
+        // the frame is incomplete, fetch the current state instead
+        dropped = false;
+        if (is_evdev)
+            sync_state();
+        return;
+    }
+
+    uint64_t timestamp = uint64_t(ev.input_event_sec) * 1000000000ULL + uint64_t(ev.input_event_usec) * 1000ULL;
+    if (timestamp == 0)
+        timestamp = now();
+
+    // throttle to the requested period, allowing for some jitter of the driver
+    uint32_t p = period;
+    if (p > 0 && last_delivery > 0 && timestamp - last_delivery < p - p / 4)
+        return;
+    last_delivery = timestamp;
+
+    Reading reading;
+    std::memset(&reading, 0, sizeof(reading));
+    reading.timestamp = timestamp;
+    for (unsigned int i = 0; i < axis_count; i++)
+        reading.values[i] = values[i] * axes[i].scale;
+
+    if (Sensor* sensor = active)
+        sensor->deliver(reading);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UBUNTU_APPLICATION_SENSORS_DESKTOP_EVDEV_SOURCE_H_
+#define UBUNTU_APPLICATION_SENSORS_DESKTOP_EVDEV_SOURCE_H_
+
+#include "sensor.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <linux/input.h>
+
+namespace ubuntu
+{
+namespace application
+{
+namespace sensors
+{
+namespace desktop
+{
+namespace evdev
+{
+/**
+ * Finds accelerometers (EV_ABS with INPUT_PROP_ACCELEROMETER) and proximity
+ * sensors (ABS_DISTANCE) among /dev/input/event*. A specific device can be
+ * forced with $UBUNTU_PLATFORM_API_EVDEV_ACCELEROMETER or
+ * $UBUNTU_PLATFORM_API_EVDEV_PROXIMITY; such a device does not need to be an
+ * evdev node, any pollable stream of input_event records (e.g. a FIFO) works.
+ */
+std::vector<Source::Ptr> discover(EventLoop& loop);
+
+/** The range of an absolute axis, as reported by EVIOCGABS. */
+struct Axis
+{
+    uint16_t code;
+    int32_t minimum;
+    int32_t maximum;
+    int32_t resolution;
+    double scale; ///< Converts a raw value to the units of a Reading.
+};
+
+/**
+ * An input device delivering a single sensor. Events are accumulated until
+ * SYN_REPORT and every complete frame becomes one reading. The evdev
+ * protocol has no way to configure the sampling rate, so the requested
+ * period only throttles the frames handed to the application.
+ */
+class Device : public Source
+{
+public:
+    Device(EventLoop& loop, const std::string& path, SensorType type);
+    ~Device();
+
+    /** True if the device can be opened and has the axes of its sensor. */
+    bool valid() const { return axis_count > 0; }
+
+    std::string description() const override;
+    std::vector<SensorType> types() const override;
+    SensorInfo info(SensorType type) const override;
+    bool set_enabled(Sensor& sensor, bool enabled) override;
+    bool set_period(Sensor& sensor, uint32_t period_ns) override;
+
+private:
+    void probe();
+    void sync_state();
+    bool start_locked();
+    void stop_locked();
+    void on_readable(uint32_t events);
+    void on_event(const struct input_event& ev);
+
+    EventLoop& loop;
+    std::string path;
+    std::string device_name;
+    SensorType sensor_type;
+    bool is_evdev; ///< False for plain streams of events, which do not answer ioctls.
+
+    Axis axes[3];
+    unsigned int axis_count;
+
+    std::mutex guard;
+    Sensor* active;
+    std::atomic<uint32_t> period;
+    int fd;
+
+    // frame state, only touched on the loop thread while the device is open
+    int32_t values[3]; ///< evdev only reports changed axes, so the last values are kept.
+    bool dropped; ///< Events were lost, skip until the next SYN_REPORT and resync.
+    uint64_t last_delivery;
+    std::vector<struct input_event> buffer;
+};
+}
+}
+}
+}
+}
+
+#endif // UBUNTU_APPLICATION_SENSORS_DESKTOP_EVDEV_SOURCE_H_
@@ -0,0 +1,220 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "event_loop.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+
+namespace desktop = ubuntu::application::sensors::desktop;
+
+desktop::EventLoop::EventLoop()
+    : epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      running(true),
+      exited(false)
+{
+    if (epoll_fd < 0 || wake_fd < 0)
+    {
+        perror("EventLoop: failed to set up epoll");
+        running = false;
+        exited = true;
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    worker = std::thread(&EventLoop::run, this);
+}
+
+desktop::EventLoop::~EventLoop()
+{
+    stop();
+
+    if (wake_fd >= 0)
+        close(wake_fd);
+    if (epoll_fd >= 0)
+        close(epoll_fd);
+}
+
+bool
+desktop::EventLoop::add(int fd, const Handler& handler)
+{
+    std::lock_guard<std::mutex> lock(guard);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        return false;
+
+    handlers[fd] = std::make_shared<Entry>(Entry{handler, false});
+    return true;
+}
+
+void
+desktop::EventLoop::remove(int fd)
+{
+    std::unique_lock<std::mutex> lock(guard);
+
+    auto it = handlers.find(fd);
+    if (it == handlers.end())
+        return;
+
+    std::shared_ptr<Entry> entry = it->second;
+    handlers.erase(it);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+
+    // On the loop thread the caller is a handler itself, no other one can
+    // be running then.
+    if (std::this_thread::get_id() != loop_thread)
+        idle.wait(lock, [&entry]() { return !entry->busy; });
+}
+
+void
+desktop::EventLoop::invoke(const std::function<void()>& task)
+{
+    std::unique_lock<std::mutex> lock(guard);
+
+    if (!exited && std::this_thread::get_id() != loop_thread)
+    {
+        auto pending = std::make_shared<Task>(Task{task, false});
+        tasks.push_back(pending);
+
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0)
+            perror("EventLoop: failed to wake up loop thread");
+
+        idle.wait(lock, [this, &pending]() { return pending->done || exited; });
+        if (pending->done)
+            return;
+    }
+
+    lock.unlock();
+    task();
+}
+
+void
+desktop::EventLoop::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        running = false;
+    }
+
+    if (!worker.joinable())
+        return;
+
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0)
+        perror("EventLoop: failed to wake up loop thread");
+
+    if (worker.get_id() == std::this_thread::get_id())
+        worker.detach();
+    else
+        worker.join();
+}
+
+void
+desktop::EventLoop::run()
+{
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        loop_thread = std::this_thread::get_id();
+    }
+
+    dispatch();
+
+    // tasks still queued run on their callers' threads now
+    std::lock_guard<std::mutex> lock(guard);
+    exited = true;
+    idle.notify_all();
+}
+
+void
+desktop::EventLoop::dispatch()
+{
+    struct epoll_event events[16];
+
+    for (;;)
+    {
+        int n = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(events[0]), -1);
+        if (n < 0 && errno != EINTR)
+        {
+            perror("EventLoop: epoll_wait failed");
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(guard);
+
+        for (int i = 0; i < n && running; i++)
+        {
+            if (events[i].data.fd == wake_fd)
+            {
+                uint64_t value;
+                if (read(wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+                    perror("EventLoop: failed to read wake up fd");
+                continue;
+            }
+
+            auto it = handlers.find(events[i].data.fd);
+            if (it == handlers.end())
+                continue;
+
+            // keep the handler alive even if it removes itself; remove()
+            // from other threads waits until it is not busy anymore
+            std::shared_ptr<Entry> entry = it->second;
+            entry->busy = true;
+            lock.unlock();
+
+            entry->handler(events[i].events);
+
+            lock.lock();
+            entry->busy = false;
+            idle.notify_all();
+        }
+
+        if (!running)
+            return;
+
+        run_tasks(lock);
+    }
+}
+
+void
+desktop::EventLoop::run_tasks(std::unique_lock<std::mutex>& lock)
+{
+    while (!tasks.empty())
+    {
+        std::shared_ptr<Task> task = tasks.front();
+        tasks.pop_front();
+        lock.unlock();
+
+        task->run();
+
+        lock.lock();
+        task->done = true;
+        idle.notify_all();
+    }
+}
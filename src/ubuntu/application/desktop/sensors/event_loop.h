@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UBUNTU_APPLICATION_SENSORS_DESKTOP_EVENT_LOOP_H_
+#define UBUNTU_APPLICATION_SENSORS_DESKTOP_EVENT_LOOP_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace ubuntu
+{
+namespace application
+{
+namespace sensors
+{
+namespace desktop
+{
+/**
+ * A single epoll thread shared by all sources. Handlers run on the loop
+ * thread without any lock of the loop held. Removing a handler from any
+ * other thread waits for a running dispatch of it to finish, so that the fd
+ * can be closed afterwards; the caller must not hold a lock the handler
+ * takes.
+ */
+class EventLoop
+{
+public:
+    /** Invoked with the epoll event mask whenever the fd is readable or hung up. */
+    typedef std::function<void(uint32_t events)> Handler;
+
+    EventLoop();
+    ~EventLoop();
+
+    bool add(int fd, const Handler& handler);
+    void remove(int fd);
+
+    /**
+     * Runs the task on the loop thread, between dispatches, and waits for
+     * it. Called from the loop thread itself, e.g. from within a handler,
+     * or once the loop is gone, the task runs right away.
+     */
+    void invoke(const std::function<void()>& task);
+
+    /** Stops and joins the loop thread; handlers are not invoked afterwards. */
+    void stop();
+
+private:
+    struct Entry
+    {
+        Handler handler;
+        bool busy; ///< Being dispatched right now.
+    };
+
+    struct Task
+    {
+        std::function<void()> run;
+        bool done;
+    };
+
+    void run();
+    void dispatch();
+    void run_tasks(std::unique_lock<std::mutex>& lock);
+
+    int epoll_fd;
+    int wake_fd;
+    bool running;
+    bool exited; ///< The loop thread does not dispatch anymore, or never did.
+    std::mutex guard;
+    std::condition_variable idle; ///< Signalled whenever a dispatch or task finished.
+    std::map<int, std::shared_ptr<Entry>> handlers;
+    std::deque<std::shared_ptr<Task>> tasks;
+    std::thread::id loop_thread;
+    std::thread worker;
+
+protected:
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+};
+}
+}
+}
+}
+
+#endif // UBUNTU_APPLICATION_SENSORS_DESKTOP_EVENT_LOOP_H_
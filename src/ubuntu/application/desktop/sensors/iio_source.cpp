@@ -0,0 +1,616 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "iio_source.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace desktop = ubuntu::application::sensors::desktop;
+namespace iio = ubuntu::application::sensors::desktop::iio;
+
+namespace
+{
+const char* devices_path = "/sys/bus/iio/devices";
+// number of scans fetched with a single read()
+const size_t scans_per_read = 64;
+const char* buffer_length = "128";
+
+struct ChannelPrefix
+{
+    const char* prefix;
+    desktop::SensorType type;
+    bool vector;
+    double unit; ///< Factor from the IIO unit to the unit of a Reading.
+};
+
+const ChannelPrefix prefixes[] = {
+    {"in_accel", desktop::SensorType::accelerometer, true, 1.0}, // m/s^2
+    {"in_anglvel", desktop::SensorType::gyroscope, true, 1.0}, // rad/s
+    {"in_magn", desktop::SensorType::magnetic_field, true, 100.0}, // Gauss -> uT
+    {"in_illuminance", desktop::SensorType::light, false, 1.0}, // lux
+    {"in_pressure", desktop::SensorType::pressure, false, 10.0} // kPa -> hPa
+};
+
+std::string iio_root()
+{
+    const char* root = getenv("UBUNTU_PLATFORM_API_IIO_ROOT");
+    return root != NULL ? root : "";
+}
+
+bool read_file(const std::string& path, std::string& value)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    char buf[256];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n < 0)
+        return false;
+
+    value.assign(buf, n);
+    value.erase(value.find_last_not_of(" \n") + 1);
+    return true;
+}
+
+bool write_file(const std::string& path, const std::string& value)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    ssize_t n = write(fd, value.c_str(), value.size());
+    close(fd);
+    return n == static_cast<ssize_t>(value.size());
+}
+
+std::vector<std::string> list_directory(const std::string& path)
+{
+    std::vector<std::string> entries;
+
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL)
+        return entries;
+
+    while (struct dirent* entry = readdir(dir))
+    {
+        if (entry->d_name[0] != '.')
+            entries.push_back(entry->d_name);
+    }
+    closedir(dir);
+
+    std::sort(entries.begin(), entries.end());
+    return entries;
+}
+
+bool starts_with(const std::string& s, const std::string& prefix)
+{
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Parses a scan element type like "le:s12/16>>4" or "be:u16/16X2>>0".
+bool parse_type(const std::string& type, iio::Channel& channel)
+{
+    char endian, sign;
+    unsigned int bits, storage_bits, repeat, shift;
+
+    if (sscanf(type.c_str(), "%ce:%c%u/%uX%u>>%u", &endian, &sign, &bits, &storage_bits, &repeat, &shift) != 6)
+    {
+        if (sscanf(type.c_str(), "%ce:%c%u/%u>>%u", &endian, &sign, &bits, &storage_bits, &shift) != 5)
+            return false;
+    }
+
+    if (bits == 0 || bits > 64 || storage_bits % 8 != 0 || storage_bits > 64 || bits + shift > storage_bits)
+        return false;
+
+    channel.big_endian = endian == 'b';
+    channel.is_signed = sign == 's';
+    channel.bits = bits;
+    channel.storage_bytes = storage_bits / 8;
+    channel.shift = shift;
+    return true;
+}
+
+int64_t decode(const uint8_t* data, const iio::Channel& channel)
+{
+    uint64_t value = 0;
+    for (unsigned int i = 0; i < channel.storage_bytes; i++)
+    {
+        unsigned int byte = channel.big_endian ? i : channel.storage_bytes - 1 - i;
+        value = (value << 8) | data[byte];
+    }
+
+    value >>= channel.shift;
+    if (channel.bits < 64)
+    {
+        value &= (uint64_t(1) << channel.bits) - 1;
+        if (channel.is_signed && (value & (uint64_t(1) << (channel.bits - 1))))
+            value |= ~uint64_t(0) << channel.bits;
+    }
+
+    return static_cast<int64_t>(value);
+}
+
+clockid_t clock_from_name(const std::string& name)
+{
+    if (name == "monotonic")
+        return CLOCK_MONOTONIC;
+    if (name == "monotonic_raw")
+        return CLOCK_MONOTONIC_RAW;
+    if (name == "realtime_coarse")
+        return CLOCK_REALTIME_COARSE;
+    if (name == "monotonic_coarse")
+        return CLOCK_MONOTONIC_COARSE;
+    if (name == "boottime")
+        return CLOCK_BOOTTIME;
+    if (name == "tai")
+        return CLOCK_TAI;
+
+    // the kernel default
+    return CLOCK_REALTIME;
+}
+
+int64_t now(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+int index_of(desktop::SensorType type)
+{
+    return static_cast<int>(type);
+}
+}
+
+std::vector<desktop::Source::Ptr>
+iio::discover(EventLoop& loop)
+{
+    std::vector<Source::Ptr> sources;
+    std::string root = iio_root();
+
+    for (const auto& name : list_directory(root + devices_path))
+    {
+        if (!starts_with(name, "iio:device"))
+            continue;
+
+        auto device = std::make_shared<iio::Device>(loop, root, name);
+        if (device->valid())
+            sources.push_back(device);
+    }
+
+    return sources;
+}
+
+iio::Device::Device(EventLoop& loop, const std::string& root, const std::string& name)
+    : loop(loop),
+      root(root),
+      sysfs_name(name),
+      device_dir(root + devices_path + "/" + name),
+      has_timestamp(false),
+      timestamp_clock(CLOCK_REALTIME),
+      fd(-1),
+      generation(0),
+      scan_size(0)
+{
+    for (int i = 0; i < index_of(SensorType::count); i++)
+    {
+        active[i] = NULL;
+        periods[i] = 0;
+    }
+
+    read_attribute("name", device_name);
+    probe();
+    probe_frequencies();
+}
+
+iio::Device::~Device()
+{
+    std::lock_guard<std::mutex> lock(guard);
+    stop_locked();
+}
+
+void
+iio::Device::probe()
+{
+    std::string value;
+    const std::string suffix = "_en";
+
+    for (const auto& entry : list_directory(device_dir + "/scan_elements"))
+    {
+        if (entry.size() <= suffix.size() || entry.compare(entry.size() - suffix.size(), suffix.size(), suffix) != 0)
+            continue;
+
+        Channel channel;
+        channel.name = entry.substr(0, entry.size() - suffix.size());
+        channel.axis = -1;
+        channel.scale = 1.0;
+        channel.offset = 0.0;
+        channel.position = 0;
+
+        if (!read_attribute("scan_elements/" + channel.name + "_index", value))
+            continue;
+        channel.index = strtoul(value.c_str(), NULL, 10);
+
+        if (!read_attribute("scan_elements/" + channel.name + "_type", value) || !parse_type(value, channel))
+        {
+            std::cerr << "IIO: unsupported scan element type of " << channel.name << " on " << sysfs_name << std::endl;
+            continue;
+        }
+
+        if (channel.name == "in_timestamp")
+        {
+            timestamp = channel;
+            has_timestamp = true;
+            continue;
+        }
+
+        for (const auto& p : prefixes)
+        {
+            std::string prefix = p.prefix;
+            if (!starts_with(channel.name, prefix))
+                continue;
+
+            if (p.vector)
+            {
+                // in_accel_x, in_accel_y, in_accel_z
+                if (channel.name.size() != prefix.size() + 2 || channel.name[prefix.size()] != '_')
+                    break;
+                char axis = channel.name[prefix.size() + 1];
+                if (axis < 'x' || axis > 'z')
+                    break;
+                channel.axis = axis - 'x';
+            } else
+            {
+                if (channel.name != prefix)
+                    break;
+                channel.axis = 0;
+            }
+
+            channel.type = p.type;
+
+            // scale and offset are either per channel or shared by all axes
+            if (read_attribute(channel.name + "_scale", value) || read_attribute(prefix + "_scale", value))
+                channel.scale = strtod(value.c_str(), NULL);
+            if (read_attribute(channel.name + "_offset", value) || read_attribute(prefix + "_offset", value))
+                channel.offset = strtod(value.c_str(), NULL);
+            channel.scale *= p.unit;
+
+            channels.push_back(channel);
+            break;
+        }
+    }
+
+    // vector sensors are only usable with all three axes
+    for (const auto& p : prefixes)
+    {
+        if (!p.vector)
+            continue;
+
+        auto count = std::count_if(channels.begin(), channels.end(), [&p](const Channel& c) { return c.type == p.type; });
+        if (count != 3)
+            channels.erase(std::remove_if(channels.begin(), channels.end(), [&p](const Channel& c) { return c.type == p.type; }),
+                           channels.end());
+    }
+
+    std::sort(channels.begin(), channels.end(), [](const Channel& a, const Channel& b) { return a.index < b.index; });
+
+    if (read_attribute("current_timestamp_clock", value))
+        timestamp_clock = clock_from_name(value);
+}
+
+void
+iio::Device::probe_frequencies()
+{
+    std::string value;
+    if (!read_attribute("sampling_frequency_available", value))
+        return;
+
+    std::istringstream ss(value);
+    double frequency;
+    while (ss >> frequency)
+    {
+        if (frequency > 0)
+            frequencies.push_back(frequency);
+    }
+
+    std::sort(frequencies.begin(), frequencies.end());
+}
+
+std::string
+iio::Device::description() const
+{
+    return "IIO device " + sysfs_name + " (" + device_name + ")";
+}
+
+std::vector<desktop::SensorType>
+iio::Device::types() const
+{
+    std::vector<SensorType> result;
+    for (const auto& channel : channels)
+    {
+        if (std::find(result.begin(), result.end(), channel.type) == result.end())
+            result.push_back(channel.type);
+    }
+    return result;
+}
+
+desktop::SensorInfo
+iio::Device::info(SensorType type) const
+{
+    SensorInfo info = {0.f, 0.f, 0.f, 0};
+
+    for (const auto& channel : channels)
+    {
+        if (channel.type != type)
+            continue;
+
+        double min_raw = channel.is_signed ? -std::ldexp(1.0, channel.bits - 1) : 0.0;
+        double max_raw = channel.is_signed ? std::ldexp(1.0, channel.bits - 1) - 1 : std::ldexp(1.0, channel.bits) - 1;
+
+        info.min_value = (min_raw + channel.offset) * channel.scale;
+        info.max_value = (max_raw + channel.offset) * channel.scale;
+        info.resolution = std::fabs(channel.scale);
+        break;
+    }
+
+    if (!frequencies.empty())
+        info.min_delay = static_cast<uint32_t>(1000.0 / frequencies.back());
+
+    return info;
+}
+
+bool
+iio::Device::set_enabled(Sensor& sensor, bool enabled)
+{
+    std::lock_guard<std::mutex> lock(guard);
+
+    // detach the reader before changing what it reads
+    stop_locked();
+    active[index_of(sensor.type())] = enabled ? &sensor : NULL;
+
+    return start_locked() || !enabled;
+}
+
+bool
+iio::Device::set_period(Sensor& sensor, uint32_t period_ns)
+{
+    std::lock_guard<std::mutex> lock(guard);
+
+    periods[index_of(sensor.type())] = period_ns;
+
+    if (fd < 0)
+        return true;
+
+    stop_locked();
+    return start_locked();
+}
+
+bool
+iio::Device::start_locked()
+{
+    generation++;
+
+    // select the scan elements of the enabled sensors
+    bool any = false;
+    uint32_t period = 0;
+    for (int i = 0; i < index_of(SensorType::count); i++)
+    {
+        if (active[i] == NULL)
+            continue;
+        any = true;
+        if (periods[i] > 0 && (period == 0 || periods[i] < period))
+            period = periods[i];
+    }
+
+    if (!any)
+        return true;
+
+    std::vector<Channel*> layout;
+    for (auto& channel : channels)
+    {
+        bool enable = active[index_of(channel.type)] != NULL;
+        write_attribute("scan_elements/" + channel.name + "_en", enable ? "1" : "0");
+        if (enable)
+            layout.push_back(&channel);
+    }
+    if (has_timestamp)
+    {
+        write_attribute("scan_elements/in_timestamp_en", "1");
+        layout.push_back(&timestamp);
+        std::sort(layout.begin(), layout.end(), [](const Channel* a, const Channel* b) { return a->index < b->index; });
+    }
+
+    // elements are naturally aligned, the scan is padded to its largest element
+    size_t position = 0;
+    size_t alignment = 1;
+    for (Channel* channel : layout)
+    {
+        size_t size = channel->storage_bytes;
+        position = (position + size - 1) / size * size;
+        channel->position = position;
+        position += size;
+        alignment = std::max(alignment, size);
+    }
+    scan_size = (position + alignment - 1) / alignment * alignment;
+    buffer.resize(scan_size * scans_per_read);
+
+    if (period > 0)
+    {
+        double requested = 1e9 / period;
+        double frequency = requested;
+        if (!frequencies.empty())
+        {
+            auto it = std::lower_bound(frequencies.begin(), frequencies.end(), requested);
+            frequency = it != frequencies.end() ? *it : frequencies.back();
+        }
+
+        std::ostringstream ss;
+        ss << frequency;
+        write_attribute("sampling_frequency", ss.str());
+    }
+
+    // use the device's own trigger unless one is configured already
+    std::string trigger;
+    if (read_attribute("trigger/current_trigger", trigger) && trigger.empty())
+    {
+        std::string wanted = device_name + "-dev" + sysfs_name.substr(strlen("iio:device"));
+        for (const auto& name : list_directory(root + devices_path))
+        {
+            std::string trigger_name;
+            if (starts_with(name, "trigger") &&
+                read_file(root + devices_path + "/" + name + "/name", trigger_name) &&
+                trigger_name == wanted)
+            {
+                write_attribute("trigger/current_trigger", trigger_name);
+                break;
+            }
+        }
+    }
+
+    write_attribute("buffer/length", buffer_length);
+    if (!write_attribute("buffer/enable", "1"))
+    {
+        std::cerr << "IIO: failed to enable buffer of " << sysfs_name << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    fd = open((root + "/dev/" + sysfs_name).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::cerr << "IIO: failed to open /dev/" << sysfs_name << ": " << strerror(errno) << std::endl;
+        write_attribute("buffer/enable", "0");
+        return false;
+    }
+
+    if (!loop.add(fd, [this](uint32_t events) { on_readable(events); }))
+    {
+        stop_locked();
+        return false;
+    }
+
+    return true;
+}
+
+void
+iio::Device::stop_locked()
+{
+    if (fd >= 0)
+    {
+        // waits for on_readable() to finish unless called from within it
+        loop.remove(fd);
+        close(fd);
+        fd = -1;
+
+        write_attribute("buffer/enable", "0");
+    }
+
+    // only written once the reader is detached, or from within it
+    generation++;
+}
+
+void
+iio::Device::on_readable(uint32_t events)
+{
+    ssize_t n = read(fd, buffer.data(), buffer.size());
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    if (n <= 0)
+    {
+        if (n == 0 || (events & (EPOLLHUP | EPOLLERR)))
+        {
+            // the device went away
+            std::cerr << "IIO: stopped reading from " << sysfs_name << std::endl;
+            loop.remove(fd);
+        }
+        return;
+    }
+
+    int64_t clock_offset = 0;
+    uint64_t fallback_timestamp = now(CLOCK_MONOTONIC);
+    if (has_timestamp && timestamp_clock != CLOCK_MONOTONIC)
+        clock_offset = int64_t(fallback_timestamp) - now(timestamp_clock);
+
+    unsigned int current = generation;
+    for (size_t offset = 0; offset + scan_size <= size_t(n); offset += scan_size)
+    {
+        deliver_scan(buffer.data() + offset, fallback_timestamp, clock_offset, current);
+
+        // a callback reconfigured the device, the remaining scans are stale
+        if (generation != current)
+            break;
+    }
+}
+
+void
+iio::Device::deliver_scan(const uint8_t* scan, uint64_t fallback_timestamp, int64_t clock_offset, unsigned int current)
+{
+    Reading readings[static_cast<int>(SensorType::count)];
+    std::memset(readings, 0, sizeof(readings));
+
+    uint64_t ts = fallback_timestamp;
+    if (has_timestamp)
+        ts = decode(scan + timestamp.position, timestamp) + clock_offset;
+
+    for (const auto& channel : channels)
+    {
+        if (active[index_of(channel.type)] == NULL)
+            continue;
+
+        double raw = static_cast<double>(decode(scan + channel.position, channel));
+        readings[index_of(channel.type)].values[channel.axis] = (raw + channel.offset) * channel.scale;
+    }
+
+    for (int i = 0; i < index_of(SensorType::count); i++)
+    {
+        Sensor* sensor = active[i];
+        if (sensor == NULL)
+            continue;
+
+        readings[i].timestamp = ts;
+        sensor->deliver(readings[i]);
+
+        // stop if the callback reconfigured this device
+        if (generation != current)
+            break;
+    }
+}
+
+bool
+iio::Device::read_attribute(const std::string& name, std::string& value) const
+{
+    return read_file(device_dir + "/" + name, value);
+}
+
+bool
+iio::Device::write_attribute(const std::string& name, const std::string& value) const
+{
+    return write_file(device_dir + "/" + name, value);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UBUNTU_APPLICATION_SENSORS_DESKTOP_IIO_SOURCE_H_
+#define UBUNTU_APPLICATION_SENSORS_DESKTOP_IIO_SOURCE_H_
+
+#include "sensor.h"
+
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ubuntu
+{
+namespace application
+{
+namespace sensors
+{
+namespace desktop
+{
+namespace iio
+{
+/**
+ * Finds IIO devices with accelerometer, gyroscope, magnetometer, light or
+ * pressure channels below /sys/bus/iio/devices. The file system root can be
+ * overridden with $UBUNTU_PLATFORM_API_IIO_ROOT, e.g. for testing.
+ */
+std::vector<Source::Ptr> discover(EventLoop& loop);
+
+/** A buffered scan element of an IIO device. */
+struct Channel
+{
+    std::string name; ///< Base name of the scan element, e.g. in_accel_x.
+    SensorType type;
+    int axis; ///< 0 to 2 for vector sensors, -1 for the timestamp.
+    unsigned int index; ///< Position of the element in a scan.
+    bool is_signed;
+    bool big_endian;
+    unsigned int bits;
+    unsigned int storage_bytes;
+    unsigned int shift;
+    double scale; ///< Converts a raw value to the units of a Reading.
+    double offset; ///< Added to a raw value before scaling.
+    size_t position; ///< Byte offset within the current scan layout.
+};
+
+/**
+ * An IIO device streaming triggered scans through its buffer and character
+ * device. Whenever the set of enabled sensors changes, the buffer is stopped,
+ * the scan elements are reconfigured and streaming restarts.
+ */
+class Device : public Source
+{
+public:
+    Device(EventLoop& loop, const std::string& root, const std::string& name);
+    ~Device();
+
+    /** True if the device provides at least one supported sensor. */
+    bool valid() const { return !types().empty(); }
+
+    std::string description() const override;
+    std::vector<SensorType> types() const override;
+    SensorInfo info(SensorType type) const override;
+    bool set_enabled(Sensor& sensor, bool enabled) override;
+    bool set_period(Sensor& sensor, uint32_t period_ns) override;
+
+private:
+    void probe();
+    void probe_frequencies();
+    bool start_locked();
+    void stop_locked();
+    void on_readable(uint32_t events);
+    void deliver_scan(const uint8_t* scan, uint64_t fallback_timestamp, int64_t clock_offset, unsigned int current);
+
+    bool read_attribute(const std::string& name, std::string& value) const;
+    bool write_attribute(const std::string& name, const std::string& value) const;
+
+    EventLoop& loop;
+    std::string root;
+    std::string sysfs_name; ///< iio:deviceN
+    std::string device_dir;
+    std::string device_name;
+
+    std::vector<Channel> channels; ///< All supported channels, ordered by index.
+    bool has_timestamp;
+    Channel timestamp;
+    clockid_t timestamp_clock;
+    std::vector<double> frequencies; ///< Available sampling frequencies in [Hz], ascending.
+
+    std::mutex guard;
+    Sensor* active[static_cast<int>(SensorType::count)];
+    uint32_t periods[static_cast<int>(SensorType::count)];
+    int fd;
+    unsigned int generation; ///< Incremented on every reconfiguration.
+    size_t scan_size;
+    std::vector<uint8_t> buffer;
+};
+}
+}
+}
+}
+}
+
+#endif // UBUNTU_APPLICATION_SENSORS_DESKTOP_IIO_SOURCE_H_
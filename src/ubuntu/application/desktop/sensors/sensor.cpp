@@ -0,0 +1,144 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sensor.h"
+#include "evdev_source.h"
+#include "iio_source.h"
+
+namespace desktop = ubuntu::application::sensors::desktop;
+
+desktop::Sensor::Sensor(SensorType type, Source* source, EventLoop& loop)
+    : sensor_type(type),
+      sensor_info(source->info(type)),
+      source(source),
+      loop(loop),
+      enabled(false),
+      callback(NULL),
+      context(NULL)
+{
+}
+
+bool
+desktop::Sensor::enable()
+{
+    bool result = false;
+    loop.invoke([this, &result]()
+    {
+        std::lock_guard<std::mutex> lock(state_guard);
+
+        if (!enabled)
+            enabled = source->set_enabled(*this, true);
+
+        result = enabled;
+    });
+    return result;
+}
+
+bool
+desktop::Sensor::disable()
+{
+    loop.invoke([this]()
+    {
+        std::lock_guard<std::mutex> lock(state_guard);
+
+        if (enabled)
+        {
+            source->set_enabled(*this, false);
+            enabled = false;
+        }
+    });
+    return true;
+}
+
+bool
+desktop::Sensor::set_period(uint32_t period_ns)
+{
+    bool result = false;
+    loop.invoke([this, period_ns, &result]()
+    {
+        std::lock_guard<std::mutex> lock(state_guard);
+        result = source->set_period(*this, period_ns);
+    });
+    return result;
+}
+
+void
+desktop::Sensor::set_callback(Callback cb, void* ctx)
+{
+    std::lock_guard<std::mutex> lock(callback_guard);
+    callback = cb;
+    context = ctx;
+}
+
+void
+desktop::Sensor::deliver(Reading& reading)
+{
+    Callback cb;
+    void* ctx;
+    {
+        std::lock_guard<std::mutex> lock(callback_guard);
+        cb = callback;
+        ctx = context;
+    }
+
+    if (cb != NULL)
+        cb(&reading, ctx);
+}
+
+desktop::SensorRegistry&
+desktop::SensorRegistry::instance()
+{
+    static SensorRegistry registry;
+    return registry;
+}
+
+desktop::SensorRegistry::SensorRegistry()
+{
+    // IIO devices come first, they describe their channels best
+    for (const auto& source : iio::discover(loop))
+        add(source);
+    for (const auto& source : evdev::discover(loop))
+        add(source);
+}
+
+desktop::SensorRegistry::~SensorRegistry()
+{
+    // sources must not be called from the loop thread while they go away
+    loop.stop();
+}
+
+desktop::Sensor*
+desktop::SensorRegistry::sensor(SensorType type)
+{
+    if (type >= SensorType::count)
+        return NULL;
+
+    return sensors[static_cast<int>(type)].get();
+}
+
+void
+desktop::SensorRegistry::add(const Source::Ptr& source)
+{
+    sources.push_back(source);
+
+    // the first source found for a type wins
+    for (SensorType type : source->types())
+    {
+        auto& slot = sensors[static_cast<int>(type)];
+        if (!slot)
+            slot.reset(new Sensor(type, source.get(), loop));
+    }
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UBUNTU_APPLICATION_SENSORS_DESKTOP_SENSOR_H_
+#define UBUNTU_APPLICATION_SENSORS_DESKTOP_SENSOR_H_
+
+#include "event_loop.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ubuntu
+{
+namespace application
+{
+namespace sensors
+{
+namespace desktop
+{
+/** The sensor types the desktop backend knows how to provide. */
+enum class SensorType
+{
+    accelerometer,
+    gyroscope,
+    magnetic_field,
+    light,
+    pressure,
+    proximity,
+    count
+};
+
+/** A single reading; this is what the application callbacks get as event. */
+struct Reading
+{
+    uint64_t timestamp; ///< [ns], CLOCK_MONOTONIC
+    float values[3]; ///< SI units as used by the Android backend; scalar sensors only use the first value.
+};
+
+/** Static properties of a sensor, in the units of its readings. */
+struct SensorInfo
+{
+    float min_value;
+    float max_value;
+    float resolution;
+    uint32_t min_delay; ///< [ms]
+};
+
+class Sensor;
+
+/** A device delivering readings for one or more sensors, e.g. an IIO device. */
+class Source
+{
+public:
+    typedef std::shared_ptr<Source> Ptr;
+
+    virtual ~Source() = default;
+
+    /** A human readable description, used in diagnostics. */
+    virtual std::string description() const = 0;
+
+    /** The sensor types this source can deliver readings for. */
+    virtual std::vector<SensorType> types() const = 0;
+
+    virtual SensorInfo info(SensorType type) const = 0;
+
+    /**
+     * Starts or stops delivering readings to the sensor. Like set_period(),
+     * only called on the event loop thread, possibly from within a reading
+     * callback of the source itself.
+     */
+    virtual bool set_enabled(Sensor& sensor, bool enabled) = 0;
+
+    /** Requests a reading every period_ns; sources pick the closest rate the hardware supports. */
+    virtual bool set_period(Sensor& sensor, uint32_t period_ns) = 0;
+
+protected:
+    Source() = default;
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+};
+
+/** A sensor as handed out through the ua_sensors_* API. */
+class Sensor
+{
+public:
+    typedef void (*Callback)(void* event, void* context);
+
+    Sensor(SensorType type, Source* source, EventLoop& loop);
+
+    SensorType type() const { return sensor_type; }
+    const SensorInfo& info() const { return sensor_info; }
+
+    /**
+     * These reconfigure the source on the event loop thread and wait for it,
+     * so that they never contend with a reading callback for the locks of
+     * the source; the callback may call them itself. Once disable() returns,
+     * no reading is delivered anymore.
+     */
+    bool enable();
+    bool disable();
+    bool set_period(uint32_t period_ns);
+    void set_callback(Callback callback, void* context);
+
+    /** Hands a reading to the application; called by the source, usually from the event loop. */
+    void deliver(Reading& reading);
+
+private:
+    SensorType sensor_type;
+    SensorInfo sensor_info;
+    Source* source;
+    EventLoop& loop;
+
+    // serializes enable/disable/set_period; never held while delivering
+    std::mutex state_guard;
+    bool enabled;
+
+    std::mutex callback_guard;
+    Callback callback;
+    void* context;
+
+protected:
+    Sensor(const Sensor&) = delete;
+    Sensor& operator=(const Sensor&) = delete;
+};
+
+/** Discovers the sources on first use and owns the sensors handed out to the application. */
+class SensorRegistry
+{
+public:
+    static SensorRegistry& instance();
+
+    /** Returns the sensor of the given type, or NULL if there is none. */
+    Sensor* sensor(SensorType type);
+
+    EventLoop& event_loop() { return loop; }
+
+private:
+    SensorRegistry();
+    ~SensorRegistry();
+
+    void add(const Source::Ptr& source);
+
+    EventLoop loop;
+    std::vector<Source::Ptr> sources;
+    std::unique_ptr<Sensor> sensors[static_cast<int>(SensorType::count)];
+};
+}
+}
+}
+}
+
+#endif // UBUNTU_APPLICATION_SENSORS_DESKTOP_SENSOR_H_
@@ -25,252 +25,289 @@
 #include <ubuntu/application/sensors/temperature.h>
 #include <ubuntu/application/sensors/pressure.h>
 
-#include <stddef.h>
+#include "sensors/sensor.h"
 
-// Ubuntu Application Sensors. Null desktop implementation
+#include <cstddef>
 
-// Acceleration Sensor
-UASensorsAccelerometer* ua_sensors_accelerometer_new()
+namespace desktop = ubuntu::application::sensors::desktop;
+
+// Ubuntu Application Sensors. Desktop implementation on top of the sources in
+// sensors/, sensors without a source are reported as absent (NULL).
+
+namespace
 {
-    return NULL;
+desktop::Sensor* registry_sensor(desktop::SensorType type)
+{
+    return desktop::SensorRegistry::instance().sensor(type);
 }
 
-UStatus ua_sensors_accelerometer_enable(UASensorsAccelerometer*)
+UStatus enable(void* s)
 {
-    return (UStatus) 0;
+    if (s == NULL)
+        return U_STATUS_ERROR;
+
+    return static_cast<desktop::Sensor*>(s)->enable() ? U_STATUS_SUCCESS : U_STATUS_ERROR;
 }
 
-UStatus ua_sensors_accelerometer_disable(UASensorsAccelerometer*)
+UStatus disable(void* s)
 {
-    return (UStatus) 0;
+    if (s == NULL)
+        return U_STATUS_ERROR;
+
+    static_cast<desktop::Sensor*>(s)->disable();
+    return U_STATUS_SUCCESS;
 }
 
-uint32_t ua_sensors_accelerometer_get_min_delay(UASensorsAccelerometer*)
+uint32_t min_delay(void* s)
 {
-    return 0;
+    if (s == NULL)
+        return 0;
+
+    return static_cast<desktop::Sensor*>(s)->info().min_delay;
 }
 
-UStatus ua_sensors_accelerometer_get_min_value(UASensorsAccelerometer*, float* value)
+UStatus min_value(void* s, float* value)
 {
-    if (!value)
+    if (s == NULL || value == NULL)
         return U_STATUS_ERROR;
 
-    *value = 0.f;
-
+    *value = static_cast<desktop::Sensor*>(s)->info().min_value;
     return U_STATUS_SUCCESS;
 }
 
-UStatus ua_sensors_accelerometer_get_max_value(UASensorsAccelerometer*, float* value)
+UStatus max_value(void* s, float* value)
 {
-    if (!value)
+    if (s == NULL || value == NULL)
         return U_STATUS_ERROR;
 
-    *value = 0.f;
-
+    *value = static_cast<desktop::Sensor*>(s)->info().max_value;
     return U_STATUS_SUCCESS;
 }
 
-UStatus ua_sensors_accelerometer_get_resolution(UASensorsAccelerometer*, float* value)
+UStatus resolution(void* s, float* value)
 {
-    if (!value)
+    if (s == NULL || value == NULL)
         return U_STATUS_ERROR;
 
-    *value = 0.f;
-
+    *value = static_cast<desktop::Sensor*>(s)->info().resolution;
     return U_STATUS_SUCCESS;
 }
 
-UStatus ua_sensors_accelerometer_set_event_rate(UASensorsAccelerometer* s, uint32_t rate)
+UStatus set_event_rate(void* s, uint32_t rate)
 {
-    return U_STATUS_SUCCESS;
+    if (s == NULL)
+        return U_STATUS_ERROR;
+
+    return static_cast<desktop::Sensor*>(s)->set_period(rate) ? U_STATUS_SUCCESS : U_STATUS_ERROR;
 }
 
-void ua_sensors_accelerometer_set_reading_cb(UASensorsAccelerometer*, on_accelerometer_event_cb, void*)
+void set_reading_cb(void* s, desktop::Sensor::Callback cb, void* ctx)
 {
+    if (s == NULL)
+        return;
+
+    static_cast<desktop::Sensor*>(s)->set_callback(cb, ctx);
 }
 
-// Acceleration Sensor Event
-uint64_t uas_accelerometer_event_get_timestamp(UASAccelerometerEvent*)
+uint64_t timestamp(void* e)
 {
-    return 0;
+    return static_cast<desktop::Reading*>(e)->timestamp;
 }
 
-UStatus uas_accelerometer_event_get_acceleration_x(UASAccelerometerEvent*, float* value)
+UStatus reading_value(void* e, int index, float* value)
 {
-    if (!value)
+    if (e == NULL || value == NULL)
         return U_STATUS_ERROR;
 
-    *value = 0.f;
-
+    *value = static_cast<desktop::Reading*>(e)->values[index];
     return U_STATUS_SUCCESS;
 }
+}
 
-UStatus uas_accelerometer_event_get_acceleration_y(UASAccelerometerEvent*, float* value)
+// Acceleration Sensor
+UASensorsAccelerometer* ua_sensors_accelerometer_new()
 {
-    if (!value)
-        return U_STATUS_ERROR;
+    return registry_sensor(desktop::SensorType::accelerometer);
+}
 
-    *value = 0.f;
+UStatus ua_sensors_accelerometer_enable(UASensorsAccelerometer* s)
+{
+    return enable(s);
+}
 
-    return U_STATUS_SUCCESS;
+UStatus ua_sensors_accelerometer_disable(UASensorsAccelerometer* s)
+{
+    return disable(s);
 }
 
-UStatus uas_accelerometer_event_get_acceleration_z(UASAccelerometerEvent*, float* value)
+uint32_t ua_sensors_accelerometer_get_min_delay(UASensorsAccelerometer* s)
 {
-    if (!value)
-        return U_STATUS_ERROR;
+    return min_delay(s);
+}
 
-    *value = 0.f;
+UStatus ua_sensors_accelerometer_get_min_value(UASensorsAccelerometer* s, float* value)
+{
+    return min_value(s, value);
+}
 
-    return U_STATUS_SUCCESS;
+UStatus ua_sensors_accelerometer_get_max_value(UASensorsAccelerometer* s, float* value)
+{
+    return max_value(s, value);
 }
 
-// Proximity Sensor
-UASensorsProximity* ua_sensors_proximity_new()
+UStatus ua_sensors_accelerometer_get_resolution(UASensorsAccelerometer* s, float* value)
 {
-    return NULL;
+    return resolution(s, value);
 }
 
-UStatus ua_sensors_proximity_enable(UASensorsProximity*)
+UStatus ua_sensors_accelerometer_set_event_rate(UASensorsAccelerometer* s, uint32_t rate)
 {
-    return (UStatus) 0;
+    return set_event_rate(s, rate);
 }
 
-UStatus ua_sensors_proximity_disable(UASensorsProximity*)
+void ua_sensors_accelerometer_set_reading_cb(UASensorsAccelerometer* s, on_accelerometer_event_cb cb, void* ctx)
 {
-    return (UStatus) 0;
+    set_reading_cb(s, cb, ctx);
 }
 
-uint32_t ua_sensors_proximity_get_min_delay(UASensorsProximity*)
+// Acceleration Sensor Event
+uint64_t uas_accelerometer_event_get_timestamp(UASAccelerometerEvent* e)
 {
-    return 0;
+    return timestamp(e);
 }
 
-UStatus ua_sensors_proximity_get_min_value(UASensorsProximity*, float* value)
+UStatus uas_accelerometer_event_get_acceleration_x(UASAccelerometerEvent* e, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
+    return reading_value(e, 0, value);
+}
 
-    *value = 0.f;
+UStatus uas_accelerometer_event_get_acceleration_y(UASAccelerometerEvent* e, float* value)
+{
+    return reading_value(e, 1, value);
+}
 
-    return U_STATUS_SUCCESS;
+UStatus uas_accelerometer_event_get_acceleration_z(UASAccelerometerEvent* e, float* value)
+{
+    return reading_value(e, 2, value);
 }
 
-UStatus ua_sensors_proximity_get_max_value(UASensorsProximity*, float* value)
+// Proximity Sensor
+UASensorsProximity* ua_sensors_proximity_new()
 {
-    if (!value)
-        return U_STATUS_ERROR;
+    return registry_sensor(desktop::SensorType::proximity);
+}
 
-    *value = 0.f;
+UStatus ua_sensors_proximity_enable(UASensorsProximity* s)
+{
+    return enable(s);
+}
 
-    return U_STATUS_SUCCESS;
+UStatus ua_sensors_proximity_disable(UASensorsProximity* s)
+{
+    return disable(s);
 }
 
-UStatus ua_sensors_proximity_get_resolution(UASensorsProximity*, float* value)
+uint32_t ua_sensors_proximity_get_min_delay(UASensorsProximity* s)
 {
-    if (!value)
-        return U_STATUS_ERROR;
+    return min_delay(s);
+}
 
-    *value = 0.f;
+UStatus ua_sensors_proximity_get_min_value(UASensorsProximity* s, float* value)
+{
+    return min_value(s, value);
+}
 
-    return U_STATUS_SUCCESS;
+UStatus ua_sensors_proximity_get_max_value(UASensorsProximity* s, float* value)
+{
+    return max_value(s, value);
+}
+
+UStatus ua_sensors_proximity_get_resolution(UASensorsProximity* s, float* value)
+{
+    return resolution(s, value);
 }
 
 UStatus ua_sensors_proximity_set_event_rate(UASensorsProximity* s, uint32_t rate)
 {
-    return U_STATUS_SUCCESS;
+    return set_event_rate(s, rate);
 }
 
-void ua_sensors_proximity_set_reading_cb(UASensorsProximity*, on_proximity_event_cb, void*)
+void ua_sensors_proximity_set_reading_cb(UASensorsProximity* s, on_proximity_event_cb cb, void* ctx)
 {
+    set_reading_cb(s, cb, ctx);
 }
 
 // Proximity Sensor Event
-uint64_t uas_proximity_event_get_timestamp(UASProximityEvent*)
+uint64_t uas_proximity_event_get_timestamp(UASProximityEvent* e)
 {
-    return 0;
+    return timestamp(e);
 }
 
-UASProximityDistance uas_proximity_event_get_distance(UASProximityEvent*)
+UASProximityDistance uas_proximity_event_get_distance(UASProximityEvent* e)
 {
-    return (UASProximityDistance) 0;
-}
+    // like the Android backend, only the maximum distance means "far"
+    desktop::Sensor* s = registry_sensor(desktop::SensorType::proximity);
+    if (s != NULL && static_cast<desktop::Reading*>(e)->values[0] >= s->info().max_value)
+        return U_PROXIMITY_FAR;
 
+    return U_PROXIMITY_NEAR;
+}
 
 // Ambient Light Sensor
 UASensorsLight* ua_sensors_light_new()
 {
-    return NULL;
+    return registry_sensor(desktop::SensorType::light);
 }
 
-UStatus ua_sensors_light_enable(UASensorsLight*)
+UStatus ua_sensors_light_enable(UASensorsLight* s)
 {
-    return (UStatus) 0;
+    return enable(s);
 }
 
-UStatus ua_sensors_light_disable(UASensorsLight*)
+UStatus ua_sensors_light_disable(UASensorsLight* s)
 {
-    return (UStatus) 0;
+    return disable(s);
 }
 
-uint32_t ua_sensors_light_get_min_delay(UASensorsLight*)
+uint32_t ua_sensors_light_get_min_delay(UASensorsLight* s)
 {
-    return 0;
+    return min_delay(s);
 }
 
-UStatus ua_sensors_light_get_min_value(UASensorsLight*, float* value)
+UStatus ua_sensors_light_get_min_value(UASensorsLight* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return min_value(s, value);
 }
 
-UStatus ua_sensors_light_get_max_value(UASensorsLight*, float* value)
+UStatus ua_sensors_light_get_max_value(UASensorsLight* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return max_value(s, value);
 }
 
-UStatus ua_sensors_light_get_resolution(UASensorsLight*, float* value)
+UStatus ua_sensors_light_get_resolution(UASensorsLight* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return resolution(s, value);
 }
 
 UStatus ua_sensors_light_set_event_rate(UASensorsLight* s, uint32_t rate)
 {
-    return U_STATUS_SUCCESS;
+    return set_event_rate(s, rate);
 }
 
-void ua_sensors_light_set_reading_cb(UASensorsLight*, on_light_event_cb, void*)
+void ua_sensors_light_set_reading_cb(UASensorsLight* s, on_light_event_cb cb, void* ctx)
 {
+    set_reading_cb(s, cb, ctx);
 }
 
 // Ambient Light Sensor Event
-uint64_t uas_light_event_get_timestamp(UASLightEvent*)
+uint64_t uas_light_event_get_timestamp(UASLightEvent* e)
 {
-    return 0;
+    return timestamp(e);
 }
 
-UStatus uas_light_event_get_light(UASLightEvent*, float* value)
+UStatus uas_light_event_get_light(UASLightEvent* e, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return reading_value(e, 0, value);
 }
 
 // Orientation Sensor
@@ -372,193 +409,135 @@ UStatus uas_orientation_event_get_roll(UASOrientationEvent*, float* value)
 // Gyroscope Sensor
 UASensorsGyroscope* ua_sensors_gyroscope_new()
 {
-    return NULL;
+    return registry_sensor(desktop::SensorType::gyroscope);
 }
 
-UStatus ua_sensors_gyroscope_enable(UASensorsGyroscope*)
+UStatus ua_sensors_gyroscope_enable(UASensorsGyroscope* s)
 {
-    return (UStatus) 0;
+    return enable(s);
 }
 
-UStatus ua_sensors_gyroscope_disable(UASensorsGyroscope*)
+UStatus ua_sensors_gyroscope_disable(UASensorsGyroscope* s)
 {
-    return (UStatus) 0;
+    return disable(s);
 }
 
-uint32_t ua_sensors_gyroscope_get_min_delay(UASensorsGyroscope*)
+uint32_t ua_sensors_gyroscope_get_min_delay(UASensorsGyroscope* s)
 {
-    return 0;
+    return min_delay(s);
 }
 
-UStatus ua_sensors_gyroscope_get_min_value(UASensorsGyroscope*, float* value)
+UStatus ua_sensors_gyroscope_get_min_value(UASensorsGyroscope* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return min_value(s, value);
 }
 
-UStatus ua_sensors_gyroscope_get_max_value(UASensorsGyroscope*, float* value)
+UStatus ua_sensors_gyroscope_get_max_value(UASensorsGyroscope* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return max_value(s, value);
 }
 
-UStatus ua_sensors_gyroscope_get_resolution(UASensorsGyroscope*, float* value)
+UStatus ua_sensors_gyroscope_get_resolution(UASensorsGyroscope* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return resolution(s, value);
 }
 
-void ua_sensors_gyroscope_set_reading_cb(UASensorsGyroscope*, on_gyroscope_event_cb, void *)
+UStatus ua_sensors_gyroscope_set_event_rate(UASensorsGyroscope* s, uint32_t rate)
 {
+    return set_event_rate(s, rate);
 }
 
-UStatus ua_sensors_gyroscope_set_event_rate(UASensorsGyroscope*, uint32_t)
+void ua_sensors_gyroscope_set_reading_cb(UASensorsGyroscope* s, on_gyroscope_event_cb cb, void* ctx)
 {
-    return U_STATUS_SUCCESS;
+    set_reading_cb(s, cb, ctx);
 }
 
 // Gyroscope Sensor Event
-uint64_t uas_gyroscope_event_get_timestamp(UASGyroscopeEvent*)
+uint64_t uas_gyroscope_event_get_timestamp(UASGyroscopeEvent* e)
 {
-    return 0;
+    return timestamp(e);
 }
 
-UStatus uas_gyroscope_event_get_rate_of_rotation_around_x(UASGyroscopeEvent*, float* value)
+UStatus uas_gyroscope_event_get_rate_of_rotation_around_x(UASGyroscopeEvent* e, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return reading_value(e, 0, value);
 }
 
-UStatus uas_gyroscope_event_get_rate_of_rotation_around_y(UASGyroscopeEvent*, float* value)
+UStatus uas_gyroscope_event_get_rate_of_rotation_around_y(UASGyroscopeEvent* e, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return reading_value(e, 1, value);
 }
 
-UStatus uas_gyroscope_event_get_rate_of_rotation_around_z(UASGyroscopeEvent*, float* value)
+UStatus uas_gyroscope_event_get_rate_of_rotation_around_z(UASGyroscopeEvent* e, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return reading_value(e, 2, value);
 }
 
 // Magnetic Field Sensor
 UASensorsMagnetic* ua_sensors_magnetic_new()
 {
-    return NULL;
+    return registry_sensor(desktop::SensorType::magnetic_field);
 }
 
-UStatus ua_sensors_magnetic_enable(UASensorsMagnetic*)
+UStatus ua_sensors_magnetic_enable(UASensorsMagnetic* s)
 {
-    return (UStatus) 0;
+    return enable(s);
 }
 
-UStatus ua_sensors_magnetic_disable(UASensorsMagnetic*)
+UStatus ua_sensors_magnetic_disable(UASensorsMagnetic* s)
 {
-    return (UStatus) 0;
+    return disable(s);
 }
 
-uint32_t ua_sensors_magnetic_get_min_delay(UASensorsMagnetic*)
+uint32_t ua_sensors_magnetic_get_min_delay(UASensorsMagnetic* s)
 {
-    return 0;
+    return min_delay(s);
 }
 
-UStatus ua_sensors_magnetic_get_min_value(UASensorsMagnetic*, float* value)
+UStatus ua_sensors_magnetic_get_min_value(UASensorsMagnetic* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return min_value(s, value);
 }
 
-UStatus ua_sensors_magnetic_get_max_value(UASensorsMagnetic*, float* value)
+UStatus ua_sensors_magnetic_get_max_value(UASensorsMagnetic* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return max_value(s, value);
 }
 
-UStatus ua_sensors_magnetic_get_resolution(UASensorsMagnetic*, float* value)
+UStatus ua_sensors_magnetic_get_resolution(UASensorsMagnetic* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return resolution(s, value);
 }
 
 UStatus ua_sensors_magnetic_set_event_rate(UASensorsMagnetic* s, uint32_t rate)
 {
-    return U_STATUS_SUCCESS;
+    return set_event_rate(s, rate);
 }
 
-void ua_sensors_magnetic_set_reading_cb(UASensorsMagnetic*, on_magnetic_event_cb, void*)
+void ua_sensors_magnetic_set_reading_cb(UASensorsMagnetic* s, on_magnetic_event_cb cb, void* ctx)
 {
+    set_reading_cb(s, cb, ctx);
 }
 
-// Acceleration Sensor Event
-uint64_t uas_magnetic_event_get_timestamp(UASMagneticEvent*)
+// Magnetic Field Sensor Event
+uint64_t uas_magnetic_event_get_timestamp(UASMagneticEvent* e)
 {
-    return 0;
+    return timestamp(e);
 }
 
-UStatus uas_magnetic_event_get_magnetic_field_x(UASMagneticEvent*, float* value)
+UStatus uas_magnetic_event_get_magnetic_field_x(UASMagneticEvent* e, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return reading_value(e, 0, value);
 }
 
-UStatus uas_magnetic_event_get_magnetic_field_y(UASMagneticEvent*, float* value)
+UStatus uas_magnetic_event_get_magnetic_field_y(UASMagneticEvent* e, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return reading_value(e, 1, value);
 }
 
-UStatus uas_magnetic_event_get_magnetic_field_z(UASMagneticEvent*, float* value)
+UStatus uas_magnetic_event_get_magnetic_field_z(UASMagneticEvent* e, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return reading_value(e, 2, value);
 }
 
 // Temperature Sensor
@@ -640,77 +619,56 @@ UStatus uas_temperature_event_get_temperature(UASTemperatureEvent*, float* value
 // Pressure Sensor
 UASensorsPressure* ua_sensors_pressure_new()
 {
-    return NULL;
+    return registry_sensor(desktop::SensorType::pressure);
 }
 
-UStatus ua_sensors_pressure_enable(UASensorsPressure*)
+UStatus ua_sensors_pressure_enable(UASensorsPressure* s)
 {
-    return (UStatus) 0;
+    return enable(s);
 }
 
-UStatus ua_sensors_pressure_disable(UASensorsPressure*)
+UStatus ua_sensors_pressure_disable(UASensorsPressure* s)
 {
-    return (UStatus) 0;
+    return disable(s);
 }
 
-uint32_t ua_sensors_pressure_get_min_delay(UASensorsPressure*)
+uint32_t ua_sensors_pressure_get_min_delay(UASensorsPressure* s)
 {
-    return 0;
+    return min_delay(s);
 }
 
-UStatus ua_sensors_pressure_get_min_value(UASensorsPressure*, float* value)
+UStatus ua_sensors_pressure_get_min_value(UASensorsPressure* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return min_value(s, value);
 }
 
-UStatus ua_sensors_pressure_get_max_value(UASensorsPressure*, float* value)
+UStatus ua_sensors_pressure_get_max_value(UASensorsPressure* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return max_value(s, value);
 }
 
-UStatus ua_sensors_pressure_get_resolution(UASensorsPressure*, float* value)
+UStatus ua_sensors_pressure_get_resolution(UASensorsPressure* s, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return resolution(s, value);
 }
 
-void ua_sensors_pressure_set_reading_cb(UASensorsPressure*, on_pressure_event_cb, void *)
+UStatus ua_sensors_pressure_set_event_rate(UASensorsPressure* s, uint32_t rate)
 {
+    return set_event_rate(s, rate);
 }
 
-UStatus ua_sensors_pressure_set_event_rate(UASensorsPressure*, uint32_t)
+void ua_sensors_pressure_set_reading_cb(UASensorsPressure* s, on_pressure_event_cb cb, void* ctx)
 {
-    return U_STATUS_SUCCESS;
+    set_reading_cb(s, cb, ctx);
 }
 
 // Pressure Sensor Event
-uint64_t uas_pressure_event_get_timestamp(UASPressureEvent*)
+uint64_t uas_pressure_event_get_timestamp(UASPressureEvent* e)
 {
-    return 0;
+    return timestamp(e);
 }
 
-UStatus uas_pressure_event_get_pressure(UASPressureEvent*, float* value)
+UStatus uas_pressure_event_get_pressure(UASPressureEvent* e, float* value)
 {
-    if (!value)
-        return U_STATUS_ERROR;
-
-    *value = 0.f;
-
-    return U_STATUS_SUCCESS;
+    return reading_value(e, 0, value);
 }
-
-
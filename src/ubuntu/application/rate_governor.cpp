@@ -0,0 +1,417 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rate_governor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <thread>
+
+namespace sensors = ubuntu::application::sensors;
+
+namespace
+{
+const uint32_t default_idle_rate = 200000000; // [ns]
+const uint32_t default_stillness_window = 32;
+const uint32_t default_stillness_duration = 2000; // [ms]
+
+uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the governors waiting for the worker to apply their rate
+struct Worker
+{
+    std::once_flag started;
+    std::mutex guard;
+    std::condition_variable wakeup;
+    std::vector<sensors::RateGovernor*> queue;
+};
+
+Worker& worker()
+{
+    // never destroyed, the detached worker thread runs until the process exits
+    static Worker* worker = new Worker;
+    return *worker;
+}
+}
+
+UStatus
+sensors::RateGovernor::set_event_rate(const Backend& backend, void* sensor, uint32_t rate)
+{
+    if (sensor == NULL)
+        return backend.set_event_rate(sensor, rate);
+
+    RateGovernor* governor = lookup(&backend, sensor);
+    {
+        std::lock_guard<std::mutex> lock(governor->guard);
+        governor->requested_rate = rate;
+    }
+
+    // always forwarded, the application may rely on the backend seeing it
+    return governor->apply_rate(true);
+}
+
+void
+sensors::RateGovernor::set_reading_cb(const Backend& backend, void* sensor, Callback cb, void* context)
+{
+    if (sensor == NULL)
+    {
+        backend.set_reading_cb(sensor, cb, context);
+        return;
+    }
+
+    RateGovernor* governor = lookup(&backend, sensor);
+    bool governed;
+    {
+        std::lock_guard<std::mutex> lock(governor->guard);
+        governor->callback = cb;
+        governor->context = context;
+        governed = governor->governed;
+    }
+
+    if (governed)
+        backend.set_reading_cb(sensor, cb != NULL ? on_reading : NULL, cb != NULL ? governor : NULL);
+    else
+        backend.set_reading_cb(sensor, cb, context);
+}
+
+sensors::RateGovernor::Callback
+sensors::RateGovernor::reading_cb(void* sensor)
+{
+    RateGovernor* governor = lookup(NULL, sensor);
+    if (governor == NULL)
+        return NULL;
+
+    std::lock_guard<std::mutex> lock(governor->guard);
+    return governor->callback;
+}
+
+UStatus
+sensors::RateGovernor::configure(const Backend& backend, void* sensor, const UASensorsRateGovernorConfig* config)
+{
+    if (sensor == NULL)
+        return U_STATUS_ERROR;
+
+    RateGovernor* governor = lookup(&backend, sensor);
+    Callback cb;
+    void* context;
+    {
+        std::lock_guard<std::mutex> lock(governor->guard);
+
+        if (config != NULL)
+        {
+            governor->config = *config;
+            auto& c = governor->config;
+            if (c.idle_rate == 0)
+                c.idle_rate = default_idle_rate;
+            if (c.stillness_variance <= 0)
+                c.stillness_variance = backend.default_stillness_variance;
+            if (c.motion_threshold <= 0)
+                c.motion_threshold = backend.default_motion_threshold;
+            if (c.stillness_window == 0)
+                c.stillness_window = default_stillness_window;
+            if (c.stillness_duration == 0)
+                c.stillness_duration = default_stillness_duration;
+
+            governor->window.assign(3 * c.stillness_window, 0.f);
+            governor->reset_window();
+            governor->active_time = 0;
+            governor->idle_time = 0;
+            governor->transitions = 0;
+        }
+
+        // (re)configuring always starts at the requested rate
+        governor->governed = config != NULL;
+        governor->idle = false;
+        governor->state_since = now();
+
+        cb = governor->callback;
+        context = governor->context;
+    }
+
+    if (config != NULL)
+        backend.set_reading_cb(sensor, cb != NULL ? on_reading : NULL, cb != NULL ? governor : NULL);
+    else
+        backend.set_reading_cb(sensor, cb, context);
+
+    governor->apply_rate(false);
+    return U_STATUS_SUCCESS;
+}
+
+UStatus
+sensors::RateGovernor::stats(void* sensor, UASensorsRateGovernorStats* stats)
+{
+    RateGovernor* governor = lookup(NULL, sensor);
+    if (governor == NULL || stats == NULL)
+        return U_STATUS_ERROR;
+
+    std::lock_guard<std::mutex> lock(governor->guard);
+    if (!governor->governed)
+        return U_STATUS_ERROR;
+
+    uint64_t elapsed = now() - governor->state_since;
+    stats->active_time = governor->active_time + (governor->idle ? 0 : elapsed);
+    stats->idle_time = governor->idle_time + (governor->idle ? elapsed : 0);
+    stats->transitions = governor->transitions;
+    stats->idle = governor->idle;
+    return U_STATUS_SUCCESS;
+}
+
+sensors::RateGovernor::RateGovernor(const Backend& backend, void* sensor)
+    : backend(backend),
+      sensor(sensor),
+      callback(NULL),
+      context(NULL),
+      requested_rate(0),
+      applied_rate(0),
+      apply_scheduled(false),
+      governed(false),
+      window_count(0),
+      window_next(0),
+      still_since(0),
+      idle(false),
+      state_since(0),
+      active_time(0),
+      idle_time(0),
+      transitions(0)
+{
+    std::memset(&config, 0, sizeof(config));
+    std::memset(rest, 0, sizeof(rest));
+    reset_window();
+}
+
+sensors::RateGovernor*
+sensors::RateGovernor::lookup(const Backend* backend, void* sensor)
+{
+    // sensors are singletons of the backends, so governors live as long as the process
+    static std::mutex registry_guard;
+    static std::map<void*, std::unique_ptr<RateGovernor>> governors;
+
+    std::lock_guard<std::mutex> lock(registry_guard);
+
+    auto it = governors.find(sensor);
+    if (it != governors.end())
+        return it->second.get();
+
+    if (backend == NULL)
+        return NULL;
+
+    RateGovernor* governor = new RateGovernor(*backend, sensor);
+    governors[sensor].reset(governor);
+    return governor;
+}
+
+void
+sensors::RateGovernor::on_reading(void* event, void* context)
+{
+    RateGovernor* governor = static_cast<RateGovernor*>(context);
+    const Backend& backend = governor->backend;
+
+    float values[3];
+    for (int i = 0; i < 3; i++)
+        backend.read_axis[i](event, &values[i]);
+    uint64_t timestamp = backend.read_timestamp(event);
+
+    Callback cb;
+    void* cb_context;
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(governor->guard);
+        cb = governor->callback;
+        cb_context = governor->context;
+        changed = governor->governed && governor->update(values, timestamp);
+    }
+
+    if (cb != NULL)
+        cb(event, cb_context);
+
+    if (changed)
+        governor->schedule_apply_rate();
+}
+
+void
+sensors::RateGovernor::reset_window()
+{
+    window_count = 0;
+    window_next = 0;
+    still_since = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        sum[i] = 0;
+        sum_squares[i] = 0;
+    }
+}
+
+bool
+sensors::RateGovernor::update(const float values[3], uint64_t timestamp)
+{
+    if (idle)
+    {
+        double deviation = 0;
+        for (int i = 0; i < 3; i++)
+            deviation += (values[i] - rest[i]) * (values[i] - rest[i]);
+
+        if (deviation <= double(config.motion_threshold) * config.motion_threshold)
+            return false;
+
+        switch_state(false, now());
+        return true;
+    }
+
+    // sliding window sums, the oldest reading drops out once the window is full
+    const size_t n = config.stillness_window;
+    float* slot = &window[3 * window_next];
+    for (int i = 0; i < 3; i++)
+    {
+        if (window_count == n)
+        {
+            sum[i] -= slot[i];
+            sum_squares[i] -= double(slot[i]) * slot[i];
+        }
+        slot[i] = values[i];
+        sum[i] += values[i];
+        sum_squares[i] += double(values[i]) * values[i];
+    }
+    window_next = (window_next + 1) % n;
+    window_count = std::min(window_count + 1, n);
+
+    if (window_count < n)
+        return false;
+
+    double variance = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        double mean = sum[i] / n;
+        variance += std::max(0.0, sum_squares[i] / n - mean * mean);
+    }
+
+    if (variance > config.stillness_variance)
+    {
+        still_since = 0;
+        return false;
+    }
+
+    if (still_since == 0 || timestamp < still_since)
+    {
+        still_since = std::max<uint64_t>(timestamp, 1);
+        return false;
+    }
+
+    if (timestamp - still_since < uint64_t(config.stillness_duration) * 1000000)
+        return false;
+
+    // nothing to save if the application is already slower than the idle rate
+    if (requested_rate == 0 || requested_rate >= config.idle_rate)
+        return false;
+
+    for (int i = 0; i < 3; i++)
+        rest[i] = sum[i] / n;
+    switch_state(true, now());
+    return true;
+}
+
+void
+sensors::RateGovernor::switch_state(bool to_idle, uint64_t now)
+{
+    if (idle)
+        idle_time += now - state_since;
+    else
+        active_time += now - state_since;
+
+    state_since = now;
+    idle = to_idle;
+    transitions++;
+
+    if (!idle)
+        reset_window();
+}
+
+uint32_t
+sensors::RateGovernor::wanted_rate() const
+{
+    if (governed && idle)
+        return std::max(requested_rate, config.idle_rate);
+
+    return requested_rate;
+}
+
+UStatus
+sensors::RateGovernor::apply_rate(bool force)
+{
+    UStatus status = U_STATUS_SUCCESS;
+
+    std::unique_lock<std::mutex> lock(guard);
+    uint32_t rate = wanted_rate();
+
+    // the backend is called without holding the lock, as it may be delivering
+    // readings concurrently; loop until no other change raced with this one
+    while (force || rate != applied_rate)
+    {
+        force = false;
+        lock.unlock();
+        status = backend.set_event_rate(sensor, rate);
+        lock.lock();
+
+        applied_rate = rate;
+        rate = wanted_rate();
+    }
+
+    return status;
+}
+
+void
+sensors::RateGovernor::schedule_apply_rate()
+{
+    Worker& w = worker();
+    std::call_once(w.started, []() { std::thread(run_worker).detach(); });
+
+    std::lock_guard<std::mutex> lock(w.guard);
+    if (apply_scheduled)
+        return;
+
+    apply_scheduled = true;
+    w.queue.push_back(this);
+    w.wakeup.notify_one();
+}
+
+void
+sensors::RateGovernor::run_worker()
+{
+    Worker& w = worker();
+    std::unique_lock<std::mutex> lock(w.guard);
+
+    for (;;)
+    {
+        w.wakeup.wait(lock, [&w]() { return !w.queue.empty(); });
+
+        std::vector<RateGovernor*> governors;
+        governors.swap(w.queue);
+        for (RateGovernor* governor : governors)
+            governor->apply_scheduled = false;
+
+        lock.unlock();
+        for (RateGovernor* governor : governors)
+            governor->apply_rate(false);
+        lock.lock();
+    }
+}
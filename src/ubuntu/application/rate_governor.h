@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UBUNTU_APPLICATION_SENSORS_RATE_GOVERNOR_PRIVATE_H_
+#define UBUNTU_APPLICATION_SENSORS_RATE_GOVERNOR_PRIVATE_H_
+
+#include <ubuntu/status.h>
+#include <ubuntu/application/sensors/rate_governor.h>
+
+#include <mutex>
+#include <vector>
+
+namespace ubuntu
+{
+namespace application
+{
+namespace sensors
+{
+/**
+ * Sits between the application and the backend for a vector sensor and
+ * switches the backend to a low event rate while the readings show no
+ * motion. Lives in the bridge, so it works the same with every backend.
+ *
+ * As long as no governor is configured for a sensor, the application's
+ * callback is handed to the backend untouched and costs nothing. Idling only
+ * starts once the application asked for a rate faster than the idle rate.
+ *
+ * Rate changes decided while delivering a reading are applied by a worker
+ * thread, so the backend is never reconfigured from within its own callback.
+ */
+class RateGovernor
+{
+public:
+    typedef void (*Callback)(void* event, void* context);
+
+    /** The backend entry points of one sensor type. */
+    struct Backend
+    {
+        UStatus (*set_event_rate)(void* sensor, uint32_t rate);
+        void (*set_reading_cb)(void* sensor, Callback cb, void* context);
+        uint64_t (*read_timestamp)(void* event);
+        UStatus (*read_axis[3])(void* event, float* value);
+        float default_stillness_variance;
+        float default_motion_threshold;
+    };
+
+    static UStatus set_event_rate(const Backend& backend, void* sensor, uint32_t rate);
+    static void set_reading_cb(const Backend& backend, void* sensor, Callback cb, void* context);
+    /** The callback last set by set_reading_cb(), NULL if none was. */
+    static Callback reading_cb(void* sensor);
+    static UStatus configure(const Backend& backend, void* sensor, const UASensorsRateGovernorConfig* config);
+    static UStatus stats(void* sensor, UASensorsRateGovernorStats* stats);
+
+private:
+    RateGovernor(const Backend& backend, void* sensor);
+
+    /** Returns the governor of the sensor, creating it if asked to. */
+    static RateGovernor* lookup(const Backend* backend, void* sensor);
+    static void on_reading(void* event, void* context);
+
+    void reset_window();
+    /** Feeds a reading to the detector; returns true if the state changed. */
+    bool update(const float values[3], uint64_t timestamp);
+    void switch_state(bool to_idle, uint64_t now);
+    uint32_t wanted_rate() const;
+    UStatus apply_rate(bool force);
+    /** Has the worker call apply_rate() soon. */
+    void schedule_apply_rate();
+    static void run_worker();
+
+    const Backend& backend;
+    void* sensor;
+
+    std::mutex guard;
+    Callback callback;
+    void* context;
+    uint32_t requested_rate; ///< As set by the application, 0 if never set.
+    uint32_t applied_rate; ///< Last rate handed to the backend.
+    bool apply_scheduled; ///< Queued for the worker, guarded by the worker's lock.
+
+    bool governed;
+    UASensorsRateGovernorConfig config;
+
+    // stillness detector over the last config.stillness_window readings
+    std::vector<float> window;
+    size_t window_count;
+    size_t window_next;
+    double sum[3];
+    double sum_squares[3];
+    uint64_t still_since; ///< Timestamp of the first still reading, 0 while moving.
+    float rest[3]; ///< Mean of the readings when idling started.
+    bool idle;
+
+    // statistics, in CLOCK_MONOTONIC [ms]
+    uint64_t state_since;
+    uint64_t active_time;
+    uint64_t idle_time;
+    uint32_t transitions;
+
+protected:
+    RateGovernor(const RateGovernor&) = delete;
+    RateGovernor& operator=(const RateGovernor&) = delete;
+};
+}
+}
+}
+
+#endif // UBUNTU_APPLICATION_SENSORS_RATE_GOVERNOR_PRIVATE_H_
@@ -148,6 +148,35 @@ UStatus ua_sensors_haptic_vibrate_with_pattern(UASensorsHaptic*, uint32_t*, uint
     return U_STATUS_ERROR;
 }
 
+UStatus ua_sensors_haptic_vibrate_once_async(UASensorsHaptic*, uint32_t, UASensorsHapticCompletionCallback, void*)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_sensors_haptic_vibrate_with_pattern_async(UASensorsHaptic*, uint32_t*, uint32_t, UASensorsHapticCompletionCallback, void*)
+{
+    return U_STATUS_ERROR;
+}
+
+UASensorsHapticPattern* ua_sensors_haptic_pattern_new(const uint32_t*, uint32_t, uint32_t)
+{
+    return NULL;
+}
+
+void ua_sensors_haptic_pattern_destroy(UASensorsHapticPattern*)
+{
+}
+
+UStatus ua_sensors_haptic_vibrate_pattern(UASensorsHaptic*, const UASensorsHapticPattern*, UASensorsHapticCompletionCallback, void*)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_sensors_haptic_set_coalescing_window(UASensorsHaptic*, uint32_t)
+{
+    return U_STATUS_ERROR;
+}
+
 // Location
 void ua_location_service_controller_ref(UALocationServiceController*)
 {
@@ -186,6 +215,34 @@ UStatus ua_location_service_controller_disable_gps(UALocationServiceController*)
     return U_STATUS_ERROR;
 }
 
+UALocationGeofenceSet* ua_location_geofence_set_new()
+{
+    return NULL;
+}
+
+void ua_location_geofence_set_ref(UALocationGeofenceSet*)
+{
+}
+
+void ua_location_geofence_set_unref(UALocationGeofenceSet*)
+{
+}
+
+UStatus ua_location_geofence_set_add(UALocationGeofenceSet*, const UALocationGeofence*)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_location_geofence_set_remove(UALocationGeofenceSet*, uint32_t)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_location_geofence_set_set_transition_handler(UALocationGeofenceSet*, UALocationGeofenceTransitionHandler, void*)
+{
+    return U_STATUS_ERROR;
+}
+
 void ua_location_heading_update_ref(UALocationHeadingUpdate*)
 {
 }
@@ -204,6 +261,11 @@ double ua_location_heading_update_get_heading_in_degree(UALocationHeadingUpdate*
     return 0;
 }
 
+UStatus ua_location_heading_update_read(UALocationHeadingUpdate*, UALocationHeading*)
+{
+    return U_STATUS_ERROR;
+}
+
 void ua_location_position_update_ref(UALocationPositionUpdate*)
 {
 }
@@ -237,6 +299,11 @@ double ua_location_position_update_get_altitude_in_meter(UALocationPositionUpdat
     return 0;
 }
 
+UStatus ua_location_position_update_read(UALocationPositionUpdate*, UALocationPosition*)
+{
+    return U_STATUS_ERROR;
+}
+
 UALocationServiceSession* ua_location_service_create_session_for_low_accuracy(UALocationServiceRequirementsFlags)
 {
     return NULL;
@@ -247,6 +314,15 @@ UALocationServiceSession* ua_location_service_create_session_for_high_accuracy(U
     return NULL;
 }
 
+UALocationServiceSessionRequest* ua_location_service_create_session_async(UALocationServiceRequirementsFlags, UALocationServiceSessionCreatedHandler, void*)
+{
+    return NULL;
+}
+
+void ua_location_service_session_request_destroy(UALocationServiceSessionRequest*)
+{
+}
+
 UALocationServiceController* ua_location_service_create_controller()
 {
     return NULL;
@@ -272,6 +348,65 @@ void ua_location_service_session_set_velocity_updates_handler(UALocationServiceS
 {
 }
 
+UStatus ua_location_service_session_set_position_filter(UALocationServiceSession*, double, uint32_t)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_location_service_session_set_adaptive_position_interval(UALocationServiceSession*, uint32_t, uint32_t, uint32_t)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_location_service_session_set_fix_handler(UALocationServiceSession*, UALocationServiceSessionFixHandler, uint32_t, void*)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_location_service_session_set_geofence_set(UALocationServiceSession*, UALocationGeofenceSet*)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_location_service_session_set_history_capacity(UALocationServiceSession*, uint32_t)
+{
+    return U_STATUS_ERROR;
+}
+
+uint32_t ua_location_service_session_get_history(UALocationServiceSession*, uint64_t, UALocationPosition*, uint32_t)
+{
+    return 0;
+}
+
+UStatus ua_location_service_session_get_nearest_fix(UALocationServiceSession*, uint64_t, UALocationPosition*)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_location_service_session_set_position_smoothing(UALocationServiceSession*, double)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_location_service_session_start_dead_reckoning(UALocationServiceSession*, uint32_t, UALocationServiceSessionFixHandler, void*)
+{
+    return U_STATUS_ERROR;
+}
+
+void ua_location_service_session_stop_dead_reckoning(UALocationServiceSession*)
+{
+}
+
+UStatus ua_location_service_session_set_heading_filter(UALocationServiceSession*, double)
+{
+    return U_STATUS_ERROR;
+}
+
+UStatus ua_location_service_session_set_velocity_filter(UALocationServiceSession*, double)
+{
+    return U_STATUS_ERROR;
+}
+
 UStatus ua_location_service_session_start_position_updates(UALocationServiceSession*)
 {
     return U_STATUS_ERROR;
@@ -317,6 +452,11 @@ double ua_location_velocity_update_get_velocity_in_meters_per_second(UALocationV
     return 0;
 }
 
+UStatus ua_location_velocity_update_read(UALocationVelocityUpdate*, UALocationVelocity*)
+{
+    return U_STATUS_ERROR;
+}
+
 // URL Dispatcher
 
 UAUrlDispatcherSession* ua_url_dispatcher_session()
@@ -30,6 +30,8 @@
 #include <ubuntu/application/sensors/gyroscope.h>
 #include <ubuntu/application/sensors/magnetic.h>
 
+#include <private/application/sensors/sensor_recording.h>
+
 #include <cstddef>
 #include <cstdlib>
 #include <cstring>
@@ -41,6 +43,7 @@
 #include <stdexcept>
 #include <chrono>
 #include <map>
+#include <set>
 #include <memory>
 #include <mutex>
 #include <condition_variable>
@@ -48,6 +51,8 @@
 
 using namespace std;
 
+namespace recording = ubuntu::application::sensors::recording;
+
 // necessary for functions that return float
 // pcs attribute (calling convention) is only defined on ARM, avoid warning on
 // other platforms
@@ -127,6 +132,11 @@ class SensorController
     // Return TestSensor of given type, or NULL if it doesn't exist
     TestSensor* get(ubuntu_sensor_type type, bool no_block = false)
     {
+        if (!no_block && replay) {
+            lock_guard<mutex> lk(mtx);
+            if (sensors.count(type) > 0)
+                requested.insert(type);
+        }
         if (!no_block && dynamic) {
             unique_lock<mutex> lk(create_mtx);
             create_cv.wait(lk, [this, type]{
@@ -146,9 +156,15 @@ class SensorController
         }
     }
 
+    // Start replaying a recording once all requested sensors are enabled and
+    // have a callback
+    void sensor_changed();
+
   private:
     SensorController();
     ~SensorController();
+    void setup_replay(const char* path);
+    void replay_events();
     bool fifo_take_command();
     bool next_command();
     bool process_create_command();
@@ -181,6 +197,24 @@ class SensorController
         return "ERROR_TYPE";
     }
 
+    static ubuntu_sensor_type type_from_recorded(ubuntu::application::sensors::SensorType type)
+    {
+        switch (type) {
+            case ubuntu::application::sensors::sensor_type_accelerometer:
+                return ubuntu_sensor_type_accelerometer;
+            case ubuntu::application::sensors::sensor_type_magnetic_field:
+                return ubuntu_sensor_type_magnetic_field;
+            case ubuntu::application::sensors::sensor_type_gyroscope:
+                return ubuntu_sensor_type_gyroscope;
+            case ubuntu::application::sensors::sensor_type_light:
+                return ubuntu_sensor_type_light;
+            case ubuntu::application::sensors::sensor_type_proximity:
+                return ubuntu_sensor_type_proximity;
+            default:
+                return undefined_sensor_type;
+        }
+    }
+
     map<ubuntu_sensor_type, shared_ptr<TestSensor>> sensors;
     ifstream data;
     bool dynamic;
@@ -194,6 +228,14 @@ class SensorController
     mutex create_mtx;
     bool exit;
 
+    // replay of a binary recording
+    bool replay;
+    bool replay_fast;
+    bool replay_started;
+    recording::Reader recorded;
+    set<ubuntu_sensor_type> requested;
+    condition_variable replay_cv;
+
     // current command/event
     string current_command;
     TestSensor* event_sensor;
@@ -205,8 +247,17 @@ SensorController::SensorController()
     : dynamic(true),
       fifo_fd(-1),
       block(false),
-      exit(false)
-{
+      exit(false),
+      replay(false),
+      replay_fast(false),
+      replay_started(false)
+{
+    const char* replay_path = getenv("UBUNTU_PLATFORM_API_SENSOR_REPLAY");
+    if (replay_path != NULL) {
+        setup_replay(replay_path);
+        return;
+    }
+
     const char* path = getenv("UBUNTU_PLATFORM_API_SENSOR_TEST");
     if (path != NULL)
         dynamic = false;
@@ -265,7 +316,15 @@ SensorController::SensorController()
 
 SensorController::~SensorController()
 {
-    if (dynamic) {
+    if (replay) {
+        {
+            lock_guard<mutex> lk(mtx);
+            exit = true;
+        }
+        replay_cv.notify_all();
+        if (worker.joinable())
+            worker.join();
+    } else if (dynamic) {
         exit = true;
         if (worker.joinable())
             worker.join();
@@ -274,6 +333,96 @@ SensorController::~SensorController()
     }
 }
 
+void
+SensorController::setup_replay(const char* path)
+{
+    dynamic = false;
+    replay = true;
+
+    if (!recorded.open(path)) {
+        cerr << "TestSensor ERROR: Failed to open sensor recording " << path << endl;
+        abort();
+    }
+
+    const char* mode = getenv("UBUNTU_PLATFORM_API_SENSOR_REPLAY_MODE");
+    replay_fast = mode != NULL && string(mode) == "fast";
+
+    for (int i = 0; i < recording::max_sensors; i++) {
+        auto recorded_type = static_cast<ubuntu::application::sensors::SensorType>(i);
+        ubuntu_sensor_type type = type_from_recorded(recorded_type);
+        recording::SensorEntry entry;
+
+        if (type == undefined_sensor_type || !recorded.sensor(recorded_type, entry))
+            continue;
+
+        sensors[type] = make_shared<TestSensor>(type, entry.min_value, entry.max_value, entry.resolution);
+        sensors[type]->min_delay = entry.min_delay;
+    }
+
+    cout << "TestSensor INFO: Setup for REPLAY " << (replay_fast ? "as fast as possible" : "in real time")
+         << " of recording " << path << endl;
+}
+
+void
+SensorController::sensor_changed()
+{
+    if (!replay)
+        return;
+
+    lock_guard<mutex> lk(mtx);
+    if (replay_started || requested.empty())
+        return;
+
+    for (auto type : requested) {
+        TestSensor* sensor = sensors[type].get();
+        if (!sensor->enabled || sensor->on_event_cb == NULL)
+            return;
+    }
+
+    replay_started = true;
+    worker = thread(&SensorController::replay_events, this);
+}
+
+void
+SensorController::replay_events()
+{
+    auto start = chrono::steady_clock::now();
+    int64_t first_timestamp = recorded.start_timestamp();
+    recording::Sample sample;
+
+    while (recorded.next(sample)) {
+        if (!replay_fast) {
+            unique_lock<mutex> lk(mtx);
+            auto due = start + chrono::nanoseconds(sample.timestamp - first_timestamp);
+            if (replay_cv.wait_until(lk, due, [this] { return exit; }))
+                return;
+        } else if (exit) {
+            return;
+        }
+
+        auto it = sensors.find(type_from_recorded(sample.type));
+        if (it == sensors.end() || !it->second->enabled)
+            continue;
+
+        TestSensor* sensor = it->second.get();
+        if (sensor->type == ubuntu_sensor_type_proximity) {
+            // like the Android backend, only the maximum distance means "far"
+            sensor->distance = sample.values[0] >= sensor->max_value ? U_PROXIMITY_FAR : U_PROXIMITY_NEAR;
+        } else {
+            sensor->x = sample.values[0];
+            if (sample.value_count == 3) {
+                sensor->y = sample.values[1];
+                sensor->z = sample.values[2];
+            }
+        }
+        // keep the recorded timestamps, they carry the original timing
+        sensor->timestamp = sample.timestamp;
+
+        if (sensor->on_event_cb != NULL)
+            sensor->on_event_cb(sensor, sensor->event_cb_context);
+    }
+}
+
 bool
 SensorController::fifo_take_command()
 {
@@ -516,6 +665,7 @@ UASensorsAccelerometer* ua_sensors_accelerometer_new()
 UStatus ua_sensors_accelerometer_enable(UASensorsAccelerometer* s)
 {
     static_cast<TestSensor*>(s)->enabled = true;
+    SensorController::instance().sensor_changed();
     return (UStatus) 0;
 }
 
@@ -570,6 +720,7 @@ void ua_sensors_accelerometer_set_reading_cb(UASensorsAccelerometer* s, on_accel
     TestSensor* sensor = static_cast<TestSensor*>(s);
     sensor->on_event_cb = cb;
     sensor->event_cb_context = ctx;
+    SensorController::instance().sensor_changed();
 }
 
 uint64_t uas_accelerometer_event_get_timestamp(UASAccelerometerEvent* e)
@@ -621,6 +772,7 @@ UASensorsProximity* ua_sensors_proximity_new()
 UStatus ua_sensors_proximity_enable(UASensorsProximity* s)
 {
     static_cast<TestSensor*>(s)->enabled = true;
+    SensorController::instance().sensor_changed();
     return (UStatus) 0;
 }
 
@@ -676,6 +828,7 @@ void ua_sensors_proximity_set_reading_cb(UASensorsProximity* s, on_proximity_eve
     TestSensor* sensor = static_cast<TestSensor*>(s);
     sensor->on_event_cb = cb;
     sensor->event_cb_context = ctx;
+    SensorController::instance().sensor_changed();
 }
 
 uint64_t uas_proximity_event_get_timestamp(UASProximityEvent* e)
@@ -703,6 +856,7 @@ UASensorsLight* ua_sensors_light_new()
 UStatus ua_sensors_light_enable(UASensorsLight* s)
 {
     static_cast<TestSensor*>(s)->enabled = true;
+    SensorController::instance().sensor_changed();
     return (UStatus) 0;
 }
 
@@ -757,6 +911,7 @@ void ua_sensors_light_set_reading_cb(UASensorsLight* s, on_light_event_cb cb, vo
     TestSensor* sensor = static_cast<TestSensor*>(s);
     sensor->on_event_cb = cb;
     sensor->event_cb_context = ctx;
+    SensorController::instance().sensor_changed();
 }
 
 uint64_t uas_light_event_get_timestamp(UASLightEvent* e)
@@ -883,13 +1038,15 @@ UASensorsGyroscope* ua_sensors_gyroscope_new()
 UStatus ua_sensors_gyroscope_enable(UASensorsGyroscope* s)
 {
     static_cast<TestSensor*>(s)->enabled = true;
+    SensorController::instance().sensor_changed();
     return (UStatus) 0;
 }
 
 UStatus ua_sensors_gyroscope_disable(UASensorsGyroscope* s)
 {
-    static_cast<TestSensor*>(s)->enabled = true;
-    return (UStatus) 0;}
+    static_cast<TestSensor*>(s)->enabled = false;
+    return (UStatus) 0;
+}
 
 uint32_t ua_sensors_gyroscope_get_min_delay(UASensorsGyroscope* s)
 {
@@ -931,6 +1088,7 @@ void ua_sensors_gyroscope_set_reading_cb(UASensorsGyroscope* s, on_gyroscope_eve
     TestSensor* sensor = static_cast<TestSensor*>(s);
     sensor->on_event_cb = cb;
     sensor->event_cb_context = ctx;
+    SensorController::instance().sensor_changed();
 }
 
 UStatus ua_sensors_gyroscope_set_event_rate(UASensorsGyroscope*, uint32_t)
@@ -939,37 +1097,37 @@ UStatus ua_sensors_gyroscope_set_event_rate(UASensorsGyroscope*, uint32_t)
 }
 
 // Gyroscope Sensor Event
-uint64_t uas_gyroscope_event_get_timestamp(UASGyroscopeEvent*)
+uint64_t uas_gyroscope_event_get_timestamp(UASGyroscopeEvent* e)
 {
-    return 0;
+    return static_cast<TestSensor*>(e)->timestamp;
 }
 
-UStatus uas_gyroscope_event_get_rate_of_rotation_around_x(UASGyroscopeEvent*, float* value)
+UStatus uas_gyroscope_event_get_rate_of_rotation_around_x(UASGyroscopeEvent* e, float* value)
 {
     if (!value)
         return U_STATUS_ERROR;
 
-    *value = 0.f;
+    *value = static_cast<TestSensor*>(e)->x;
 
     return U_STATUS_SUCCESS;
 }
 
-UStatus uas_gyroscope_event_get_rate_of_rotation_around_y(UASGyroscopeEvent*, float* value)
+UStatus uas_gyroscope_event_get_rate_of_rotation_around_y(UASGyroscopeEvent* e, float* value)
 {
     if (!value)
         return U_STATUS_ERROR;
 
-    *value = 0.f;
+    *value = static_cast<TestSensor*>(e)->y;
 
     return U_STATUS_SUCCESS;
 }
 
-UStatus uas_gyroscope_event_get_rate_of_rotation_around_z(UASGyroscopeEvent*, float* value)
+UStatus uas_gyroscope_event_get_rate_of_rotation_around_z(UASGyroscopeEvent* e, float* value)
 {
     if (!value)
         return U_STATUS_ERROR;
 
-    *value = 0.f;
+    *value = static_cast<TestSensor*>(e)->z;
 
     return U_STATUS_SUCCESS;
 }
@@ -988,6 +1146,7 @@ UASensorsMagnetic* ua_sensors_magnetic_new()
 UStatus ua_sensors_magnetic_enable(UASensorsMagnetic* s)
 {
     static_cast<TestSensor*>(s)->enabled = true;
+    SensorController::instance().sensor_changed();
     return (UStatus) 0;
 }
 
@@ -1042,6 +1201,7 @@ void ua_sensors_magnetic_set_reading_cb(UASensorsMagnetic* s, on_magnetic_event_
     TestSensor* sensor = static_cast<TestSensor*>(s);
     sensor->on_event_cb = cb;
     sensor->event_cb_context = ctx;
+    SensorController::instance().sensor_changed();
 }
 
 uint64_t uas_magnetic_event_get_timestamp(UASAccelerometerEvent* e)
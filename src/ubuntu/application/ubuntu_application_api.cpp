@@ -43,6 +43,65 @@
 #include <ubuntu/application/init.h>
 
 #include "base_module.h"
+#include "rate_governor.h"
+
+namespace
+{
+// The motion sensors are routed through the rate governor, which needs the
+// backend's own entry points next to the event accessors of the bridge.
+const ubuntu::application::sensors::RateGovernor::Backend& accelerometer_backend()
+{
+    static ubuntu::application::sensors::RateGovernor::Backend backend = []()
+    {
+        ubuntu::application::sensors::RateGovernor::Backend b = ubuntu::application::sensors::RateGovernor::Backend();
+        DLSYM(&b.set_event_rate, "ua_sensors_accelerometer_set_event_rate", "sensors");
+        DLSYM(&b.set_reading_cb, "ua_sensors_accelerometer_set_reading_cb", "sensors");
+        b.read_timestamp = uas_accelerometer_event_get_timestamp;
+        b.read_axis[0] = uas_accelerometer_event_get_acceleration_x;
+        b.read_axis[1] = uas_accelerometer_event_get_acceleration_y;
+        b.read_axis[2] = uas_accelerometer_event_get_acceleration_z;
+        b.default_stillness_variance = 0.01f; // (m/s^2)^2
+        b.default_motion_threshold = 0.5f; // m/s^2
+        return b;
+    }();
+    return backend;
+}
+
+const ubuntu::application::sensors::RateGovernor::Backend& gyroscope_backend()
+{
+    static ubuntu::application::sensors::RateGovernor::Backend backend = []()
+    {
+        ubuntu::application::sensors::RateGovernor::Backend b = ubuntu::application::sensors::RateGovernor::Backend();
+        DLSYM(&b.set_event_rate, "ua_sensors_gyroscope_set_event_rate", "sensors");
+        DLSYM(&b.set_reading_cb, "ua_sensors_gyroscope_set_reading_cb", "sensors");
+        b.read_timestamp = uas_gyroscope_event_get_timestamp;
+        b.read_axis[0] = uas_gyroscope_event_get_rate_of_rotation_around_x;
+        b.read_axis[1] = uas_gyroscope_event_get_rate_of_rotation_around_y;
+        b.read_axis[2] = uas_gyroscope_event_get_rate_of_rotation_around_z;
+        b.default_stillness_variance = 0.0005f; // (rad/s)^2
+        b.default_motion_threshold = 0.1f; // rad/s
+        return b;
+    }();
+    return backend;
+}
+
+// Not governed, passing through only keeps track of its callback.
+const ubuntu::application::sensors::RateGovernor::Backend& magnetic_backend()
+{
+    static ubuntu::application::sensors::RateGovernor::Backend backend = []()
+    {
+        ubuntu::application::sensors::RateGovernor::Backend b = ubuntu::application::sensors::RateGovernor::Backend();
+        DLSYM(&b.set_event_rate, "ua_sensors_magnetic_set_event_rate", "sensors");
+        DLSYM(&b.set_reading_cb, "ua_sensors_magnetic_set_reading_cb", "sensors");
+        b.read_timestamp = uas_magnetic_event_get_timestamp;
+        b.read_axis[0] = uas_magnetic_event_get_magnetic_field_x;
+        b.read_axis[1] = uas_magnetic_event_get_magnetic_field_y;
+        b.read_axis[2] = uas_magnetic_event_get_magnetic_field_z;
+        return b;
+    }();
+    return backend;
+}
+}
 
 #ifdef __cplusplus
 extern "C" {
@@ -92,8 +151,31 @@ IMPLEMENT_FUNCTION1(sensors, uint32_t, ua_sensors_accelerometer_get_min_delay, U
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_accelerometer_get_min_value, UASensorsAccelerometer*, float*);
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_accelerometer_get_max_value, UASensorsAccelerometer*, float*);
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_accelerometer_get_resolution, UASensorsAccelerometer*, float*);
-IMPLEMENT_VOID_FUNCTION3(sensors, ua_sensors_accelerometer_set_reading_cb, UASensorsAccelerometer*, on_accelerometer_event_cb, void*);
-IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_accelerometer_set_event_rate, UASensorsAccelerometer*, uint32_t);
+
+void ua_sensors_accelerometer_set_reading_cb(UASensorsAccelerometer* s, on_accelerometer_event_cb cb, void* ctx)
+{
+    ubuntu::application::sensors::RateGovernor::set_reading_cb(accelerometer_backend(), s, cb, ctx);
+}
+
+on_accelerometer_event_cb ua_sensors_accelerometer_get_reading_cb(UASensorsAccelerometer* s)
+{
+    return ubuntu::application::sensors::RateGovernor::reading_cb(s);
+}
+
+UStatus ua_sensors_accelerometer_set_event_rate(UASensorsAccelerometer* s, uint32_t rate)
+{
+    return ubuntu::application::sensors::RateGovernor::set_event_rate(accelerometer_backend(), s, rate);
+}
+
+UStatus ua_sensors_accelerometer_set_rate_governor(UASensorsAccelerometer* s, const UASensorsRateGovernorConfig* config)
+{
+    return ubuntu::application::sensors::RateGovernor::configure(accelerometer_backend(), s, config);
+}
+
+UStatus ua_sensors_accelerometer_get_rate_governor_stats(UASensorsAccelerometer* s, UASensorsRateGovernorStats* stats)
+{
+    return ubuntu::application::sensors::RateGovernor::stats(s, stats);
+}
 
 // Acceleration Sensor Event
 IMPLEMENT_FUNCTION1(sensors, uint64_t, uas_accelerometer_event_get_timestamp, UASAccelerometerEvent*);
@@ -138,6 +220,12 @@ IMPLEMENT_FUNCTION1(sensors, UStatus, ua_sensors_haptic_enable, UASensorsHaptic*
 IMPLEMENT_FUNCTION1(sensors, UStatus, ua_sensors_haptic_disable, UASensorsHaptic*);
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_haptic_vibrate_once, UASensorsHaptic*, uint32_t);
 IMPLEMENT_FUNCTION3(sensors, UStatus, ua_sensors_haptic_vibrate_with_pattern, UASensorsHaptic*, uint32_t*, uint32_t);
+IMPLEMENT_FUNCTION4(sensors, UStatus, ua_sensors_haptic_vibrate_once_async, UASensorsHaptic*, uint32_t, UASensorsHapticCompletionCallback, void*);
+IMPLEMENT_FUNCTION5(sensors, UStatus, ua_sensors_haptic_vibrate_with_pattern_async, UASensorsHaptic*, uint32_t*, uint32_t, UASensorsHapticCompletionCallback, void*);
+IMPLEMENT_FUNCTION3(sensors, UASensorsHapticPattern*, ua_sensors_haptic_pattern_new, const uint32_t*, uint32_t, uint32_t);
+IMPLEMENT_VOID_FUNCTION1(sensors, ua_sensors_haptic_pattern_destroy, UASensorsHapticPattern*);
+IMPLEMENT_FUNCTION4(sensors, UStatus, ua_sensors_haptic_vibrate_pattern, UASensorsHaptic*, const UASensorsHapticPattern*, UASensorsHapticCompletionCallback, void*);
+IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_haptic_set_coalescing_window, UASensorsHaptic*, uint32_t);
 
 // Orientation Sensor
 IMPLEMENT_CTOR0(sensors, UASensorsOrientation*, ua_sensors_orientation_new);
@@ -164,8 +252,31 @@ IMPLEMENT_FUNCTION1(sensors, uint32_t, ua_sensors_gyroscope_get_min_delay, UASen
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_gyroscope_get_min_value, UASensorsGyroscope*, float*);
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_gyroscope_get_max_value, UASensorsGyroscope*, float*);
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_gyroscope_get_resolution, UASensorsGyroscope*, float*);
-IMPLEMENT_VOID_FUNCTION3(sensors, ua_sensors_gyroscope_set_reading_cb, UASensorsGyroscope*, on_gyroscope_event_cb, void*);
-IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_gyroscope_set_event_rate, UASensorsGyroscope*, uint32_t);
+
+void ua_sensors_gyroscope_set_reading_cb(UASensorsGyroscope* s, on_gyroscope_event_cb cb, void* ctx)
+{
+    ubuntu::application::sensors::RateGovernor::set_reading_cb(gyroscope_backend(), s, cb, ctx);
+}
+
+on_gyroscope_event_cb ua_sensors_gyroscope_get_reading_cb(UASensorsGyroscope* s)
+{
+    return ubuntu::application::sensors::RateGovernor::reading_cb(s);
+}
+
+UStatus ua_sensors_gyroscope_set_event_rate(UASensorsGyroscope* s, uint32_t rate)
+{
+    return ubuntu::application::sensors::RateGovernor::set_event_rate(gyroscope_backend(), s, rate);
+}
+
+UStatus ua_sensors_gyroscope_set_rate_governor(UASensorsGyroscope* s, const UASensorsRateGovernorConfig* config)
+{
+    return ubuntu::application::sensors::RateGovernor::configure(gyroscope_backend(), s, config);
+}
+
+UStatus ua_sensors_gyroscope_get_rate_governor_stats(UASensorsGyroscope* s, UASensorsRateGovernorStats* stats)
+{
+    return ubuntu::application::sensors::RateGovernor::stats(s, stats);
+}
 
 // Gyroscope Sensor Event
 IMPLEMENT_FUNCTION1(sensors, uint64_t, uas_gyroscope_event_get_timestamp, UASGyroscopeEvent*);
@@ -181,8 +292,21 @@ IMPLEMENT_FUNCTION1(sensors, uint32_t, ua_sensors_magnetic_get_min_delay, UASens
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_magnetic_get_min_value, UASensorsMagnetic*, float*);
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_magnetic_get_max_value, UASensorsMagnetic*, float*);
 IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_magnetic_get_resolution, UASensorsMagnetic*, float*);
-IMPLEMENT_VOID_FUNCTION3(sensors, ua_sensors_magnetic_set_reading_cb, UASensorsMagnetic*, on_magnetic_event_cb, void*);
-IMPLEMENT_FUNCTION2(sensors, UStatus, ua_sensors_magnetic_set_event_rate, UASensorsMagnetic*, uint32_t);
+
+void ua_sensors_magnetic_set_reading_cb(UASensorsMagnetic* s, on_magnetic_event_cb cb, void* ctx)
+{
+    ubuntu::application::sensors::RateGovernor::set_reading_cb(magnetic_backend(), s, cb, ctx);
+}
+
+on_magnetic_event_cb ua_sensors_magnetic_get_reading_cb(UASensorsMagnetic* s)
+{
+    return ubuntu::application::sensors::RateGovernor::reading_cb(s);
+}
+
+UStatus ua_sensors_magnetic_set_event_rate(UASensorsMagnetic* s, uint32_t rate)
+{
+    return ubuntu::application::sensors::RateGovernor::set_event_rate(magnetic_backend(), s, rate);
+}
 
 // Magnetic Field Sensor Event
 IMPLEMENT_FUNCTION1(sensors, uint64_t, uas_magnetic_event_get_timestamp, UASMagneticEvent*);
@@ -231,10 +355,17 @@ IMPLEMENT_FUNCTION1(location, UStatus, ua_location_service_controller_enable_ser
 IMPLEMENT_FUNCTION1(location, UStatus, ua_location_service_controller_disable_service, UALocationServiceController*);
 IMPLEMENT_FUNCTION1(location, UStatus, ua_location_service_controller_enable_gps, UALocationServiceController*);
 IMPLEMENT_FUNCTION1(location, UStatus, ua_location_service_controller_disable_gps, UALocationServiceController*);
+IMPLEMENT_CTOR0(location, UALocationGeofenceSet*, ua_location_geofence_set_new);
+IMPLEMENT_VOID_FUNCTION1(location, ua_location_geofence_set_ref, UALocationGeofenceSet*);
+IMPLEMENT_VOID_FUNCTION1(location, ua_location_geofence_set_unref, UALocationGeofenceSet*);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_geofence_set_add, UALocationGeofenceSet*, const UALocationGeofence*);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_geofence_set_remove, UALocationGeofenceSet*, uint32_t);
+IMPLEMENT_FUNCTION3(location, UStatus, ua_location_geofence_set_set_transition_handler, UALocationGeofenceSet*, UALocationGeofenceTransitionHandler, void*);
 IMPLEMENT_VOID_FUNCTION1(location, ua_location_heading_update_ref, UALocationHeadingUpdate*);
 IMPLEMENT_VOID_FUNCTION1(location, ua_location_heading_update_unref, UALocationHeadingUpdate*);
 IMPLEMENT_FUNCTION1(location, uint64_t, ua_location_heading_update_get_timestamp, UALocationHeadingUpdate*);
 IMPLEMENT_FUNCTION1(location, double, ua_location_heading_update_get_heading_in_degree, UALocationHeadingUpdate*);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_heading_update_read, UALocationHeadingUpdate*, UALocationHeading*);
 IMPLEMENT_VOID_FUNCTION1(location, ua_location_position_update_ref, UALocationPositionUpdate*);
 IMPLEMENT_VOID_FUNCTION1(location, ua_location_position_update_unref, UALocationPositionUpdate*);
 IMPLEMENT_FUNCTION1(location, uint64_t, ua_location_position_update_get_timestamp, UALocationPositionUpdate*);
@@ -246,16 +377,31 @@ IMPLEMENT_FUNCTION1(location, bool, ua_location_position_update_has_horizontal_a
 IMPLEMENT_FUNCTION1(location, double, ua_location_position_update_get_horizontal_accuracy_in_meter, UALocationPositionUpdate*);
 IMPLEMENT_FUNCTION1(location, bool, ua_location_position_update_has_vertical_accuracy, UALocationPositionUpdate*);
 IMPLEMENT_FUNCTION1(location, double, ua_location_position_update_get_vertical_accuracy_in_meter, UALocationPositionUpdate*);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_position_update_read, UALocationPositionUpdate*, UALocationPosition*);
 IMPLEMENT_FUNCTION1(location, UALocationServiceSession*, ua_location_service_create_session_for_low_accuracy, UALocationServiceRequirementsFlags);
 IMPLEMENT_FUNCTION2(location, UALocationServiceSession*, ua_location_service_try_create_session_for_low_accuracy, UALocationServiceRequirementsFlags, UALocationServiceError*);
 IMPLEMENT_FUNCTION1(location, UALocationServiceSession*, ua_location_service_create_session_for_high_accuracy, UALocationServiceRequirementsFlags);
 IMPLEMENT_FUNCTION2(location, UALocationServiceSession*, ua_location_service_try_create_session_for_high_accuracy, UALocationServiceRequirementsFlags, UALocationServiceError*);
+IMPLEMENT_FUNCTION3(location, UALocationServiceSessionRequest*, ua_location_service_create_session_async, UALocationServiceRequirementsFlags, UALocationServiceSessionCreatedHandler, void*);
+IMPLEMENT_VOID_FUNCTION1(location, ua_location_service_session_request_destroy, UALocationServiceSessionRequest*);
 IMPLEMENT_CTOR0(location, UALocationServiceController*, ua_location_service_create_controller);
 IMPLEMENT_VOID_FUNCTION1(location, ua_location_service_session_ref, UALocationServiceSession*);
 IMPLEMENT_VOID_FUNCTION1(location, ua_location_service_session_unref, UALocationServiceSession*);
 IMPLEMENT_VOID_FUNCTION3(location, ua_location_service_session_set_position_updates_handler, UALocationServiceSession*, UALocationServiceSessionPositionUpdatesHandler, void*);
 IMPLEMENT_VOID_FUNCTION3(location, ua_location_service_session_set_heading_updates_handler, UALocationServiceSession*, UALocationServiceSessionHeadingUpdatesHandler, void*);
 IMPLEMENT_VOID_FUNCTION3(location, ua_location_service_session_set_velocity_updates_handler, UALocationServiceSession*, UALocationServiceSessionVelocityUpdatesHandler, void*);
+IMPLEMENT_FUNCTION4(location, UStatus, ua_location_service_session_set_adaptive_position_interval, UALocationServiceSession*, uint32_t, uint32_t, uint32_t);
+IMPLEMENT_FUNCTION3(location, UStatus, ua_location_service_session_set_position_filter, UALocationServiceSession*, double, uint32_t);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_service_session_set_history_capacity, UALocationServiceSession*, uint32_t);
+IMPLEMENT_FUNCTION4(location, uint32_t, ua_location_service_session_get_history, UALocationServiceSession*, uint64_t, UALocationPosition*, uint32_t);
+IMPLEMENT_FUNCTION3(location, UStatus, ua_location_service_session_get_nearest_fix, UALocationServiceSession*, uint64_t, UALocationPosition*);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_service_session_set_position_smoothing, UALocationServiceSession*, double);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_service_session_set_heading_filter, UALocationServiceSession*, double);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_service_session_set_velocity_filter, UALocationServiceSession*, double);
+IMPLEMENT_FUNCTION4(location, UStatus, ua_location_service_session_set_fix_handler, UALocationServiceSession*, UALocationServiceSessionFixHandler, uint32_t, void*);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_service_session_set_geofence_set, UALocationServiceSession*, UALocationGeofenceSet*);
+IMPLEMENT_FUNCTION4(location, UStatus, ua_location_service_session_start_dead_reckoning, UALocationServiceSession*, uint32_t, UALocationServiceSessionFixHandler, void*);
+IMPLEMENT_VOID_FUNCTION1(location, ua_location_service_session_stop_dead_reckoning, UALocationServiceSession*);
 IMPLEMENT_FUNCTION1(location, UStatus, ua_location_service_session_start_position_updates, UALocationServiceSession*);
 IMPLEMENT_VOID_FUNCTION1(location, ua_location_service_session_stop_position_updates, UALocationServiceSession*);
 IMPLEMENT_FUNCTION1(location, UStatus, ua_location_service_session_start_heading_updates, UALocationServiceSession*);
@@ -266,6 +412,7 @@ IMPLEMENT_VOID_FUNCTION1(location, ua_location_velocity_update_ref, UALocationVe
 IMPLEMENT_VOID_FUNCTION1(location, ua_location_velocity_update_unref, UALocationVelocityUpdate*);
 IMPLEMENT_FUNCTION1(location, uint64_t, ua_location_velocity_update_get_timestamp, UALocationVelocityUpdate*);
 IMPLEMENT_FUNCTION1(location, double, ua_location_velocity_update_get_velocity_in_meters_per_second, UALocationVelocityUpdate*);
+IMPLEMENT_FUNCTION2(location, UStatus, ua_location_velocity_update_read, UALocationVelocityUpdate*, UALocationVelocity*);
 
 // URL Dispatcher
 
@@ -80,6 +80,24 @@ void gps_nmea_cb(int64_t timestamp, const char* nmea, int length, void* context)
     printf("gps_nmea_cb() - %s\n", str);
 }
 
+void gps_parsed_nmea_cb(int64_t timestamp, const UHardwareGpsNmeaSentence* sentence, void* context)
+{
+    switch (sentence->type)
+    {
+    case U_HARDWARE_GPS_NMEA_GGA:
+        printf("gps_parsed_nmea_cb() - %sGGA quality %d, %f, %f, %d satellites\n",
+               sentence->talker, sentence->u.gga.quality, sentence->u.gga.latitude,
+               sentence->u.gga.longitude, sentence->u.gga.satellites_in_use);
+        break;
+    case U_HARDWARE_GPS_NMEA_GSV:
+        printf("gps_parsed_nmea_cb() - %sGSV %d satellites in view\n",
+               sentence->talker, sentence->u.gsv.satellites_in_view);
+        break;
+    default:
+        break;
+    }
+}
+
 void gps_set_cabapilities_cb(uint32_t capabilities, void* context)
 {
     printf("gps_set_cabapilities_cb() -");
@@ -211,6 +229,8 @@ bool GPSTest::init_and_start(const char* supl_server, uint16_t port)
         return false;
     }
 
+    u_hardware_gps_set_parsed_nmea_callback(u_hardware_gps, gps_parsed_nmea_cb, this);
+
     bool ok = u_hardware_gps_start(u_hardware_gps);
     if (!ok)
     {
@@ -103,6 +103,51 @@ UHardwareGps,
 char*, 
 int);
 
+IMPLEMENT_OPTIONAL_FUNCTION3(
+    int,
+    u_hardware_gps_nmea_parse,
+    0,
+    const char*,
+    int,
+    UHardwareGpsNmeaSentence*);
+
+IMPLEMENT_OPTIONAL_VOID_FUNCTION3(
+    u_hardware_gps_set_parsed_nmea_callback,
+    UHardwareGps,
+    UHardwareGpsParsedNmeaCallback,
+    void*);
+
+IMPLEMENT_OPTIONAL_FUNCTION4(
+    bool,
+    u_hardware_gps_set_dispatch_mode,
+    false,
+    UHardwareGps,
+    UHardwareGpsDispatchMode,
+    uint32_t,
+    UHardwareGpsOverflowPolicy);
+
+IMPLEMENT_OPTIONAL_FUNCTION1(
+    int,
+    u_hardware_gps_get_dispatch_fd,
+    -1,
+    UHardwareGps);
+
+IMPLEMENT_OPTIONAL_FUNCTION1(
+    int,
+    u_hardware_gps_dispatch,
+    0,
+    UHardwareGps);
+
+IMPLEMENT_OPTIONAL_VOID_FUNCTION2(
+    u_hardware_gps_get_dropped_reports,
+    UHardwareGps,
+    UHardwareGpsDroppedReports*);
+
+IMPLEMENT_OPTIONAL_VOID_FUNCTION2(
+    u_hardware_gps_get_time_to_first_fix,
+    UHardwareGps,
+    UHardwareGpsTimeToFirstFix*);
+
 IMPLEMENT_OPTIONAL_FUNCTION0(
     UHardwareBooster*,
     u_hardware_booster_new,
@@ -0,0 +1,282 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the D-Bus paths of the library against the stand-in services of
+ * standin_services.h, running on private session and system buses:
+ *
+ *   - haptic: round trips of ua_sensors_haptic_vibrate_once
+ *   - location: position update latency at a fixed rate, and throughput
+ *     when updates are published as fast as possible
+ *
+ * No system service is needed, run it from the build tree as
+ *
+ *   tests/bench_ua_dbus [benchmark...]
+ */
+
+#include "standin_services.h"
+
+#include <ubuntu/application/sensors/haptic.h>
+#include <ubuntu/application/location/position_update.h>
+#include <ubuntu/application/location/service.h>
+#include <ubuntu/application/location/session.h>
+
+#include <core/dbus/fixture.h>
+
+#include <com/ubuntu/location/position.h>
+#include <com/ubuntu/location/update.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace cul = com::ubuntu::location;
+
+namespace
+{
+const size_t haptic_calls = 5000;
+const size_t haptic_warmup_calls = 100;
+const unsigned location_rate = 1000; // [Hz]
+const size_t location_paced_updates = 2000;
+const size_t location_unpaced_updates = 50000;
+
+struct Environment
+{
+    standin::USensorD* usensord;
+    standin::LocationService* location;
+};
+
+struct Result
+{
+    uint64_t count;
+    uint64_t dropped;
+    double per_second;
+    double p50_latency_us;
+    double p99_latency_us;
+};
+
+int64_t now_ns()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// position updates carry wall clock timestamps
+int64_t wall_clock_us()
+{
+    return chrono::duration_cast<chrono::microseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+}
+
+double percentile(vector<double>& values, double p)
+{
+    if (values.empty())
+        return 0;
+
+    size_t index = min(values.size() - 1, size_t(p * (values.size() - 1) + 0.5));
+    nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+bool wait_for(const function<bool()>& condition, chrono::milliseconds timeout)
+{
+    int64_t deadline = now_ns() + chrono::duration_cast<chrono::nanoseconds>(timeout).count();
+    while (!condition())
+    {
+        if (now_ns() > deadline)
+            return false;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return true;
+}
+
+bool bench_haptic(Environment& env, Result& result)
+{
+    UASensorsHaptic* haptic = ua_sensors_haptic_new();
+    if (haptic == NULL || ua_sensors_haptic_enable(haptic) != U_STATUS_SUCCESS)
+        return false;
+
+    for (size_t i = 0; i < haptic_warmup_calls; i++)
+        ua_sensors_haptic_vibrate_once(haptic, 1);
+
+    vector<double> latencies;
+    latencies.reserve(haptic_calls);
+
+    uint64_t before = env.usensord->vibrations.load();
+    int64_t start = now_ns();
+    for (size_t i = 0; i < haptic_calls; i++)
+    {
+        int64_t call = now_ns();
+        if (ua_sensors_haptic_vibrate_once(haptic, 1) != U_STATUS_SUCCESS)
+            continue;
+        latencies.push_back((now_ns() - call) / 1e3);
+    }
+    int64_t elapsed = now_ns() - start;
+
+    ua_sensors_haptic_destroy(haptic);
+
+    result.count = latencies.size();
+    result.dropped = haptic_calls - (env.usensord->vibrations.load() - before);
+    result.per_second = elapsed > 0 ? latencies.size() / (elapsed / 1e9) : 0;
+    result.p50_latency_us = percentile(latencies, 0.5);
+    result.p99_latency_us = percentile(latencies, 0.99);
+    return true;
+}
+
+/* Arrival bookkeeping of the position handler; preallocated so that
+ * recording an update does not allocate. */
+vector<int64_t> arrivals;
+atomic<size_t> arrival_count(0);
+
+void on_position(UALocationPositionUpdate* update, void*)
+{
+    int64_t latency = wall_clock_us() - int64_t(ua_location_position_update_get_timestamp(update));
+    size_t i = arrival_count.fetch_add(1);
+    if (i < arrivals.size())
+        arrivals[i] = latency;
+}
+
+cul::Update<cul::Position> position_update(size_t i)
+{
+    return cul::Update<cul::Position>
+    {
+        cul::Position
+        {
+            cul::wgs84::Latitude{(i % 90) * cul::units::Degrees},
+            cul::wgs84::Longitude{(i % 180) * cul::units::Degrees}
+        },
+        cul::Clock::now()
+    };
+}
+
+/* Publishes count updates at the given rate, or as fast as possible if it
+ * is 0, and waits for them to arrive. */
+bool bench_location(Environment& env, unsigned rate, size_t count, Result& result)
+{
+    UALocationServiceSession* session = ua_location_service_create_session_for_high_accuracy(0);
+    if (session == NULL)
+        return false;
+
+    arrivals.assign(count, 0);
+    arrival_count = 0;
+
+    ua_location_service_session_set_position_updates_handler(session, on_position, NULL);
+    if (ua_location_service_session_start_position_updates(session) != U_STATUS_SUCCESS ||
+        !wait_for([&env]() { return env.location->active_sessions() > 0; }, chrono::seconds(5)))
+    {
+        ua_location_service_session_unref(session);
+        return false;
+    }
+
+    int64_t period = rate > 0 ? 1000000000LL / rate : 0;
+    int64_t start = now_ns();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (period > 0)
+            this_thread::sleep_until(chrono::steady_clock::time_point(chrono::nanoseconds(start + int64_t(i) * period)));
+        env.location->publish(position_update(i));
+    }
+
+    // with some grace period for stragglers
+    wait_for([count]() { return arrival_count.load() >= count; }, chrono::seconds(2));
+    int64_t elapsed = now_ns() - start;
+
+    ua_location_service_session_stop_position_updates(session);
+    ua_location_service_session_unref(session);
+
+    size_t delivered = min(arrival_count.load(), count);
+    vector<double> latencies(arrivals.begin(), arrivals.begin() + delivered);
+
+    result.count = delivered;
+    result.dropped = count - delivered;
+    result.per_second = elapsed > 0 ? delivered / (elapsed / 1e9) : 0;
+    result.p50_latency_us = percentile(latencies, 0.5);
+    result.p99_latency_us = percentile(latencies, 0.99);
+    return true;
+}
+
+struct Benchmark
+{
+    const char* name;
+    const char* label;
+    bool (*run)(Environment& env, Result& result);
+};
+
+const Benchmark benchmarks[] = {
+    {"haptic", "vibrate_once", bench_haptic},
+    {"location", "position@1kHz", [](Environment& env, Result& result) {
+        return bench_location(env, location_rate, location_paced_updates, result);
+    }},
+    {"location", "position@max", [](Environment& env, Result& result) {
+        return bench_location(env, 0, location_unpaced_updates, result);
+    }}
+};
+}
+
+int main(int argc, char** argv)
+{
+    // private buses, the well-known bus addresses of the process point to them
+    core::dbus::Fixture fixture
+    {
+        core::dbus::Fixture::default_session_bus_config_file(),
+        core::dbus::Fixture::default_system_bus_config_file()
+    };
+
+    standin::Dispatcher session_bus{fixture.create_connection_to_session_bus()};
+    standin::Dispatcher system_bus{fixture.create_connection_to_system_bus()};
+    standin::USensorD usensord{session_bus.bus};
+    standin::LocationService location{system_bus.bus};
+
+    Environment env;
+    env.usensord = &usensord;
+    env.location = &location;
+
+    printf("%-10s %-14s %10s %12s %10s %10s %8s\n",
+           "benchmark", "case", "count", "per second", "p50 us", "p99 us", "dropped");
+    fflush(stdout);
+
+    int ret = 0;
+    for (const Benchmark& benchmark : benchmarks)
+    {
+        if (argc > 1 && find_if(argv + 1, argv + argc, [&benchmark](const char* arg) {
+                return string(arg) == benchmark.name;
+            }) == argv + argc)
+            continue;
+
+        Result result;
+        if (!benchmark.run(env, result))
+        {
+            fprintf(stderr, "%s: %s failed\n", benchmark.name, benchmark.label);
+            ret = 1;
+            continue;
+        }
+
+        printf("%-10s %-14s %10llu %12.0f %10.1f %10.1f %8llu\n",
+               benchmark.name, benchmark.label, (unsigned long long) result.count,
+               result.per_second, result.p50_latency_us, result.p99_latency_us,
+               (unsigned long long) result.dropped);
+        fflush(stdout);
+    }
+
+    return ret;
+}
@@ -0,0 +1,404 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures sensor event delivery through the whole stack (bridge, test
+ * backend and application callback) by replaying generated recordings at
+ * increasing rates and for a growing number of simultaneous sensors.
+ *
+ * Run it like test_ua_sensors_mock, from the build tree:
+ *
+ *   LD_LIBRARY_PATH=src/ubuntu:src/ubuntu/application/testbackend \
+ *       tests/bench_ua_sensors [mode...]
+ *
+ * Every configuration runs in a fresh child process, as the test backend
+ * reads its configuration only once.
+ */
+
+#include <ubuntu/application/sensors/accelerometer.h>
+#include <ubuntu/application/sensors/event/accelerometer.h>
+#include <ubuntu/application/sensors/gyroscope.h>
+#include <ubuntu/application/sensors/event/gyroscope.h>
+#include <ubuntu/application/sensors/magnetic.h>
+#include <ubuntu/application/sensors/event/magnetic.h>
+#include <ubuntu/application/sensors/light.h>
+#include <ubuntu/application/sensors/event/light.h>
+#include <ubuntu/application/sensors/proximity.h>
+#include <ubuntu/application/sensors/event/proximity.h>
+
+#include <private/application/sensors/sensor_recording.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace uas = ubuntu::application::sensors;
+
+namespace
+{
+// rate per sensor in Hz, 0 replays as fast as possible
+const unsigned rates[] = {100, 1000, 10000, 50000, 0};
+const unsigned max_sensor_count = 5;
+const double run_seconds = 1.0;
+const size_t unpaced_events = 200000;
+
+const uas::SensorType sensor_types[max_sensor_count] = {
+    uas::sensor_type_accelerometer,
+    uas::sensor_type_gyroscope,
+    uas::sensor_type_magnetic_field,
+    uas::sensor_type_light,
+    uas::sensor_type_proximity
+};
+
+struct Config
+{
+    unsigned rate;
+    unsigned sensor_count;
+    size_t event_count;
+    const char* recording;
+};
+
+struct Result
+{
+    uint64_t delivered;
+    uint64_t dropped;
+    double events_per_second;
+    double cpu_us_per_event;
+    double p50_latency_us;
+    double p99_latency_us;
+};
+
+/* Arrival bookkeeping shared by all callbacks; preallocated so that
+ * recording an event does not allocate. */
+struct Arrival
+{
+    uint64_t timestamp;
+    int64_t arrival;
+};
+
+vector<Arrival> arrivals;
+atomic<size_t> arrival_count(0);
+
+int64_t now_ns()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t cpu_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void on_arrival(uint64_t timestamp)
+{
+    size_t i = arrival_count.fetch_add(1);
+    if (i < arrivals.size())
+        arrivals[i] = {timestamp, now_ns()};
+}
+
+/* A way of getting events out of the API. Only the callback API exists
+ * today; batched or pull based delivery can be added here and is then
+ * benchmarked with the same configurations. */
+struct Mode
+{
+    const char* name;
+    // subscribes to the first count sensors, called before replay starts
+    bool (*subscribe)(unsigned count);
+};
+
+bool subscribe_callbacks(unsigned count)
+{
+    // The backend starts replaying once the first sensor is enabled, events
+    // of sensors set up after that would be missed and counted as dropped.
+    vector<function<void()>> enables;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        switch (sensor_types[i])
+        {
+            case uas::sensor_type_accelerometer:
+            {
+                UASensorsAccelerometer* s = ua_sensors_accelerometer_new();
+                if (s == NULL)
+                    return false;
+                ua_sensors_accelerometer_set_reading_cb(s,
+                    [](UASAccelerometerEvent* ev, void*) {
+                        float x; uas_accelerometer_event_get_acceleration_x(ev, &x);
+                        on_arrival(uas_accelerometer_event_get_timestamp(ev));
+                    }, NULL);
+                enables.push_back([s]() { ua_sensors_accelerometer_enable(s); });
+                break;
+            }
+            case uas::sensor_type_gyroscope:
+            {
+                UASensorsGyroscope* s = ua_sensors_gyroscope_new();
+                if (s == NULL)
+                    return false;
+                ua_sensors_gyroscope_set_reading_cb(s,
+                    [](UASGyroscopeEvent* ev, void*) {
+                        float x; uas_gyroscope_event_get_rate_of_rotation_around_x(ev, &x);
+                        on_arrival(uas_gyroscope_event_get_timestamp(ev));
+                    }, NULL);
+                enables.push_back([s]() { ua_sensors_gyroscope_enable(s); });
+                break;
+            }
+            case uas::sensor_type_magnetic_field:
+            {
+                UASensorsMagnetic* s = ua_sensors_magnetic_new();
+                if (s == NULL)
+                    return false;
+                ua_sensors_magnetic_set_reading_cb(s,
+                    [](UASMagneticEvent* ev, void*) {
+                        float x; uas_magnetic_event_get_magnetic_field_x(ev, &x);
+                        on_arrival(uas_magnetic_event_get_timestamp(ev));
+                    }, NULL);
+                enables.push_back([s]() { ua_sensors_magnetic_enable(s); });
+                break;
+            }
+            case uas::sensor_type_light:
+            {
+                UASensorsLight* s = ua_sensors_light_new();
+                if (s == NULL)
+                    return false;
+                ua_sensors_light_set_reading_cb(s,
+                    [](UASLightEvent* ev, void*) {
+                        float light; uas_light_event_get_light(ev, &light);
+                        on_arrival(uas_light_event_get_timestamp(ev));
+                    }, NULL);
+                enables.push_back([s]() { ua_sensors_light_enable(s); });
+                break;
+            }
+            case uas::sensor_type_proximity:
+            {
+                UASensorsProximity* s = ua_sensors_proximity_new();
+                if (s == NULL)
+                    return false;
+                ua_sensors_proximity_set_reading_cb(s,
+                    [](UASProximityEvent* ev, void*) {
+                        uas_proximity_event_get_distance(ev);
+                        on_arrival(uas_proximity_event_get_timestamp(ev));
+                    }, NULL);
+                enables.push_back([s]() { ua_sensors_proximity_enable(s); });
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    for (const function<void()>& enable : enables)
+        enable();
+
+    return true;
+}
+
+const Mode modes[] = {
+    {"callback", subscribe_callbacks}
+};
+
+/* Writes a recording where each of the sensors reports at the given rate,
+ * interleaved in time. */
+bool write_recording(const Config& config)
+{
+    uas::recording::Writer writer;
+    if (!writer.open(config.recording))
+        return false;
+
+    for (unsigned i = 0; i < config.sensor_count; i++)
+        writer.add_sensor(sensor_types[i], -100, 100, 0.01, 0);
+
+    // unpaced runs are replayed as fast as possible, timestamps only need to be monotonic
+    int64_t period = config.rate > 0 ? 1000000000LL / (int64_t(config.rate) * config.sensor_count) : 1000;
+    int64_t timestamp = 1000000000;
+    float values[uas::recording::max_values] = {1.f, 2.f, 3.f};
+
+    for (size_t i = 0; i < config.event_count; i++)
+    {
+        writer.record(sensor_types[i % config.sensor_count], timestamp, values);
+        timestamp += period;
+    }
+
+    return true;
+}
+
+double percentile(vector<double>& values, double p)
+{
+    if (values.empty())
+        return 0;
+
+    size_t index = min(values.size() - 1, size_t(p * (values.size() - 1) + 0.5));
+    nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+/* Runs in the child: replays the recording and evaluates the arrivals.
+ * Latency is measured against the recorded schedule, relative to the
+ * earliest delivered event. */
+Result run(const Mode& mode, const Config& config)
+{
+    Result result;
+    memset(&result, 0, sizeof(result));
+
+    setenv("UBUNTU_PLATFORM_API_BACKEND", "test", 1);
+    setenv("UBUNTU_PLATFORM_API_SENSOR_REPLAY", config.recording, 1);
+    setenv("UBUNTU_PLATFORM_API_SENSOR_REPLAY_MODE", config.rate > 0 ? "realtime" : "fast", 1);
+
+    arrivals.resize(config.event_count);
+
+    int64_t cpu_start = cpu_time_ns();
+    if (!mode.subscribe(config.sensor_count))
+    {
+        fprintf(stderr, "Failed to set up %u sensors for mode %s\n", config.sensor_count, mode.name);
+        exit(1);
+    }
+
+    // wait for all events, with some grace period for stragglers
+    double expected_seconds = config.rate > 0 ? run_seconds : 10.0;
+    int64_t deadline = now_ns() + int64_t((expected_seconds + 1.0) * 1e9);
+    while (arrival_count.load() < config.event_count && now_ns() < deadline)
+        this_thread::sleep_for(chrono::milliseconds(5));
+    int64_t cpu_end = cpu_time_ns();
+
+    size_t count = min(arrival_count.load(), config.event_count);
+    result.delivered = count;
+    result.dropped = config.event_count - count;
+    if (count == 0)
+        return result;
+
+    // recorded timestamps and arrival times use different clocks, so only
+    // the variation of their offset is meaningful
+    int64_t min_offset = arrivals[0].arrival - int64_t(arrivals[0].timestamp);
+    for (size_t i = 1; i < count; i++)
+        min_offset = min(min_offset, arrivals[i].arrival - int64_t(arrivals[i].timestamp));
+
+    vector<double> latencies;
+    latencies.reserve(count);
+    for (size_t i = 0; i < count; i++)
+        latencies.push_back((arrivals[i].arrival - int64_t(arrivals[i].timestamp) - min_offset) / 1e3);
+
+    int64_t elapsed = arrivals[count - 1].arrival - arrivals[0].arrival;
+    result.events_per_second = elapsed > 0 ? count / (elapsed / 1e9) : 0;
+    result.cpu_us_per_event = (cpu_end - cpu_start) / 1e3 / count;
+    result.p50_latency_us = percentile(latencies, 0.5);
+    result.p99_latency_us = percentile(latencies, 0.99);
+
+    return result;
+}
+
+bool run_in_child(const Mode& mode, const Config& config, Result& result)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+        return false;
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Result r = run(mode, config);
+        ssize_t ret = write(fds[1], &r, sizeof(r));
+        _exit(ret == sizeof(r) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t ret = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    return ret == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+}
+
+int main(int argc, char** argv)
+{
+    char recording[] = "/tmp/bench_ua_sensors.XXXXXX";
+    int fd = mkstemp(recording);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    printf("%-10s %7s %8s %10s %12s %10s %10s %10s %8s\n",
+           "mode", "sensors", "rate/Hz", "events", "events/s", "cpu us/ev", "p50 us", "p99 us", "dropped");
+    fflush(stdout);
+
+    int ret = 0;
+    for (const Mode& mode : modes)
+    {
+        if (argc > 1 && find_if(argv + 1, argv + argc, [&mode](const char* arg) {
+                return string(arg) == mode.name;
+            }) == argv + argc)
+            continue;
+
+        for (unsigned sensors = 1; sensors <= max_sensor_count; sensors++)
+        {
+            for (unsigned rate : rates)
+            {
+                Config config;
+                config.rate = rate;
+                config.sensor_count = sensors;
+                config.event_count = rate > 0 ? size_t(rate * sensors * run_seconds) : unpaced_events;
+                config.recording = recording;
+
+                Result result;
+                if (!write_recording(config) || !run_in_child(mode, config, result))
+                {
+                    fprintf(stderr, "%s: run with %u sensors at %u Hz failed\n", mode.name, sensors, rate);
+                    ret = 1;
+                    continue;
+                }
+
+                // without pacing there is no schedule to measure latency against
+                string rate_label = rate > 0 ? to_string(rate) : "max";
+                string p50 = rate > 0 ? to_string(lround(result.p50_latency_us)) : "-";
+                string p99 = rate > 0 ? to_string(lround(result.p99_latency_us)) : "-";
+                printf("%-10s %7u %8s %10zu %12.0f %10.2f %10s %10s %8llu\n",
+                       mode.name, sensors, rate_label.c_str(), config.event_count,
+                       result.events_per_second, result.cpu_us_per_event,
+                       p50.c_str(), p99.c_str(),
+                       (unsigned long long) result.dropped);
+                fflush(stdout);
+            }
+        }
+    }
+
+    unlink(recording);
+    return ret;
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Minimal in-process replacements for com.canonical.usensord and
+ * com.ubuntu.location.Service. They are meant to be registered on the
+ * private buses of a core::dbus::Fixture, which also points the well-known
+ * bus addresses of the process at them, so the library under test connects
+ * to the stand-ins without any change.
+ */
+
+#ifndef STANDIN_SERVICES_H_
+#define STANDIN_SERVICES_H_
+
+#include "application/sensors/usensord_service.h"
+
+#include <core/dbus/bus.h>
+#include <core/dbus/message.h>
+#include <core/dbus/object.h>
+#include <core/dbus/service.h>
+#include <core/dbus/asio/executor.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/stl/vector.h>
+
+#include <com/ubuntu/location/service/permission_manager.h>
+#include <com/ubuntu/location/service/skeleton.h>
+#include <com/ubuntu/location/service/session/interface.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace standin
+{
+/** Runs a connection on its own thread, so the stand-ins never share one with the client. */
+class Dispatcher
+{
+public:
+    Dispatcher(const core::dbus::Bus::Ptr& bus) : bus(bus)
+    {
+        bus->install_executor(core::dbus::asio::make_executor(bus));
+        worker = std::thread([bus]() { bus->run(); });
+    }
+
+    ~Dispatcher()
+    {
+        bus->stop();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    core::dbus::Bus::Ptr bus;
+
+private:
+    std::thread worker;
+};
+
+/**
+ * Answers Vibrate and VibratePattern right away, counts the requests and
+ * keeps the patterns it was asked to play.
+ */
+class USensorD
+{
+public:
+    typedef ubuntu::application::sensors::USensorD Service;
+
+    /** A VibratePattern request as received. */
+    struct Pattern
+    {
+        std::vector<std::uint32_t> durations;
+        std::uint32_t repeat;
+    };
+
+    USensorD(const core::dbus::Bus::Ptr& bus)
+        : service(core::dbus::Service::add_service<Service>(bus)),
+          object(service->add_object_for_path(core::dbus::types::ObjectPath("/com/canonical/usensord/haptic"))),
+          vibrations(0),
+          patterns(0),
+          failing(false)
+    {
+        object->install_method_handler<Service::Haptic::Vibrate>([this, bus](const core::dbus::Message::Ptr& msg)
+        {
+            std::uint32_t duration;
+            msg->reader() >> duration;
+
+            vibrations++;
+            bus->send(reply(msg));
+        });
+
+        object->install_method_handler<Service::Haptic::VibratePattern>([this, bus](const core::dbus::Message::Ptr& msg)
+        {
+            std::vector<std::uint32_t> pattern;
+            std::uint32_t repeat;
+            msg->reader() >> pattern >> repeat;
+
+            {
+                std::lock_guard<std::mutex> lock(guard);
+                received.push_back(Pattern{pattern, repeat});
+            }
+            patterns++;
+            bus->send(reply(msg));
+        });
+    }
+
+    /** The VibratePattern requests received so far, oldest first. */
+    std::vector<Pattern> received_patterns()
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        return received;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        received.clear();
+    }
+
+    core::dbus::Service::Ptr service;
+    core::dbus::Object::Ptr object;
+
+    std::atomic<std::uint64_t> vibrations;
+    std::atomic<std::uint64_t> patterns;
+    /** Answers requests with an error while set. */
+    std::atomic<bool> failing;
+
+private:
+    core::dbus::Message::Ptr reply(const core::dbus::Message::Ptr& msg)
+    {
+        if (failing)
+            return core::dbus::Message::make_error(msg, "com.canonical.usensord.Error.Failed", "failing on request");
+        return core::dbus::Message::make_method_return(msg);
+    }
+
+    std::mutex guard;
+    std::vector<Pattern> received;
+};
+
+/**
+ * The real service skeleton, with sessions that deliver whatever the
+ * harness publishes instead of asking providers.
+ */
+class LocationService : public com::ubuntu::location::service::Skeleton
+{
+public:
+    typedef com::ubuntu::location::service::Skeleton Skeleton;
+    typedef com::ubuntu::location::service::session::Interface Session;
+
+    LocationService(const core::dbus::Bus::Ptr& bus)
+        : Skeleton(configuration(bus)),
+          session_delay_ms(0)
+    {
+        does_satellite_based_positioning() = true;
+        is_online() = true;
+    }
+
+    /** Hands the update to every session that has position updates running. */
+    void publish(const com::ubuntu::location::Update<com::ubuntu::location::Position>& update)
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        for (const auto& session : sessions)
+        {
+            if (session->updates().position_status.get() == Session::Updates::Status::enabled)
+                session->updates().position = update;
+        }
+    }
+
+    /** Number of sessions with position updates running. */
+    std::size_t active_sessions()
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        std::size_t count = 0;
+        for (const auto& session : sessions)
+        {
+            if (session->updates().position_status.get() == Session::Updates::Status::enabled)
+                count++;
+        }
+        return count;
+    }
+
+    /** Number of sessions created so far. */
+    std::size_t created_sessions()
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        return sessions.size();
+    }
+
+    /** Delays the answer to session requests while non-zero, in [ms]. */
+    std::atomic<unsigned int> session_delay_ms;
+
+protected:
+    Session::Ptr create_session_for_criteria(const com::ubuntu::location::Criteria&) override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(session_delay_ms.load()));
+
+        std::lock_guard<std::mutex> lock(guard);
+        sessions.push_back(std::make_shared<StandInSession>());
+        return sessions.back();
+    }
+
+private:
+    struct StandInSession : public Session
+    {
+        Updates& updates() override { return session_updates; }
+
+        Updates session_updates;
+    };
+
+    struct GrantingPermissionManager : public com::ubuntu::location::service::PermissionManager
+    {
+        Result check_permission_for_credentials(
+            const com::ubuntu::location::Criteria&,
+            const com::ubuntu::location::service::Credentials&) override
+        {
+            return Result::granted;
+        }
+    };
+
+    static Skeleton::Configuration configuration(const core::dbus::Bus::Ptr& bus)
+    {
+        return Skeleton::Configuration
+        {
+            bus,
+            bus,
+            std::make_shared<Skeleton::DBusDaemonCredentialsResolver>(bus),
+            std::make_shared<Skeleton::ObjectPathGenerator>(),
+            std::make_shared<GrantingPermissionManager>()
+        };
+    }
+
+    std::mutex guard;
+    std::vector<Session::Ptr> sessions;
+};
+}
+
+#endif // STANDIN_SERVICES_H_
@@ -0,0 +1,106 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "application/location/cached_property.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+typedef detail::CachedProperty<bool> Property;
+
+const chrono::milliseconds staleness{20};
+
+void let_go_stale()
+{
+    this_thread::sleep_for(2 * staleness);
+}
+}
+
+TEST(CachedProperty, values_go_stale_without_subscription)
+{
+    Property p;
+    p.set_staleness(staleness);
+
+    bool value = false;
+    EXPECT_FALSE(p.get(value));
+
+    p.update(true);
+    EXPECT_TRUE(p.get(value));
+    EXPECT_TRUE(value);
+
+    let_go_stale();
+    EXPECT_FALSE(p.get(value));
+
+    // still known for the status flags
+    EXPECT_TRUE(p.known(value));
+    EXPECT_TRUE(value);
+}
+
+TEST(CachedProperty, subscribed_values_stay_valid)
+{
+    Property p;
+    bool connected = true;
+    p.set_staleness(staleness);
+    p.set_subscription([&connected]() { return connected; });
+
+    bool value = false;
+    p.update(true);
+    let_go_stale();
+    EXPECT_TRUE(p.get(value));
+    EXPECT_TRUE(value);
+
+    // losing the signal falls back to the staleness bound
+    connected = false;
+    EXPECT_FALSE(p.get(value));
+
+    connected = true;
+    unsigned int fetches = 0;
+    EXPECT_TRUE(p.get_or_fetch([&fetches]() { fetches++; return false; }));
+    EXPECT_EQ(0u, fetches);
+}
+
+TEST(CachedProperty, zero_staleness_disables_the_cache)
+{
+    Property p;
+    p.set_subscription([]() { return true; });
+    p.update(true);
+
+    bool value = false;
+    EXPECT_FALSE(p.get(value));
+
+    unsigned int fetches = 0;
+    EXPECT_FALSE(p.get_or_fetch([&fetches]() { fetches++; return false; }));
+    EXPECT_EQ(1u, fetches);
+}
+
+TEST(CachedProperty, prime_yields_to_updates)
+{
+    Property p;
+    p.set_staleness(staleness);
+
+    p.update(true);
+    p.prime(false);
+
+    bool value = false;
+    EXPECT_TRUE(p.get(value));
+    EXPECT_TRUE(value);
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+#include "application/location/dead_reckoning.h"
+
+using namespace std;
+
+namespace
+{
+const double meter_per_degree = 6371008.8 * M_PI / 180.;
+const double latitude = 52.5;
+const double longitude = 13.4;
+
+double east_of_fix(const detail::DeadReckoning::Estimate& e)
+{
+    return (e.longitude - longitude) * meter_per_degree * cos(latitude * M_PI / 180.);
+}
+
+double north_of_fix(const detail::DeadReckoning::Estimate& e)
+{
+    return (e.latitude - latitude) * meter_per_degree;
+}
+
+/* A device lying flat, screen up, its top pointing azimuth degrees clockwise
+ * from north, and shaken like in a pocket unless it is resting. Feeds 50Hz of
+ * sensor readings from t0 to t1. */
+void feed_sensors(detail::DeadReckoning& dr, double t0, double t1, double azimuth, bool resting)
+{
+    // northern hemisphere: the field points north and down
+    double a = azimuth * M_PI / 180.;
+    double north_x = -sin(a), north_y = cos(a);
+
+    int i = 0;
+    for (double t = t0; t < t1; t += 0.02, i++)
+    {
+        double shake = resting ? 0 : 2. * sin(i * 0.9);
+        dr.acceleration(t, 0, 0, detail::DeadReckoning::standard_gravity + shake);
+        dr.magnetic_field(t, 20 * north_x, 20 * north_y, -40);
+        dr.rotation(t, 0, 0, 0);
+    }
+}
+}
+
+TEST(DeadReckoning, no_estimate_without_fix)
+{
+    detail::DeadReckoning dr;
+    detail::DeadReckoning::Estimate e;
+
+    EXPECT_FALSE(dr.estimate(1, e));
+}
+
+TEST(DeadReckoning, follows_course_without_sensors)
+{
+    detail::DeadReckoning dr;
+    dr.fix(0, latitude, longitude, 5);
+    dr.velocity(0, 10);
+    dr.heading(0, 90);
+
+    detail::DeadReckoning::Estimate e;
+    ASSERT_TRUE(dr.estimate(2, e));
+    EXPECT_NEAR(20, east_of_fix(e), 0.1);
+    EXPECT_NEAR(0, north_of_fix(e), 0.1);
+    EXPECT_NEAR(90, e.heading, 1e-6);
+    // accuracy degrades with the age of the fix
+    EXPECT_GT(e.accuracy, 5);
+}
+
+TEST(DeadReckoning, new_fix_resets_estimate)
+{
+    detail::DeadReckoning dr;
+    dr.fix(0, latitude, longitude, 5);
+    dr.velocity(0, 10);
+    dr.heading(0, 0);
+
+    detail::DeadReckoning::Estimate e;
+    ASSERT_TRUE(dr.estimate(1, e));
+    EXPECT_NEAR(10, north_of_fix(e), 0.1);
+
+    dr.fix(1, latitude, longitude, 3);
+    ASSERT_TRUE(dr.estimate(1, e));
+    EXPECT_NEAR(0, north_of_fix(e), 1e-6);
+    EXPECT_NEAR(3, e.accuracy, 1e-6);
+}
+
+TEST(DeadReckoning, stale_fix_gives_no_estimate)
+{
+    detail::DeadReckoning dr;
+    dr.fix(0, latitude, longitude, 5);
+
+    detail::DeadReckoning::Estimate e;
+    EXPECT_TRUE(dr.estimate(detail::DeadReckoning::max_age - 1, e));
+    EXPECT_FALSE(dr.estimate(detail::DeadReckoning::max_age + 1, e));
+}
+
+TEST(DeadReckoning, heading_from_magnetometer)
+{
+    detail::DeadReckoning dr;
+    feed_sensors(dr, 0, 1, 90, false);
+    dr.fix(1, latitude, longitude, 5);
+    dr.velocity(1, 1.4);
+    feed_sensors(dr, 1, 3, 90, false);
+
+    detail::DeadReckoning::Estimate e;
+    ASSERT_TRUE(dr.estimate(3, e));
+    EXPECT_NEAR(90, e.heading, 1);
+    EXPECT_NEAR(2.8, east_of_fix(e), 0.2);
+    EXPECT_NEAR(0, north_of_fix(e), 0.2);
+}
+
+TEST(DeadReckoning, gyroscope_turns_heading)
+{
+    detail::DeadReckoning dr;
+    feed_sensors(dr, 0, 1, 0, false);
+
+    // a quarter turn clockwise in a second, faster than the magnetometer pulls back
+    for (double t = 1; t < 2; t += 0.01)
+    {
+        dr.acceleration(t, 0, 0, detail::DeadReckoning::standard_gravity);
+        dr.rotation(t, 0, 0, -M_PI / 2);
+    }
+
+    dr.fix(2, latitude, longitude, 5);
+    detail::DeadReckoning::Estimate e;
+    ASSERT_TRUE(dr.estimate(2, e));
+    EXPECT_NEAR(90, e.heading, 5);
+}
+
+TEST(DeadReckoning, learns_offset_from_course)
+{
+    detail::DeadReckoning dr;
+    // device mounted sideways: the sensors say north, the vehicle drives east
+    feed_sensors(dr, 0, 1, 0, false);
+    dr.fix(1, latitude, longitude, 5);
+    dr.velocity(1, 10);
+    dr.heading(1, 90);
+    feed_sensors(dr, 1, 2, 0, false);
+
+    detail::DeadReckoning::Estimate e;
+    ASSERT_TRUE(dr.estimate(2, e));
+    EXPECT_NEAR(90, e.heading, 1);
+    EXPECT_NEAR(10, east_of_fix(e), 0.5);
+}
+
+TEST(DeadReckoning, stays_put_at_rest)
+{
+    detail::DeadReckoning dr;
+    // long enough for the motion estimate to settle
+    feed_sensors(dr, 0, 5, 0, true);
+    dr.fix(5, latitude, longitude, 5);
+    dr.velocity(5, 1.4);
+    feed_sensors(dr, 5, 7, 0, true);
+
+    detail::DeadReckoning::Estimate e;
+    ASSERT_TRUE(dr.estimate(7, e));
+    EXPECT_NEAR(0, north_of_fix(e), 0.1);
+    EXPECT_EQ(0, e.speed);
+}
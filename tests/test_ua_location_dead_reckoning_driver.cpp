@@ -0,0 +1,209 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "application/location/dead_reckoning_driver.h"
+
+#include <ubuntu/application/sensors/accelerometer.h>
+#include <ubuntu/application/sensors/gyroscope.h>
+#include <ubuntu/application/sensors/magnetic.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+/** Stands in for a process-wide sensor of the backends. */
+struct Sensor
+{
+    void* cb = nullptr;
+    bool enabled = false;
+};
+
+Sensor accelerometer, gyroscope, magnetic;
+
+void reset_sensors()
+{
+    accelerometer = gyroscope = magnetic = Sensor{};
+}
+
+Sensor* sensor(void* s)
+{
+    return static_cast<Sensor*>(s);
+}
+
+UStatus axis(void*, float* value)
+{
+    *value = 0;
+    return U_STATUS_SUCCESS;
+}
+
+void application_cb(UASAccelerometerEvent*, void*)
+{
+}
+
+bool wait_for(const function<bool()>& condition, chrono::milliseconds timeout = chrono::seconds(5))
+{
+    auto deadline = chrono::steady_clock::now() + timeout;
+    while (!condition())
+    {
+        if (chrono::steady_clock::now() > deadline)
+            return false;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return true;
+}
+}
+
+// The sensor API as seen by the driver, without a backend.
+extern "C"
+{
+UASensorsAccelerometer* ua_sensors_accelerometer_new() { return &accelerometer; }
+UASensorsGyroscope* ua_sensors_gyroscope_new() { return &gyroscope; }
+UASensorsMagnetic* ua_sensors_magnetic_new() { return &magnetic; }
+
+UStatus ua_sensors_accelerometer_enable(UASensorsAccelerometer* s) { sensor(s)->enabled = true; return U_STATUS_SUCCESS; }
+UStatus ua_sensors_gyroscope_enable(UASensorsGyroscope* s) { sensor(s)->enabled = true; return U_STATUS_SUCCESS; }
+UStatus ua_sensors_magnetic_enable(UASensorsMagnetic* s) { sensor(s)->enabled = true; return U_STATUS_SUCCESS; }
+UStatus ua_sensors_accelerometer_disable(UASensorsAccelerometer* s) { sensor(s)->enabled = false; return U_STATUS_SUCCESS; }
+UStatus ua_sensors_gyroscope_disable(UASensorsGyroscope* s) { sensor(s)->enabled = false; return U_STATUS_SUCCESS; }
+UStatus ua_sensors_magnetic_disable(UASensorsMagnetic* s) { sensor(s)->enabled = false; return U_STATUS_SUCCESS; }
+
+void ua_sensors_accelerometer_set_reading_cb(UASensorsAccelerometer* s, on_accelerometer_event_cb cb, void*) { sensor(s)->cb = reinterpret_cast<void*>(cb); }
+void ua_sensors_gyroscope_set_reading_cb(UASensorsGyroscope* s, on_gyroscope_event_cb cb, void*) { sensor(s)->cb = reinterpret_cast<void*>(cb); }
+void ua_sensors_magnetic_set_reading_cb(UASensorsMagnetic* s, on_magnetic_event_cb cb, void*) { sensor(s)->cb = reinterpret_cast<void*>(cb); }
+on_accelerometer_event_cb ua_sensors_accelerometer_get_reading_cb(UASensorsAccelerometer* s) { return reinterpret_cast<on_accelerometer_event_cb>(sensor(s)->cb); }
+on_gyroscope_event_cb ua_sensors_gyroscope_get_reading_cb(UASensorsGyroscope* s) { return reinterpret_cast<on_gyroscope_event_cb>(sensor(s)->cb); }
+on_magnetic_event_cb ua_sensors_magnetic_get_reading_cb(UASensorsMagnetic* s) { return reinterpret_cast<on_magnetic_event_cb>(sensor(s)->cb); }
+
+UStatus ua_sensors_accelerometer_set_event_rate(UASensorsAccelerometer*, uint32_t) { return U_STATUS_SUCCESS; }
+UStatus ua_sensors_gyroscope_set_event_rate(UASensorsGyroscope*, uint32_t) { return U_STATUS_SUCCESS; }
+UStatus ua_sensors_magnetic_set_event_rate(UASensorsMagnetic*, uint32_t) { return U_STATUS_SUCCESS; }
+
+UStatus uas_accelerometer_event_get_acceleration_x(UASAccelerometerEvent* e, float* v) { return axis(e, v); }
+UStatus uas_accelerometer_event_get_acceleration_y(UASAccelerometerEvent* e, float* v) { return axis(e, v); }
+UStatus uas_accelerometer_event_get_acceleration_z(UASAccelerometerEvent* e, float* v) { return axis(e, v); }
+UStatus uas_gyroscope_event_get_rate_of_rotation_around_x(UASGyroscopeEvent* e, float* v) { return axis(e, v); }
+UStatus uas_gyroscope_event_get_rate_of_rotation_around_y(UASGyroscopeEvent* e, float* v) { return axis(e, v); }
+UStatus uas_gyroscope_event_get_rate_of_rotation_around_z(UASGyroscopeEvent* e, float* v) { return axis(e, v); }
+UStatus uas_magnetic_event_get_magnetic_field_x(UASMagneticEvent* e, float* v) { return axis(e, v); }
+UStatus uas_magnetic_event_get_magnetic_field_y(UASMagneticEvent* e, float* v) { return axis(e, v); }
+UStatus uas_magnetic_event_get_magnetic_field_z(UASMagneticEvent* e, float* v) { return axis(e, v); }
+}
+
+namespace
+{
+void ignore_fix(const UALocationFix*, void*)
+{
+}
+
+/** A session-like owner, destroyed by its own fix handler. */
+struct Owner
+{
+    Owner() : driver(new detail::DeadReckoningDriver(estimator)), handled(false)
+    {
+    }
+
+    static void destroy_driver(const UALocationFix*, void* context)
+    {
+        Owner* owner = static_cast<Owner*>(context);
+        delete owner->driver;
+        owner->driver = nullptr;
+        owner->handled = true;
+    }
+
+    detail::DeadReckoning estimator;
+    detail::DeadReckoningDriver* driver;
+    atomic<bool> handled;
+};
+}
+
+TEST(DeadReckoningDriver, enables_and_disables_the_sensors)
+{
+    reset_sensors();
+    detail::DeadReckoning estimator;
+    detail::DeadReckoningDriver driver(estimator);
+
+    ASSERT_TRUE(driver.start(10, ignore_fix, nullptr));
+    EXPECT_TRUE(driver.running());
+    EXPECT_TRUE(accelerometer.enabled && gyroscope.enabled && magnetic.enabled);
+    EXPECT_NE(nullptr, accelerometer.cb);
+
+    // only one driver at a time
+    detail::DeadReckoning other_estimator;
+    detail::DeadReckoningDriver other(other_estimator);
+    EXPECT_FALSE(other.start(10, ignore_fix, nullptr));
+
+    driver.stop();
+    EXPECT_FALSE(driver.running());
+    EXPECT_FALSE(accelerometer.enabled || gyroscope.enabled || magnetic.enabled);
+
+    // the callbacks left registered are its own
+    EXPECT_TRUE(other.start(10, ignore_fix, nullptr));
+}
+
+TEST(DeadReckoningDriver, refuses_sensors_the_application_consumes)
+{
+    reset_sensors();
+    accelerometer.cb = reinterpret_cast<void*>(application_cb);
+    accelerometer.enabled = true;
+
+    detail::DeadReckoning estimator;
+    detail::DeadReckoningDriver driver(estimator);
+    EXPECT_FALSE(driver.start(10, ignore_fix, nullptr));
+    EXPECT_FALSE(driver.running());
+    EXPECT_EQ(reinterpret_cast<void*>(application_cb), accelerometer.cb);
+    EXPECT_FALSE(gyroscope.enabled || magnetic.enabled);
+
+    driver.stop();
+    EXPECT_TRUE(accelerometer.enabled);
+}
+
+TEST(DeadReckoningDriver, leaves_sensors_taken_over_while_running_enabled)
+{
+    reset_sensors();
+    detail::DeadReckoning estimator;
+    detail::DeadReckoningDriver driver(estimator);
+    ASSERT_TRUE(driver.start(10, ignore_fix, nullptr));
+
+    accelerometer.cb = reinterpret_cast<void*>(application_cb);
+
+    driver.stop();
+    EXPECT_TRUE(accelerometer.enabled);
+    EXPECT_FALSE(gyroscope.enabled || magnetic.enabled);
+}
+
+TEST(DeadReckoningDriver, fix_handler_may_destroy_the_driver)
+{
+    for (int i = 0; i < 20; i++)
+    {
+        reset_sensors();
+        Owner* owner = new Owner;
+        ASSERT_TRUE(owner->driver->start(100, Owner::destroy_driver, owner));
+        // estimates need a fix, which starting resets
+        owner->estimator.fix(detail::DeadReckoningDriver::now(), 52.5, 13.4, 5);
+
+        ASSERT_TRUE(wait_for([owner]() { return owner->handled.load(); }));
+        // gives a timer still touching the driver the chance to do so
+        this_thread::sleep_for(chrono::milliseconds(20));
+        delete owner;
+    }
+}
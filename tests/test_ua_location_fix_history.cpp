@@ -0,0 +1,105 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "application/location/fix_history.h"
+
+using namespace std;
+
+namespace
+{
+UALocationPosition fix_at(uint64_t timestamp)
+{
+    UALocationPosition p = UALocationPosition{};
+    p.timestamp = timestamp;
+    p.latitude = timestamp / 1000.;
+    return p;
+}
+}
+
+TEST(FixHistory, empty_history)
+{
+    detail::FixHistory history;
+    UALocationPosition buffer[4];
+    UALocationPosition p;
+
+    EXPECT_EQ(0u, history.get(0, buffer, 4));
+    EXPECT_EQ(0u, history.get(0, nullptr, 0));
+    EXPECT_FALSE(history.nearest(0, p));
+}
+
+TEST(FixHistory, keeps_most_recent_fixes)
+{
+    detail::FixHistory history;
+    ASSERT_TRUE(history.set_capacity(4));
+    for (uint64_t t = 1; t <= 10; t++)
+        history.add(fix_at(t * 1000));
+
+    UALocationPosition buffer[8];
+    ASSERT_EQ(4u, history.get(0, buffer, 8));
+    for (int i = 0; i < 4; i++)
+        EXPECT_EQ(uint64_t((7 + i) * 1000), buffer[i].timestamp);
+}
+
+TEST(FixHistory, get_since_and_max)
+{
+    detail::FixHistory history;
+    for (uint64_t t = 1; t <= 10; t++)
+        history.add(fix_at(t * 1000));
+
+    UALocationPosition buffer[8];
+    EXPECT_EQ(3u, history.get(8000, nullptr, 0));
+    ASSERT_EQ(3u, history.get(8000, buffer, 8));
+    EXPECT_EQ(8000u, buffer[0].timestamp);
+    EXPECT_EQ(10000u, buffer[2].timestamp);
+
+    // the most recent ones, oldest first
+    ASSERT_EQ(2u, history.get(0, buffer, 2));
+    EXPECT_EQ(9000u, buffer[0].timestamp);
+    EXPECT_EQ(10000u, buffer[1].timestamp);
+}
+
+TEST(FixHistory, nearest_fix)
+{
+    detail::FixHistory history;
+    history.add(fix_at(1000));
+    history.add(fix_at(5000));
+    // set back clock
+    history.add(fix_at(2000));
+
+    UALocationPosition p;
+    ASSERT_TRUE(history.nearest(1400, p));
+    EXPECT_EQ(1000u, p.timestamp);
+    ASSERT_TRUE(history.nearest(2400, p));
+    EXPECT_EQ(2000u, p.timestamp);
+    ASSERT_TRUE(history.nearest(100000, p));
+    EXPECT_EQ(5000u, p.timestamp);
+}
+
+TEST(FixHistory, capacity)
+{
+    detail::FixHistory history;
+    history.add(fix_at(1000));
+
+    EXPECT_FALSE(history.set_capacity(detail::FixHistory::max_capacity + 1));
+    EXPECT_EQ(1u, history.get(0, nullptr, 0));
+
+    // disabled
+    ASSERT_TRUE(history.set_capacity(0));
+    history.add(fix_at(2000));
+    EXPECT_EQ(0u, history.get(0, nullptr, 0));
+}
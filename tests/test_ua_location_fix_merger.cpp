@@ -0,0 +1,279 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "application/location/fix_merger.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+// [ms], long enough for the timer not to interfere with the synchronous cases
+const uint32_t window = 100;
+
+bool wait_for(const function<bool()>& condition, chrono::milliseconds timeout = chrono::seconds(5))
+{
+    auto deadline = chrono::steady_clock::now() + timeout;
+    while (!condition())
+    {
+        if (chrono::steady_clock::now() > deadline)
+            return false;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return true;
+}
+
+struct Fixes
+{
+    void add(const UALocationFix& fix)
+    {
+        lock_guard<mutex> lock(guard);
+        delivered.push_back(fix);
+    }
+
+    vector<UALocationFix> get()
+    {
+        lock_guard<mutex> lock(guard);
+        return delivered;
+    }
+
+    size_t size()
+    {
+        lock_guard<mutex> lock(guard);
+        return delivered.size();
+    }
+
+    mutex guard;
+    vector<UALocationFix> delivered;
+};
+
+void record(const UALocationFix* fix, void* context)
+{
+    static_cast<Fixes*>(context)->add(*fix);
+}
+
+UALocationPosition position(uint64_t timestamp)
+{
+    UALocationPosition p{};
+    p.timestamp = timestamp;
+    return p;
+}
+
+UALocationHeading heading(uint64_t timestamp)
+{
+    UALocationHeading h{};
+    h.timestamp = timestamp;
+    return h;
+}
+
+UALocationVelocity velocity(uint64_t timestamp)
+{
+    UALocationVelocity v{};
+    v.timestamp = timestamp;
+    return v;
+}
+}
+
+TEST(FixMerger, merges_updates_within_the_window)
+{
+    Fixes fixes;
+    detail::FixMerger merger;
+    merger.set_enabled(UA_LOCATION_FIX_POSITION, true);
+    merger.set_enabled(UA_LOCATION_FIX_HEADING, true);
+    merger.set_enabled(UA_LOCATION_FIX_VELOCITY, true);
+    merger.set_handler(record, window, &fixes);
+    EXPECT_TRUE(merger.active());
+
+    merger.add(position(1000000));
+    merger.add(heading(1000000 + 20000));
+    EXPECT_EQ(0u, fixes.size());
+
+    // complete, so delivered right away
+    merger.add(velocity(1000000 - 20000));
+    ASSERT_EQ(1u, fixes.size());
+
+    UALocationFix fix = fixes.get()[0];
+    EXPECT_EQ(uint32_t(UA_LOCATION_FIX_POSITION | UA_LOCATION_FIX_HEADING | UA_LOCATION_FIX_VELOCITY), fix.components);
+    EXPECT_EQ(1000000u, fix.position.timestamp);
+    EXPECT_EQ(1020000u, fix.heading.timestamp);
+    EXPECT_EQ(980000u, fix.velocity.timestamp);
+}
+
+TEST(FixMerger, only_enabled_components_make_a_fix_complete)
+{
+    Fixes fixes;
+    detail::FixMerger merger;
+    merger.set_enabled(UA_LOCATION_FIX_POSITION, true);
+    merger.set_handler(record, window, &fixes);
+
+    merger.add(position(1000));
+    ASSERT_EQ(1u, fixes.size());
+    EXPECT_EQ(uint32_t(UA_LOCATION_FIX_POSITION), fixes.get()[0].components);
+
+    // disabling the missing component completes the pending fix
+    merger.set_enabled(UA_LOCATION_FIX_HEADING, true);
+    merger.add(position(2000));
+    EXPECT_EQ(1u, fixes.size());
+    merger.set_enabled(UA_LOCATION_FIX_HEADING, false);
+    EXPECT_EQ(2u, fixes.size());
+}
+
+TEST(FixMerger, repeated_component_or_outside_window_starts_a_new_fix)
+{
+    Fixes fixes;
+    detail::FixMerger merger;
+    merger.set_enabled(UA_LOCATION_FIX_POSITION, true);
+    merger.set_enabled(UA_LOCATION_FIX_HEADING, true);
+    merger.set_handler(record, window, &fixes);
+
+    merger.add(position(1000000));
+    merger.add(position(1001000));
+    ASSERT_EQ(1u, fixes.size());
+    EXPECT_EQ(1000000u, fixes.get()[0].position.timestamp);
+
+    // beyond the window in either direction
+    merger.add(heading(1001000 + window * 1000 + 1));
+    ASSERT_EQ(2u, fixes.size());
+    EXPECT_EQ(uint32_t(UA_LOCATION_FIX_POSITION), fixes.get()[1].components);
+    EXPECT_EQ(1001000u, fixes.get()[1].position.timestamp);
+
+    merger.add(position(1001000));
+    ASSERT_EQ(3u, fixes.size());
+    EXPECT_EQ(uint32_t(UA_LOCATION_FIX_HEADING), fixes.get()[2].components);
+}
+
+TEST(FixMerger, timer_delivers_an_incomplete_fix)
+{
+    Fixes fixes;
+    detail::FixMerger merger;
+    merger.set_enabled(UA_LOCATION_FIX_POSITION, true);
+    merger.set_enabled(UA_LOCATION_FIX_HEADING, true);
+    merger.set_handler(record, window, &fixes);
+
+    auto start = chrono::steady_clock::now();
+    merger.add(position(1000));
+    ASSERT_TRUE(wait_for([&fixes]() { return fixes.size() == 1; }));
+    EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(window));
+    EXPECT_EQ(uint32_t(UA_LOCATION_FIX_POSITION), fixes.get()[0].components);
+
+    // and nothing else
+    this_thread::sleep_for(chrono::milliseconds(2 * window));
+    EXPECT_EQ(1u, fixes.size());
+}
+
+TEST(FixMerger, removing_the_handler_drops_the_pending_fix)
+{
+    Fixes fixes;
+    detail::FixMerger merger;
+    merger.set_enabled(UA_LOCATION_FIX_POSITION, true);
+    merger.set_enabled(UA_LOCATION_FIX_HEADING, true);
+    merger.set_handler(record, window, &fixes);
+
+    merger.add(position(1000));
+    merger.set_handler(nullptr, window, nullptr);
+    EXPECT_FALSE(merger.active());
+
+    merger.add(heading(1000));
+    this_thread::sleep_for(chrono::milliseconds(2 * window));
+    EXPECT_EQ(0u, fixes.size());
+}
+
+TEST(FixMerger, no_handler_runs_after_shutdown)
+{
+    Fixes fixes;
+    detail::FixMerger merger;
+    merger.set_enabled(UA_LOCATION_FIX_POSITION, true);
+    merger.set_enabled(UA_LOCATION_FIX_HEADING, true);
+    merger.set_handler(record, window, &fixes);
+
+    merger.add(position(1000));
+    merger.shutdown();
+    this_thread::sleep_for(chrono::milliseconds(2 * window));
+    EXPECT_EQ(0u, fixes.size());
+}
+
+TEST(FixMerger, handler_on_the_timer_thread_may_destroy_the_merger)
+{
+    static atomic<bool> destroyed{false};
+    static detail::FixMerger* merger = nullptr;
+
+    merger = new detail::FixMerger;
+    merger->set_enabled(UA_LOCATION_FIX_POSITION, true);
+    merger->set_enabled(UA_LOCATION_FIX_HEADING, true);
+    merger->set_handler([](const UALocationFix*, void*)
+    {
+        // as when the handler releases the last reference to its session
+        delete merger;
+        destroyed = true;
+    }, window, nullptr);
+
+    merger->add(position(1000));
+    EXPECT_TRUE(wait_for([]() { return destroyed.load(); }));
+
+    // the timer thread winds down on its own, the sanitizers check it leaves the merger alone
+    this_thread::sleep_for(chrono::milliseconds(50));
+}
+
+TEST(FixMerger, handler_on_the_adding_thread_may_destroy_the_merger)
+{
+    static atomic<bool> destroyed{false};
+    static detail::FixMerger* merger = nullptr;
+
+    merger = new detail::FixMerger;
+    merger->set_enabled(UA_LOCATION_FIX_POSITION, true);
+    merger->set_enabled(UA_LOCATION_FIX_HEADING, true);
+    merger->set_handler([](const UALocationFix*, void*)
+    {
+        // the timer thread is waiting for the pending fix, and is joined here
+        delete merger;
+        destroyed = true;
+    }, window, nullptr);
+
+    // the repeated component delivers the pending fix on this thread
+    merger->add(position(1000));
+    merger->add(position(2000));
+    EXPECT_TRUE(destroyed);
+}
+
+TEST(FixMerger, removing_the_handler_waits_for_a_running_one)
+{
+    static atomic<bool> running{false};
+    static atomic<bool> finished{false};
+
+    detail::FixMerger merger;
+    merger.set_enabled(UA_LOCATION_FIX_POSITION, true);
+    merger.set_handler([](const UALocationFix*, void*)
+    {
+        running = true;
+        this_thread::sleep_for(chrono::milliseconds(50));
+        finished = true;
+    }, window, nullptr);
+
+    thread adder([&merger]() { merger.add(position(1000)); });
+    ASSERT_TRUE(wait_for([]() { return running.load(); }));
+
+    merger.set_handler(nullptr, window, nullptr);
+    EXPECT_TRUE(finished);
+    adder.join();
+}
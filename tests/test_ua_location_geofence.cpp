@@ -0,0 +1,308 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "application/location/geofence_index.h"
+// for evaluate(), which the session calls with every position
+#include "application/location/geofence_p.h"
+#include "application/location/update_filter.h"
+
+#include <ubuntu/application/location/geofence.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+vector<uint32_t> candidates(const detail::GeofenceIndex& index, double latitude, double longitude)
+{
+    vector<uint32_t> ids;
+    index.candidates(latitude, longitude, [&ids](uint32_t id) { ids.push_back(id); });
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+bool has(const vector<uint32_t>& ids, uint32_t id)
+{
+    return find(ids.begin(), ids.end(), id) != ids.end();
+}
+
+struct Transition
+{
+    uint32_t id;
+    UALocationGeofenceTransition transition;
+    uint64_t timestamp;
+};
+
+vector<Transition> transitions;
+
+void record(UALocationGeofenceSet*, uint32_t id, UALocationGeofenceTransition transition,
+            const UALocationPosition* position, void*)
+{
+    transitions.push_back(Transition{id, transition, position->timestamp});
+}
+
+UALocationPosition position(uint64_t timestamp_in_s, double latitude, double longitude)
+{
+    UALocationPosition p{};
+    p.timestamp = timestamp_in_s * 1000000;
+    p.latitude = latitude;
+    p.longitude = longitude;
+    return p;
+}
+
+const uint32_t all_transitions = UA_LOCATION_GEOFENCE_ENTER | UA_LOCATION_GEOFENCE_EXIT | UA_LOCATION_GEOFENCE_DWELL;
+}
+
+TEST(GeofenceIndex, finds_fences_across_the_antimeridian)
+{
+    detail::GeofenceIndex index;
+    // 500m around a point 110m west of the antimeridian
+    index.insert(1, 0, 179.999, 500);
+
+    EXPECT_TRUE(has(candidates(index, 0, 179.999), 1));
+    EXPECT_TRUE(has(candidates(index, 0, -179.999), 1));
+    EXPECT_TRUE(has(candidates(index, 0.002, -179.998), 1));
+    EXPECT_FALSE(has(candidates(index, 0, 0), 1));
+    EXPECT_FALSE(has(candidates(index, 0, -179), 1));
+}
+
+TEST(GeofenceIndex, fences_at_the_poles_cover_all_longitudes)
+{
+    detail::GeofenceIndex index;
+    index.insert(1, 89.999, 0, 1000);
+    index.insert(2, -90, 0, 1000);
+
+    // candidates only, the coarsest level may hold them
+    for (double longitude : {-180., -120., -0.5, 0., 45., 179.9, 180.})
+    {
+        EXPECT_TRUE(has(candidates(index, 89.9995, longitude), 1)) << longitude;
+        EXPECT_TRUE(has(candidates(index, 90, longitude), 1)) << longitude;
+        EXPECT_TRUE(has(candidates(index, -89.9995, longitude), 2)) << longitude;
+        EXPECT_TRUE(has(candidates(index, -90, longitude), 2)) << longitude;
+    }
+}
+
+TEST(GeofenceIndex, small_and_large_fences_are_found_on_their_levels)
+{
+    detail::GeofenceIndex index;
+    // from below the finest cell size to a continent
+    index.insert(1, 52.5, 13.4, 10);
+    index.insert(2, 52.5, 13.4, 5000);
+    index.insert(3, 52.5, 13.4, 2000000);
+
+    vector<uint32_t> center = candidates(index, 52.5, 13.4);
+    EXPECT_EQ(vector<uint32_t>({1, 2, 3}), center);
+
+    // 4.5km north, only the larger ones qualify
+    vector<uint32_t> near = candidates(index, 52.5 + 4500 / 111195., 13.4);
+    EXPECT_FALSE(has(near, 1));
+    EXPECT_TRUE(has(near, 2));
+    EXPECT_TRUE(has(near, 3));
+
+    // 1500km east
+    vector<uint32_t> far = candidates(index, 52.5, 13.4 + 1500000 / (111195. * cos(52.5 * M_PI / 180.)));
+    EXPECT_EQ(vector<uint32_t>({3}), far);
+
+    vector<uint32_t> elsewhere = candidates(index, -33.9, 151.2);
+    EXPECT_FALSE(has(elsewhere, 1));
+    EXPECT_FALSE(has(elsewhere, 2));
+}
+
+TEST(GeofenceIndex, erased_fences_are_gone)
+{
+    detail::GeofenceIndex index;
+    index.insert(1, 52.5, 13.4, 100);
+    index.insert(2, 52.5, 13.4, 100);
+
+    index.erase(1, 52.5, 13.4, 100);
+    EXPECT_EQ(vector<uint32_t>({2}), candidates(index, 52.5, 13.4));
+
+    index.erase(2, 52.5, 13.4, 100);
+    EXPECT_TRUE(candidates(index, 52.5, 13.4).empty());
+}
+
+TEST(GeofenceIndex, candidates_include_every_containing_fence)
+{
+    struct Circle
+    {
+        double latitude;
+        double longitude;
+        double radius;
+    };
+
+    mt19937 rng(42);
+    uniform_real_distribution<double> latitude(-90, 90);
+    uniform_real_distribution<double> longitude(-180, 180);
+    uniform_real_distribution<double> exponent(0, 6.5);
+    uniform_real_distribution<double> offset(-1, 1);
+
+    detail::GeofenceIndex index;
+    vector<Circle> circles;
+    for (uint32_t id = 0; id < 2000; id++)
+    {
+        Circle c{latitude(rng), longitude(rng), pow(10., exponent(rng))};
+        circles.push_back(c);
+        index.insert(id, c.latitude, c.longitude, c.radius);
+    }
+
+    unsigned int contained = 0;
+    for (int i = 0; i < 5000; i++)
+    {
+        // near a fence, so that a fair share of the points lies inside one
+        const Circle& near = circles[rng() % circles.size()];
+        double lat = max(-90., min(90., near.latitude + offset(rng) * near.radius / 111195.));
+        double lon = near.longitude + offset(rng) * near.radius / 111195.;
+        lon = lon > 180 ? lon - 360 : lon < -180 ? lon + 360 : lon;
+
+        vector<uint32_t> ids = candidates(index, lat, lon);
+        for (uint32_t id = 0; id < circles.size(); id++)
+        {
+            const Circle& c = circles[id];
+            if (detail::haversine_distance_in_meter(c.latitude, c.longitude, lat, lon) > c.radius)
+                continue;
+
+            contained++;
+            ASSERT_TRUE(has(ids, id)) << "fence " << id << " at " << lat << ", " << lon;
+        }
+    }
+
+    EXPECT_GT(contained, 250u);
+}
+
+TEST(GeofenceSet, reports_enter_dwell_and_exit)
+{
+    UALocationGeofenceSet* set = ua_location_geofence_set_new();
+    ASSERT_NE(nullptr, set);
+
+    UALocationGeofence fence{7, 52.5, 13.4, 100, all_transitions, 30000};
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_add(set, &fence));
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_set_transition_handler(set, record, nullptr));
+    transitions.clear();
+
+    set->evaluate(position(0, 52.51, 13.4));
+    EXPECT_TRUE(transitions.empty());
+
+    set->evaluate(position(10, 52.5, 13.4));
+    ASSERT_EQ(1u, transitions.size());
+    EXPECT_EQ(7u, transitions[0].id);
+    EXPECT_EQ(UA_LOCATION_GEOFENCE_ENTER, transitions[0].transition);
+
+    // not inside for the dwell time yet
+    set->evaluate(position(39, 52.5, 13.4005));
+    EXPECT_EQ(1u, transitions.size());
+
+    set->evaluate(position(40, 52.5, 13.4));
+    ASSERT_EQ(2u, transitions.size());
+    EXPECT_EQ(UA_LOCATION_GEOFENCE_DWELL, transitions[1].transition);
+    EXPECT_EQ(40000000u, transitions[1].timestamp);
+
+    // once per stay
+    set->evaluate(position(80, 52.5, 13.4));
+    EXPECT_EQ(2u, transitions.size());
+
+    set->evaluate(position(90, 52.51, 13.4));
+    ASSERT_EQ(3u, transitions.size());
+    EXPECT_EQ(UA_LOCATION_GEOFENCE_EXIT, transitions[2].transition);
+
+    set->evaluate(position(100, 52.51, 13.4));
+    EXPECT_EQ(3u, transitions.size());
+
+    ua_location_geofence_set_unref(set);
+}
+
+TEST(GeofenceSet, reports_only_requested_transitions)
+{
+    UALocationGeofenceSet* set = ua_location_geofence_set_new();
+    ASSERT_NE(nullptr, set);
+
+    // dwell time 0 dwells on entry
+    UALocationGeofence fence{1, 0, 179.9995, 200, UA_LOCATION_GEOFENCE_EXIT | UA_LOCATION_GEOFENCE_DWELL, 0};
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_add(set, &fence));
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_set_transition_handler(set, record, nullptr));
+    transitions.clear();
+
+    // entered from the other side of the antimeridian
+    set->evaluate(position(0, 0, -179.9995));
+    ASSERT_EQ(1u, transitions.size());
+    EXPECT_EQ(UA_LOCATION_GEOFENCE_DWELL, transitions[0].transition);
+
+    set->evaluate(position(1, 0, -179.99));
+    ASSERT_EQ(2u, transitions.size());
+    EXPECT_EQ(UA_LOCATION_GEOFENCE_EXIT, transitions[1].transition);
+
+    ua_location_geofence_set_unref(set);
+}
+
+TEST(GeofenceSet, removed_fences_report_nothing)
+{
+    UALocationGeofenceSet* set = ua_location_geofence_set_new();
+    ASSERT_NE(nullptr, set);
+
+    UALocationGeofence fence{1, 52.5, 13.4, 100, all_transitions, 0};
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_add(set, &fence));
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_set_transition_handler(set, record, nullptr));
+    transitions.clear();
+
+    set->evaluate(position(0, 52.5, 13.4));
+    EXPECT_EQ(2u, transitions.size());
+
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_remove(set, 1));
+    EXPECT_EQ(U_STATUS_ERROR, ua_location_geofence_set_remove(set, 1));
+
+    set->evaluate(position(1, 52.51, 13.4));
+    set->evaluate(position(2, 52.5, 13.4));
+    EXPECT_EQ(2u, transitions.size());
+
+    // invalid fences are refused
+    UALocationGeofence invalid{2, 91, 0, 100, all_transitions, 0};
+    EXPECT_EQ(U_STATUS_ERROR, ua_location_geofence_set_add(set, &invalid));
+    invalid = UALocationGeofence{2, 0, 0, 0, all_transitions, 0};
+    EXPECT_EQ(U_STATUS_ERROR, ua_location_geofence_set_add(set, &invalid));
+
+    ua_location_geofence_set_unref(set);
+}
+
+TEST(GeofenceSet, handler_may_release_the_set)
+{
+    static unsigned int calls;
+    calls = 0;
+
+    UALocationGeofenceSet* set = ua_location_geofence_set_new();
+    ASSERT_NE(nullptr, set);
+
+    // entering both reports two transitions, the set has to outlive the first
+    UALocationGeofence a{1, 52.5, 13.4, 100, all_transitions, 0};
+    UALocationGeofence b{2, 52.5, 13.4, 200, all_transitions, 0};
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_add(set, &a));
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_add(set, &b));
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_geofence_set_set_transition_handler(set,
+        [](UALocationGeofenceSet* set, uint32_t, UALocationGeofenceTransition, const UALocationPosition*, void*)
+        {
+            // the only reference, the sanitizers notice the set being used afterwards
+            if (calls++ == 0)
+                ua_location_geofence_set_unref(set);
+        }, nullptr));
+
+    set->evaluate(position(0, 52.5, 13.4));
+    EXPECT_EQ(4u, calls);
+}
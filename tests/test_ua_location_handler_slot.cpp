@@ -0,0 +1,250 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "application/location/handler_slot.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+struct Update
+{
+    int value;
+};
+
+typedef void (*Handler)(Update* update, void* context);
+
+// passes every nth update, all of them for n == 0
+struct EveryNth
+{
+    void reset() { count = 0; }
+    bool accept(int) { return n == 0 || count++ % n == 0; }
+
+    unsigned int n;
+    unsigned int count;
+};
+
+typedef detail::HandlerSlot<Handler, EveryNth> Slot;
+
+vector<int> received;
+
+void record(Update* update, void*)
+{
+    received.push_back(update->value);
+}
+
+/* Every context knows the handler it was installed with, so that a dispatch
+ * mixing up the two is noticed. */
+struct Context
+{
+    int id;
+    atomic<unsigned int>* calls;
+};
+
+atomic<unsigned int> mismatches{0};
+atomic<bool> shut_down{false};
+atomic<unsigned int> calls_after_shutdown{0};
+
+template<int id>
+void checking_handler(Update*, void* context)
+{
+    Context* c = static_cast<Context*>(context);
+    if (c->id != id)
+        mismatches++;
+    if (shut_down)
+        calls_after_shutdown++;
+    (*c->calls)++;
+}
+}
+
+TEST(HandlerSlot, dispatches_to_the_current_handler)
+{
+    Slot slot;
+    received.clear();
+
+    slot.dispatch<Update>(1);
+    EXPECT_TRUE(received.empty());
+
+    slot.update([](Slot::Record& r) { r.handler = record; });
+    slot.dispatch<Update>(2);
+    slot.dispatch<Update>(3);
+    EXPECT_EQ(vector<int>({2, 3}), received);
+
+    slot.update([](Slot::Record& r) { r.handler = nullptr; });
+    slot.dispatch<Update>(4);
+    EXPECT_EQ(vector<int>({2, 3}), received);
+}
+
+TEST(HandlerSlot, filter_restarts_with_every_update)
+{
+    Slot slot;
+    received.clear();
+
+    slot.update([](Slot::Record& r) { r.handler = record; r.filter.n = 2; });
+    for (int i = 1; i <= 4; i++)
+        slot.dispatch<Update>(i);
+    EXPECT_EQ(vector<int>({1, 3}), received);
+
+    // changing only the context still starts filtering over, with the settings kept
+    slot.update([](Slot::Record& r) { r.context = &r; });
+    for (int i = 5; i <= 7; i++)
+        slot.dispatch<Update>(i);
+    EXPECT_EQ(vector<int>({1, 3, 5, 7}), received);
+}
+
+TEST(HandlerSlot, shutdown_waits_for_running_dispatch)
+{
+    Slot slot;
+    static atomic<bool> in_handler{false};
+    static atomic<bool> finished{false};
+
+    slot.update([](Slot::Record& r)
+    {
+        r.handler = [](Update*, void*)
+        {
+            in_handler = true;
+            this_thread::sleep_for(chrono::milliseconds(50));
+            finished = true;
+        };
+    });
+
+    thread dispatcher([&slot]() { slot.dispatch<Update>(1); });
+    while (not in_handler)
+        this_thread::yield();
+
+    slot.shutdown();
+    EXPECT_TRUE(finished);
+    dispatcher.join();
+
+    // detached for good
+    finished = false;
+    slot.dispatch<Update>(2);
+    EXPECT_FALSE(finished);
+}
+
+TEST(HandlerSlot, concurrent_swaps_and_dispatch)
+{
+    Slot slot;
+    atomic<unsigned int> calls{0};
+    Context a{0, &calls};
+    Context b{1, &calls};
+
+    atomic<bool> stop{false};
+    unsigned int dispatches = 0;
+    thread dispatcher([&]()
+    {
+        while (not stop)
+        {
+            slot.dispatch<Update>(int(dispatches));
+            dispatches++;
+        }
+    });
+
+    // replaced and cleared records are freed while the dispatcher may still
+    // use them, which the sanitizers notice if reclamation is off
+    for (int i = 0; i < 20000; i++)
+    {
+        switch (i % 3)
+        {
+            case 0:
+                slot.update([&a](Slot::Record& r) { r.handler = checking_handler<0>; r.context = &a; });
+                break;
+            case 1:
+                slot.update([&b](Slot::Record& r) { r.handler = checking_handler<1>; r.context = &b; });
+                break;
+            default:
+                slot.update([](Slot::Record& r) { r.handler = nullptr; r.context = nullptr; });
+                break;
+        }
+    }
+
+    // the dispatcher has to reach the final handler at least once, however
+    // the threads are scheduled
+    atomic<unsigned int> final_calls{0};
+    Context final_context{0, &final_calls};
+    slot.update([&final_context](Slot::Record& r) { r.handler = checking_handler<0>; r.context = &final_context; });
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (final_calls == 0 && chrono::steady_clock::now() < deadline)
+        this_thread::yield();
+
+    slot.shutdown();
+    shut_down = true;
+
+    this_thread::sleep_for(chrono::milliseconds(10));
+    stop = true;
+    dispatcher.join();
+
+    EXPECT_GT(dispatches, 0u);
+    EXPECT_GT(final_calls.load(), 0u);
+    EXPECT_EQ(0u, mismatches.load());
+    EXPECT_EQ(0u, calls_after_shutdown.load());
+}
+
+TEST(HandlerSlot, handler_may_destroy_its_slot)
+{
+    static Slot* slot;
+    static atomic<unsigned int> destroyed{0};
+
+    slot = new Slot;
+    slot->update([](Slot::Record& r)
+    {
+        r.handler = [](Update*, void*)
+        {
+            // the sanitizers notice the dispatch touching the slot afterwards
+            delete slot;
+            slot = nullptr;
+            destroyed++;
+        };
+    });
+
+    // on another thread, where waiting for the own dispatch never ends
+    thread dispatcher([]() { slot->dispatch<Update>(1); });
+    dispatcher.join();
+
+    EXPECT_EQ(1u, destroyed.load());
+    EXPECT_EQ(nullptr, slot);
+}
+
+TEST(HandlerSlot, handler_may_shut_down_its_slot)
+{
+    Slot slot;
+    static Slot* current;
+    static atomic<unsigned int> handled{0};
+
+    current = &slot;
+    slot.update([](Slot::Record& r)
+    {
+        r.handler = [](Update*, void*)
+        {
+            current->shutdown();
+            handled++;
+        };
+    });
+
+    slot.dispatch<Update>(1);
+    slot.dispatch<Update>(2);
+    EXPECT_EQ(1u, handled.load());
+
+    // no reader left behind
+    slot.shutdown();
+}
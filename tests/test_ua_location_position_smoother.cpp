@@ -0,0 +1,188 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "application/location/position_smoother.h"
+
+#include <chrono>
+#include <cmath>
+
+namespace cul = com::ubuntu::location;
+
+using namespace std;
+
+namespace
+{
+typedef cul::Update<cul::Position> PositionUpdate;
+
+const double meter_per_degree = detail::PositionSmoother::earth_radius * M_PI / 180.;
+const double latitude = 52.5;
+const double longitude = 13.4;
+const cul::Clock::Timestamp start = cul::Clock::now();
+
+/* A fix north meters north of the reference point, t seconds after start. */
+PositionUpdate fix(double t, double north, double accuracy = 5)
+{
+    cul::Position p
+    {
+        cul::wgs84::Latitude{(latitude + north / meter_per_degree) * cul::units::Degrees},
+        cul::wgs84::Longitude{longitude * cul::units::Degrees}
+    };
+    p.accuracy.horizontal = accuracy * cul::units::Meters;
+
+    return PositionUpdate{p, start + chrono::duration_cast<cul::Clock::Timestamp::duration>(chrono::duration<double>(t))};
+}
+
+double north_of(const PositionUpdate& update)
+{
+    return (update.value.latitude.value.value() - latitude) * meter_per_degree;
+}
+
+/* Walks north at 1m/s, one fix per second from t0 on, and returns the time after the last one. */
+double walk(detail::PositionSmoother& smoother, double t0, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        PositionUpdate update = fix(t0 + i, t0 + i);
+        PositionUpdate smoothed = update;
+        EXPECT_TRUE(smoother.smooth(update, smoothed)) << "fix at " << t0 + i;
+    }
+    return t0 + count;
+}
+}
+
+TEST(PositionSmoother, first_fix_passes_unchanged)
+{
+    detail::PositionSmoother smoother;
+    smoother.set_acceleration_noise(1);
+    EXPECT_TRUE(smoother.enabled());
+
+    PositionUpdate update = fix(0, 10);
+    PositionUpdate smoothed = update;
+    ASSERT_TRUE(smoother.smooth(update, smoothed));
+    EXPECT_NEAR(10, north_of(smoothed), 1e-6);
+}
+
+TEST(PositionSmoother, smooths_noise_and_follows_motion)
+{
+    detail::PositionSmoother smoother;
+    smoother.set_acceleration_noise(0.5);
+
+    // walking north at 1m/s with fixes alternating 3m to either side of the track
+    double error_in = 0, error_out = 0;
+    for (int i = 0; i < 60; i++)
+    {
+        double noise = i % 2 ? 3 : -3;
+        PositionUpdate update = fix(i, i + noise);
+        PositionUpdate smoothed = update;
+        ASSERT_TRUE(smoother.smooth(update, smoothed));
+
+        if (i >= 10)
+        {
+            error_in += fabs(noise);
+            error_out += fabs(north_of(smoothed) - i);
+        }
+    }
+
+    EXPECT_LT(error_out, error_in / 2);
+}
+
+TEST(PositionSmoother, rejects_outliers)
+{
+    detail::PositionSmoother smoother;
+    smoother.set_acceleration_noise(0.5);
+    double t = walk(smoother, 0, 20);
+
+    // 500m off with an accuracy of 5m
+    PositionUpdate outlier = fix(t, 500);
+    PositionUpdate smoothed = outlier;
+    EXPECT_FALSE(smoother.smooth(outlier, smoothed));
+
+    // and the track goes on undisturbed
+    PositionUpdate update = fix(t + 1, t + 1);
+    smoothed = update;
+    ASSERT_TRUE(smoother.smooth(update, smoothed));
+    EXPECT_NEAR(t + 1, north_of(smoothed), 2);
+}
+
+TEST(PositionSmoother, restarts_after_max_rejections)
+{
+    detail::PositionSmoother smoother;
+    smoother.set_acceleration_noise(0.5);
+    double t = walk(smoother, 0, 20);
+
+    // reappearing 2km away, as after a tunnel
+    for (unsigned int i = 0; i < detail::PositionSmoother::max_rejections; i++, t++)
+    {
+        PositionUpdate update = fix(t, 2000 + t);
+        PositionUpdate smoothed = update;
+        EXPECT_FALSE(smoother.smooth(update, smoothed)) << i;
+    }
+
+    PositionUpdate update = fix(t, 2000 + t);
+    PositionUpdate smoothed = update;
+    ASSERT_TRUE(smoother.smooth(update, smoothed));
+    EXPECT_NEAR(2000 + t, north_of(smoothed), 1e-6);
+
+    // tracking from there on
+    update = fix(t + 1, 2000 + t + 1);
+    smoothed = update;
+    EXPECT_TRUE(smoother.smooth(update, smoothed));
+}
+
+TEST(PositionSmoother, fixes_going_back_in_time_count_as_rejections)
+{
+    detail::PositionSmoother smoother;
+    smoother.set_acceleration_noise(0.5);
+    double t = walk(smoother, 100, 20);
+
+    // a single late fix is dropped
+    PositionUpdate late = fix(t - 5, t - 5);
+    PositionUpdate smoothed = late;
+    EXPECT_FALSE(smoother.smooth(late, smoothed));
+    t = walk(smoother, t, 1);
+
+    // a clock that jumped back restarts the filter
+    for (unsigned int i = 0; i < detail::PositionSmoother::max_rejections; i++)
+    {
+        PositionUpdate update = fix(i, 50 + i);
+        smoothed = update;
+        EXPECT_FALSE(smoother.smooth(update, smoothed)) << i;
+    }
+
+    PositionUpdate update = fix(10, 60);
+    smoothed = update;
+    ASSERT_TRUE(smoother.smooth(update, smoothed));
+    EXPECT_NEAR(60, north_of(smoothed), 1e-6);
+
+    update = fix(11, 61);
+    smoothed = update;
+    EXPECT_TRUE(smoother.smooth(update, smoothed));
+}
+
+TEST(PositionSmoother, reset_restarts_with_the_next_fix)
+{
+    detail::PositionSmoother smoother;
+    smoother.set_acceleration_noise(0.5);
+    double t = walk(smoother, 0, 10);
+
+    smoother.reset();
+    PositionUpdate update = fix(t, 1000);
+    PositionUpdate smoothed = update;
+    ASSERT_TRUE(smoother.smooth(update, smoothed));
+    EXPECT_NEAR(1000, north_of(smoothed), 1e-6);
+}
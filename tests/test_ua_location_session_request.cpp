@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "standin_services.h"
+
+#include <ubuntu/application/location/position_update.h>
+#include <ubuntu/application/location/service.h>
+#include <ubuntu/application/location/session.h>
+
+#include <core/dbus/fixture.h>
+
+#include <com/ubuntu/location/position.h>
+#include <com/ubuntu/location/update.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+using namespace std;
+
+namespace cul = com::ubuntu::location;
+
+namespace
+{
+bool wait_for(const function<bool()>& condition, chrono::milliseconds timeout = chrono::seconds(5))
+{
+    auto deadline = chrono::steady_clock::now() + timeout;
+    while (!condition())
+    {
+        if (chrono::steady_clock::now() > deadline)
+            return false;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return true;
+}
+
+/* What a handler was invoked with; freed by the tests to catch invocations
+ * after the request was destroyed. */
+struct Outcome
+{
+    atomic<unsigned int> calls{0};
+    atomic<bool> running{false};
+    atomic<bool> finished{false};
+    UALocationServiceSession* session = nullptr;
+    UALocationServiceError error = UA_LOCATION_SERVICE_ERROR_NONE;
+    UALocationServiceSessionRequest* request = nullptr;
+    chrono::milliseconds linger{0};
+};
+
+void on_created(UALocationServiceSession* session, UALocationServiceError error, void* context)
+{
+    Outcome* outcome = static_cast<Outcome*>(context);
+    outcome->running = true;
+    this_thread::sleep_for(outcome->linger);
+
+    outcome->session = session;
+    outcome->error = error;
+    outcome->finished = true;
+    outcome->calls++;
+}
+
+void on_created_destroying_request(UALocationServiceSession* session, UALocationServiceError error, void* context)
+{
+    Outcome* outcome = static_cast<Outcome*>(context);
+    ua_location_service_session_request_destroy(outcome->request);
+    on_created(session, error, context);
+}
+
+/* Holds the only reference to a session, dropped by its position handler. */
+struct LastReference
+{
+    UALocationServiceSession* session = nullptr;
+    atomic<unsigned int> calls{0};
+};
+
+void on_position_dropping_session(UALocationPositionUpdate*, void* context)
+{
+    LastReference* last = static_cast<LastReference*>(context);
+    if (last->calls++ == 0)
+        ua_location_service_session_unref(last->session);
+}
+
+cul::Update<cul::Position> position_update()
+{
+    return cul::Update<cul::Position>
+    {
+        cul::Position
+        {
+            cul::wgs84::Latitude{52.5 * cul::units::Degrees},
+            cul::wgs84::Longitude{13.4 * cul::units::Degrees}
+        },
+        cul::Clock::now()
+    };
+}
+}
+
+/* The stand-in location service runs on a private system bus, shared by all
+ * tests as the library resolves the service only once. */
+class SessionRequestTest : public testing::Test
+{
+  protected:
+    static void SetUpTestCase()
+    {
+        fixture = new core::dbus::Fixture
+        {
+            core::dbus::Fixture::default_session_bus_config_file(),
+            core::dbus::Fixture::default_system_bus_config_file()
+        };
+        system_bus = new standin::Dispatcher{fixture->create_connection_to_system_bus()};
+        location = new standin::LocationService{system_bus->bus};
+    }
+
+    static void TearDownTestCase()
+    {
+        delete location;
+        delete system_bus;
+        delete fixture;
+    }
+
+    virtual void SetUp()
+    {
+        location->session_delay_ms = 0;
+    }
+
+    static core::dbus::Fixture* fixture;
+    static standin::Dispatcher* system_bus;
+    static standin::LocationService* location;
+};
+
+core::dbus::Fixture* SessionRequestTest::fixture = nullptr;
+standin::Dispatcher* SessionRequestTest::system_bus = nullptr;
+standin::LocationService* SessionRequestTest::location = nullptr;
+
+TEST_F(SessionRequestTest, refuses_a_missing_handler)
+{
+    EXPECT_EQ(nullptr, ua_location_service_create_session_async(0, nullptr, nullptr));
+    ua_location_service_session_request_destroy(nullptr);
+}
+
+TEST_F(SessionRequestTest, hands_over_the_new_session)
+{
+    Outcome outcome;
+    auto request = ua_location_service_create_session_async(0, on_created, &outcome);
+    ASSERT_NE(nullptr, request);
+
+    ASSERT_TRUE(wait_for([&outcome]() { return outcome.finished.load(); }));
+    EXPECT_EQ(1u, outcome.calls.load());
+    EXPECT_EQ(UA_LOCATION_SERVICE_ERROR_NONE, outcome.error);
+    ASSERT_NE(nullptr, outcome.session);
+
+    ua_location_service_session_request_destroy(request);
+    ua_location_service_session_unref(outcome.session);
+}
+
+TEST_F(SessionRequestTest, cancelled_request_never_calls_back)
+{
+    location->session_delay_ms = 200;
+    auto created = location->created_sessions();
+
+    Outcome* outcome = new Outcome;
+    auto request = ua_location_service_create_session_async(0, on_created, outcome);
+    ASSERT_NE(nullptr, request);
+
+    ua_location_service_session_request_destroy(request);
+    unsigned int calls = outcome->calls;
+    // freed right away, the sanitizers notice a late invocation
+    delete outcome;
+    EXPECT_EQ(0u, calls);
+
+    // the service still answers, the library drops the session
+    EXPECT_TRUE(wait_for([created]() { return location->created_sessions() > created; }));
+}
+
+TEST_F(SessionRequestTest, destroy_waits_for_running_handler)
+{
+    Outcome outcome;
+    outcome.linger = chrono::milliseconds(100);
+
+    auto request = ua_location_service_create_session_async(0, on_created, &outcome);
+    ASSERT_NE(nullptr, request);
+    ASSERT_TRUE(wait_for([&outcome]() { return outcome.running.load(); }));
+
+    ua_location_service_session_request_destroy(request);
+    EXPECT_TRUE(outcome.finished);
+
+    if (outcome.session)
+        ua_location_service_session_unref(outcome.session);
+}
+
+TEST_F(SessionRequestTest, handler_may_destroy_its_request)
+{
+    Outcome outcome;
+    // handed over before the service can answer
+    location->session_delay_ms = 100;
+    outcome.request = ua_location_service_create_session_async(0, on_created_destroying_request, &outcome);
+    ASSERT_NE(nullptr, outcome.request);
+
+    ASSERT_TRUE(wait_for([&outcome]() { return outcome.finished.load(); }));
+    EXPECT_EQ(1u, outcome.calls.load());
+
+    if (outcome.session)
+        ua_location_service_session_unref(outcome.session);
+}
+
+TEST_F(SessionRequestTest, handler_may_drop_the_last_session_reference)
+{
+    LastReference last;
+    last.session = ua_location_service_create_session_for_high_accuracy(0);
+    ASSERT_NE(nullptr, last.session);
+
+    ua_location_service_session_set_position_updates_handler(last.session, on_position_dropping_session, &last);
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_location_service_session_start_position_updates(last.session));
+    ASSERT_TRUE(wait_for([]() { return location->active_sessions() > 0; }));
+
+    // the session goes away on the bus thread, within the first update
+    location->publish(position_update());
+    ASSERT_TRUE(wait_for([&last]() { return last.calls.load() > 0; }));
+
+    // later updates find no session anymore, the sanitizers notice if they do
+    location->publish(position_update());
+    this_thread::sleep_for(chrono::milliseconds(50));
+    EXPECT_EQ(1u, last.calls.load());
+}
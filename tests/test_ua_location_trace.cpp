@@ -0,0 +1,124 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "application/location/trace.h"
+
+using namespace std;
+
+TEST(LocationTrace, gpx_track)
+{
+    istringstream in{
+        "<?xml version=\"1.0\"?>\n"
+        "<gpx version=\"1.1\" xmlns:gpxtpx=\"http://www.garmin.com/xmlschemas/TrackPointExtension/v2\">\n"
+        " <trk><trkseg>\n"
+        "  <trkpt lat=\"52.5\" lon=\"13.4\"><ele>34.5</ele><time>2020-05-01T12:00:00Z</time></trkpt>\n"
+        "  <trkpt lon='13.4' lat='52.5001'><time>2020-05-01T14:00:02+02:00</time><hdop>2</hdop></trkpt>\n"
+        "  <trkpt\n lat=\"52.5001\" lon=\"13.4\"><time>2020-05-01T12:00:04.5Z</time>\n"
+        "   <extensions><gpxtpx:TrackPointExtension><gpxtpx:speed>1.5</gpxtpx:speed><gpxtpx:course>270</gpxtpx:course>"
+        "</gpxtpx:TrackPointExtension></extensions></trkpt>\n"
+        " </trkseg></trk>\n"
+        "</gpx>\n"};
+
+    vector<detail::TraceSample> samples = detail::parse_gpx(in);
+    ASSERT_EQ(3u, samples.size());
+
+    EXPECT_DOUBLE_EQ(0, samples[0].time);
+    EXPECT_DOUBLE_EQ(52.5, samples[0].latitude);
+    EXPECT_DOUBLE_EQ(13.4, samples[0].longitude);
+    EXPECT_TRUE(samples[0].has_altitude);
+    EXPECT_DOUBLE_EQ(34.5, samples[0].altitude);
+    EXPECT_FALSE(samples[0].has_accuracy);
+
+    // derived from the first leg, 11.1m north in 2s
+    EXPECT_NEAR(5.56, samples[0].speed, 0.01);
+    EXPECT_TRUE(samples[0].has_course);
+    EXPECT_NEAR(0, samples[0].course, 1e-6);
+
+    EXPECT_DOUBLE_EQ(2, samples[1].time);
+    EXPECT_TRUE(samples[1].has_accuracy);
+    EXPECT_DOUBLE_EQ(10, samples[1].accuracy);
+
+    EXPECT_DOUBLE_EQ(4.5, samples[2].time);
+    EXPECT_DOUBLE_EQ(1.5, samples[2].speed);
+    EXPECT_DOUBLE_EQ(270, samples[2].course);
+}
+
+TEST(LocationTrace, gpx_route_without_time)
+{
+    istringstream in{
+        "<gpx><rte>"
+        "<rtept lat=\"1\" lon=\"2\"/>"
+        "<rtept lat=\"1\" lon=\"2\"/>"
+        "</rte></gpx>"};
+
+    vector<detail::TraceSample> samples = detail::parse_gpx(in);
+    ASSERT_EQ(2u, samples.size());
+    EXPECT_DOUBLE_EQ(1, samples[1].time);
+    EXPECT_DOUBLE_EQ(0, samples[1].speed);
+    EXPECT_FALSE(samples[1].has_course);
+}
+
+TEST(LocationTrace, nmea_log)
+{
+    istringstream in{
+        "$GPGGA,235959.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*65\n"
+        "$GPRMC,235959.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*48\n"
+        "$GPGGA,000000.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*64\n"
+        // bad checksum
+        "$GPRMC,000001.00,A,4807.038,N,01131.000,E,022.4,084.4,240394,003.1,W*00\n"
+        // no fix
+        "$GPRMC,000002.00,V,,,,,,,240394,,*15\n"
+        "$GPRMC,000003.00,A,4807.038,S,01131.000,W,000.0,,240394,003.1,W*60\n"};
+
+    vector<detail::TraceSample> samples = detail::parse_nmea(in);
+    ASSERT_EQ(3u, samples.size());
+
+    EXPECT_DOUBLE_EQ(0, samples[0].time);
+    EXPECT_NEAR(48.1173, samples[0].latitude, 1e-4);
+    EXPECT_NEAR(11.5167, samples[0].longitude, 1e-4);
+    EXPECT_DOUBLE_EQ(545.4, samples[0].altitude);
+    EXPECT_DOUBLE_EQ(4.5, samples[0].accuracy);
+    EXPECT_NEAR(22.4 * 1852 / 3600, samples[0].speed, 1e-9);
+    EXPECT_DOUBLE_EQ(84.4, samples[0].course);
+
+    // past midnight without a date
+    EXPECT_DOUBLE_EQ(1, samples[1].time);
+    EXPECT_DOUBLE_EQ(4, samples[2].time);
+    EXPECT_NEAR(-48.1173, samples[2].latitude, 1e-4);
+    EXPECT_NEAR(-11.5167, samples[2].longitude, 1e-4);
+}
+
+TEST(LocationTrace, nmea_log_dated_late)
+{
+    // checksums left out, they are optional
+    istringstream in{
+        "$GPGGA,235958.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,\n"
+        "$GPGGA,235959.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,\n"
+        "$GPGGA,000000.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,\n"
+        // the first date, of the day after the first fix
+        "$GPRMC,000001.00,A,4807.038,N,01131.000,E,000.0,084.4,240394,003.1,W\n"
+        "$GPGGA,000002.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,\n"};
+
+    vector<detail::TraceSample> samples = detail::parse_nmea(in);
+    ASSERT_EQ(5u, samples.size());
+
+    for (size_t i = 0; i < samples.size(); i++)
+        EXPECT_DOUBLE_EQ(i, samples[i].time) << i;
+}
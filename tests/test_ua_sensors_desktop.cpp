@@ -0,0 +1,551 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <core/testing/fork_and_run.h>
+
+#include "gtest/gtest.h"
+
+#include <ubuntu/application/sensors/accelerometer.h>
+#include <ubuntu/application/sensors/event/accelerometer.h>
+#include <ubuntu/application/sensors/gyroscope.h>
+#include <ubuntu/application/sensors/light.h>
+#include <ubuntu/application/sensors/pressure.h>
+#include <ubuntu/application/sensors/event/pressure.h>
+#include <ubuntu/application/sensors/proximity.h>
+#include <ubuntu/application/sensors/event/proximity.h>
+
+#include <linux/input.h>
+
+using namespace std;
+
+
+/*******************************************
+ *
+ * Tests with a fake IIO sysfs tree
+ *
+ *******************************************/
+
+struct event {
+    uint64_t timestamp;
+    float x, y, z;
+};
+queue<struct event> events;
+mutex events_guard;
+
+void push_event(uint64_t timestamp, float x, float y, float z)
+{
+    struct event e;
+    e.timestamp = timestamp;
+    e.x = x;
+    e.y = y;
+    e.z = z;
+
+    lock_guard<mutex> lock(events_guard);
+    events.push(e);
+}
+
+class IIOBackendTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        snprintf(root, sizeof(root), "%s", "/tmp/iio_test.XXXXXX");
+        if (mkdtemp(root) == NULL) {
+            perror("mkdtemp");
+            abort();
+        }
+        setenv("UBUNTU_PLATFORM_API_IIO_ROOT", root, 1);
+
+        mkdirs("/sys/bus/iio/devices");
+        mkdirs("/dev");
+
+        // accelerometer with its own trigger and timestamps
+        create_device(0, "test-accel");
+        for (const char* axis : {"x", "y", "z"})
+            create_channel(0, string("in_accel_") + axis, string(1, char('0' + (axis[0] - 'x'))), "le:s16/16>>0");
+        create_channel(0, "in_timestamp", "3", "le:s64/64>>0");
+        set_attribute("/sys/bus/iio/devices/iio:device0/in_accel_scale", "0.01");
+        set_attribute("/sys/bus/iio/devices/iio:device0/sampling_frequency", "25");
+        set_attribute("/sys/bus/iio/devices/iio:device0/sampling_frequency_available", "12.5 25 50 100");
+        set_attribute("/sys/bus/iio/devices/iio:device0/current_timestamp_clock", "monotonic");
+        mkdirs("/sys/bus/iio/devices/trigger0");
+        set_attribute("/sys/bus/iio/devices/trigger0/name", "test-accel-dev0");
+
+        // barometer, 12 bit big endian value in the upper bits, no timestamps
+        create_device(1, "test-baro");
+        create_channel(1, "in_pressure", "0", "be:u12/16>>4");
+        set_attribute("/sys/bus/iio/devices/iio:device1/in_pressure_scale", "0.05");
+
+        while (events.size() > 0)
+            events.pop();
+    }
+
+    virtual void TearDown()
+    {
+        string cmd = string("rm -rf ") + root;
+        if (system(cmd.c_str()) != 0)
+            perror("cleaning up fake IIO tree");
+    }
+
+    void mkdirs(const string& path)
+    {
+        string cmd = string("mkdir -p ") + root + path;
+        if (system(cmd.c_str()) != 0)
+            abort();
+    }
+
+    void set_attribute(const string& path, const string& value)
+    {
+        ofstream f(root + path);
+        f << value << endl;
+    }
+
+    string attribute(const string& path)
+    {
+        ifstream f(root + path);
+        string value;
+        getline(f, value);
+        return value;
+    }
+
+    void create_device(int n, const string& name)
+    {
+        string dir = "/sys/bus/iio/devices/iio:device" + to_string(n);
+        mkdirs(dir + "/scan_elements");
+        mkdirs(dir + "/buffer");
+        mkdirs(dir + "/trigger");
+        set_attribute(dir + "/name", name);
+        set_attribute(dir + "/buffer/enable", "0");
+        set_attribute(dir + "/buffer/length", "2");
+        set_attribute(dir + "/trigger/current_trigger", "");
+
+        // the character device is a FIFO the tests feed with scans
+        string node = string(root) + "/dev/iio:device" + to_string(n);
+        if (mkfifo(node.c_str(), 0600) < 0)
+            abort();
+    }
+
+    void create_channel(int n, const string& name, const string& index, const string& type)
+    {
+        string dir = "/sys/bus/iio/devices/iio:device" + to_string(n) + "/scan_elements/";
+        set_attribute(dir + name + "_en", "0");
+        set_attribute(dir + name + "_index", index);
+        set_attribute(dir + name + "_type", type);
+    }
+
+    // keeps the FIFO open for writing, so that the reader never sees EOF
+    int open_device(int n)
+    {
+        string node = string(root) + "/dev/iio:device" + to_string(n);
+        return open(node.c_str(), O_RDWR);
+    }
+
+    char root[100];
+};
+
+// accelerometer scan: three s16 values, padding, s64 timestamp
+struct __attribute__((packed)) AccelScan {
+    int16_t x, y, z;
+    int16_t padding;
+    int64_t timestamp;
+};
+
+AccelScan accel_scan(int16_t x, int16_t y, int16_t z, int64_t timestamp)
+{
+    AccelScan scan;
+    scan.x = x;
+    scan.y = y;
+    scan.z = z;
+    scan.padding = 0;
+    scan.timestamp = timestamp;
+    return scan;
+}
+
+TESTP_F(IIOBackendTest, Discovery, {
+    EXPECT_EQ(NULL, ua_sensors_gyroscope_new());
+    EXPECT_EQ(NULL, ua_sensors_light_new());
+
+    UASensorsAccelerometer *s = ua_sensors_accelerometer_new();
+    EXPECT_TRUE(s != NULL);
+
+    float min = 0.f; ua_sensors_accelerometer_get_min_value(s, &min);
+    float max = 0.f; ua_sensors_accelerometer_get_max_value(s, &max);
+    float res = 0.f; ua_sensors_accelerometer_get_resolution(s, &res);
+
+    EXPECT_FLOAT_EQ(-327.68, min);
+    EXPECT_FLOAT_EQ(327.67, max);
+    EXPECT_FLOAT_EQ(0.01, res);
+    EXPECT_EQ(10u, ua_sensors_accelerometer_get_min_delay(s));
+
+    UASensorsPressure *p = ua_sensors_pressure_new();
+    EXPECT_TRUE(p != NULL);
+    ua_sensors_pressure_get_max_value(p, &max);
+    // 4095 * 0.05 kPa in hPa
+    EXPECT_FLOAT_EQ(2047.5, max);
+})
+
+TESTP_F(IIOBackendTest, AccelEvents, {
+    UASensorsAccelerometer *s = ua_sensors_accelerometer_new();
+    ASSERT_TRUE(s != NULL);
+
+    ua_sensors_accelerometer_set_reading_cb(s,
+        [](UASAccelerometerEvent* ev, void*) {
+            float x; uas_accelerometer_event_get_acceleration_x(ev, &x);
+            float y; uas_accelerometer_event_get_acceleration_y(ev, &y);
+            float z; uas_accelerometer_event_get_acceleration_z(ev, &z);
+
+            push_event(uas_accelerometer_event_get_timestamp(ev), x, y, z);
+        }, NULL);
+
+    // 30 Hz is rounded up to the next available frequency
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_set_event_rate(s, 1000000000 / 30));
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_enable(s));
+
+    const string dir = "/sys/bus/iio/devices/iio:device0/";
+    EXPECT_EQ("1", attribute(dir + "buffer/enable"));
+    EXPECT_EQ("1", attribute(dir + "scan_elements/in_accel_x_en"));
+    EXPECT_EQ("1", attribute(dir + "scan_elements/in_timestamp_en"));
+    EXPECT_EQ("50", attribute(dir + "sampling_frequency"));
+    EXPECT_EQ("test-accel-dev0", attribute(dir + "trigger/current_trigger"));
+
+    // two scans with a single write, as the kernel would hand them out
+    int fd = open_device(0);
+    ASSERT_GE(fd, 0);
+    AccelScan scans[2];
+    scans[0] = accel_scan(100, -200, 981, 1000000000);
+    scans[1] = accel_scan(-1, 0, 32767, 1020000000);
+    ASSERT_EQ(ssize_t(sizeof(scans)), write(fd, scans, sizeof(scans)));
+
+    usleep(100000);
+    ASSERT_EQ(2u, events.size());
+
+    auto e = events.front();
+    events.pop();
+    EXPECT_EQ(1000000000u, e.timestamp);
+    EXPECT_FLOAT_EQ(1.0, e.x);
+    EXPECT_FLOAT_EQ(-2.0, e.y);
+    EXPECT_FLOAT_EQ(9.81, e.z);
+
+    e = events.front();
+    events.pop();
+    EXPECT_EQ(1020000000u, e.timestamp);
+    EXPECT_FLOAT_EQ(-0.01, e.x);
+    EXPECT_FLOAT_EQ(327.67, e.z);
+
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_disable(s));
+    EXPECT_EQ("0", attribute(dir + "buffer/enable"));
+
+    // nothing is delivered after disabling
+    ASSERT_EQ(ssize_t(sizeof(scans[0])), write(fd, scans, sizeof(scans[0])));
+    usleep(50000);
+    EXPECT_EQ(0u, events.size());
+    close(fd);
+})
+
+TESTP_F(IIOBackendTest, ReconfigureFromCallback, {
+    UASensorsAccelerometer *s = ua_sensors_accelerometer_new();
+    UASensorsPressure *p = ua_sensors_pressure_new();
+    ASSERT_TRUE(s != NULL);
+    ASSERT_TRUE(p != NULL);
+
+    // every reading switches the rate, while the main thread reconfigures
+    // the same and another device at the same time
+    ua_sensors_accelerometer_set_reading_cb(s,
+        [](UASAccelerometerEvent* ev, void* context) {
+            static bool fast = false;
+            fast = !fast;
+            ua_sensors_accelerometer_set_event_rate(static_cast<UASensorsAccelerometer*>(context),
+                                                     fast ? 10000000 : 80000000);
+            push_event(uas_accelerometer_event_get_timestamp(ev), 0, 0, 0);
+        }, s);
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_enable(s));
+
+    int fd = open_device(0);
+    ASSERT_GE(fd, 0);
+
+    atomic<bool> writing(true);
+    thread writer([fd, &writing]() {
+        for (int64_t i = 0; writing; i++)
+        {
+            AccelScan scan = accel_scan(i, 0, 0, 1000000000 + i);
+            if (write(fd, &scan, sizeof(scan)) != sizeof(scan))
+                break;
+            usleep(100);
+        }
+    });
+
+    for (int i = 0; i < 2000; i++)
+    {
+        ua_sensors_accelerometer_set_event_rate(s, 40000000);
+        if (i % 10 == 0)
+        {
+            ua_sensors_pressure_enable(p);
+            ua_sensors_pressure_disable(p);
+        }
+    }
+
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_disable(s));
+    writing = false;
+    writer.join();
+    EXPECT_EQ("0", attribute("/sys/bus/iio/devices/iio:device0/buffer/enable"));
+    {
+        lock_guard<mutex> lock(events_guard);
+        EXPECT_GT(events.size(), 0u);
+        while (events.size() > 0)
+            events.pop();
+    }
+
+    // nothing is delivered after disabling
+    AccelScan scan = accel_scan(1, 2, 3, 2000000000);
+    ASSERT_EQ(ssize_t(sizeof(scan)), write(fd, &scan, sizeof(scan)));
+    usleep(50000);
+    EXPECT_EQ(0u, events.size());
+    close(fd);
+})
+
+TESTP_F(IIOBackendTest, PressureEvents, {
+    UASensorsPressure *s = ua_sensors_pressure_new();
+    ASSERT_TRUE(s != NULL);
+
+    ua_sensors_pressure_set_reading_cb(s,
+        [](UASPressureEvent* ev, void*) {
+            float pressure; uas_pressure_event_get_pressure(ev, &pressure);
+
+            push_event(uas_pressure_event_get_timestamp(ev), pressure, 0, 0);
+        }, NULL);
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_pressure_enable(s));
+    EXPECT_EQ("1", attribute("/sys/bus/iio/devices/iio:device1/scan_elements/in_pressure_en"));
+
+    int fd = open_device(1);
+    ASSERT_GE(fd, 0);
+    // raw value 2026 in the upper 12 bits, big endian
+    uint8_t scan[2];
+    scan[0] = 0x7e;
+    scan[1] = 0xa0;
+    ASSERT_EQ(2, write(fd, scan, sizeof(scan)));
+
+    usleep(100000);
+    ASSERT_EQ(1u, events.size());
+
+    auto e = events.front();
+    // 2026 * 0.05 kPa in hPa
+    EXPECT_FLOAT_EQ(1013.0, e.x);
+    // without a timestamp channel, the time of arrival is used
+    EXPECT_GT(e.timestamp, 0u);
+    close(fd);
+})
+
+
+/*******************************************
+ *
+ * Tests with input event streams
+ *
+ *******************************************/
+
+class EvdevBackendTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        snprintf(root, sizeof(root), "%s", "/tmp/evdev_test.XXXXXX");
+        if (mkdtemp(root) == NULL) {
+            perror("mkdtemp");
+            abort();
+        }
+
+        // hide real IIO devices, they would take precedence
+        setenv("UBUNTU_PLATFORM_API_IIO_ROOT", root, 1);
+
+        accel_path = string(root) + "/accel";
+        proximity_path = string(root) + "/proximity";
+        if (mkfifo(accel_path.c_str(), 0600) < 0 || mkfifo(proximity_path.c_str(), 0600) < 0)
+            abort();
+        setenv("UBUNTU_PLATFORM_API_EVDEV_ACCELEROMETER", accel_path.c_str(), 1);
+        setenv("UBUNTU_PLATFORM_API_EVDEV_PROXIMITY", proximity_path.c_str(), 1);
+
+        while (events.size() > 0)
+            events.pop();
+    }
+
+    virtual void TearDown()
+    {
+        string cmd = string("rm -rf ") + root;
+        if (system(cmd.c_str()) != 0)
+            perror("cleaning up event streams");
+    }
+
+    void emit(int fd, uint16_t type, uint16_t code, int32_t value, uint64_t timestamp_us)
+    {
+        struct input_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.input_event_sec = timestamp_us / 1000000;
+        ev.input_event_usec = timestamp_us % 1000000;
+        ev.type = type;
+        ev.code = code;
+        ev.value = value;
+        if (write(fd, &ev, sizeof(ev)) != sizeof(ev))
+            abort();
+    }
+
+    void accel_frame(int fd, int32_t x, int32_t y, int32_t z, uint64_t timestamp_us)
+    {
+        emit(fd, EV_ABS, ABS_X, x, timestamp_us);
+        emit(fd, EV_ABS, ABS_Y, y, timestamp_us);
+        emit(fd, EV_ABS, ABS_Z, z, timestamp_us);
+        emit(fd, EV_SYN, SYN_REPORT, 0, timestamp_us);
+    }
+
+    static void on_accel_event(UASAccelerometerEvent* ev, void*)
+    {
+        float x; uas_accelerometer_event_get_acceleration_x(ev, &x);
+        float y; uas_accelerometer_event_get_acceleration_y(ev, &y);
+        float z; uas_accelerometer_event_get_acceleration_z(ev, &z);
+        push_event(uas_accelerometer_event_get_timestamp(ev), x, y, z);
+    }
+
+    char root[100];
+    string accel_path;
+    string proximity_path;
+};
+
+// without a reported range, 16 bit values spanning +-2g are assumed
+const float g_per_unit = 9.80665 / 16384;
+
+TESTP_F(EvdevBackendTest, Discovery, {
+    UASensorsAccelerometer *s = ua_sensors_accelerometer_new();
+    EXPECT_TRUE(s != NULL);
+
+    float min = 0.f; ua_sensors_accelerometer_get_min_value(s, &min);
+    float max = 0.f; ua_sensors_accelerometer_get_max_value(s, &max);
+    float res = 0.f; ua_sensors_accelerometer_get_resolution(s, &res);
+
+    EXPECT_FLOAT_EQ(-32768 * g_per_unit, min);
+    EXPECT_FLOAT_EQ(32767 * g_per_unit, max);
+    EXPECT_FLOAT_EQ(g_per_unit, res);
+
+    UASensorsProximity *p = ua_sensors_proximity_new();
+    EXPECT_TRUE(p != NULL);
+    ua_sensors_proximity_get_max_value(p, &max);
+    EXPECT_FLOAT_EQ(1.0, max);
+})
+
+TESTP_F(EvdevBackendTest, AccelFrames, {
+    UASensorsAccelerometer *s = ua_sensors_accelerometer_new();
+    ASSERT_TRUE(s != NULL);
+    ua_sensors_accelerometer_set_reading_cb(s, on_accel_event, NULL);
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_enable(s));
+
+    int fd = open(accel_path.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+
+    accel_frame(fd, 16384, 0, -16384, 1000000);
+    // only changed axes are reported, the others keep their values
+    emit(fd, EV_ABS, ABS_X, 8192, 1020000);
+    emit(fd, EV_SYN, SYN_REPORT, 0, 1020000);
+    // an incomplete frame is dropped
+    emit(fd, EV_ABS, ABS_Y, 100, 1040000);
+    emit(fd, EV_SYN, SYN_DROPPED, 0, 1040000);
+    emit(fd, EV_SYN, SYN_REPORT, 0, 1040000);
+    emit(fd, EV_SYN, SYN_REPORT, 0, 1060000);
+
+    usleep(100000);
+    ASSERT_EQ(3u, events.size());
+
+    auto e = events.front();
+    events.pop();
+    EXPECT_EQ(1000000000u, e.timestamp);
+    EXPECT_FLOAT_EQ(9.80665, e.x);
+    EXPECT_FLOAT_EQ(0.0, e.y);
+    EXPECT_FLOAT_EQ(-9.80665, e.z);
+
+    e = events.front();
+    events.pop();
+    EXPECT_EQ(1020000000u, e.timestamp);
+    EXPECT_FLOAT_EQ(9.80665 / 2, e.x);
+    EXPECT_FLOAT_EQ(-9.80665, e.z);
+
+    e = events.front();
+    events.pop();
+    EXPECT_EQ(1060000000u, e.timestamp);
+    EXPECT_FLOAT_EQ(100 * g_per_unit, e.y);
+
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_disable(s));
+    close(fd);
+})
+
+TESTP_F(EvdevBackendTest, Throttling, {
+    UASensorsAccelerometer *s = ua_sensors_accelerometer_new();
+    ASSERT_TRUE(s != NULL);
+    ua_sensors_accelerometer_set_reading_cb(s, on_accel_event, NULL);
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_set_event_rate(s, 50000000));
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_enable(s));
+
+    int fd = open(accel_path.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+
+    // the driver reports at 100 Hz, 20 Hz were requested
+    for (int i = 0; i <= 10; i++)
+        accel_frame(fd, i, 0, 0, 1000000 + i * 10000);
+
+    usleep(100000);
+    ASSERT_EQ(3u, events.size());
+    EXPECT_EQ(1000000000u, events.front().timestamp);
+    events.pop();
+    EXPECT_EQ(1040000000u, events.front().timestamp);
+    events.pop();
+    EXPECT_EQ(1080000000u, events.front().timestamp);
+    close(fd);
+})
+
+TESTP_F(EvdevBackendTest, ProximityEvents, {
+    UASensorsProximity *s = ua_sensors_proximity_new();
+    ASSERT_TRUE(s != NULL);
+
+    ua_sensors_proximity_set_reading_cb(s,
+        [](UASProximityEvent* ev, void*) {
+            push_event(uas_proximity_event_get_timestamp(ev), uas_proximity_event_get_distance(ev), 0, 0);
+        }, NULL);
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_proximity_enable(s));
+
+    int fd = open(proximity_path.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    emit(fd, EV_ABS, ABS_DISTANCE, 0, 2000000);
+    emit(fd, EV_SYN, SYN_REPORT, 0, 2000000);
+    emit(fd, EV_ABS, ABS_DISTANCE, 1, 3000000);
+    emit(fd, EV_SYN, SYN_REPORT, 0, 3000000);
+
+    usleep(100000);
+    ASSERT_EQ(2u, events.size());
+    EXPECT_EQ(U_PROXIMITY_NEAR, events.front().x);
+    events.pop();
+    EXPECT_EQ(U_PROXIMITY_FAR, events.front().x);
+    EXPECT_EQ(3000000000u, events.front().timestamp);
+    close(fd);
+})
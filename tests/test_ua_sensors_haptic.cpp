@@ -0,0 +1,313 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "standin_services.h"
+
+#include <ubuntu/application/sensors/haptic.h>
+
+#include <core/dbus/fixture.h>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+// the longest pattern merged into a single request by the library
+const size_t max_merged_pattern_size = 1024;
+
+bool wait_for(const function<bool()>& condition, chrono::milliseconds timeout = chrono::seconds(5))
+{
+    auto deadline = chrono::steady_clock::now() + timeout;
+    while (!condition())
+    {
+        if (chrono::steady_clock::now() > deadline)
+            return false;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return true;
+}
+
+/* Completions in the order they were reported, by the index handed over as
+ * context. */
+struct Completions
+{
+    void add(UStatus status, size_t index)
+    {
+        lock_guard<mutex> lock(guard);
+        reported.push_back(make_pair(index, status));
+    }
+
+    vector<pair<size_t, UStatus>> get()
+    {
+        lock_guard<mutex> lock(guard);
+        return reported;
+    }
+
+    size_t size()
+    {
+        lock_guard<mutex> lock(guard);
+        return reported.size();
+    }
+
+    mutex guard;
+    vector<pair<size_t, UStatus>> reported;
+};
+
+Completions completions;
+
+void on_completion(UStatus status, void* context)
+{
+    completions.add(status, reinterpret_cast<size_t>(context));
+}
+
+void* index(size_t i)
+{
+    return reinterpret_cast<void*>(i);
+}
+}
+
+/* The stand-in usensord runs on a private session bus, shared by all tests
+ * as the library keeps a single connection per bus. */
+class HapticTest : public testing::Test
+{
+  protected:
+    static void SetUpTestCase()
+    {
+        fixture = new core::dbus::Fixture
+        {
+            core::dbus::Fixture::default_session_bus_config_file(),
+            core::dbus::Fixture::default_system_bus_config_file()
+        };
+        session_bus = new standin::Dispatcher{fixture->create_connection_to_session_bus()};
+        usensord = new standin::USensorD{session_bus->bus};
+    }
+
+    static void TearDownTestCase()
+    {
+        delete usensord;
+        delete session_bus;
+        delete fixture;
+    }
+
+    virtual void SetUp()
+    {
+        usensord->clear();
+        usensord->failing = false;
+        {
+            lock_guard<mutex> lock(completions.guard);
+            completions.reported.clear();
+        }
+
+        haptic = ua_sensors_haptic_new();
+        ASSERT_TRUE(haptic != NULL);
+        ASSERT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_enable(haptic));
+    }
+
+    virtual void TearDown()
+    {
+        if (haptic != NULL)
+            ua_sensors_haptic_destroy(haptic);
+        for (UASensorsHapticPattern* p : patterns)
+            ua_sensors_haptic_pattern_destroy(p);
+        patterns.clear();
+    }
+
+    UASensorsHapticPattern* pattern(const vector<uint32_t>& durations, uint32_t repeat)
+    {
+        UASensorsHapticPattern* p = ua_sensors_haptic_pattern_new(durations.data(), durations.size(), repeat);
+        if (p != NULL)
+            patterns.push_back(p);
+        return p;
+    }
+
+    static core::dbus::Fixture* fixture;
+    static standin::Dispatcher* session_bus;
+    static standin::USensorD* usensord;
+
+    UASensorsHaptic* haptic;
+    vector<UASensorsHapticPattern*> patterns;
+};
+
+core::dbus::Fixture* HapticTest::fixture = NULL;
+standin::Dispatcher* HapticTest::session_bus = NULL;
+standin::USensorD* HapticTest::usensord = NULL;
+
+TEST_F(HapticTest, invalid_patterns)
+{
+    uint32_t durations[] = {100, 50};
+
+    EXPECT_EQ(NULL, ua_sensors_haptic_pattern_new(NULL, 2, 1));
+    EXPECT_EQ(NULL, ua_sensors_haptic_pattern_new(durations, 0, 1));
+    EXPECT_EQ(NULL, ua_sensors_haptic_pattern_new(durations, 2, 0));
+
+    UASensorsHapticPattern* p = pattern({100, 50}, 1);
+    ASSERT_TRUE(p != NULL);
+    EXPECT_EQ(U_STATUS_ERROR, ua_sensors_haptic_vibrate_pattern(NULL, p, NULL, NULL));
+    EXPECT_EQ(U_STATUS_ERROR, ua_sensors_haptic_vibrate_pattern(haptic, NULL, NULL, NULL));
+
+    ua_sensors_haptic_disable(haptic);
+    EXPECT_EQ(U_STATUS_ERROR, ua_sensors_haptic_vibrate_pattern(haptic, p, NULL, NULL));
+}
+
+TEST_F(HapticTest, without_window_every_request_is_sent_as_is)
+{
+    UASensorsHapticPattern* a = pattern({100, 50}, 3);
+    UASensorsHapticPattern* b = pattern({20}, 1);
+
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, a, on_completion, index(0)));
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, b, on_completion, index(1)));
+
+    ASSERT_TRUE(wait_for([]() { return completions.size() == 2; }));
+    auto received = usensord->received_patterns();
+    ASSERT_EQ(2u, received.size());
+    EXPECT_EQ(vector<uint32_t>({100, 50}), received[0].durations);
+    EXPECT_EQ(3u, received[0].repeat);
+    EXPECT_EQ(vector<uint32_t>({20}), received[1].durations);
+    EXPECT_EQ(1u, received[1].repeat);
+
+    auto reported = completions.get();
+    EXPECT_EQ(make_pair(size_t(0), U_STATUS_SUCCESS), reported[0]);
+    EXPECT_EQ(make_pair(size_t(1), U_STATUS_SUCCESS), reported[1]);
+}
+
+TEST_F(HapticTest, requests_within_window_are_merged)
+{
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_set_coalescing_window(haptic, 100));
+
+    UASensorsHapticPattern* a = pattern({100}, 1);
+    UASensorsHapticPattern* b = pattern({30, 40}, 2);
+    UASensorsHapticPattern* c = pattern({10, 20, 30}, 2);
+
+    auto start = chrono::steady_clock::now();
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, a, on_completion, index(0)));
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, b, on_completion, index(1)));
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, c, on_completion, index(2)));
+
+    ASSERT_TRUE(wait_for([]() { return completions.size() == 3; }));
+    EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(100));
+
+    // a single request, played back to back; odd-length patterns get a zero
+    // pause at the seam so that the next one starts with "on" again
+    auto received = usensord->received_patterns();
+    ASSERT_EQ(1u, received.size());
+    EXPECT_EQ(vector<uint32_t>({100, 0, 30, 40, 30, 40, 10, 20, 30, 0, 10, 20, 30}), received[0].durations);
+    EXPECT_EQ(1u, received[0].repeat);
+
+    // every merged request is completed, in order
+    auto reported = completions.get();
+    for (size_t i = 0; i < 3; i++)
+        EXPECT_EQ(make_pair(i, U_STATUS_SUCCESS), reported[i]);
+}
+
+TEST_F(HapticTest, full_batch_is_sent_early)
+{
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_set_coalescing_window(haptic, 500));
+
+    // two of them do not fit into a single request
+    vector<uint32_t> durations(max_merged_pattern_size / 2 + 1, 10);
+    UASensorsHapticPattern* p = pattern(durations, 1);
+
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, p, on_completion, index(0)));
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, p, on_completion, index(1)));
+
+    // the first one goes out right away, the second one waits for the window
+    ASSERT_TRUE(wait_for([]() { return completions.size() == 1; }, chrono::milliseconds(250)));
+    EXPECT_EQ(1u, usensord->received_patterns().size());
+
+    ASSERT_TRUE(wait_for([]() { return completions.size() == 2; }));
+    auto received = usensord->received_patterns();
+    ASSERT_EQ(2u, received.size());
+    EXPECT_EQ(durations, received[0].durations);
+    EXPECT_EQ(durations, received[1].durations);
+}
+
+TEST_F(HapticTest, long_patterns_are_not_merged_but_keep_order)
+{
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_set_coalescing_window(haptic, 500));
+
+    UASensorsHapticPattern* a = pattern({100}, 1);
+    // too long to be merged once repeated
+    UASensorsHapticPattern* b = pattern({10, 20}, max_merged_pattern_size);
+
+    auto start = chrono::steady_clock::now();
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, a, on_completion, index(0)));
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, b, on_completion, index(1)));
+
+    // the pending request is sent first, without waiting for the window
+    ASSERT_TRUE(wait_for([]() { return completions.size() == 2; }));
+    EXPECT_LT(chrono::steady_clock::now() - start, chrono::milliseconds(500));
+
+    auto received = usensord->received_patterns();
+    ASSERT_EQ(2u, received.size());
+    EXPECT_EQ(vector<uint32_t>({100}), received[0].durations);
+    EXPECT_EQ(vector<uint32_t>({10, 20}), received[1].durations);
+    EXPECT_EQ(uint32_t(max_merged_pattern_size), received[1].repeat);
+}
+
+TEST_F(HapticTest, closing_window_sends_pending_requests)
+{
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_set_coalescing_window(haptic, 10000));
+
+    UASensorsHapticPattern* p = pattern({100, 50}, 1);
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, p, on_completion, index(0)));
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, p, on_completion, index(1)));
+
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_set_coalescing_window(haptic, 0));
+    ASSERT_TRUE(wait_for([]() { return completions.size() == 2; }, chrono::seconds(2)));
+
+    auto received = usensord->received_patterns();
+    ASSERT_EQ(1u, received.size());
+    EXPECT_EQ(vector<uint32_t>({100, 50, 100, 50}), received[0].durations);
+}
+
+TEST_F(HapticTest, failure_is_reported_to_every_merged_request)
+{
+    usensord->failing = true;
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_set_coalescing_window(haptic, 50));
+
+    UASensorsHapticPattern* p = pattern({100}, 1);
+    for (size_t i = 0; i < 3; i++)
+        EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, p, on_completion, index(i)));
+
+    ASSERT_TRUE(wait_for([]() { return completions.size() == 3; }));
+    EXPECT_EQ(1u, usensord->received_patterns().size());
+
+    auto reported = completions.get();
+    for (size_t i = 0; i < 3; i++)
+        EXPECT_EQ(make_pair(i, U_STATUS_ERROR), reported[i]);
+}
+
+TEST_F(HapticTest, destroying_sends_pending_requests_without_completing_them)
+{
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_set_coalescing_window(haptic, 10000));
+
+    UASensorsHapticPattern* p = pattern({100, 50}, 1);
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_haptic_vibrate_pattern(haptic, p, on_completion, index(0)));
+
+    ua_sensors_haptic_destroy(haptic);
+    haptic = NULL;
+
+    ASSERT_TRUE(wait_for([]() { return usensord->received_patterns().size() == 1; }));
+    this_thread::sleep_for(chrono::milliseconds(50));
+    EXPECT_EQ(0u, completions.size());
+}
@@ -37,6 +37,8 @@
 #include <ubuntu/application/sensors/magnetic.h>
 #include <ubuntu/application/sensors/event/magnetic.h>
 
+#include <private/application/sensors/sensor_recording.h>
+
 using namespace std;
 
 typedef chrono::time_point<chrono::system_clock,chrono::nanoseconds> time_point_system_ns;
@@ -278,3 +280,143 @@ TESTP_F(SimBackendTest, AccelEvents, {
     EXPECT_GE(delay, 1050);
     EXPECT_LE(delay, 1150);
 })
+
+TESTP_F(SimBackendTest, ReplayRecording, {
+    namespace uas = ubuntu::application::sensors;
+
+    // two gyroscope readings 20 ms apart and a far proximity reading 5 s later,
+    // which needs an absolute timestamp in the recording
+    {
+        uas::recording::Writer writer;
+        ASSERT_TRUE(writer.open(data_file));
+        writer.add_sensor(uas::sensor_type_gyroscope, -20, 20, 0.01, 0);
+        writer.add_sensor(uas::sensor_type_proximity, 0, 5, 1, 0);
+
+        float rotation[3];
+        rotation[0] = 0.5; rotation[1] = -1.5; rotation[2] = 2.5;
+        writer.record(uas::sensor_type_gyroscope, 1000000000, rotation);
+        rotation[0] = 3.5;
+        writer.record(uas::sensor_type_gyroscope, 1020000000, rotation);
+        float distance = 5;
+        writer.record(uas::sensor_type_proximity, 6020000000, &distance);
+    }
+
+    setenv("UBUNTU_PLATFORM_API_SENSOR_REPLAY", data_file, 1);
+    setenv("UBUNTU_PLATFORM_API_SENSOR_REPLAY_MODE", "fast", 1);
+
+    EXPECT_EQ(NULL, ua_sensors_accelerometer_new());
+    UASensorsGyroscope *g = ua_sensors_gyroscope_new();
+    UASensorsProximity *p = ua_sensors_proximity_new();
+    EXPECT_TRUE(g != NULL);
+    EXPECT_TRUE(p != NULL);
+
+    float max = 0.f; ua_sensors_gyroscope_get_max_value(g, &max);
+    EXPECT_FLOAT_EQ(20.0, max);
+
+    ua_sensors_gyroscope_set_reading_cb(g,
+        [](UASGyroscopeEvent* ev, void* ctx) {
+            float x; uas_gyroscope_event_get_rate_of_rotation_around_x(ev, &x);
+            float y; uas_gyroscope_event_get_rate_of_rotation_around_y(ev, &y);
+            float z; uas_gyroscope_event_get_rate_of_rotation_around_z(ev, &z);
+            events.push({uas_gyroscope_event_get_timestamp(ev), x, y, z,
+                         (UASProximityDistance) 0, ctx});
+        }, NULL);
+    ua_sensors_proximity_set_reading_cb(p,
+        [](UASProximityEvent* ev, void* ctx) {
+            events.push({uas_proximity_event_get_timestamp(ev),
+                         .0, .0, .0,
+                         uas_proximity_event_get_distance(ev),
+                         ctx});
+        }, NULL);
+    ua_sensors_gyroscope_enable(g);
+
+    // replay only starts once all requested sensors are enabled
+    usleep(50000);
+    EXPECT_EQ(0, events.size());
+
+    ua_sensors_proximity_enable(p);
+
+    // fast mode does not wait for the 5 s gap
+    usleep(200000);
+    ASSERT_EQ(3, events.size());
+
+    auto e = events.front();
+    events.pop();
+    EXPECT_EQ(1000000000u, e.timestamp);
+    EXPECT_FLOAT_EQ(0.5, e.x);
+    EXPECT_FLOAT_EQ(-1.5, e.y);
+    EXPECT_FLOAT_EQ(2.5, e.z);
+
+    e = events.front();
+    events.pop();
+    EXPECT_EQ(1020000000u, e.timestamp);
+    EXPECT_FLOAT_EQ(3.5, e.x);
+
+    e = events.front();
+    events.pop();
+    EXPECT_EQ(6020000000u, e.timestamp);
+    EXPECT_EQ(U_PROXIMITY_FAR, e.distance);
+})
+
+TESTP_F(SimBackendTest, RateGovernor, {
+    namespace uas = ubuntu::application::sensors;
+
+    // 3 s of a device lying still, then a jolt and a few more still readings
+    {
+        uas::recording::Writer writer;
+        ASSERT_TRUE(writer.open(data_file));
+        writer.add_sensor(uas::sensor_type_accelerometer, -1000, 1000, 0.1, 0);
+
+        float accel[3];
+        for (int i = 0; i < 310; i++) {
+            accel[0] = (i % 2) ? 0.01 : -0.01;
+            accel[1] = 0;
+            accel[2] = (i == 300) ? 12.0 : 9.81;
+            writer.record(uas::sensor_type_accelerometer, 1000000000 + i * 10000000LL, accel);
+        }
+    }
+
+    setenv("UBUNTU_PLATFORM_API_SENSOR_REPLAY", data_file, 1);
+    setenv("UBUNTU_PLATFORM_API_SENSOR_REPLAY_MODE", "fast", 1);
+
+    UASensorsAccelerometer *s = ua_sensors_accelerometer_new();
+    ASSERT_TRUE(s != NULL);
+
+    UASensorsRateGovernorStats stats;
+    EXPECT_EQ(U_STATUS_ERROR, ua_sensors_accelerometer_get_rate_governor_stats(s, &stats));
+
+    UASensorsRateGovernorConfig config;
+    memset(&config, 0, sizeof(config));
+    config.stillness_window = 16;
+    config.stillness_duration = 500;
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_set_rate_governor(s, &config));
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_set_event_rate(s, 10000000));
+
+    // the application sees every reading, along with the governor state at that time
+    ua_sensors_accelerometer_set_reading_cb(s,
+        [](UASAccelerometerEvent* ev, void* ctx) {
+            UASensorsRateGovernorStats stats;
+            ua_sensors_accelerometer_get_rate_governor_stats(ctx, &stats);
+            events.push({uas_accelerometer_event_get_timestamp(ev), .0, .0, .0,
+                         (UASProximityDistance) stats.idle, ctx});
+        }, s);
+    ua_sensors_accelerometer_enable(s);
+
+    usleep(200000);
+    ASSERT_EQ(310, events.size());
+
+    // idle after a full window plus 500 ms of stillness, active again on the jolt
+    for (int i = 0; i < 310; i++) {
+        bool expect_idle = i >= 15 + 50 && i < 300;
+        EXPECT_EQ(expect_idle, events.front().distance != 0) << "reading " << i;
+        events.pop();
+    }
+
+    ASSERT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_get_rate_governor_stats(s, &stats));
+    EXPECT_FALSE(stats.idle);
+    EXPECT_EQ(2u, stats.transitions);
+
+    // removing the governor hands the callback back to the backend
+    EXPECT_EQ(U_STATUS_SUCCESS, ua_sensors_accelerometer_set_rate_governor(s, NULL));
+    EXPECT_EQ(U_STATUS_ERROR, ua_sensors_accelerometer_get_rate_governor_stats(s, &stats));
+})
@@ -0,0 +1,331 @@
+/*
+ * Copyright © 2020 UBports Foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include <ubuntu/hardware/gps.h>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+// Wraps a sentence body, the text between '$' and '*', with its checksum.
+string sentence(const string& body, const char* line_end = "\r\n")
+{
+    unsigned char checksum = 0;
+    for (char c : body)
+        checksum ^= static_cast<unsigned char>(c);
+
+    char hex[3];
+    snprintf(hex, sizeof(hex), "%02X", checksum);
+    return "$" + body + "*" + hex + line_end;
+}
+
+int parse(const string& text, UHardwareGpsNmeaSentence& out)
+{
+    return u_hardware_gps_nmea_parse(text.data(), int(text.size()), &out);
+}
+
+const double meters_per_second_per_knot = 1852. / 3600.;
+}
+
+TEST(GpsNmea, gga)
+{
+    UHardwareGpsNmeaSentence s;
+    string text = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+
+    EXPECT_EQ(int(text.size()), parse(text, s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_GGA, s.type);
+    EXPECT_STREQ("GP", s.talker);
+    EXPECT_EQ(45319000u, s.u.gga.time_of_day);
+    EXPECT_NEAR(48.1173, s.u.gga.latitude, 1e-9);
+    EXPECT_NEAR(11.516667, s.u.gga.longitude, 1e-6);
+    EXPECT_EQ(1, s.u.gga.quality);
+    EXPECT_EQ(8, s.u.gga.satellites_in_use);
+    EXPECT_FLOAT_EQ(0.9f, s.u.gga.hdop);
+    EXPECT_FLOAT_EQ(545.4f, s.u.gga.altitude);
+    EXPECT_FLOAT_EQ(46.9f, s.u.gga.geoid_separation);
+}
+
+TEST(GpsNmea, gga_without_fix)
+{
+    UHardwareGpsNmeaSentence s;
+    string text = sentence("GNGGA,000001.25,,,,,0,00,,,M,,M,,");
+
+    ASSERT_EQ(int(text.size()), parse(text, s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_GGA, s.type);
+    EXPECT_STREQ("GN", s.talker);
+    EXPECT_EQ(1250u, s.u.gga.time_of_day);
+    EXPECT_TRUE(std::isnan(s.u.gga.latitude));
+    EXPECT_TRUE(std::isnan(s.u.gga.longitude));
+    EXPECT_EQ(0, s.u.gga.quality);
+    EXPECT_TRUE(std::isnan(s.u.gga.hdop));
+    EXPECT_TRUE(std::isnan(s.u.gga.altitude));
+}
+
+TEST(GpsNmea, rmc)
+{
+    UHardwareGpsNmeaSentence s;
+    ASSERT_LT(0, parse("$GPRMC,123519,A,4807.038,S,01131.000,W,022.4,084.4,230394,003.1,W*65\r\n", s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_RMC, s.type);
+    EXPECT_EQ(45319000u, s.u.rmc.time_of_day);
+    EXPECT_EQ('A', s.u.rmc.status);
+    EXPECT_NEAR(-48.1173, s.u.rmc.latitude, 1e-9);
+    EXPECT_NEAR(-11.516667, s.u.rmc.longitude, 1e-6);
+    EXPECT_NEAR(22.4 * meters_per_second_per_knot, s.u.rmc.speed, 1e-4);
+    EXPECT_FLOAT_EQ(84.4f, s.u.rmc.course);
+    EXPECT_EQ(1994, s.u.rmc.year);
+    EXPECT_EQ(3, s.u.rmc.month);
+    EXPECT_EQ(23, s.u.rmc.day);
+    EXPECT_FLOAT_EQ(-3.1f, s.u.rmc.magnetic_variation);
+    EXPECT_EQ(0, s.u.rmc.mode);
+
+    // NMEA 2.3 with a mode indicator, without a date
+    ASSERT_LT(0, parse(sentence("GNRMC,235959.999,V,,,,,,,,,,N"), s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_RMC, s.type);
+    EXPECT_EQ(86399999u, s.u.rmc.time_of_day);
+    EXPECT_EQ('V', s.u.rmc.status);
+    EXPECT_EQ(0, s.u.rmc.year);
+    EXPECT_EQ('N', s.u.rmc.mode);
+}
+
+TEST(GpsNmea, gsa)
+{
+    UHardwareGpsNmeaSentence s;
+    ASSERT_LT(0, parse("$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n", s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_GSA, s.type);
+    EXPECT_EQ('A', s.u.gsa.selection);
+    EXPECT_EQ(3, s.u.gsa.fix_type);
+    ASSERT_EQ(5, s.u.gsa.count);
+    EXPECT_EQ(4, s.u.gsa.prn[0]);
+    EXPECT_EQ(5, s.u.gsa.prn[1]);
+    EXPECT_EQ(9, s.u.gsa.prn[2]);
+    EXPECT_EQ(12, s.u.gsa.prn[3]);
+    EXPECT_EQ(24, s.u.gsa.prn[4]);
+    EXPECT_FLOAT_EQ(2.5f, s.u.gsa.pdop);
+    EXPECT_FLOAT_EQ(1.3f, s.u.gsa.hdop);
+    EXPECT_FLOAT_EQ(2.1f, s.u.gsa.vdop);
+    EXPECT_EQ(0, s.u.gsa.system);
+
+    // NMEA 4.1 with the system id
+    ASSERT_LT(0, parse(sentence("GNGSA,A,3,65,66,,,,,,,,,,,1.9,1.0,1.6,2"), s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_GSA, s.type);
+    EXPECT_EQ(2, s.u.gsa.count);
+    EXPECT_EQ(2, s.u.gsa.system);
+}
+
+TEST(GpsNmea, gsv)
+{
+    UHardwareGpsNmeaSentence s;
+    ASSERT_LT(0, parse("$GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*75\r\n", s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_GSV, s.type);
+    EXPECT_EQ(2, s.u.gsv.total_messages);
+    EXPECT_EQ(1, s.u.gsv.message_number);
+    EXPECT_EQ(8, s.u.gsv.satellites_in_view);
+    ASSERT_EQ(4, s.u.gsv.count);
+    EXPECT_EQ(1, s.u.gsv.satellites[0].prn);
+    EXPECT_EQ(40, s.u.gsv.satellites[0].elevation);
+    EXPECT_EQ(83, s.u.gsv.satellites[0].azimuth);
+    EXPECT_EQ(46, s.u.gsv.satellites[0].snr);
+    EXPECT_EQ(14, s.u.gsv.satellites[3].prn);
+    EXPECT_EQ(45, s.u.gsv.satellites[3].snr);
+
+    // the last message, a satellite not tracked and the NMEA 4.1 signal id
+    ASSERT_LT(0, parse(sentence("GLGSV,2,2,06,70,12,,,71,45,120,33,1"), s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_GSV, s.type);
+    ASSERT_EQ(2, s.u.gsv.count);
+    EXPECT_EQ(70, s.u.gsv.satellites[0].prn);
+    EXPECT_EQ(-1, s.u.gsv.satellites[0].azimuth);
+    EXPECT_EQ(-1, s.u.gsv.satellites[0].snr);
+    EXPECT_EQ(71, s.u.gsv.satellites[1].prn);
+    EXPECT_EQ(33, s.u.gsv.satellites[1].snr);
+}
+
+TEST(GpsNmea, vtg)
+{
+    UHardwareGpsNmeaSentence s;
+    ASSERT_LT(0, parse("$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n", s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_VTG, s.type);
+    EXPECT_FLOAT_EQ(54.7f, s.u.vtg.course);
+    EXPECT_FLOAT_EQ(34.4f, s.u.vtg.magnetic_course);
+    EXPECT_NEAR(5.5 * meters_per_second_per_knot, s.u.vtg.speed, 1e-4);
+    EXPECT_EQ(0, s.u.vtg.mode);
+
+    // km/h only
+    ASSERT_LT(0, parse(sentence("GPVTG,,T,,M,,N,36.0,K,A"), s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_VTG, s.type);
+    EXPECT_TRUE(std::isnan(s.u.vtg.course));
+    EXPECT_FLOAT_EQ(10.f, s.u.vtg.speed);
+    EXPECT_EQ('A', s.u.vtg.mode);
+
+    // before NMEA 2.3, without the unit fields
+    ASSERT_LT(0, parse(sentence("GPVTG,054.7,034.4,005.5,010.2"), s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_VTG, s.type);
+    EXPECT_FLOAT_EQ(34.4f, s.u.vtg.magnetic_course);
+    EXPECT_NEAR(5.5 * meters_per_second_per_knot, s.u.vtg.speed, 1e-4);
+}
+
+TEST(GpsNmea, bad_checksums_are_not_decoded)
+{
+    UHardwareGpsNmeaSentence s;
+    const string good = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+
+    // still consumed, so that the next sentence can be read
+    string wrong = good;
+    wrong[wrong.find('*') + 2] = '8';
+    EXPECT_EQ(int(wrong.size()), parse(wrong, s));
+    EXPECT_EQ(U_HARDWARE_GPS_NMEA_UNKNOWN, s.type);
+
+    string garbled = good;
+    garbled.replace(garbled.find('*') + 1, 2, "G7");
+    EXPECT_EQ(int(garbled.size()), parse(garbled, s));
+    EXPECT_EQ(U_HARDWARE_GPS_NMEA_UNKNOWN, s.type);
+
+    string missing = good.substr(0, good.find('*')) + "\r\n";
+    EXPECT_EQ(int(missing.size()), parse(missing, s));
+    EXPECT_EQ(U_HARDWARE_GPS_NMEA_UNKNOWN, s.type);
+
+    string truncated = good.substr(0, good.find('*') + 2);
+    EXPECT_EQ(int(truncated.size()), parse(truncated, s));
+    EXPECT_EQ(U_HARDWARE_GPS_NMEA_UNKNOWN, s.type);
+
+    // lower case digits are fine
+    string lower = sentence("GPVTG,,T,,M,,N,,K,N");
+    for (size_t i = lower.find('*'); i < lower.size(); i++)
+        lower[i] = char(tolower(lower[i]));
+    ASSERT_LT(0, parse(lower, s));
+    EXPECT_EQ(U_HARDWARE_GPS_NMEA_VTG, s.type);
+}
+
+TEST(GpsNmea, unsupported_sentences_are_not_decoded)
+{
+    UHardwareGpsNmeaSentence s;
+    for (const string& text : {sentence("GPZDA,201530.00,04,07,2002,00,00"),
+                               sentence("PGRME,15.0,M,45.0,M,25.0,M"),
+                               sentence("GPGG,1"),
+                               string("!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\r\n")})
+    {
+        EXPECT_EQ(int(text.size()), parse(text, s)) << text;
+        EXPECT_EQ(U_HARDWARE_GPS_NMEA_UNKNOWN, s.type) << text;
+    }
+}
+
+TEST(GpsNmea, reads_one_sentence_after_the_other)
+{
+    const string sentences[] =
+    {
+        "$GPRMC,123519,A,4807.038,S,01131.000,W,022.4,084.4,230394,003.1,W*65\r\n",
+        "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\n",
+        // bad checksum
+        "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*38\r\n",
+        "$GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*75\r\n",
+    };
+    const UHardwareGpsNmeaSentenceType types[] =
+    {
+        U_HARDWARE_GPS_NMEA_RMC,
+        U_HARDWARE_GPS_NMEA_VTG,
+        U_HARDWARE_GPS_NMEA_UNKNOWN,
+        U_HARDWARE_GPS_NMEA_GSV,
+    };
+
+    // noise before the first one, as after a buffer overrun
+    string buffer = "1,M,,*4A\r\n";
+    for (const string& s : sentences)
+        buffer += s;
+
+    UHardwareGpsNmeaSentence s;
+    const char* p = buffer.data();
+    int left = int(buffer.size());
+    for (size_t i = 0; i < 4; i++)
+    {
+        int consumed = u_hardware_gps_nmea_parse(p, left, &s);
+        ASSERT_LT(0, consumed);
+        EXPECT_EQ(types[i], s.type) << i;
+        p += consumed;
+        left -= consumed;
+    }
+    EXPECT_EQ(0, left);
+    EXPECT_EQ(0, u_hardware_gps_nmea_parse(p, left, &s));
+    EXPECT_EQ(0, u_hardware_gps_nmea_parse("\r\n", 2, &s));
+}
+
+TEST(GpsNmea, text_ends_at_a_zero_terminator)
+{
+    UHardwareGpsNmeaSentence s;
+    string text = "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48";
+    text += '\0';
+    text += "$GPGGA,123519";
+
+    EXPECT_EQ(int(text.size()), parse(text, s));
+    EXPECT_EQ(U_HARDWARE_GPS_NMEA_VTG, s.type);
+}
+
+// Bodies from a few bytes, read by the scalar loop alone, to several times
+// the 16 byte blocks of the SIMD loop, with a separator on every offset.
+TEST(GpsNmea, decodes_every_length_and_separator_offset)
+{
+    for (int padding = 0; padding < 64; padding++)
+    {
+        // Leading zeros move the following separators along.
+        string prn = string(padding % 8, '0') + "7";
+        string body = "GPGSA,A,3," + prn;
+        for (int i = 1; i < padding / 8; i++)
+            body += "," + string(i % 7, '0') + to_string(i);
+
+        UHardwareGpsNmeaSentence s;
+        string text = sentence(body);
+        ASSERT_EQ(int(text.size()), parse(text, s)) << body;
+        ASSERT_EQ(U_HARDWARE_GPS_NMEA_GSA, s.type) << body;
+        EXPECT_EQ('A', s.u.gsa.selection) << body;
+        EXPECT_EQ(3, s.u.gsa.fix_type) << body;
+        ASSERT_EQ(max(1, padding / 8), s.u.gsa.count) << body;
+        EXPECT_EQ(7, s.u.gsa.prn[0]) << body;
+        for (int i = 1; i < padding / 8; i++)
+            EXPECT_EQ(i, s.u.gsa.prn[i]) << body;
+    }
+
+    // the shortest sentences
+    UHardwareGpsNmeaSentence s;
+    ASSERT_LT(0, parse(sentence("GPVTG"), s));
+    EXPECT_EQ(U_HARDWARE_GPS_NMEA_VTG, s.type);
+    EXPECT_TRUE(std::isnan(s.u.vtg.course));
+    ASSERT_LT(0, parse(sentence("GPGSA,M"), s));
+    EXPECT_EQ(U_HARDWARE_GPS_NMEA_GSA, s.type);
+    EXPECT_EQ('M', s.u.gsa.selection);
+}
+
+// Every byte feeds the checksum, in the SIMD lanes as well as in the tail.
+TEST(GpsNmea, any_changed_byte_fails_the_checksum)
+{
+    const string good = sentence("GPRMC,123519,A,4807.038,S,01131.000,W,022.4,084.4,230394,003.1,W", "");
+    const size_t star = good.find('*');
+
+    UHardwareGpsNmeaSentence s;
+    ASSERT_LT(0, parse(good, s));
+    ASSERT_EQ(U_HARDWARE_GPS_NMEA_RMC, s.type);
+
+    for (size_t i = 1; i < star; i++)
+    {
+        string bad = good;
+        bad[i] = bad[i] == '1' ? '2' : '1';
+        ASSERT_LT(0, parse(bad, s));
+        EXPECT_EQ(U_HARDWARE_GPS_NMEA_UNKNOWN, s.type) << "changed byte " << i;
+    }
+}